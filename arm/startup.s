@@ -7,6 +7,16 @@
 
 .extern main
 .extern SysTick_Handler
+.extern EEFC1_Handler
+.extern DMAC_Handler
+.extern UOTGHS_Handler
+.extern CAN0_Handler
+.extern CAN1_Handler
+.extern PWM_Handler
+.extern RTT_Handler
+.extern TC6_Handler
+.extern TC7_Handler
+.extern TC8_Handler
 
 .extern _estack
 .extern _sidata
@@ -46,8 +56,55 @@ g_pfnVectors:
      então +1 é uma garantia prática aqui. */
   .word (SysTick_Handler + 1) /* SysTick */
 
-  /* 64 IRQs "genéricos" (ok pra começar) */
-  .rept 64
+  /* IRQs do SAM3X8E (IRQn = peripheral ID). Handlers em Swift usam +1. */
+  .word Default_Handler       /*  0 SUPC   */
+  .word Default_Handler       /*  1 RSTC   */
+  .word Default_Handler       /*  2 RTC    */
+  .word (RTT_Handler + 1)     /*  3 RTT    */
+  .word Default_Handler       /*  4 WDT    */
+  .word Default_Handler       /*  5 PMC    */
+  .word Default_Handler       /*  6 EFC0   */
+  .word (EEFC1_Handler + 1)   /*  7 EFC1   */
+  .word Default_Handler       /*  8 UART   */
+  .word Default_Handler       /*  9 SMC    */
+  .word Default_Handler       /* 10 -      */
+  .word Default_Handler       /* 11 PIOA   */
+  .word Default_Handler       /* 12 PIOB   */
+  .word Default_Handler       /* 13 PIOC   */
+  .word Default_Handler       /* 14 PIOD   */
+  .word Default_Handler       /* 15 -      */
+  .word Default_Handler       /* 16 -      */
+  .word Default_Handler       /* 17 USART0 */
+  .word Default_Handler       /* 18 USART1 */
+  .word Default_Handler       /* 19 USART2 */
+  .word Default_Handler       /* 20 USART3 */
+  .word Default_Handler       /* 21 HSMCI  */
+  .word Default_Handler       /* 22 TWI0   */
+  .word Default_Handler       /* 23 TWI1   */
+  .word Default_Handler       /* 24 SPI0   */
+  .word Default_Handler       /* 25 -      */
+  .word Default_Handler       /* 26 SSC    */
+  .word Default_Handler       /* 27 TC0    */
+  .word Default_Handler       /* 28 TC1    */
+  .word Default_Handler       /* 29 TC2    */
+  .word Default_Handler       /* 30 TC3    */
+  .word Default_Handler       /* 31 TC4    */
+  .word Default_Handler       /* 32 TC5    */
+  .word (TC6_Handler + 1)     /* 33 TC6    */
+  .word (TC7_Handler + 1)     /* 34 TC7    */
+  .word (TC8_Handler + 1)     /* 35 TC8    */
+  .word (PWM_Handler + 1)     /* 36 PWM    */
+  .word Default_Handler       /* 37 ADC    */
+  .word Default_Handler       /* 38 DACC   */
+  .word (DMAC_Handler + 1)    /* 39 DMAC   */
+  .word (UOTGHS_Handler + 1)  /* 40 UOTGHS */
+  .word Default_Handler       /* 41 TRNG   */
+  .word Default_Handler       /* 42 EMAC   */
+  .word (CAN0_Handler + 1)    /* 43 CAN0   */
+  .word (CAN1_Handler + 1)    /* 44 CAN1   */
+
+  /* Resto da tabela (mantém 64 IRQs no total) */
+  .rept 19
     .word Default_Handler
   .endr
 
@@ -0,0 +1,92 @@
+// bench/main.swift — benchmark firmware (`make bench-firmware`).
+//
+// Replaces src/main.swift in the bench build: registers the driver
+// benchmarks with Bench and prints the report at boot.
+//
+// Pins:
+//  D5 -> run the suite again
+//  D13 (LED) -> gpio_toggle
+//  A0 -> adc_read12 (leave floating or tie to anything)
+//  SDA/SCL (Wire) -> i2c_probe: address-only write to 0x68, NACK without a device
+//
+// Prints at boot:
+//  BENCH_BEGIN build=<git describe> cpu_hz=84000000 overhead=... count=...
+//  BENCH name=... iters=... min=... median=... max=...   (cycles, one per benchmark)
+//  BENCH_END
+//
+// Host:
+//  tools/bench.py capture /dev/ttyACM0 -o build/bench/<rev>.txt
+//  tools/bench.py compare build/bench/old.txt build/bench/new.txt
+//
+// Notes:
+// - eefc_save erases + programs a flash page per call: 8 calls per run (the
+//   A/B slots share them), keep re-runs reasonable.
+// - uart_write_byte is paced by the baud rate once the holding register is
+//   full (~7300 cycles per byte at 115200); it sends CR bytes only.
+// - mmio_* use GPBR7 (backup register, unused by the drivers).
+//
+
+// benchBuild (String, `git describe`) comes from build/bench/BenchBuild.swift,
+// written by the Makefile.
+
+// The firmware's own CRC32 (MMIO.swift), so crc32_1k tracks what EEFC,
+// FlashLog and FirmwareUpdater pay.
+@inline(never)
+func benchCRC32(_ buf: UnsafeMutableBufferPointer<U8>) -> U32 {
+    ~crc32Update(0xFFFF_FFFF, buf)
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard(printBootBanner: false)
+    let serial = ctx.serial
+    let timer  = ctx.timer
+    let i2c    = ctx.i2c
+    bm_enable_irq()
+
+    let led = PIN(13)
+    led.output()
+    let bAgain = PIN(5)
+    bAgain.inputPullup()
+    let a0 = AnalogPIN(0)
+    i2c.begin()
+
+    let store = EEFCStorage()
+    let kBench = EEFCKey("bench")
+    _ = store.save(key: kBench, value: U32(0))
+
+    let src = UnsafeMutableBufferPointer<U8>.allocate(capacity: 1024)
+    let dst = UnsafeMutableBufferPointer<U8>.allocate(capacity: 1024)
+    src.initialize(repeating: 0xA5)
+    dst.initialize(repeating: 0)
+    let gpbr7 = ATSAM3X8E.GPBR_BASE + 7 * ATSAM3X8E.GPBR.STRIDE
+    var sink: U32 = 0
+
+    let bench = Bench(build: benchBuild)
+    bench.add("gpio_toggle", iterations: 1000, lockIRQ: true) { led.toggle() }
+    bench.add("mmio_read32", iterations: 1000, lockIRQ: true) { sink &+= read32(gpbr7) }
+    bench.add("mmio_write32", iterations: 1000, lockIRQ: true) { write32(gpbr7, sink) }
+    bench.add("uart_write_byte", iterations: 64) { serial.writeByte(13) }
+    bench.add("i2c_probe", iterations: 32) {
+        i2c.beginTransmission(0x68)
+        sink &+= U32(i2c.endTransmission())
+    }
+    bench.add("adc_read12", iterations: 256) { sink &+= U32((try? a0.readRaw()) ?? 0) }
+    bench.add("eefc_load", iterations: 64) {
+        if case .success(let v) = store.loadU32(key: kBench) { sink &+= v }
+    }
+    bench.add("eefc_save", iterations: 8) {
+        sink &+= 1
+        _ = store.save(key: kBench, value: sink)
+    }
+    bench.add("memcpy_1k", iterations: 256, lockIRQ: true) {
+        UnsafeMutableRawPointer(dst.baseAddress!).copyMemory(from: src.baseAddress!, byteCount: 1024)
+    }
+    bench.add("crc32_1k", iterations: 32, lockIRQ: true) { sink &+= benchCRC32(src) }
+
+    while true {
+        bench.run(serial, cpuHz: ctx.cpuHz)
+        while !bAgain.isLow() { timer.sleep(ms: 10) }
+        while bAgain.isLow() { timer.sleep(ms: 10) }
+    }
+}
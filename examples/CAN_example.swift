@@ -0,0 +1,189 @@
+// CAN_example.swift
+//
+// Example: CAN filters in loopback, then a fully loaded 1 Mbit/s bus
+// between CAN0 (sender) and CAN1 (receiver) on the same board.
+//
+// Wiring (bus test, two 3.3 V transceivers, e.g. SN65HVD230):
+//  CANTX/CANRX (PA0/PA1)   -> transceiver A (CAN0)
+//  D53 (PB14) / DAC0 (PB15) -> transceiver B (CAN1)
+//  CANH-CANH, CANL-CANL, 120 ohm at both ends
+//
+// Pins:
+//  D5 -> reset the counters
+//
+// Every second the bus test prints:
+//  frames/s, bus load (permille of 1 Mbit/s, unstuffed), sequence gaps,
+//  rx lost (mailbox FIFO), rx overruns (queue), queue high-water,
+//  error counters and TEC/REC
+//
+// Notes:
+// - Without transceivers begin() fails with not_synchronized and only the
+//   loopback check runs.
+// - CAN0 keeps its TX queue full of 8-byte frames (ID 0x100, byte 0..3 =
+//   sequence); CAN1 receives with one accept-all FIFO of 6 mailboxes.
+//   "gaps=0 lost=0 overruns=0" at ~7,000 frames/s = no drops at full load.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+/// Loopback: filters (standard range + extended PGN) through the queues.
+func loopbackCheck(_ serial: SerialUART) -> Bool {
+    let can = CAN(.can0, mckHz: 84_000_000)
+    do throws(CAN.Error) {
+        try can.begin(bitrate: 1_000_000, mode: .loopback)
+        try can.addFilter(id: 0x100, mask: 0x700, depth: 2)                          // 0x100...0x1FF
+        try can.addFilter(id: 0x18DA_F100, mask: 0x1FFF_FF00, extended: true)        // 0x18DAF1xx
+
+        try can.send(CAN.Frame(id: 0x123, length: 2, dataLow: 0xBEEF))
+        try can.send(CAN.Frame(id: 0x223, length: 1))                                // rejected
+        try can.send(CAN.Frame(id: 0x18DA_F122, extended: true, length: 8, dataLow: 1, dataHigh: 2))
+        try can.send(CAN.Frame(id: 0x18DB_F122, extended: true))                     // rejected
+    } catch {
+        serial.writeString("LOOPBACK ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        return false
+    }
+
+    var ok = true
+    if let f = can.receive() {
+        ok = ok && f.id == 0x123 && !f.extended && f[0] == 0xEF && f[1] == 0xBE
+    } else {
+        ok = false
+    }
+    if let f = can.receive() {
+        ok = ok && f.id == 0x18DA_F122 && f.extended && f.dataHigh == 2
+    } else {
+        ok = false
+    }
+    ok = ok && can.receive() == nil
+
+    serial.writeString(ok ? "LOOPBACK PASS\r\n" : "LOOPBACK FAIL\r\n")
+    return ok
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    _ = loopbackCheck(serial)
+
+    if let t = CAN.timing(bitrate: 1_000_000, mckHz: 84_000_000) {
+        serial.writeString("TIMING brp=")
+        serial.writeString(decU32(t.prescaler))
+        serial.writeString(" tq=")
+        serial.writeString(decU32(t.quantaPerBit))
+        serial.writeString(" prop=")
+        serial.writeString(decU32(t.propagation))
+        serial.writeString(" ph1=")
+        serial.writeString(decU32(t.phase1))
+        serial.writeString(" ph2=")
+        serial.writeString(decU32(t.phase2))
+        serial.writeString(" sp_permille=")
+        serial.writeString(decU32(t.samplePointPermille))
+        serial.writeString("\r\n")
+    }
+
+    let tx = CAN(.can0, mckHz: 84_000_000)
+    let rx = CAN(.can1, mckHz: 84_000_000, rxQueueSize: 128)
+    do throws(CAN.Error) {
+        try rx.begin(bitrate: 1_000_000, txMailboxes: 2)
+        try rx.acceptAll()
+        try tx.begin(bitrate: 1_000_000, txMailboxes: 3)
+    } catch {
+        serial.writeString("BUS ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+    bm_enable_irq()
+
+    let bReset = PIN(5)
+    bReset.inputPullup()
+    var last5 = false
+
+    var seqTx: U32 = 0
+    var seqRx: U32 = 0
+    var gaps: U32 = 0
+    var bits: U32 = 0
+    var frames: U32 = 0
+    var nextReport = timer.millis() &+ 1000
+
+    while true {
+        // Keep the sender saturated: the bus, not the CPU, sets the rate.
+        while tx.txPending < 16 {
+            do throws(CAN.Error) {
+                try tx.send(CAN.Frame(id: 0x100, length: 8, dataLow: seqTx, dataHigh: ~seqTx))
+                seqTx &+= 1
+            } catch {
+                break
+            }
+        }
+
+        while let f = rx.receive() {
+            if f.dataLow != seqRx { gaps &+= 1 }
+            seqRx = f.dataLow &+ 1
+            bits &+= f.bits
+            frames &+= 1
+        }
+
+        let p5 = bReset.isLow()
+        if !last5 && p5 {
+            tx.resetStats()
+            rx.resetStats()
+            gaps = 0
+        }
+        last5 = p5
+
+        let now = timer.millis()
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            let st = rx.stats
+            let ts = tx.stats
+            let ec = tx.errorCounters
+            serial.writeString("frames_s=")
+            serial.writeString(decU32(frames))
+            serial.writeString(" load_permille=")
+            serial.writeString(decU32(bits / 1000))
+            serial.writeString(" gaps=")
+            serial.writeString(decU32(gaps))
+            serial.writeString(" lost=")
+            serial.writeString(decU32(st.rxLost))
+            serial.writeString(" overruns=")
+            serial.writeString(decU32(st.rxOverruns))
+            serial.writeString(" q_max=")
+            serial.writeString(decU32(st.rxQueueMax))
+            serial.writeString(" ack_err=")
+            serial.writeString(decU32(ts.ackErrors))
+            serial.writeString(" bus_off=")
+            serial.writeString(decU32(ts.busOff))
+            serial.writeString(" tec=")
+            serial.writeString(decU32(ec.tx))
+            serial.writeString(" rec=")
+            serial.writeString(decU32(ec.rx))
+            serial.writeString("\r\n")
+            frames = 0
+            bits = 0
+        }
+    }
+}
@@ -0,0 +1,101 @@
+// DMAMemory_example.swift
+//
+// Example: calibrate the CPU/DMA copy threshold, then copy a 16 KiB buffer
+// asynchronously while the CPU keeps counting.
+//
+// Pins:
+//  D5  -> run one async 16 KiB dmaCopy and report CPU loops done meanwhile
+//
+// At boot the example prints one line per calibration size:
+//  bytes, cpu cycles, dma cycles — then the chosen threshold.
+//
+// Notes:
+// - bm_enable_irq() lets the completion come from DMAC_Handler; without it,
+//   DMA.poll() in the loop retires the transfer instead.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+// Written from the DMAC completion (IRQ context).
+var g_copyDone = false
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+
+    bm_enable_irq()
+
+    let scratch = UnsafeMutableRawBufferPointer.allocate(byteCount: 8192, alignment: 4)
+    let t = DMAMemory.calibrate(scratch: scratch) { s in
+        serial.writeString("bytes=")
+        serial.writeString(decU32(s.bytes))
+        serial.writeString(" cpu_cycles=")
+        serial.writeString(decU32(s.cpuCycles))
+        serial.writeString(" dma_cycles=")
+        serial.writeString(decU32(s.dmaCycles))
+        serial.writeString("\r\n")
+    }
+    serial.writeString("threshold=")
+    serial.writeString(decU32(U32(t)))
+    serial.writeString("\r\n")
+
+    let size = 16 * 1024
+    let src = UnsafeMutableRawBufferPointer.allocate(byteCount: size, alignment: 4)
+    let dst = UnsafeMutableRawBufferPointer.allocate(byteCount: size, alignment: 4)
+    dmaFill(dst: src.baseAddress!, value: 0xA5, len: size)
+
+    let bCopy = PIN(5)
+    bCopy.inputPullup()
+    var last5 = false
+
+    serial.writeString("DMAMemory test ready\r\n")
+
+    while true {
+        DMA.poll()
+
+        let p5 = bCopy.isLow()
+        if !last5 && p5 {
+            g_copyDone = false
+            let t0 = CycleCounter.now()
+            dmaCopy(dst: dst.baseAddress!, src: UnsafeRawPointer(src.baseAddress!), len: size) { _ in
+                g_copyDone = true
+            }
+
+            // CPU work while the DMAC moves the buffer.
+            var loops: U32 = 0
+            while !g_copyDone {
+                loops &+= 1
+                DMA.poll()
+            }
+            let cycles = CycleCounter.now() &- t0
+
+            serial.writeString("copy bytes=")
+            serial.writeString(decU32(U32(size)))
+            serial.writeString(" cycles=")
+            serial.writeString(decU32(cycles))
+            serial.writeString(" cpu_loops=")
+            serial.writeString(decU32(loops))
+            serial.writeString(dst[size - 1] == 0xA5 ? " OK\r\n" : " MISMATCH\r\n")
+        }
+        last5 = p5
+    }
+}
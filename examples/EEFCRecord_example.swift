@@ -0,0 +1,120 @@
+// EEFCRecord_example.swift — persist a calibration struct as one KV entry
+//
+// Pins:
+//  A0  -> raw input used to capture the offset
+//  D5  -> capture offset = A0 now, bump saves counter, save record
+//  D6  -> load & print the record (zero-copy from flash)
+//  D7  -> remove the record (next load -> defaults)
+//
+// Notes:
+// - Calibration v2 appended `gainX1000`: a record saved by v1 firmware loads
+//   with its stored fields and gainX1000 = 1000 (init() default).
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+struct Calibration: EEFCRecord {
+    static let recordVersion: U16 = 2
+
+    var offset: U16 = 0
+    var saves: U16 = 0
+    var flags: U32 = 0
+    var gainX1000: U32 = 1000     // v2
+
+    init() {}
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+
+    let store = EEFCStorage()
+    let kCal = EEFCKey("cal")
+    let a0 = AnalogPIN(0)
+
+    let bSave   = PIN(5)
+    let bLoad   = PIN(6)
+    let bRemove = PIN(7)
+    bSave.inputPullup()
+    bLoad.inputPullup()
+    bRemove.inputPullup()
+
+    var last5 = false
+    var last6 = false
+    var last7 = false
+
+    serial.writeString("EEFC record test ready\r\n")
+
+    while true {
+        let p5 = bSave.isLow()
+        let p6 = bLoad.isLow()
+        let p7 = bRemove.isLow()
+
+        // D5 — capture + save
+        if !last5 && p5 {
+            var cal = store.loadRecordOrDefault(Calibration.self, key: kCal)
+            if let raw = try? a0.readRaw() { cal.offset = raw }
+            cal.saves &+= 1
+
+            if let err = store.save(key: kCal, record: cal) {
+                serial.writeString("SAVE cal FAIL: ")
+                serial.writeString(err.name)
+                serial.writeString("\r\n")
+            } else {
+                serial.writeString("SAVE cal OK\r\n")
+            }
+        }
+
+        // D6 — load
+        if !last6 && p6 {
+            switch store.loadRecord(Calibration.self, key: kCal) {
+            case .success(let cal):
+                serial.writeString("LOAD cal offset=")
+                serial.writeString(decU32(U32(cal.offset)))
+                serial.writeString(" saves=")
+                serial.writeString(decU32(U32(cal.saves)))
+                serial.writeString(" gain_x1000=")
+                serial.writeString(decU32(cal.gainX1000))
+                serial.writeString("\r\n")
+            case .failure(let e):
+                serial.writeString("LOAD cal FAIL: ")
+                serial.writeString(e.name)
+                serial.writeString("\r\n")
+            }
+        }
+
+        // D7 — remove
+        if !last7 && p7 {
+            if let err = store.remove(key: kCal) {
+                serial.writeString("REMOVE cal FAIL: ")
+                serial.writeString(err.name)
+                serial.writeString("\r\n")
+            } else {
+                serial.writeString("REMOVE cal OK\r\n")
+            }
+        }
+
+        last5 = p5
+        last6 = p6
+        last7 = p7
+    }
+}
@@ -38,6 +38,10 @@ public func main() -> Never {
 
     let store = EEFCStorage()
 
+    // Interned keys: validated + hashed once, not on every access.
+    let kTime  = EEFCKey("time")
+    let kHello = EEFCKey("hello")
+
     // ---------------- GPIO ----------------
 
     let bSaveTime   = PIN(5)
@@ -80,7 +84,7 @@ public func main() -> Never {
         // D5 — save time
         if !last5 && p5 {
             let t = timer.millis()
-            if let err = store.save(key: "time", value: t) {
+            if let err = store.save(key: kTime, value: t) {
                 serial.writeString("SAVE time FAIL: ")
                 serial.writeString(err.name)
                 serial.writeString("\r\n")
@@ -93,7 +97,7 @@ public func main() -> Never {
 
         // D6 — load time
         if !last6 && p6 {
-            switch store.loadU32(key: "time") {
+            switch store.loadU32(key: kTime) {
             case .success(let t):
                 serial.writeString("LOAD time = ")
                 serial.writeString(decU32(t))
@@ -108,12 +112,12 @@ public func main() -> Never {
         // D7 — append "Hello "
         if !last7 && p7 {
             var current = ""
-            if case .success(let s) = store.loadString(key: "hello") {
+            if case .success(let s) = store.loadString(key: kHello) {
                 current = s
             }
             current += "Hello "
 
-            if let err = store.save(key: "hello", value: current) {
+            if let err = store.save(key: kHello, value: current) {
                 serial.writeString("SAVE hello FAIL: ")
                 serial.writeString(err.name)
                 serial.writeString("\r\n")
@@ -124,7 +128,7 @@ public func main() -> Never {
 
         // D8 — load hello
         if !last8 && p8 {
-            switch store.loadString(key: "hello") {
+            switch store.loadString(key: kHello) {
             case .success(let s):
                 serial.writeString("LOAD hello = ")
                 serial.writeString(s)
@@ -138,7 +142,7 @@ public func main() -> Never {
 
         // D9 — clear hello
         if !last9 && p9 {
-            if let err = store.remove(key: "hello") {
+            if let err = store.remove(key: kHello) {
                 serial.writeString("REMOVE hello FAIL: ")
                 serial.writeString(err.name)
                 serial.writeString("\r\n")
@@ -149,7 +153,7 @@ public func main() -> Never {
 
         // D10 — clear time
         if !last10 && p10 {
-            if let err = store.remove(key: "time") {
+            if let err = store.remove(key: kTime) {
                 serial.writeString("REMOVE time FAIL: ")
                 serial.writeString(err.name)
                 serial.writeString("\r\n")
@@ -0,0 +1,179 @@
+// FATLog_example.swift
+//
+// Example: stream A0 samples as text lines into LOG.BIN on an SD card.
+//
+// Pins:
+//  D42 (PA19) -> MCCK      D43 (PA20) -> MCCDA (CMD)
+//  PA21..PA24 -> MCDA0..3  (TX LED, A3, A4, A5 pads)
+//  A0  -> sampled every millisecond
+//  D5  -> sync() (partial buffer + header to the card)
+//  D6  -> print card / volume info
+//
+// Every second the example prints:
+//  bytes/s, total size, buffer writes, overruns, dropped, card busy max (us)
+//
+// Notes:
+// - Prepare the card with tools/sdimage.py create + dd (LOG.BIN must be
+//   contiguous), read it back with dd and tools/sdimage.py dump.
+// - Line format: "<ms>,<a0>\n".
+// - log.poll() must run in the loop; append() never waits for the card.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+/// Decimal digits of `value` into `p`; returns the count.
+@inline(__always)
+func putDec(_ p: UnsafeMutablePointer<UInt8>, _ value: U32) -> Int {
+    var v = value
+    var n = 0
+    repeat {
+        p[n] = UInt8(v % 10) + 48
+        v /= 10
+        n += 1
+    } while v > 0
+
+    var i = 0
+    var j = n - 1
+    while i < j {
+        let t = p[i]
+        p[i] = p[j]
+        p[j] = t
+        i += 1
+        j -= 1
+    }
+    return n
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let card = SDCard(mckHz: 84_000_000)
+    do throws(BlockDeviceError) {
+        let info = try card.begin()
+        serial.writeString("SD mb=")
+        serial.writeString(decU32(info.megabytes))
+        serial.writeString(" bus=")
+        serial.writeString(decU32(info.busWidth))
+        serial.writeString(" mcck_hz=")
+        serial.writeString(decU32(info.clockHz))
+        serial.writeString(info.highSpeed ? " hs=1\r\n" : " hs=0\r\n")
+    } catch {
+        serial.writeString("SD ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+
+    let log = FATLog(device: card, config: FATLog<SDCard>.Config(name: "LOG.BIN", bufferBlocks: 16))
+    do throws(FATLog<SDCard>.Error) {
+        try log.mount()
+    } catch {
+        serial.writeString("LOG ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+    serial.writeString("LOG size=")
+    serial.writeString(decU32(log.size))
+    serial.writeString(" capacity=")
+    serial.writeString(decU32(log.capacity))
+    serial.writeString(" recovered=")
+    serial.writeString(decU32(log.stats.recovered))
+    serial.writeString("\r\n")
+
+    let a0 = AnalogPIN(0)
+    let bSync = PIN(5)
+    let bInfo = PIN(6)
+    bSync.inputPullup()
+    bInfo.inputPullup()
+    var last5 = false
+    var last6 = false
+
+    let line = UnsafeMutablePointer<UInt8>.allocate(capacity: 24)
+    var nextSample = timer.millis()
+    var nextReport = nextSample &+ 1000
+    var lastAppended: U32 = 0
+
+    while true {
+        log.poll()
+
+        let now = timer.millis()
+        if ((now &- nextSample) & 0x8000_0000) == 0 {
+            nextSample = nextSample &+ 1
+            if let raw = try? a0.readRaw() {
+                var n = putDec(line, now)
+                line[n] = 0x2C                      // ','
+                n += 1
+                n += putDec(line + n, U32(raw))
+                line[n] = 0x0A
+                n += 1
+                log.append(UnsafeRawPointer(line), count: n)
+            }
+        }
+
+        let p5 = bSync.isLow()
+        let p6 = bInfo.isLow()
+
+        if !last5 && p5 {
+            serial.writeString(log.sync() ? "SYNC OK size=" : "SYNC FAIL size=")
+            serial.writeString(decU32(log.size))
+            serial.writeString("\r\n")
+        }
+
+        if !last6 && p6, let v = log.volume {
+            serial.writeString("VOL part_lba=")
+            serial.writeString(decU32(v.partitionLBA))
+            serial.writeString(" spc=")
+            serial.writeString(decU32(v.sectorsPerCluster))
+            serial.writeString(" file_lba=")
+            serial.writeString(decU32(v.fileLBA))
+            serial.writeString(" file_blocks=")
+            serial.writeString(decU32(v.fileBlocks))
+            serial.writeString("\r\n")
+        }
+
+        last5 = p5
+        last6 = p6
+
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            let st = log.stats
+            let cs = card.stats
+            serial.writeString("bytes_s=")
+            serial.writeString(decU32(st.appended &- lastAppended))
+            serial.writeString(" size=")
+            serial.writeString(decU32(log.size))
+            serial.writeString(" writes=")
+            serial.writeString(decU32(st.writes))
+            serial.writeString(" overruns=")
+            serial.writeString(decU32(st.overruns))
+            serial.writeString(" dropped=")
+            serial.writeString(decU32(st.dropped))
+            serial.writeString(" busy_max_us=")
+            serial.writeString(decU32(cs.maxBusyCycles / 84))
+            serial.writeString("\r\n")
+            lastAppended = st.appended
+        }
+    }
+}
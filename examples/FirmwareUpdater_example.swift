@@ -0,0 +1,102 @@
+// FirmwareUpdater_example.swift
+//
+// Example: blink D13 while listening for an A/B firmware update.
+//
+// Pins:
+//  D13 -> blinks (500 ms) so you can see which image is running
+//  D5  -> print bank info (running / boot / max image size)
+//
+// Host:
+//  make images
+//  tools/fwupdate.py /dev/ttyACM0
+//
+// Notes:
+// - updater.poll() must be called from the loop. Until a BEGIN frame arrives
+//   it only drains the UART; the transfer itself blocks until END/ABORT.
+// - After SWITCH the board resets into the other bank.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let updater = FirmwareUpdater(serial: serial, timer: timer)
+
+    let led = PIN(13)
+    led.output()
+
+    let bInfo = PIN(5)
+    bInfo.inputPullup()
+    var last5 = false
+
+    var lastReportMs: U32 = 0
+    var nextBlink = timer.millis() &+ 500
+
+    serial.writeString("FirmwareUpdater ready, running from bank ")
+    serial.writeString(decU32(updater.runningBank))
+    serial.writeString("\r\n")
+
+    while true {
+        updater.poll()
+
+        // Verified with --no-switch: print the device-side throughput once.
+        if let r = updater.report, r.elapsedMs != lastReportMs {
+            lastReportMs = r.elapsedMs
+            serial.writeString("update bytes=")
+            serial.writeString(decU32(r.bytes))
+            serial.writeString(" ms=")
+            serial.writeString(decU32(r.elapsedMs))
+            serial.writeString(" bytes_s=")
+            serial.writeString(decU32(r.bytesPerSecond))
+            serial.writeString(" stalls=")
+            serial.writeString(decU32(r.stalls))
+            serial.writeString(" written=")
+            serial.writeString(decU32(r.pagesWritten))
+            serial.writeString(" copied=")
+            serial.writeString(decU32(r.pagesCopied))
+            serial.writeString(" skipped=")
+            serial.writeString(decU32(r.pagesSkipped))
+            serial.writeString("\r\n")
+        }
+
+        let now = timer.millis()
+        if ((now &- nextBlink) & 0x8000_0000) == 0 {
+            nextBlink = now &+ 500
+            led.toggle()
+        }
+
+        let p5 = bInfo.isLow()
+        if !last5 && p5 {
+            serial.writeString("running_bank=")
+            serial.writeString(decU32(updater.runningBank))
+            serial.writeString(" target_bank=")
+            serial.writeString(decU32(updater.inactiveBank))
+            serial.writeString(" max_image=")
+            serial.writeString(decU32(updater.maxImageSize))
+            serial.writeString("\r\n")
+        }
+        last5 = p5
+    }
+}
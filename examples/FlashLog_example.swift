@@ -0,0 +1,122 @@
+// FlashLog_example.swift
+//
+// Example: log A0 into the bank-1 flash ring and report throughput.
+//
+// Pins:
+//  A0  -> sampled every loop iteration (as fast as the loop runs)
+//  D5  -> dump the whole log over serial (oldest -> newest)
+//  D6  -> dump records from the last 5 seconds (seek by time)
+//  D7  -> flush the partial RAM page to flash
+//
+// Every second the example prints:
+//  rec/s, bytes/record (x100), flash bytes/record (x100), pages, dropped
+//
+// Notes:
+// - FlashLog.poll() must be called from the loop (page programming).
+// - Samples are only logged when the value changes by more than 2 LSB,
+//   which is what makes delta/varint encoding pay off.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let log = FlashLog()
+    let a0 = AnalogPIN(0)
+
+    let bDumpAll  = PIN(5)
+    let bDumpLast = PIN(6)
+    let bFlush    = PIN(7)
+    bDumpAll.inputPullup()
+    bDumpLast.inputPullup()
+    bFlush.inputPullup()
+
+    var last5 = false
+    var last6 = false
+    var last7 = false
+
+    var lastValue: Int32 = -1000
+    var nextReport = timer.millis() &+ 1000
+
+    serial.writeString("FlashLog test ready\r\n")
+
+    while true {
+        log.poll()
+
+        let now = timer.millis()
+        if let raw = try? a0.readRaw() {
+            let v = Int32(raw)
+            if v > lastValue + 2 || v < lastValue - 2 {
+                _ = log.append(timeMs: now, value: v)
+                lastValue = v
+            }
+        }
+
+        let p5 = bDumpAll.isLow()
+        let p6 = bDumpLast.isLow()
+        let p7 = bFlush.isLow()
+
+        if (!last5 && p5) || (!last6 && p6) {
+            var c = p5 ? log.cursor() : log.seek(timeMs: now &- 5000)
+            var n: U32 = 0
+            while let r = c.next() {
+                serial.writeString(decU32(r.timeMs))
+                serial.writeString(",")
+                serial.writeString(decU32(U32(bitPattern: r.value)))
+                serial.writeString("\r\n")
+                n &+= 1
+            }
+            serial.writeString("DUMP records=")
+            serial.writeString(decU32(n))
+            serial.writeString("\r\n")
+        }
+
+        if !last7 && p7 {
+            serial.writeString(log.flush() ? "FLUSH OK\r\n" : "FLUSH FAIL\r\n")
+        }
+
+        last5 = p5
+        last6 = p6
+        last7 = p7
+
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            let st = log.stats
+            serial.writeString("rec_s=")
+            serial.writeString(decU32(st.recordsPerSecond))
+            serial.writeString(" bpr_x100=")
+            serial.writeString(decU32(st.bytesPerRecordX100))
+            serial.writeString(" flash_bpr_x100=")
+            serial.writeString(decU32(st.flashBytesPerRecordX100))
+            serial.writeString(" pages=")
+            serial.writeString(decU32(st.pagesWritten))
+            serial.writeString(" compactions=")
+            serial.writeString(decU32(st.compactions))
+            serial.writeString(" dropped=")
+            serial.writeString(decU32(st.dropped))
+            serial.writeString("\r\n")
+        }
+    }
+}
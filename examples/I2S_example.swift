@@ -0,0 +1,200 @@
+// I2S_example.swift
+//
+// Example: I2S clock table, an internal-loopback latency measurement, then
+// a duplex fixed-point DSP chain (DC blocker + gain) between a codec's ADC
+// and DAC.
+//
+// Wiring (parts clocked by BCLK/WS alone, e.g. an INMP441 microphone and
+// a MAX98357A amplifier):
+//  D23 (TK) -> BCLK, D24 (TF) -> LRCK/WS, A0 (TD) -> amplifier DIN
+//  A9 (RD) <- microphone SD  (RK/RF unused: the receiver runs on TK/TF)
+//
+// Pins:
+//  D5 -> reset the counters
+//  D6 -> gain: 1.0 / 0.5 / 0.25 (Q15)
+//
+// Prints at boot:
+//  CLOCK rate=... bits=... div=... actual=... ppm=...
+//  LOOPBACK latency_frames=... expected=...
+//
+// Every second prints:
+//  blocks, underruns/overruns, SSC overruns, processing cycles (last/max),
+//  CPU load (permille of the half-buffer period), latency in us
+//
+// Notes:
+// - 48 kHz, 16-bit, 64 frames per half: 1.33 ms blocks, ~2.7 ms latency.
+// - The DSP runs in DMAC_Handler; keep it under one half buffer.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@inline(__always)
+func saturate16(_ v: Int32) -> Int16 {
+    v > 32767 ? 32767 : (v < -32768 ? -32768 : Int16(v))
+}
+
+/// SSC loopback (TD -> RD inside the SSC): send one impulse, count frames
+/// until it comes back.
+func loopbackLatency(_ i2s: I2S, _ timer: Timer) -> U32 {
+    var framesOut: U32 = 0
+    var sentAt: U32 = 0
+    var measured: U32 = 0
+    var sent = false
+
+    do throws(I2S.Error) {
+        try i2s.begin(I2S.Config(framesPerHalf: 64, loopback: true)) { block in
+            guard let inp = block.input16, let out = block.output16 else { return }
+            var f = 0
+            while f < block.frames {
+                if sent && measured == 0 && inp[2 * f] == 0x4000 {
+                    measured = framesOut &+ U32(f) &- sentAt
+                }
+                out[2 * f] = 0
+                out[2 * f + 1] = 0
+                f += 1
+            }
+            if !sent && framesOut >= 1024 {         // let the stream settle first
+                out[0] = 0x4000
+                sentAt = framesOut
+                sent = true
+            }
+            framesOut &+= U32(block.frames)
+        }
+        try i2s.start()
+    } catch {
+        return 0
+    }
+    let deadline = timer.millis() &+ 200
+    // IRQs are still off: poll() runs the processor in this loop.
+    while measured == 0 && ((timer.millis() &- deadline) & 0x8000_0000) != 0 {
+        i2s.poll()
+    }
+    i2s.stop()
+    return measured
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let rates: [U32] = [8_000, 44_100, 48_000, 96_000]
+    for rate in rates {
+        for format in [I2S.Format.s16, I2S.Format.s32] {
+            guard let c = I2S.clock(sampleRate: rate, format: format, mckHz: ctx.mckHz) else { continue }
+            serial.writeString("CLOCK rate=")
+            serial.writeString(decU32(rate))
+            serial.writeString(" bits=")
+            serial.writeString(decU32(format.slotBits))
+            serial.writeString(" div=")
+            serial.writeString(decU32(c.divider))
+            serial.writeString(" actual=")
+            serial.writeString(decU32(c.sampleRate))
+            serial.writeString(" ppm=")
+            if c.errorPpm < 0 { serial.writeString("-") }
+            serial.writeString(decU32(c.errorPpm.magnitude))
+            serial.writeString("\r\n")
+        }
+    }
+
+    let i2s = I2S(mckHz: ctx.mckHz)
+    let measured = loopbackLatency(i2s, timer)
+    serial.writeString("LOOPBACK latency_frames=")
+    serial.writeString(decU32(measured))
+    serial.writeString(" expected=")
+    serial.writeString(decU32(i2s.latencyFrames))
+    serial.writeString("\r\n")
+
+    bm_enable_irq()
+
+    // Duplex DSP: per channel y = x - x1 + 0.995 * y1 (DC blocker), then gain.
+    var gainQ15: Int32 = 32767
+    var x1: (Int32, Int32) = (0, 0)
+    var y1: (Int32, Int32) = (0, 0)
+    let poleQ15: Int32 = 32604                      // 0.995
+
+    do throws(I2S.Error) {
+        try i2s.begin(I2S.Config(sampleRate: 48_000, format: .s16, direction: .duplex, framesPerHalf: 64)) { block in
+            guard let inp = block.input16, let out = block.output16 else { return }
+            var f = 0
+            while f < block.frames {
+                let l = Int32(inp[2 * f])
+                let r = Int32(inp[2 * f + 1])
+                let yl = l - x1.0 + ((poleQ15 * y1.0) >> 15)
+                let yr = r - x1.1 + ((poleQ15 * y1.1) >> 15)
+                x1 = (l, r)
+                y1 = (yl, yr)
+                out[2 * f] = saturate16((yl * gainQ15) >> 15)
+                out[2 * f + 1] = saturate16((yr * gainQ15) >> 15)
+                f += 1
+            }
+        }
+        try i2s.start()
+    } catch {
+        serial.writeString("I2S ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+
+    let bReset = PIN(5)
+    let bGain = PIN(6)
+    bReset.inputPullup()
+    bGain.inputPullup()
+    var last5 = false
+    var last6 = false
+
+    var nextReport = timer.millis() &+ 1000
+
+    while true {
+        let p5 = bReset.isLow()
+        if !last5 && p5 { i2s.resetStats() }
+        last5 = p5
+
+        let p6 = bGain.isLow()
+        if !last6 && p6 { gainQ15 = gainQ15 > 8192 ? gainQ15 / 2 : 32767 }
+        last6 = p6
+
+        let now = timer.millis()
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            let st = i2s.stats
+            serial.writeString("blocks=")
+            serial.writeString(decU32(st.blocks))
+            serial.writeString(" underruns=")
+            serial.writeString(decU32(st.underruns))
+            serial.writeString(" overruns=")
+            serial.writeString(decU32(st.overruns))
+            serial.writeString(" ssc_overruns=")
+            serial.writeString(decU32(st.sscOverruns))
+            serial.writeString(" cycles=")
+            serial.writeString(decU32(st.lastProcessCycles))
+            serial.writeString(" max_cycles=")
+            serial.writeString(decU32(st.maxProcessCycles))
+            serial.writeString(" load_permille=")
+            serial.writeString(decU32(i2s.cpuLoadPermille))
+            serial.writeString(" latency_us=")
+            serial.writeString(decU32(i2s.latencyMicros))
+            serial.writeString("\r\n")
+        }
+    }
+}
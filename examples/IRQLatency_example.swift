@@ -0,0 +1,95 @@
+// IRQLatency_example.swift
+//
+// Example: print the NVIC priority plan, then the interrupt latency suite
+// (entry, tail-chaining, preemption) for every configuration.
+//
+// Pins:
+//  none
+//
+// Prints at boot:
+//  PLAN grouping=preempt2 systick=2.0
+//  PRIO irq=3 preempt=3 sub=0          (one line per NVIC.IRQ)
+//
+// Every 5 s prints, per configuration (cycles):
+//  LAT config=same_level entry_min=... entry_max=... tail_min=... tail_max=...
+//      preempt_min=... preempt_max=... preempted=0
+//
+// Expected at 84 MHz: entry ~12 + prologue, tail-chain ~6 + prologue;
+// preempted=1 only for "preempt" and "preempt4", where preempt_min stays
+// small while the others include IRQLatency.holdCycles.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+    bm_enable_irq()
+
+    let sysTick = NVIC.priority(of: .sysTick)
+    serial.writeString("PLAN grouping=preempt")
+    serial.writeString(decU32(NVIC.grouping.preemptBits))
+    serial.writeString(" systick=")
+    serial.writeString(decU32(sysTick.preempt))
+    serial.writeString(".")
+    serial.writeString(decU32(sysTick.sub))
+    serial.writeString("\r\n")
+    for irq in NVIC.IRQ.allCases {
+        serial.writeString("PRIO irq=")
+        serial.writeString(decU32(irq.rawValue))
+        serial.writeString(" preempt=")
+        serial.writeString(decU32(irq.plannedLevel.preempt.rawValue))
+        serial.writeString(" sub=")
+        serial.writeString(decU32(irq.plannedLevel.sub.rawValue))
+        serial.writeString("\r\n")
+    }
+
+    var next = timer.millis()
+
+    while true {
+        let now = timer.millis()
+        if ((now &- next) & 0x8000_0000) == 0 {
+            next = now &+ 5000
+            for r in IRQLatency.runAll() {
+                serial.writeString("LAT config=")
+                serial.writeString(r.name)
+                serial.writeString(" entry_min=")
+                serial.writeString(decU32(r.entry.min))
+                serial.writeString(" entry_max=")
+                serial.writeString(decU32(r.entry.max))
+                serial.writeString(" tail_min=")
+                serial.writeString(decU32(r.tailChain.min))
+                serial.writeString(" tail_max=")
+                serial.writeString(decU32(r.tailChain.max))
+                serial.writeString(" preempt_min=")
+                serial.writeString(decU32(r.preempt.min))
+                serial.writeString(" preempt_max=")
+                serial.writeString(decU32(r.preempt.max))
+                serial.writeString(" preempted=")
+                serial.writeString(r.preempted ? "1" : "0")
+                serial.writeString("\r\n")
+            }
+        }
+        timer.sleep(ms: 10)
+    }
+}
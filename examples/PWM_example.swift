@@ -0,0 +1,171 @@
+// PWM_example.swift
+//
+// Example: six-step three-phase commutation played by the PDC on a
+// synchronous, complementary, dead-timed channel group, plus an LED fade on
+// an independent channel, with the frequency/resolution table for 84 MHz.
+//
+// Pins:
+//  Phase A: D35 (PWMH0) / D34 (PWML0)
+//  Phase B: D37 (PWMH1) / D36 (PWML1)
+//  Phase C: D39 (PWMH2) / D38 (PWML2)
+//  D9 (PWML4) -> LED (fades, 1 kHz)
+//  D5 -> stop / restart the commutation table
+//
+// Prints at boot:
+//  bits=N left_hz=... center_hz=...   (highest frequency per resolution)
+//  plan for 20 kHz center-aligned: prescaler, period, resolution, tick
+//
+// Every second prints:
+//  table passes (6 steps each), PDC underruns, LED duty
+//
+// Notes:
+// - 20 kHz center-aligned, 500 ns dead-time: scope PWMH0 and PWML0 to see
+//   the gap at each edge. Each step holds for 16 update periods x 40 repeats
+//   (~32 ms), so a motor-less scope shows the sequence clearly.
+// - The CPU only touches the PWM for the LED and once per table pass.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    // Frequency / resolution trade-off at this MCK.
+    var bits: U32 = 8
+    while bits <= 16 {
+        serial.writeString("bits=")
+        serial.writeString(decU32(bits))
+        serial.writeString(" left_hz=")
+        serial.writeString(decU32(PWM.maxFrequency(bits: bits, mckHz: ctx.mckHz)))
+        serial.writeString(" center_hz=")
+        serial.writeString(decU32(PWM.maxFrequency(bits: bits, alignment: .center, mckHz: ctx.mckHz)))
+        serial.writeString("\r\n")
+        bits += 2
+    }
+
+    let pwm = PWM(mckHz: ctx.mckHz)
+    var planned: PWM.Plan? = nil
+    do throws(PWM.Error) {
+        planned = try pwm.configureSynchronous(
+            channels: 0b0111,
+            frequencyHz: 20_000,
+            alignment: .center,
+            output: .complementary,
+            deadTimeNs: 500,
+            updateEvery: 16
+        )
+        try pwm.configure(channel: 4, frequencyHz: 1_000, output: .low)
+    } catch {
+        serial.writeString("PWM ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+    guard let plan = planned else { while true { timer.sleepFor(ms: 1000) } }
+    serial.writeString("PLAN hz=")
+    serial.writeString(decU32(plan.actualHz))
+    serial.writeString(" prescaler_shift=")
+    serial.writeString(decU32(plan.prescalerShift))
+    serial.writeString(" period=")
+    serial.writeString(decU32(plan.period))
+    serial.writeString(" bits=")
+    serial.writeString(decU32(plan.resolutionBits))
+    serial.writeString(" tick_ps=")
+    serial.writeString(decU32(plan.tickPs))
+    serial.writeString("\r\n")
+
+    // Six steps: each phase high (75 %), low (25 %) or mid (50 %).
+    // A B C per step: H L M, H M L, M H L, L H M, L M H, M L H
+    let hi = U16(plan.period * 3 / 4)
+    let lo = U16(plan.period / 4)
+    let mid = U16(plan.period / 2)
+    let pattern: [U16] = [
+        hi, lo, mid,   hi, mid, lo,   mid, hi, lo,
+        lo, hi, mid,   lo, mid, hi,   mid, lo, hi,
+    ]
+    let repeats = 40
+    let steps = 6 * repeats
+    let table = UnsafeMutablePointer<U16>.allocate(capacity: steps * 3)
+    var s = 0
+    while s < steps {
+        let k = (s / repeats) * 3
+        table[s * 3] = pattern[k]
+        table[s * 3 + 1] = pattern[k + 1]
+        table[s * 3 + 2] = pattern[k + 2]
+        s += 1
+    }
+
+    bm_enable_irq()
+    var running = true
+    do throws(PWM.Error) {
+        try pwm.playDutyTable(table, steps: steps, loop: true)
+    } catch {
+        running = false
+    }
+    pwm.start(0b1_0001)                 // group (via channel 0) + LED channel
+
+    let bToggle = PIN(5)
+    bToggle.inputPullup()
+    var last5 = false
+
+    var led: U32 = 0
+    var up = true
+    var nextFade = timer.millis() &+ 5
+    var nextReport = timer.millis() &+ 1000
+
+    while true {
+        let p5 = bToggle.isLow()
+        if !last5 && p5 {
+            if running {
+                pwm.stopDutyTable()
+                running = false
+            } else {
+                running = (try? pwm.playDutyTable(table, steps: steps, loop: true)) != nil
+            }
+        }
+        last5 = p5
+
+        let now = timer.millis()
+        if ((now &- nextFade) & 0x8000_0000) == 0 {
+            nextFade = now &+ 5
+            if up { led += 5 } else { led -= 5 }
+            if led >= 1000 { up = false }
+            if led == 0 { up = true }
+            pwm.setDutyPermille(4, led)
+        }
+
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            serial.writeString("passes=")
+            serial.writeString(decU32(pwm.stats.tablePasses))
+            serial.writeString(" underruns=")
+            serial.writeString(decU32(pwm.stats.underruns))
+            serial.writeString(" running=")
+            serial.writeString(running ? "1" : "0")
+            serial.writeString(" led_permille=")
+            serial.writeString(decU32(led))
+            serial.writeString("\r\n")
+        }
+    }
+}
@@ -0,0 +1,116 @@
+// Power_example.swift
+//
+// Example: peripheral clock gating, measured wakeup latency per mode, and
+// an idle loop that picks the deepest mode meeting a latency budget.
+//
+// Pins:
+//  D5 -> switch the latency budget: 200 us (Sleep only) <-> 20 ms (WAIT allowed)
+//  D6 -> measure the backup-mode latency (the board resets, then prints it)
+//  D13 (LED) -> toggled every 500 ms, the only deadline
+//
+// Prints at boot:
+//  CLOCKS gated=...                      (enabled without a user: now off)
+//  LATENCY sleep_us=... wait_us=... backup_us=...
+//                                         (backup_us after a D6 press, else the default)
+//
+// Every 5 s prints:
+//  budget_us=... run=... sleep=... wait=... slept_ms=... late=...
+//
+// Notes:
+// - Serial output is given 2 ms to drain before idling (WAIT stops the UART clock).
+// - Buttons are read between idles: hold them up to 0.5 s.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let led = PIN(13)
+    led.output()
+    let bBudget = PIN(5)
+    bBudget.inputPullup()
+    let bBackup = PIN(6)
+    bBackup.inputPullup()
+
+    let tk = TimeKeeper(timer: timer)
+    tk.begin()
+    let power = Power(timeKeeper: tk, timer: timer)
+    let gated = power.begin()
+    serial.writeString("CLOCKS gated=")
+    serial.writeString(decU32(gated))
+    serial.writeString("\r\n")
+    timer.sleepFor(ms: 2)
+
+    let lat = power.measureLatency()
+    serial.writeString("LATENCY sleep_us=")
+    serial.writeString(decU32(lat.sleepUs))
+    serial.writeString(" wait_us=")
+    serial.writeString(decU32(lat.waitUs))
+    serial.writeString(" backup_us=")
+    serial.writeString(decU32(lat.backupUs))
+    serial.writeString("\r\n")
+
+    var budgetUs: U32 = 200
+    var nextBlink = timer.millis() &+ 500
+    var nextReport = timer.millis() &+ 5000
+
+    while true {
+        if bBudget.isLow() {
+            budgetUs = budgetUs == 200 ? 20_000 : 200
+            while bBudget.isLow() {}
+        }
+        if bBackup.isLow() {
+            serial.writeString("BACKUP measuring\r\n")
+            timer.sleepFor(ms: 2)
+            power.measureBackupLatency()
+        }
+
+        let now = timer.millis()
+        if ((now &- nextBlink) & 0x8000_0000) == 0 {
+            nextBlink = now &+ 500
+            led.toggle()
+        }
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 5000
+            let st = power.stats
+            serial.writeString("budget_us=")
+            serial.writeString(decU32(budgetUs))
+            serial.writeString(" run=")
+            serial.writeString(decU32(st.run))
+            serial.writeString(" sleep=")
+            serial.writeString(decU32(st.sleep))
+            serial.writeString(" wait=")
+            serial.writeString(decU32(st.wait))
+            serial.writeString(" slept_ms=")
+            serial.writeString(decU32(st.sleptMs))
+            serial.writeString(" late=")
+            serial.writeString(decU32(st.lateWakeups))
+            serial.writeString("\r\n")
+            timer.sleepFor(ms: 2)
+        }
+
+        power.idle(until: nextBlink, latencyBudgetUs: budgetUs)
+    }
+}
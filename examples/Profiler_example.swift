@@ -0,0 +1,135 @@
+// Profiler_example.swift
+//
+// Example: sample three workloads at 2 kHz for 5 s, then dump the profile
+// for tools/profile.py.
+//
+// Pins:
+//  D5 -> reset the table and profile another 5 s
+//
+// Prints at boot:
+//  PROFILING rate_hz=2000 capacity=1024
+//
+// After each run:
+//  STATS samples=... dropped=... entries=... isr_cycles_max=...
+//  PROFILE <hex bytes> + binary dump
+//
+// Host:
+//  tools/profile.py capture /dev/ttyACM0 -o build/profile.bin
+//  tools/profile.py report build/profile.bin --folded build/profile.folded --demangle
+//
+// Expected: most samples in checksumLoop and isqrt, the rest in Timer.sleep;
+// the leaf isqrt appears as "isqrtLoop;isqrt" in the folded stacks.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@inline(never)
+func checksumLoop(_ buf: UnsafeMutableBufferPointer<U8>) -> U32 {
+    var sum: U32 = 0
+    for b in buf { sum = (sum &<< 5) &+ sum &+ U32(b) }
+    return sum
+}
+
+@inline(never)
+func isqrt(_ x: U32) -> U32 {
+    var r: U32 = 0
+    var bit: U32 = 1 << 30
+    var n = x
+    while bit > n { bit >>= 2 }
+    while bit != 0 {
+        if n >= r + bit {
+            n -= r + bit
+            r = (r >> 1) + bit
+        } else {
+            r >>= 1
+        }
+        bit >>= 2
+    }
+    return r
+}
+
+@inline(never)
+func isqrtLoop(_ count: U32) -> U32 {
+    var acc: U32 = 0
+    var i: U32 = 1
+    while i <= count {
+        acc &+= isqrt(i &* 2654435761)
+        i += 1
+    }
+    return acc
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+    bm_enable_irq()
+
+    let buf = UnsafeMutableBufferPointer<U8>.allocate(capacity: 8 * 1024)
+    buf.initialize(repeating: 0x5A)
+
+    let profiler = Profiler()
+    do throws(Profiler.Error) {
+        try profiler.start(rateHz: 2000, mckHz: ctx.mckHz)
+    } catch {
+        serial.writeString("PROFILER ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+    serial.writeString("PROFILING rate_hz=")
+    serial.writeString(decU32(profiler.rateHz))
+    serial.writeString(" capacity=")
+    serial.writeString(decU32(U32(profiler.capacity)))
+    serial.writeString("\r\n")
+
+    let bAgain = PIN(5)
+    bAgain.inputPullup()
+    var sink: U32 = 0
+
+    while true {
+        let end = timer.millis() &+ 5000
+        while ((timer.millis() &- end) & 0x8000_0000) != 0 {
+            sink &+= checksumLoop(buf)
+            sink &+= isqrtLoop(400)
+            timer.sleep(ms: 2)
+        }
+
+        let st = profiler.stats
+        serial.writeString("STATS samples=")
+        serial.writeString(decU32(st.samples))
+        serial.writeString(" dropped=")
+        serial.writeString(decU32(st.dropped))
+        serial.writeString(" entries=")
+        serial.writeString(decU32(st.entries))
+        serial.writeString(" isr_cycles_max=")
+        serial.writeString(decU32(st.isrCyclesMax))
+        serial.writeString(" sink=")
+        serial.writeString(decU32(sink & 0xFF))
+        serial.writeString("\r\n")
+        profiler.dump(serial)
+        serial.writeString("\r\n")
+
+        while !bAgain.isLow() { timer.sleep(ms: 10) }
+        profiler.reset()
+    }
+}
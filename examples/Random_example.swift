@@ -0,0 +1,128 @@
+// Random_example.swift
+//
+// Example: TRNG words and health counters, a per-boot Swift hash seed, the
+// speed of each random source, and xoshiro128** dice rolls.
+//
+// Pins:
+//  D5 -> roll 10 dice (Xoshiro128 seeded from the TRNG)
+//
+// Prints at boot:
+//  TRNG w0=... w1=... w2=... w3=...     (different every boot)
+//  HASH value=...                       (Hasher seed from arc4random_buf: differs too)
+//  MONOBIT bits=... ones_permille=...   (16 KiB of TRNG output, ~500 expected)
+//  SEED42 first=...                     (fixed seed: the same every boot)
+//  RATE bytes=... trng=... system=... xoshiro_words=... xoshiro_fill=...
+//       (bytes per 1000 cycles)
+//
+// Every second prints:
+//  TRNG words, timeouts, repeats
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    serial.writeString("TRNG")
+    var k = 0
+    while k < 4 {
+        serial.writeString(" w")
+        serial.writeString(decU32(U32(k)))
+        serial.writeString("=")
+        serial.writeString(decU32(TRNG.next()))
+        k += 1
+    }
+    serial.writeString("\r\n")
+
+    var hasher = Hasher()
+    hasher.combine(42)
+    serial.writeString("HASH value=")
+    serial.writeString(decU32(U32(truncatingIfNeeded: hasher.finalize())))
+    serial.writeString("\r\n")
+
+    let scratch = UnsafeMutableRawBufferPointer.allocate(byteCount: 16 * 1024, alignment: 4)
+    TRNG.fill(scratch)
+    var ones: U32 = 0
+    for byte in scratch { ones &+= U32(byte.nonzeroBitCount) }
+    let bits = U32(scratch.count) * 8
+    serial.writeString("MONOBIT bits=")
+    serial.writeString(decU32(bits))
+    serial.writeString(" ones_permille=")
+    serial.writeString(decU32(U32(UInt64(ones) * 1000 / UInt64(bits))))
+    serial.writeString("\r\n")
+
+    var fixed = Xoshiro128(seed: 42)
+    serial.writeString("SEED42 first=")
+    serial.writeString(decU32(fixed.nextWord()))
+    serial.writeString("\r\n")
+
+    let rate = Random.measure(scratch: scratch)
+    serial.writeString("RATE bytes=")
+    serial.writeString(decU32(rate.bytes))
+    serial.writeString(" trng=")
+    serial.writeString(decU32(rate.trng))
+    serial.writeString(" system=")
+    serial.writeString(decU32(rate.system))
+    serial.writeString(" xoshiro_words=")
+    serial.writeString(decU32(rate.xoshiroWords))
+    serial.writeString(" xoshiro_fill=")
+    serial.writeString(decU32(rate.xoshiroFill))
+    serial.writeString("\r\n")
+
+    var rng = Xoshiro128()
+    let bRoll = PIN(5)
+    bRoll.inputPullup()
+    var last5 = false
+
+    var nextReport = timer.millis() &+ 1000
+
+    while true {
+        let p5 = bRoll.isLow()
+        if !last5 && p5 {
+            serial.writeString("DICE")
+            var d = 0
+            while d < 10 {
+                serial.writeString(" ")
+                serial.writeString(decU32(rng.next(below: 6) + 1))
+                d += 1
+            }
+            serial.writeString("\r\n")
+        }
+        last5 = p5
+
+        let now = timer.millis()
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            _ = TRNG.next()
+            let st = TRNG.stats
+            serial.writeString("words=")
+            serial.writeString(decU32(st.words))
+            serial.writeString(" timeouts=")
+            serial.writeString(decU32(st.timeouts))
+            serial.writeString(" repeats=")
+            serial.writeString(decU32(st.repeats))
+            serial.writeString("\r\n")
+        }
+    }
+}
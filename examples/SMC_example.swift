@@ -0,0 +1,237 @@
+// SMC_example.swift
+//
+// Example: an ILI9341 LCD on the SMC's 8080 bus (CPU vs DMA frame fills),
+// then, when the firmware is linked with EXT_SRAM_SIZE, external SRAM on
+// NCS0: memory test + bandwidth next to internal RAM.
+//
+// Wiring (LCD, 8-bit 8080 mode, IM[3:0] = 0011):
+//  D34..D41 -> DB0..DB7   D45 (NWE) -> WRX   D4 (NRD) -> RDX
+//  D9 (A0)  -> D/CX       D31 (NCS1) -> CSX   RESX -> 3.3 V
+//
+// External SRAM (board with the full EBI, e.g. 128K x 8, 55 ns):
+//  NCS0 (PA6) -> CE, A0..A16, D0..D7, NRD -> OE, NWE -> WE
+//  make EXT_SRAM_SIZE=131072
+//
+// Prints at boot:
+//  LCD write_cycles=... write_ns=... read_cycles=... read_ns=...
+//  LCD fill cpu_kib_s=... dma_kib_s=... cpu_fps_x10=... dma_fps_x10=...
+//  SRAM test=PASS|FAIL at=...          (only with EXT_SRAM_SIZE)
+//  BW mem=internal|external cpu_write=... cpu_read=... dma_write=... dma_read=... (KiB/s)
+//
+// Every second prints:
+//  frames filled by DMA in the last second (color bars cycling)
+//
+// Notes:
+// - One 8080 write = one SMC cycle: at 84 MHz the ILI9341 timing gives
+//   7 cycles (~83 ns) per byte, so a 240x320 RGB565 frame takes ~13 ms.
+// - CPU writes go through bm_write8 (one call per byte); the DMA feeds the
+//   data register from a RAM buffer with byte beats and a fixed destination.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+let lcdWidth: U32 = 240
+let lcdHeight: U32 = 320
+let frameBytes: U32 = lcdWidth * lcdHeight * 2
+let chunkBytes: U32 = 3840                      // 8 rows; frameBytes / chunkBytes = 40
+
+// D/CX on A0: offset 0 = command, offset 1 = data.
+func lcdCommand(_ lcd: SMC.Window, _ cmd: U8) { lcd.write8(0, cmd) }
+func lcdData(_ lcd: SMC.Window, _ v: U8) { lcd.write8(1, v) }
+
+func lcdInit(_ lcd: SMC.Window, _ timer: Timer) {
+    lcdCommand(lcd, 0x01)                       // software reset
+    timer.sleepFor(ms: 120)
+    lcdCommand(lcd, 0x11)                       // sleep out
+    timer.sleepFor(ms: 120)
+    lcdCommand(lcd, 0x3A); lcdData(lcd, 0x55)   // RGB565
+    lcdCommand(lcd, 0x36); lcdData(lcd, 0x48)   // portrait, BGR
+    lcdCommand(lcd, 0x29)                       // display on
+}
+
+/// Full-screen window, then memory write: the next frameBytes data bytes
+/// are pixels.
+func lcdBeginFrame(_ lcd: SMC.Window) {
+    lcdCommand(lcd, 0x2A)
+    lcdData(lcd, 0); lcdData(lcd, 0); lcdData(lcd, U8((lcdWidth - 1) >> 8)); lcdData(lcd, U8((lcdWidth - 1) & 0xFF))
+    lcdCommand(lcd, 0x2B)
+    lcdData(lcd, 0); lcdData(lcd, 0); lcdData(lcd, U8((lcdHeight - 1) >> 8)); lcdData(lcd, U8((lcdHeight - 1) & 0xFF))
+    lcdCommand(lcd, 0x2C)
+}
+
+func fillCPU(_ lcd: SMC.Window, _ color: U16) {
+    lcdBeginFrame(lcd)
+    let hi = U8(color >> 8)
+    let lo = U8(color & 0xFF)
+    var i: U32 = 0
+    while i < lcdWidth * lcdHeight {
+        lcd.write8(1, hi)
+        lcd.write8(1, lo)
+        i += 1
+    }
+}
+
+/// 40 DMA blocks of `chunk` (byte beats) into the LCD data register.
+func fillDMA(_ lcd: SMC.Window, _ dma: DMA.Channel, _ chunk: UnsafeMutablePointer<U8>) {
+    lcdBeginFrame(lcd)
+    var sent: U32 = 0
+    while sent < frameBytes {
+        dma.start(
+            DMA.Block(
+                source: U32(UInt(bitPattern: chunk)),
+                destination: lcd.base + 1,
+                count: chunkBytes,
+                width: .byte,
+                incrementDestination: false
+            ),
+            config: .memoryToMemory
+        )
+        _ = dma.wait()
+        sent += chunkBytes
+    }
+}
+
+func paintBars(_ chunk: UnsafeMutablePointer<U8>, _ shift: U32) {
+    let colors: [U16] = [0xF800, 0x07E0, 0x001F, 0xFFE0, 0xF81F, 0x07FF, 0xFFFF, 0x0000]
+    var px: U32 = 0
+    while px < chunkBytes / 2 {
+        let c = colors[Int(((px % lcdWidth) / 30 + shift) % 8)]
+        chunk[Int(2 * px)] = U8(c >> 8)
+        chunk[Int(2 * px + 1)] = U8(c & 0xFF)
+        px += 1
+    }
+}
+
+func printBandwidth(_ serial: SerialUART, _ name: String, _ bw: SMC.Bandwidth) {
+    serial.writeString("BW mem=")
+    serial.writeString(name)
+    serial.writeString(" bytes=")
+    serial.writeString(decU32(bw.bytes))
+    serial.writeString(" cpu_write=")
+    serial.writeString(decU32(bw.cpuWrite))
+    serial.writeString(" cpu_read=")
+    serial.writeString(decU32(bw.cpuRead))
+    serial.writeString(" dma_write=")
+    serial.writeString(decU32(bw.dmaWrite))
+    serial.writeString(" dma_read=")
+    serial.writeString(decU32(bw.dmaRead))
+    serial.writeString("\r\n")
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let smc = SMC(mckHz: ctx.mckHz)
+    var window: SMC.Window? = nil
+    do throws(SMC.Error) {
+        window = try smc.configure(chipSelect: 1, timing: .ili9341, addressLines: 1)
+    } catch {
+        serial.writeString("SMC ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+    guard let lcd = window, let dma = DMA.allocate(largeFIFO: true) else { while true { timer.sleepFor(ms: 1000) } }
+
+    serial.writeString("LCD write_cycles=")
+    serial.writeString(decU32(lcd.writeCycles))
+    serial.writeString(" write_ns=")
+    serial.writeString(decU32(smc.nanoseconds(cycles: lcd.writeCycles)))
+    serial.writeString(" read_cycles=")
+    serial.writeString(decU32(lcd.readCycles))
+    serial.writeString(" read_ns=")
+    serial.writeString(decU32(smc.nanoseconds(cycles: lcd.readCycles)))
+    serial.writeString("\r\n")
+
+    lcdInit(lcd, timer)
+
+    let chunk = UnsafeMutablePointer<U8>.allocate(capacity: Int(chunkBytes))
+    paintBars(chunk, 0)
+
+    var t0 = CycleCounter.now()
+    fillCPU(lcd, 0x001F)
+    let cpuCycles = CycleCounter.now() &- t0
+    t0 = CycleCounter.now()
+    fillDMA(lcd, dma, chunk)
+    let dmaCycles = CycleCounter.now() &- t0
+
+    let cpuHz = UInt64(ctx.cpuHz)
+    serial.writeString("LCD fill cpu_kib_s=")
+    serial.writeString(decU32(U32(UInt64(frameBytes) * cpuHz / (UInt64(cpuCycles) * 1024))))
+    serial.writeString(" dma_kib_s=")
+    serial.writeString(decU32(U32(UInt64(frameBytes) * cpuHz / (UInt64(dmaCycles) * 1024))))
+    serial.writeString(" cpu_fps_x10=")
+    serial.writeString(decU32(U32(cpuHz * 10 / UInt64(cpuCycles))))
+    serial.writeString(" dma_fps_x10=")
+    serial.writeString(decU32(U32(cpuHz * 10 / UInt64(dmaCycles))))
+    serial.writeString("\r\n")
+
+    // Internal reference, then external SRAM if the image was linked for one.
+    let scratch = UnsafeMutableRawBufferPointer.allocate(byteCount: 16 * 1024, alignment: 4)
+    let local = UnsafeMutableRawPointer.allocate(byteCount: 16 * 1024, alignment: 4)
+    printBandwidth(serial, "internal", SMC.bandwidth(target: local, scratch: scratch, cpuHz: ctx.cpuHz))
+
+    if ExternalRAM.size > 0 {
+        var lines: U32 = 0
+        while (U32(1) << lines) < ExternalRAM.size { lines += 1 }
+        do throws(SMC.Error) {
+            let sram = try smc.configure(chipSelect: 0, timing: .sram(accessNs: 55), addressLines: lines)
+            let bad = SMC.verify(sram, bytes: ExternalRAM.size)
+            serial.writeString(bad == nil ? "SRAM test=PASS" : "SRAM test=FAIL at=")
+            if let bad { serial.writeString(decU32(bad)) }
+            serial.writeString(" read_cycles=")
+            serial.writeString(decU32(sram.readCycles))
+            serial.writeString(" write_cycles=")
+            serial.writeString(decU32(sram.writeCycles))
+            serial.writeString("\r\n")
+            if bad == nil, let ext = ExternalRAM.allocate(bytes: 16 * 1024) {
+                printBandwidth(serial, "external", SMC.bandwidth(target: ext, scratch: scratch, cpuHz: ctx.cpuHz))
+            }
+        } catch {
+            serial.writeString("SRAM ERROR ")
+            serial.writeString(error.name)
+            serial.writeString("\r\n")
+        }
+    }
+
+    var shift: U32 = 0
+    var frames: U32 = 0
+    var nextReport = timer.millis() &+ 1000
+
+    while true {
+        paintBars(chunk, shift)
+        fillDMA(lcd, dma, chunk)
+        shift &+= 1
+        frames &+= 1
+
+        let now = timer.millis()
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            serial.writeString("fps=")
+            serial.writeString(decU32(frames))
+            serial.writeString("\r\n")
+            frames = 0
+        }
+    }
+}
@@ -0,0 +1,125 @@
+// SPI_example.swift
+//
+// Example: SPI0 throughput at SCK = MCK/2 and a two-device transfer queue.
+//
+// Wiring:
+//  MOSI -> MISO (SPI header) for a loopback check (optional)
+//  D10 (NPCS0), D4 (NPCS1) -> chip selects (scope / logic analyzer)
+//
+// Pins:
+//  D5  -> run the queue demo (cs0 then cs1, back to back, one DMA chain)
+//
+// Every second the example prints:
+//  sck_hz, bytes, cycles, bytes/s, MB/s x100 for a 4 KiB DMA transfer
+//
+// Notes:
+// - The queue needs variable peripheral mode, so the example restarts the
+//   SPI in that mode for the demo and back in fixed mode afterwards.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let spi = SPI(mckHz: ctx.mckHz)
+    let fast = SPI.Settings(clockHz: ctx.mckHz / 2)
+    let slow = SPI.Settings(clockHz: 1_000_000, mode: .mode3)
+
+    func setup(variable: Bool) {
+        spi.begin(variablePeripheral: variable)
+        _ = try? spi.configure(.cs0, fast)
+        _ = try? spi.configure(.cs1, slow)
+    }
+    setup(variable: false)
+
+    let buffer = UnsafeMutableBufferPointer<UInt8>.allocate(capacity: 4096)
+    let cmdA = UnsafeMutableBufferPointer<U32>.allocate(capacity: 4)
+    let cmdB = UnsafeMutableBufferPointer<U32>.allocate(capacity: 2)
+    let rxA = UnsafeMutableBufferPointer<U32>.allocate(capacity: 4)
+
+    let bQueue = PIN(5)
+    bQueue.inputPullup()
+    var last5 = false
+
+    var nextReport = timer.millis() &+ 1000
+
+    serial.writeString("SPI test ready\r\n")
+
+    while true {
+        let now = timer.millis()
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+
+            var i = 0
+            while i < buffer.count {
+                buffer[i] = UInt8(truncatingIfNeeded: i)
+                i += 1
+            }
+
+            do {
+                let t = try spi.measureThroughput(.cs0, buffer: buffer)
+                serial.writeString("sck_hz=")
+                serial.writeString(decU32(t.sckHz))
+                serial.writeString(" bytes=")
+                serial.writeString(decU32(t.bytes))
+                serial.writeString(" cycles=")
+                serial.writeString(decU32(t.cycles))
+                serial.writeString(" bytes_s=")
+                serial.writeString(decU32(t.bytesPerSecond))
+                serial.writeString(" mb_s_x100=")
+                serial.writeString(decU32(t.mbPerSecondX100))
+                serial.writeString("\r\n")
+            } catch {
+                serial.writeString("SPI ERROR ")
+                serial.writeString(error.name)
+                serial.writeString("\r\n")
+            }
+        }
+
+        let p5 = bQueue.isLow()
+        if !last5 && p5 {
+            setup(variable: true)
+
+            cmdA[0] = 0x9F; cmdA[1] = 0; cmdA[2] = 0; cmdA[3] = 0   // e.g. JEDEC ID on cs0
+            cmdB[0] = 0x55; cmdB[1] = 0xAA                           // e.g. register write on cs1
+
+            do {
+                try spi.enqueue(.cs0, words: cmdA, rx: rxA)
+                try spi.enqueue(.cs1, words: cmdB)
+                try spi.runQueue()
+                serial.writeString("QUEUE OK rx=")
+                serial.writeHex32(rxA[1] & 0xFFFF)
+                serial.writeString("\r\n")
+            } catch {
+                serial.writeString("QUEUE ERROR ")
+                serial.writeString(error.name)
+                serial.writeString("\r\n")
+            }
+
+            setup(variable: false)
+        }
+        last5 = p5
+    }
+}
@@ -0,0 +1,121 @@
+// TimeKeeper_example.swift
+//
+// Example: RTT time that keeps counting through Sleep, WAIT and backup
+// mode, the RTC calendar, and MCK calibrated against the 32.768 kHz crystal.
+//
+// Pins:
+//  D5 -> 5 s in backup mode (the board resets on wakeup; time continues)
+//
+// Prints at boot:
+//  BOOT cold|warm|backup ticks=... ms=...
+//  CAL mck_hz=... ppm=... crystal=0|1   (SysTick retuned with the measured clock)
+//  DATE yyyy-mm-dd hh:mm:ss unix=...    (set to 2026-01-01 00:00:00 on a cold start)
+//
+// Every loop prints:
+//  SLEEP mode=sleep|wait asked=2000 slept=... millis=... rtt_ms=...
+//  (millis follows the RTT although SysTick was off)
+//
+// Notes:
+// - The UART is idle during WAIT: each line is given 2 ms to drain first.
+// - Backup mode keeps the RTT, RTC and GPBR only; RAM starts over.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+func dec2(_ v: U32) -> String {
+    v < 10 ? "0" + decU32(v) : decU32(v)
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let tk = TimeKeeper(timer: timer)
+    tk.begin()
+
+    serial.writeString("BOOT ")
+    serial.writeString(tk.coldStart ? "cold" : (tk.wokeFromBackup ? "backup" : "warm"))
+    serial.writeString(" ticks=")
+    serial.writeString(decU32(U32(truncatingIfNeeded: tk.now())))
+    serial.writeString(" ms=")
+    serial.writeString(decU32(U32(truncatingIfNeeded: tk.nowMillis())))
+    serial.writeString("\r\n")
+
+    let cal = tk.calibrate(ticks: 1024, retune: true)
+    serial.writeString("CAL mck_hz=")
+    serial.writeString(decU32(cal.measuredHz))
+    serial.writeString(" ppm=")
+    if cal.ppm < 0 { serial.writeString("-") }
+    serial.writeString(decU32(cal.ppm.magnitude))
+    serial.writeString(" crystal=")
+    serial.writeString(cal.crystal ? "1" : "0")
+    serial.writeString("\r\n")
+
+    if tk.coldStart {
+        tk.setDateTime(TimeKeeper.DateTime(year: 2026, month: 1, day: 1))
+    }
+    let t = tk.dateTime()
+    serial.writeString("DATE ")
+    serial.writeString(decU32(t.year))
+    serial.writeString("-")
+    serial.writeString(dec2(t.month))
+    serial.writeString("-")
+    serial.writeString(dec2(t.day))
+    serial.writeString(" ")
+    serial.writeString(dec2(t.hour))
+    serial.writeString(":")
+    serial.writeString(dec2(t.minute))
+    serial.writeString(":")
+    serial.writeString(dec2(t.second))
+    serial.writeString(" unix=")
+    serial.writeString(decU32(U32(truncatingIfNeeded: tk.unixSeconds())))
+    serial.writeString("\r\n")
+
+    let bBackup = PIN(5)
+    bBackup.inputPullup()
+    var wait = false
+
+    while true {
+        if bBackup.isLow() {
+            serial.writeString("BACKUP 5000 ms\r\n")
+            timer.sleepFor(ms: 2)
+            tk.sleepInBackup(ms: 5000)
+        }
+
+        let mode: TimeKeeper.SleepMode = wait ? .wait : .sleep
+        let before = timer.millis()
+        let slept = tk.sleep(ms: 2000, mode: mode)
+
+        serial.writeString("SLEEP mode=")
+        serial.writeString(wait ? "wait" : "sleep")
+        serial.writeString(" asked=2000 slept=")
+        serial.writeString(decU32(slept))
+        serial.writeString(" millis=")
+        serial.writeString(decU32(timer.millis() &- before))
+        serial.writeString(" rtt_ms=")
+        serial.writeString(decU32(U32(truncatingIfNeeded: tk.nowMillis())))
+        serial.writeString("\r\n")
+        timer.sleepFor(ms: 2)
+        wait.toggle()
+    }
+}
@@ -0,0 +1,190 @@
+// USBSerial_example.swift
+//
+// Example: USB CDC-ACM on the Native USB port + throughput benchmark.
+//
+// Connect the "Native USB" micro-B port (the programming port stays the
+// debug UART). The host sees /dev/ttyACM* (Linux) or a COM port.
+//
+// Line protocol (driven by tools/usbcdc_test.py):
+//  I\n       -> "OK I speed=<high|full> packet=<n> baud=<b> dtr=<0|1>\n"
+//  T <n>\n   -> n pattern bytes (byte i = (i ^ (i >> 8)) & 0xFF), then
+//               "OK T bytes=<n> cycles=<c> bytes_s=<r>\n"
+//  R <n>\n   -> receives n bytes, "OK R bytes=<n> sum=<s> bytes_s=<r>\n"
+//  E <n>\n   -> echoes the next n bytes back, then "OK E bytes=<n>\n"
+//  S\n       -> driver counters
+//
+// Pins:
+//  D5 -> print stats on the debug UART
+//
+// Notes:
+// - Switching telemetry to USB is one line: use `usb` where the other
+//   examples use `ctx.serial` (same writeString/writeByte/readByteNonBlocking).
+// - T uses the DMA path (aligned 4 KiB buffer); the stats line goes through
+//   the TX ring.
+// - IRQs are enabled so enumeration runs from UOTGHS_Handler.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@inline(__always)
+func patternByte(_ i: U32) -> UInt8 {
+    UInt8((i ^ (i >> 8)) & 0xFF)
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard()
+    let debug = ctx.serial
+    let timer = ctx.timer
+
+    let usb = USBSerial(mckHz: 84_000_000)
+    usb.begin(115_200)
+    bm_enable_irq()
+
+    debug.writeString("USB CDC-ACM started\r\n")
+
+    let block = UnsafeMutableRawPointer.allocate(byteCount: 4096, alignment: 4)
+    let scratch = UnsafeMutableRawPointer.allocate(byteCount: 512, alignment: 4)
+
+    let bStats = PIN(5)
+    bStats.inputPullup()
+    var last5 = false
+
+    var cmd: U8 = 0
+    var arg: U32 = 0
+    var wasConfigured = false
+
+    while true {
+        if usb.isConfigured != wasConfigured {
+            wasConfigured = usb.isConfigured
+            debug.writeString(wasConfigured ? "USB configured speed=" : "USB detached\r\n")
+            if wasConfigured { debug.writeString(usb.speed == .high ? "high\r\n" : "full\r\n") }
+        }
+
+        let c = usb.readByteNonBlocking()
+        if c >= 0 {
+            let b = U8(c)
+            if b == 0x0A {
+                switch cmd {
+                case 0x49:      // I
+                    usb.writeString("OK I speed=")
+                    usb.writeString(usb.speed == .high ? "high packet=512" : "full packet=64")
+                    usb.writeString(" baud=")
+                    usb.writeString(decU32(usb.lineCoding.baud))
+                    usb.writeString(usb.dtr ? " dtr=1\n" : " dtr=0\n")
+
+                case 0x54:      // T <n>
+                    // Pattern offset matches the stream position inside each 4 KiB block.
+                    var sent: U32 = 0
+                    let t0 = CycleCounter.now()
+                    while sent < arg {
+                        let n = min(U32(4096), arg - sent)
+                        let p = block.assumingMemoryBound(to: UInt8.self)
+                        for i in 0..<Int(n) { p[i] = patternByte(sent &+ U32(i)) }
+                        if usb.write(UnsafeRawPointer(block), count: Int(n)) != Int(n) { break }
+                        sent &+= n
+                    }
+                    _ = usb.flush()
+                    let cycles = CycleCounter.now() &- t0
+                    let rate = cycles == 0 ? 0 : U32((UInt64(sent) * 84_000_000) / UInt64(cycles))
+                    usb.writeString("OK T bytes=")
+                    usb.writeString(decU32(sent))
+                    usb.writeString(" cycles=")
+                    usb.writeString(decU32(cycles))
+                    usb.writeString(" bytes_s=")
+                    usb.writeString(decU32(rate))
+                    usb.writeString("\n")
+
+                case 0x52, 0x45:    // R <n> / E <n>
+                    let echo = cmd == 0x45
+                    var got: U32 = 0
+                    var sum: U32 = 0
+                    let t0 = CycleCounter.now()
+                    var idle = timer.millis()
+                    while got < arg && timer.millis() &- idle < 2000 {
+                        let n = usb.read(into: scratch, count: min(512, Int(arg - got)))
+                        if n == 0 { continue }
+                        idle = timer.millis()
+                        let p = scratch.assumingMemoryBound(to: UInt8.self)
+                        for i in 0..<n { sum &+= U32(p[i]) }
+                        if echo { usb.write(UnsafeRawPointer(scratch), count: n) }
+                        got &+= U32(n)
+                    }
+                    let cycles = CycleCounter.now() &- t0
+                    if echo {
+                        usb.writeString("OK E bytes=")
+                        usb.writeString(decU32(got))
+                        usb.writeString("\n")
+                    } else {
+                        let rate = cycles == 0 ? 0 : U32((UInt64(got) * 84_000_000) / UInt64(cycles))
+                        usb.writeString("OK R bytes=")
+                        usb.writeString(decU32(got))
+                        usb.writeString(" sum=")
+                        usb.writeString(decU32(sum))
+                        usb.writeString(" bytes_s=")
+                        usb.writeString(decU32(rate))
+                        usb.writeString("\n")
+                    }
+
+                case 0x53:      // S
+                    let st = usb.stats
+                    usb.writeString("OK S resets=")
+                    usb.writeString(decU32(st.resets))
+                    usb.writeString(" setups=")
+                    usb.writeString(decU32(st.setups))
+                    usb.writeString(" stalls=")
+                    usb.writeString(decU32(st.stalls))
+                    usb.writeString(" tx_dropped=")
+                    usb.writeString(decU32(st.txDropped))
+                    usb.writeString(" rx_pauses=")
+                    usb.writeString(decU32(st.rxPauses))
+                    usb.writeString(" dma_writes=")
+                    usb.writeString(decU32(st.dmaWrites))
+                    usb.writeString("\n")
+
+                default:
+                    if cmd != 0 { usb.writeString("ERR\n") }
+                }
+                cmd = 0
+                arg = 0
+            } else if b >= 0x30 && b <= 0x39 {
+                arg = arg &* 10 &+ U32(b - 0x30)
+            } else if b != 0x20 && b != 0x0D && cmd == 0 {
+                cmd = b
+            }
+        }
+
+        let p5 = bStats.isLow()
+        if !last5 && p5 {
+            let st = usb.stats
+            debug.writeString("tx_bytes=")
+            debug.writeString(decU32(st.txBytes))
+            debug.writeString(" tx_packets=")
+            debug.writeString(decU32(st.txPackets))
+            debug.writeString(" rx_bytes=")
+            debug.writeString(decU32(st.rxBytes))
+            debug.writeString(" suspends=")
+            debug.writeString(decU32(st.suspends))
+            debug.writeString("\r\n")
+        }
+        last5 = p5
+    }
+}
@@ -0,0 +1,124 @@
+// Watchdog_example.swift
+//
+// Example: watchdog supervisor with two tasks, the previous boot's report,
+// and the per-loop cost of the supervisor.
+//
+// Pins:
+//  D5 -> "sensor" task hangs forever (the whole loop stops: the WDT resets,
+//        and the next boot names the last task that checked in)
+//  D6 -> "blink" task stops checking in (the loop keeps running: the
+//        supervisor records the miss and stops kicking)
+//
+// Prints at boot:
+//  RESET watchdog=0|1 missed=<name>|none overdue_ms=... last=<name>|none
+//  WDT period_ms=2000
+//
+// Every second prints:
+//  kicks, evaluations, cycles of checkIn + service() in the last loop
+//
+// Notes:
+// - Board.initBoard(watchdog: true): without it the WDT is already off.
+//
+
+@inline(__always)
+func decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
+
+@_cdecl("main")
+public func main() -> Never {
+    let ctx = Board.initBoard(watchdog: true)
+    let serial = ctx.serial
+    let timer  = ctx.timer
+
+    let wd = Watchdog(timer: timer)
+    var blink = 0
+    var sensor = 0
+    do throws(Watchdog.Error) {
+        blink = try wd.register("blink", timeoutMs: 600)
+        sensor = try wd.register("sensor", timeoutMs: 300)
+        try wd.begin(periodMs: 2000)
+    } catch {
+        serial.writeString("WDT ERROR ")
+        serial.writeString(error.name)
+        serial.writeString("\r\n")
+        while true { timer.sleepFor(ms: 1000) }
+    }
+
+    let r = wd.lastReset
+    serial.writeString("RESET watchdog=")
+    serial.writeString(r.resetByWatchdog ? "1" : "0")
+    serial.writeString(" missed=")
+    serial.writeString(r.missedTask.map { wd.name(of: $0) } ?? "none")
+    serial.writeString(" overdue_ms=")
+    serial.writeString(decU32(r.overdueMs))
+    serial.writeString(" last=")
+    serial.writeString(r.lastCheckIn.map { wd.name(of: $0) } ?? "none")
+    serial.writeString("\r\n")
+    serial.writeString("WDT period_ms=")
+    serial.writeString(decU32(wd.periodMs))
+    serial.writeString("\r\n")
+
+    let led = PIN(13)
+    led.output()
+    let bHang = PIN(5)
+    bHang.inputPullup()
+    let bStall = PIN(6)
+    bStall.inputPullup()
+    var blinkStalled = false
+
+    var nextBlink = timer.millis() &+ 250
+    var nextReport = timer.millis() &+ 1000
+    var loopCycles: U32 = 0
+
+    while true {
+        let now = timer.millis()
+
+        if ((now &- nextBlink) & 0x8000_0000) == 0 && !blinkStalled {
+            nextBlink = now &+ 250
+            wd.checkIn(blink)
+            led.toggle()
+        }
+        if bStall.isLow() && !blinkStalled {
+            blinkStalled = true
+            serial.writeString("STALL blink\r\n")
+        }
+
+        let c0 = CycleCounter.now()
+        wd.checkIn(sensor)
+        wd.service()
+        loopCycles = CycleCounter.now() &- c0
+        if bHang.isLow() {
+            serial.writeString("HANG sensor\r\n")
+            while true { bm_nop() }
+        }
+
+        if ((now &- nextReport) & 0x8000_0000) == 0 {
+            nextReport = now &+ 1000
+            serial.writeString("kicks=")
+            serial.writeString(decU32(wd.stats.kicks))
+            serial.writeString(" evaluations=")
+            serial.writeString(decU32(wd.stats.evaluations))
+            serial.writeString(" tripped=")
+            serial.writeString(wd.tripped ? "1" : "0")
+            serial.writeString(" loop_cycles=")
+            serial.writeString(decU32(loopCycles))
+            serial.writeString("\r\n")
+        }
+    }
+}
@@ -20,23 +20,78 @@ public enum ATSAM3X8E {
     public static let PIOC_BASE: U32 = 0x400E_1200
     public static let PIOD_BASE: U32 = 0x400E_1400
 
+    public static let RSTC_BASE: U32 = 0x400E_1A00
     public static let WDT_BASE:  U32 = 0x400E_1A50
 
+    // Backup domain (VDDBU, slow clock): kept across WAIT/backup mode and resets
+    public static let SUPC_BASE: U32 = 0x400E_1A10
+    public static let RTT_BASE:  U32 = 0x400E_1A30
+    public static let RTC_BASE:  U32 = 0x400E_1A60
+    public static let GPBR_BASE: U32 = 0x400E_1A90
+
     public static let EEFC0_BASE: U32 = 0x400E_0A00
     public static let EEFC1_BASE: U32 = 0x400E_0C00
 
     // UART (Arduino Due "Programming Port" serial)
     public static let UART_BASE: U32 = 0x400E_0800
 
+    // TC (timer counters): 3 blocks x 3 channels, TC0..TC8
+    public static let TC0_BASE: U32 = 0x4008_0000
+
     // TWI (I2C)
     public static let TWI0_BASE: U32 = 0x4008_C000
     public static let TWI1_BASE: U32 = 0x4009_0000
 
+    // HSMCI (SD/MMC host)
+    public static let HSMCI_BASE: U32 = 0x4000_0000
+
+    // SPI0 (Arduino Due SPI header / pins 74-76)
+    public static let SPI0_BASE: U32 = 0x4000_8000
+
+    // SSC (synchronous serial: I2S / TDM)
+    public static let SSC_BASE: U32 = 0x4000_4000
+
+    // SMC (static memory controller) + external bus windows, 16 MiB per NCSx
+    public static let SMC_BASE: U32 = 0x400E_0000
+    public static let EBI_CS0_BASE:  U32 = 0x6000_0000
+    public static let EBI_CS_STRIDE: U32 = 0x0100_0000
+
+    // TRNG (true random number generator, one 32-bit word every 84 MCK cycles)
+    public static let TRNG_BASE: U32 = 0x400B_C000
+
+    // DMAC (AHB DMA controller, 6 channels)
+    public static let DMAC_BASE: U32 = 0x400C_4000
+
+    // UOTGHS (USB OTG high speed) registers + endpoint FIFO window (DPRAM)
+    public static let UOTGHS_BASE: U32 = 0x400A_C000
+    public static let UOTGHS_RAM:  U32 = 0x2018_0000
+
+    // EMAC (10/100 Ethernet MAC, RMII)
+    public static let EMAC_BASE: U32 = 0x400B_0000
+
+    // PWM (8 channels, 16-bit counters, PDC on the duty-cycle update register)
+    public static let PWM_BASE: U32 = 0x4009_4000
+
+    // CAN0 / CAN1 (8 mailboxes each)
+    public static let CAN0_BASE: U32 = 0x400B_4000
+    public static let CAN1_BASE: U32 = 0x400B_8000
+
+    // Cortex-M3 NVIC (SCS)
+    public static let NVIC_BASE: U32 = 0xE000_E100
+
+    // Cortex-M3 System Control Block (SCS)
+    public static let SCB_BASE: U32 = 0xE000_ED00
+
     // Cortex-M3 SysTick (SCS)
     public static let SYST_CSR: U32 = 0xE000_E010
     public static let SYST_RVR: U32 = 0xE000_E014
     public static let SYST_CVR: U32 = 0xE000_E018
 
+    // Cortex-M3 DWT cycle counter (debug block, usable without a debugger)
+    public static let DEMCR:      U32 = 0xE000_EDFC
+    public static let DWT_CTRL:   U32 = 0xE000_1000
+    public static let DWT_CYCCNT: U32 = 0xE000_1004
+
     // ADC / DACC
     public static let ADC_BASE:  U32 = 0x400C_0000
     public static let DACC_BASE: U32 = 0x400C_8000
@@ -44,20 +99,49 @@ public enum ATSAM3X8E {
     // MARK: - Flash memory map (code is mapped at 0x0008_0000)
     public static let FLASH_BASE: U32 = 0x0008_0000
 
+    // Two 256 KiB banks: bank 0 (EEFC0) then bank 1 (EEFC1)
+    public static let FLASH_BANK_SIZE:  U32 = 0x0004_0000
+    public static let FLASH_BANK1_BASE: U32 = 0x000C_0000
+
     // MARK: - Peripheral IDs (for PMC clock enable)
     public enum ID {
+        public static let RTC:  U32 = 2
+        public static let RTT:  U32 = 3
+
+        public static let EFC0: U32 = 6
+        public static let EFC1: U32 = 7
+
         public static let UART: U32 = 8
+        public static let SMC:  U32 = 9
 
         public static let PIOA: U32 = 11
         public static let PIOB: U32 = 12
         public static let PIOC: U32 = 13
         public static let PIOD: U32 = 14
 
+        public static let HSMCI: U32 = 21
+
         public static let TWI0: U32 = 22
         public static let TWI1: U32 = 23
 
+        public static let SPI0: U32 = 24
+
+        public static let SSC:  U32 = 26
+
+        public static let TC0:  U32 = 27        // TCn = TC0 + n (n = 0..8)
+        public static let TC8:  U32 = 35
+
+        public static let PWM:  U32 = 36
         public static let ADC:  U32 = 37
         public static let DACC: U32 = 38
+        public static let DMAC: U32 = 39
+        public static let UOTGHS: U32 = 40
+
+        public static let EMAC: U32 = 42
+        public static let CAN0: U32 = 43
+        public static let CAN1: U32 = 44
+
+        public static let TRNG: U32 = 41
     }
 
     // MARK: - PMC (Power Management Controller)
@@ -72,19 +156,26 @@ public enum ATSAM3X8E {
         public static let PCDR1: U32 = ATSAM3X8E.PMC_BASE + 0x0104
         public static let PCSR1: U32 = ATSAM3X8E.PMC_BASE + 0x0108
 
+        public static let SCER:       U32 = ATSAM3X8E.PMC_BASE + 0x0000
+        public static let CKGR_UCKR:  U32 = ATSAM3X8E.PMC_BASE + 0x001C
         public static let CKGR_MOR:   U32 = ATSAM3X8E.PMC_BASE + 0x0020
         public static let CKGR_PLLAR: U32 = ATSAM3X8E.PMC_BASE + 0x0028
         public static let MCKR:       U32 = ATSAM3X8E.PMC_BASE + 0x0030
+        public static let USB:        U32 = ATSAM3X8E.PMC_BASE + 0x0038
         public static let SR:         U32 = ATSAM3X8E.PMC_BASE + 0x0068
+        public static let FSMR:       U32 = ATSAM3X8E.PMC_BASE + 0x0070
 
         // SR bits
         public static let SR_MOSCXTS:  U32 = U32(1) << 0
         public static let SR_LOCKA:    U32 = U32(1) << 1
         public static let SR_MCKRDY:   U32 = U32(1) << 3
+        public static let SR_LOCKU:    U32 = U32(1) << 6
         public static let SR_MOSCSELS: U32 = U32(1) << 16
 
         // CKGR_MOR bits/fields
         public static let MOR_MOSCXTEN: U32 = U32(1) << 0
+        public static let MOR_WAITMODE: U32 = U32(1) << 2
+        public static let MOR_MOSCRCEN: U32 = U32(1) << 3
 
         public static let MOR_MOSCXTST_SHIFT: U32 = 8
         public static let MOR_MOSCXTST_MASK:  U32 = 0xFF << MOR_MOSCXTST_SHIFT
@@ -96,10 +187,25 @@ public enum ATSAM3X8E {
 
         // PMC_MCKR fields
         public static let MCKR_CSS_MASK: U32 = 0x3
+        public static let MCKR_CSS_MAIN: U32 = 1
         public static let MCKR_CSS_PLLA: U32 = 2
 
         public static let MCKR_PRES_MASK: U32 = 0x7 << 4
         public static let MCKR_PRES_1:    U32 = 0 << 4
+
+        // UTMI PLL (480 MHz) + USB clock
+        public static let UCKR_UPLLEN: U32 = U32(1) << 16
+        public static let UCKR_UPLLCOUNT_SHIFT: U32 = 20
+        public static let USB_USBS: U32 = U32(1) << 0          // USB clock = UPLL
+        public static let USB_USBDIV_SHIFT: U32 = 8
+        public static let SCER_UOTGCLK: U32 = U32(1) << 5
+
+        // PLLAR with MULA = 0: PLLA off
+        public static let PLLAR_OFF: U32 = U32(1) << 29
+
+        // FSMR: fast startup (WAIT mode wakeup) sources
+        public static let FSMR_RTTAL: U32 = U32(1) << 16
+        public static let FSMR_RTCAL: U32 = U32(1) << 17
     }
 
     // MARK: - EEFC (Enhanced Embedded Flash Controller)
@@ -110,6 +216,9 @@ public enum ATSAM3X8E {
         public static let FSR_OFFSET: U32 = 0x08
         public static let FRR_OFFSET: U32 = 0x0C
 
+        // FMR fields
+        public static let FMR_FRDY: U32 = U32(1) << 0   // FRDY interrupt enable
+
         // FMR fields (Flash Wait States)
         public static let FMR_FWS_SHIFT: U32 = 8
         public static let FMR_FWS_MASK:  U32 = 0xF << FMR_FWS_SHIFT
@@ -128,6 +237,15 @@ public enum ATSAM3X8E {
         // Commands (FCMD)
         public static let FCMD_WP:  U32 = 0x01  // Write Page
         public static let FCMD_EWP: U32 = 0x03  // Erase Page and Write Page
+        public static let FCMD_EA:  U32 = 0x05  // Erase All (whole bank of this EEFC)
+        public static let FCMD_SGPB: U32 = 0x0B // Set GPNVM Bit (EEFC0 only)
+        public static let FCMD_CGPB: U32 = 0x0C // Clear GPNVM Bit (EEFC0 only)
+        public static let FCMD_GGPB: U32 = 0x0D // Get GPNVM Bits (result in FRR)
+
+        // GPNVM bits
+        public static let GPNVM_SECURITY:   U32 = 0
+        public static let GPNVM_BOOT_FLASH: U32 = 1   // 1 = boot from flash (not SAM-BA ROM)
+        public static let GPNVM_BOOT_BANK:  U32 = 2   // 0 = bank 0, 1 = bank 1 mapped at 0x0
     }
 
     // Absolute addresses for EEFC0 / EEFC1
@@ -275,6 +393,7 @@ public enum ATSAM3X8E {
 
         public static let SR_RXRDY: U32 = U32(1) << 0
         public static let SR_TXRDY: U32 = U32(1) << 1
+        public static let SR_TXEMPTY: U32 = U32(1) << 9
         public static let SR_OVRE:  U32 = U32(1) << 5
         public static let SR_FRAME: U32 = U32(1) << 6
         public static let SR_PARE:  U32 = U32(1) << 7
@@ -403,10 +522,864 @@ public enum ATSAM3X8E {
         public static let THR_TXDATA_MASK: U32 = 0xFF
     }
 
+    // MARK: - HSMCI (SD/MMC)
+    public enum HSMCI {
+        public static let CR:    U32 = ATSAM3X8E.HSMCI_BASE + 0x0000
+        public static let MR:    U32 = ATSAM3X8E.HSMCI_BASE + 0x0004
+        public static let DTOR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x0008
+        public static let SDCR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x000C
+        public static let ARGR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x0010
+        public static let CMDR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x0014
+        public static let BLKR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x0018
+        public static let CSTOR: U32 = ATSAM3X8E.HSMCI_BASE + 0x001C
+        public static let RSPR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x0020   // 4 words; R2 reads it 4 times
+        public static let RDR:   U32 = ATSAM3X8E.HSMCI_BASE + 0x0030
+        public static let TDR:   U32 = ATSAM3X8E.HSMCI_BASE + 0x0034
+        public static let SR:    U32 = ATSAM3X8E.HSMCI_BASE + 0x0040
+        public static let IER:   U32 = ATSAM3X8E.HSMCI_BASE + 0x0044
+        public static let IDR:   U32 = ATSAM3X8E.HSMCI_BASE + 0x0048
+        public static let IMR:   U32 = ATSAM3X8E.HSMCI_BASE + 0x004C
+        public static let DMA:   U32 = ATSAM3X8E.HSMCI_BASE + 0x0050
+        public static let CFG:   U32 = ATSAM3X8E.HSMCI_BASE + 0x0054
+        public static let WPMR:  U32 = ATSAM3X8E.HSMCI_BASE + 0x00E4
+
+        public static let CR_MCIEN:  U32 = U32(1) << 0
+        public static let CR_MCIDIS: U32 = U32(1) << 1
+        public static let CR_PWSEN:  U32 = U32(1) << 2
+        public static let CR_PWSDIS: U32 = U32(1) << 3
+        public static let CR_SWRST:  U32 = U32(1) << 7
+
+        // MCCK = MCK / (2 * (CLKDIV + 1))
+        public static let MR_CLKDIV_MASK: U32 = 0xFF
+        public static let MR_PWSDIV_SHIFT: U32 = 8
+        public static let MR_RDPROOF: U32 = U32(1) << 11
+        public static let MR_WRPROOF: U32 = U32(1) << 12
+
+        public static let DTOR_MAX: U32 = (0xF << 0) | (0x7 << 4)     // DTOCYC 15 x 1048576
+        public static let CSTOR_MAX: U32 = (0xF << 0) | (0x7 << 4)
+
+        public static let SDCR_SDCBUS_1: U32 = 0 << 6
+        public static let SDCR_SDCBUS_4: U32 = 2 << 6
+
+        public static let CMDR_RSPTYP_NONE: U32 = 0 << 6
+        public static let CMDR_RSPTYP_48:   U32 = 1 << 6
+        public static let CMDR_RSPTYP_136:  U32 = 2 << 6
+        public static let CMDR_RSPTYP_R1B:  U32 = 3 << 6
+        public static let CMDR_SPCMD_INIT:  U32 = 1 << 8            // 74 clocks before CMD0
+        public static let CMDR_OPDCMD:      U32 = U32(1) << 11
+        public static let CMDR_MAXLAT_64:   U32 = U32(1) << 12
+        public static let CMDR_TRCMD_START: U32 = 1 << 16
+        public static let CMDR_TRCMD_STOP:  U32 = 2 << 16
+        public static let CMDR_TRDIR_READ:  U32 = U32(1) << 18
+        public static let CMDR_TRTYP_SINGLE:   U32 = 0 << 19
+        public static let CMDR_TRTYP_MULTIPLE: U32 = 1 << 19
+
+        public static let BLKR_BLKLEN_SHIFT: U32 = 16
+
+        public static let SR_CMDRDY:   U32 = U32(1) << 0
+        public static let SR_RXRDY:    U32 = U32(1) << 1
+        public static let SR_TXRDY:    U32 = U32(1) << 2
+        public static let SR_BLKE:     U32 = U32(1) << 3
+        public static let SR_DTIP:     U32 = U32(1) << 4
+        public static let SR_NOTBUSY:  U32 = U32(1) << 5
+        public static let SR_RINDE:    U32 = U32(1) << 16
+        public static let SR_RDIRE:    U32 = U32(1) << 17
+        public static let SR_RCRCE:    U32 = U32(1) << 18
+        public static let SR_RENDE:    U32 = U32(1) << 19
+        public static let SR_RTOE:     U32 = U32(1) << 20
+        public static let SR_DCRCE:    U32 = U32(1) << 21
+        public static let SR_DTOE:     U32 = U32(1) << 22
+        public static let SR_CSTOE:    U32 = U32(1) << 23
+        public static let SR_FIFOEMPTY: U32 = U32(1) << 26
+        public static let SR_XFRDONE:  U32 = U32(1) << 27
+        public static let SR_OVRE:     U32 = U32(1) << 30
+        public static let SR_UNRE:     U32 = U32(1) << 31
+
+        public static let SR_CMD_ERRORS: U32 = SR_RINDE | SR_RDIRE | SR_RCRCE | SR_RENDE | SR_RTOE | SR_CSTOE
+        public static let SR_DATA_ERRORS: U32 = SR_DCRCE | SR_DTOE | SR_OVRE | SR_UNRE
+
+        public static let DMA_CHKSIZE_1: U32 = 0 << 4
+        public static let DMA_DMAEN:     U32 = U32(1) << 8
+
+        public static let CFG_FIFOMODE: U32 = U32(1) << 0
+        public static let CFG_FERRCTRL: U32 = U32(1) << 4
+        public static let CFG_HSMODE:   U32 = U32(1) << 8
+
+        public static let WPMR_KEY: U32 = 0x4D_4349 << 8     // "MCI"
+
+        // Peripheral A on PIOA: MCCK PA19, MCCDA PA20, MCDA0..3 PA21..PA24
+        public static let PIOA_MASK: U32 = U32(0x3F) << 19
+    }
+
+    // MARK: - SPI (SPI0)
+    public enum SPI {
+        public static let CR:   U32 = ATSAM3X8E.SPI0_BASE + 0x0000
+        public static let MR:   U32 = ATSAM3X8E.SPI0_BASE + 0x0004
+        public static let RDR:  U32 = ATSAM3X8E.SPI0_BASE + 0x0008
+        public static let TDR:  U32 = ATSAM3X8E.SPI0_BASE + 0x000C
+        public static let SR:   U32 = ATSAM3X8E.SPI0_BASE + 0x0010
+        public static let IER:  U32 = ATSAM3X8E.SPI0_BASE + 0x0014
+        public static let IDR:  U32 = ATSAM3X8E.SPI0_BASE + 0x0018
+        public static let IMR:  U32 = ATSAM3X8E.SPI0_BASE + 0x001C
+        public static let CSR0: U32 = ATSAM3X8E.SPI0_BASE + 0x0030   // CSR1..3 follow, 4 bytes apart
+        public static let WPMR: U32 = ATSAM3X8E.SPI0_BASE + 0x00E4
+
+        public static let CR_SPIEN:    U32 = U32(1) << 0
+        public static let CR_SPIDIS:   U32 = U32(1) << 1
+        public static let CR_SWRST:    U32 = U32(1) << 7
+        public static let CR_LASTXFER: U32 = U32(1) << 24
+
+        public static let MR_MSTR:    U32 = U32(1) << 0
+        public static let MR_PS:      U32 = U32(1) << 1      // variable peripheral select
+        public static let MR_PCSDEC:  U32 = U32(1) << 2
+        public static let MR_MODFDIS: U32 = U32(1) << 4
+        public static let MR_WDRBT:   U32 = U32(1) << 5
+        public static let MR_LLB:     U32 = U32(1) << 7
+        public static let MR_PCS_SHIFT:    U32 = 16
+        public static let MR_PCS_MASK:     U32 = 0xF << MR_PCS_SHIFT
+        public static let MR_DLYBCS_SHIFT: U32 = 24
+
+        // TDR (variable peripheral mode): data + PCS + LASTXFER per word
+        public static let TDR_PCS_SHIFT: U32 = 16
+        public static let TDR_LASTXFER:  U32 = U32(1) << 24
+
+        public static let SR_RDRF:    U32 = U32(1) << 0
+        public static let SR_TDRE:    U32 = U32(1) << 1
+        public static let SR_MODF:    U32 = U32(1) << 2
+        public static let SR_OVRES:   U32 = U32(1) << 3
+        public static let SR_TXEMPTY: U32 = U32(1) << 9
+
+        public static let CSR_CPOL:   U32 = U32(1) << 0
+        public static let CSR_NCPHA:  U32 = U32(1) << 1
+        public static let CSR_CSNAAT: U32 = U32(1) << 2
+        public static let CSR_CSAAT:  U32 = U32(1) << 3
+        public static let CSR_BITS_SHIFT:   U32 = 4          // 0 = 8 bits ... 8 = 16 bits
+        public static let CSR_SCBR_SHIFT:   U32 = 8
+        public static let CSR_DLYBS_SHIFT:  U32 = 16
+        public static let CSR_DLYBCT_SHIFT: U32 = 24
+
+        public static let WPMR_KEY: U32 = 0x53_5049 << 8     // "SPI"
+
+        // Peripheral A pins on PIOA: MISO PA25, MOSI PA26, SPCK PA27,
+        // NPCS0 PA28 (D10), NPCS1 PA29 (D4); peripheral B on PIOB:
+        // NPCS2 PB21 (D52), NPCS3 PB23.
+        public static let PIOA_MASK: U32 = (U32(1) << 25) | (U32(1) << 26) | (U32(1) << 27)
+        public static let PIOA_NPCS0: U32 = U32(1) << 28
+        public static let PIOA_NPCS1: U32 = U32(1) << 29
+        public static let PIOB_NPCS2: U32 = U32(1) << 21
+        public static let PIOB_NPCS3: U32 = U32(1) << 23
+    }
+
+    // MARK: - SSC
+    public enum SSC {
+        public static let CR:   U32 = ATSAM3X8E.SSC_BASE + 0x0000
+        public static let CMR:  U32 = ATSAM3X8E.SSC_BASE + 0x0004
+        public static let RCMR: U32 = ATSAM3X8E.SSC_BASE + 0x0010
+        public static let RFMR: U32 = ATSAM3X8E.SSC_BASE + 0x0014
+        public static let TCMR: U32 = ATSAM3X8E.SSC_BASE + 0x0018
+        public static let TFMR: U32 = ATSAM3X8E.SSC_BASE + 0x001C
+        public static let RHR:  U32 = ATSAM3X8E.SSC_BASE + 0x0020
+        public static let THR:  U32 = ATSAM3X8E.SSC_BASE + 0x0024
+        public static let SR:   U32 = ATSAM3X8E.SSC_BASE + 0x0040
+        public static let IDR:  U32 = ATSAM3X8E.SSC_BASE + 0x0048
+        public static let WPMR: U32 = ATSAM3X8E.SSC_BASE + 0x00E4
+
+        public static let CR_RXEN:  U32 = U32(1) << 0
+        public static let CR_RXDIS: U32 = U32(1) << 1
+        public static let CR_TXEN:  U32 = U32(1) << 8
+        public static let CR_TXDIS: U32 = U32(1) << 9
+        public static let CR_SWRST: U32 = U32(1) << 15
+
+        public static let CMR_DIV_MASK: U32 = 0x0FFF      // SCK = MCK / (2 * DIV)
+
+        // RCMR / TCMR
+        public static let CMR_CKS_MCK: U32 = 0 << 0       // divided clock
+        public static let CMR_CKS_TK:  U32 = 1 << 0       // receiver: clock from TK
+        public static let CMR_CKS_PIN: U32 = 2 << 0       // RK (receiver) / TK (transmitter) pin
+        public static let CMR_CKO_CONTINUOUS: U32 = 1 << 2
+        public static let CMR_CKI:     U32 = U32(1) << 5  // TX: shift on rising / RX: sample on rising
+        public static let CMR_START_CONTINUOUS: U32 = 0 << 8
+        public static let CMR_START_TRANSMIT:   U32 = 1 << 8   // receiver starts with the transmitter
+        public static let CMR_START_FALLING:    U32 = 4 << 8   // falling edge on RF / TF
+        public static let CMR_START_EDGE:       U32 = 7 << 8   // any edge on RF / TF
+        public static let CMR_STTDLY_SHIFT: U32 = 16
+        public static let CMR_PERIOD_SHIFT: U32 = 24
+
+        // RFMR / TFMR
+        public static let FMR_DATLEN_MASK: U32 = 0x1F      // bits per word - 1
+        public static let FMR_LOOP:        U32 = U32(1) << 5   // RFMR: RD/RF/RK from TD/TF/TK
+        public static let FMR_MSBF:        U32 = U32(1) << 7
+        public static let FMR_DATNB_SHIFT: U32 = 8         // words per frame - 1
+        public static let FMR_FSLEN_SHIFT: U32 = 16        // low 4 bits of (sync length - 1)
+        public static let FMR_FSLEN_EXT_SHIFT: U32 = 24    // high 4 bits
+        public static let FMR_FSOS_NONE:     U32 = 0 << 20
+        public static let FMR_FSOS_NEGATIVE: U32 = 1 << 20
+
+        public static let SR_TXRDY:   U32 = U32(1) << 0
+        public static let SR_TXEMPTY: U32 = U32(1) << 1
+        public static let SR_RXRDY:   U32 = U32(1) << 4
+        public static let SR_OVRUN:   U32 = U32(1) << 5
+
+        // Pins: TK/TF/TD = PA14/PA15/PA16 (peripheral B), RF/RD/RK = PB17/PB18/PB19 (peripheral A)
+        public static let PIOA_TX_MASK: U32 = (U32(1) << 14) | (U32(1) << 15) | (U32(1) << 16)
+        public static let PIOB_RX_MASK: U32 = (U32(1) << 17) | (U32(1) << 18) | (U32(1) << 19)
+    }
+
+    // MARK: - SMC
+    public enum SMC {
+        public static let CHIP_SELECTS: U32 = 2           // NCS0/NCS1 have pins on the Due
+
+        // Per chip select: CS_BASE + cs * CS_STRIDE + offset
+        public static let CS_BASE:   U32 = ATSAM3X8E.SMC_BASE + 0x0070
+        public static let CS_STRIDE: U32 = 0x14
+        public static let SETUP_OFFSET:   U32 = 0x00
+        public static let PULSE_OFFSET:   U32 = 0x04
+        public static let CYCLE_OFFSET:   U32 = 0x08
+        public static let TIMINGS_OFFSET: U32 = 0x0C      // NAND only (left 0)
+        public static let MODE_OFFSET:    U32 = 0x10
+
+        public static let WPCR: U32 = ATSAM3X8E.SMC_BASE + 0x01E4
+        public static let WPCR_KEY: U32 = 0x534D_4300     // "SMC"
+
+        // SETUP: NWE / NCS_WR / NRD / NCS_RD, 6-bit fields: cycles = 128 * b5 + b4..0
+        public static let SETUP_NWE_SHIFT:    U32 = 0
+        public static let SETUP_NCS_WR_SHIFT: U32 = 8
+        public static let SETUP_NRD_SHIFT:    U32 = 16
+        public static let SETUP_NCS_RD_SHIFT: U32 = 24
+
+        // PULSE: same layout, 7-bit fields: cycles = 256 * b6 + b5..0
+        public static let PULSE_NWE_SHIFT:    U32 = 0
+        public static let PULSE_NCS_WR_SHIFT: U32 = 8
+        public static let PULSE_NRD_SHIFT:    U32 = 16
+        public static let PULSE_NCS_RD_SHIFT: U32 = 24
+
+        // CYCLE: NWE / NRD total, 9-bit fields: cycles = 256 * b8..7 + b6..0
+        public static let CYCLE_NWE_SHIFT: U32 = 0
+        public static let CYCLE_NRD_SHIFT: U32 = 16
+
+        // MODE
+        public static let MODE_READ_NRD:  U32 = U32(1) << 0   // data sampled on NRD rising
+        public static let MODE_WRITE_NWE: U32 = U32(1) << 1   // write ends on NWE rising
+        public static let MODE_DBW_16:    U32 = U32(1) << 12  // 0 = 8-bit bus
+        public static let MODE_TDF_SHIFT: U32 = 16            // data float cycles, 0...15
+        public static let MODE_TDF_MAX:   U32 = 15
+
+        // Pins (peripheral A unless noted):
+        //   D0..D7 = PC2..PC9, NWE = PC18, A0..A9 = PC21..PC30, A10..A17 = PD0..PD7
+        //   NRD = PA29, NCS0 = PA6, NCS1 = PA7 (peripheral B)
+        public static let PIOC_DATA_MASK: U32 = 0x0000_03FC
+        public static let PIOC_NWE_MASK:  U32 = U32(1) << 18
+        public static let PIOC_ADDR_SHIFT: U32 = 21        // A0
+        public static let PIOC_ADDR_LINES: U32 = 10        // A0..A9 on PIOC, the rest on PIOD
+        public static let PIOA_NRD_MASK:  U32 = U32(1) << 29
+        public static let PIOA_NCS0_MASK: U32 = U32(1) << 6
+        public static let PIOA_NCS1_MASK: U32 = U32(1) << 7
+        public static let ADDR_LINES_MAX: U32 = 18
+    }
+
+    // MARK: - TRNG
+    public enum TRNG {
+        public static let CR:    U32 = ATSAM3X8E.TRNG_BASE + 0x0000
+        public static let ISR:   U32 = ATSAM3X8E.TRNG_BASE + 0x001C
+        public static let ODATA: U32 = ATSAM3X8E.TRNG_BASE + 0x0050     // read clears DATRDY
+
+        public static let CR_KEY:    U32 = 0x524E_4700      // "RNG" << 8
+        public static let CR_ENABLE: U32 = U32(1) << 0
+        public static let ISR_DATRDY: U32 = U32(1) << 0
+    }
+
+    // MARK: - DMAC
+    public enum DMAC {
+        public static let CHANNELS: U32 = 6
+
+        public static let GCFG:    U32 = ATSAM3X8E.DMAC_BASE + 0x0000
+        public static let EN:      U32 = ATSAM3X8E.DMAC_BASE + 0x0004
+        public static let EBCIER:  U32 = ATSAM3X8E.DMAC_BASE + 0x0018
+        public static let EBCIDR:  U32 = ATSAM3X8E.DMAC_BASE + 0x001C
+        public static let EBCIMR:  U32 = ATSAM3X8E.DMAC_BASE + 0x0020
+        public static let EBCISR:  U32 = ATSAM3X8E.DMAC_BASE + 0x0024   // read clears
+        public static let CHER:    U32 = ATSAM3X8E.DMAC_BASE + 0x0028
+        public static let CHDR:    U32 = ATSAM3X8E.DMAC_BASE + 0x002C
+        public static let CHSR:    U32 = ATSAM3X8E.DMAC_BASE + 0x0030
+
+        public static let EN_ENABLE: U32 = U32(1) << 0
+
+        // Per-channel registers: CH_BASE + ch * CH_STRIDE + offset
+        public static let CH_BASE:   U32 = ATSAM3X8E.DMAC_BASE + 0x003C
+        public static let CH_STRIDE: U32 = 0x28
+        public static let SADDR_OFFSET: U32 = 0x00
+        public static let DADDR_OFFSET: U32 = 0x04
+        public static let DSCR_OFFSET:  U32 = 0x08
+        public static let CTRLA_OFFSET: U32 = 0x0C
+        public static let CTRLB_OFFSET: U32 = 0x10
+        public static let CFG_OFFSET:   U32 = 0x14
+
+        // EBCIxx: bit ch = BTC, 8 + ch = CBTC, 16 + ch = ERR
+        public static let EBCI_BTC_SHIFT:  U32 = 0
+        public static let EBCI_CBTC_SHIFT: U32 = 8
+        public static let EBCI_ERR_SHIFT:  U32 = 16
+
+        // CHER/CHDR/CHSR: bit ch = ENA/DIS, 8 + ch = SUSP/RES
+        public static let CHSR_EMPT_SHIFT: U32 = 16
+        public static let CHSR_STAL_SHIFT: U32 = 24
+
+        public static let CTRLA_BTSIZE_MASK: U32 = 0xFFFF
+        public static let CTRLA_SRC_WIDTH_SHIFT: U32 = 24
+        public static let CTRLA_DST_WIDTH_SHIFT: U32 = 28
+        public static let CTRLA_DONE: U32 = U32(1) << 31
+        public static let WIDTH_BYTE:     U32 = 0
+        public static let WIDTH_HALFWORD: U32 = 1
+        public static let WIDTH_WORD:     U32 = 2
+
+        public static let CTRLB_SRC_DSCR: U32 = U32(1) << 16   // 1 = descriptor fetch disabled
+        public static let CTRLB_DST_DSCR: U32 = U32(1) << 20
+        public static let CTRLB_FC_SHIFT: U32 = 21
+        public static let CTRLB_FC_MEM2MEM: U32 = 0 << 21
+        public static let CTRLB_FC_MEM2PER: U32 = 1 << 21
+        public static let CTRLB_FC_PER2MEM: U32 = 2 << 21
+        public static let CTRLB_SRC_INCR_FIXED: U32 = 2 << 24
+        public static let CTRLB_DST_INCR_FIXED: U32 = 2 << 28
+
+        public static let CFG_SRC_PER_SHIFT: U32 = 0
+        public static let CFG_DST_PER_SHIFT: U32 = 4
+        public static let CFG_SRC_H2SEL: U32 = U32(1) << 9     // hardware handshaking
+        public static let CFG_DST_H2SEL: U32 = U32(1) << 13
+        public static let CFG_SOD:       U32 = U32(1) << 16    // stop on done
+        public static let CFG_AHB_PROT_1: U32 = 1 << 24
+        public static let CFG_FIFOCFG_ALAP: U32 = 0 << 28
+        public static let CFG_FIFOCFG_ASAP: U32 = 2 << 28
+        public static let CFG_FIFOCFG_SHIFT: U32 = 28
+
+        // Hardware handshaking interfaces: see DMA.Interface (DMA.swift)
+    }
+
+    // MARK: - EMAC (Ethernet MAC)
+    public enum EMAC {
+        public static let NCR:   U32 = ATSAM3X8E.EMAC_BASE + 0x0000
+        public static let NCFGR: U32 = ATSAM3X8E.EMAC_BASE + 0x0004
+        public static let NSR:   U32 = ATSAM3X8E.EMAC_BASE + 0x0008
+        public static let TSR:   U32 = ATSAM3X8E.EMAC_BASE + 0x0014
+        public static let RBQP:  U32 = ATSAM3X8E.EMAC_BASE + 0x0018
+        public static let TBQP:  U32 = ATSAM3X8E.EMAC_BASE + 0x001C
+        public static let RSR:   U32 = ATSAM3X8E.EMAC_BASE + 0x0020
+        public static let ISR:   U32 = ATSAM3X8E.EMAC_BASE + 0x0024
+        public static let IER:   U32 = ATSAM3X8E.EMAC_BASE + 0x0028
+        public static let IDR:   U32 = ATSAM3X8E.EMAC_BASE + 0x002C
+        public static let IMR:   U32 = ATSAM3X8E.EMAC_BASE + 0x0030
+        public static let MAN:   U32 = ATSAM3X8E.EMAC_BASE + 0x0034
+        public static let FCSE:  U32 = ATSAM3X8E.EMAC_BASE + 0x0050   // statistics: FCS errors
+        public static let ROV:   U32 = ATSAM3X8E.EMAC_BASE + 0x0070   // statistics: RX overruns
+        public static let RRE:   U32 = ATSAM3X8E.EMAC_BASE + 0x006C   // statistics: RX resource errors
+        public static let HRB:   U32 = ATSAM3X8E.EMAC_BASE + 0x0090
+        public static let HRT:   U32 = ATSAM3X8E.EMAC_BASE + 0x0094
+        public static let SA1B:  U32 = ATSAM3X8E.EMAC_BASE + 0x0098
+        public static let SA1T:  U32 = ATSAM3X8E.EMAC_BASE + 0x009C
+        public static let USRIO: U32 = ATSAM3X8E.EMAC_BASE + 0x00C0
+
+        public static let NCR_RE:      U32 = U32(1) << 2
+        public static let NCR_TE:      U32 = U32(1) << 3
+        public static let NCR_MPE:     U32 = U32(1) << 4
+        public static let NCR_CLRSTAT: U32 = U32(1) << 5
+        public static let NCR_TSTART:  U32 = U32(1) << 9
+
+        public static let NCFGR_SPD:   U32 = U32(1) << 0      // 100 Mbit/s
+        public static let NCFGR_FD:    U32 = U32(1) << 1
+        public static let NCFGR_CAF:   U32 = U32(1) << 4      // copy all frames
+        public static let NCFGR_NBC:   U32 = U32(1) << 5      // no broadcast
+        public static let NCFGR_CLK_SHIFT: U32 = 10           // MDC = MCK / (8 << CLK)
+        public static let NCFGR_CLK_64: U32 = 3 << NCFGR_CLK_SHIFT
+        public static let NCFGR_DRFCS: U32 = U32(1) << 17     // strip FCS from RX frames
+
+        public static let NSR_IDLE: U32 = U32(1) << 2         // MDIO idle
+
+        public static let TSR_UBR:  U32 = U32(1) << 0
+        public static let TSR_COL:  U32 = U32(1) << 1
+        public static let TSR_RLES: U32 = U32(1) << 2
+        public static let TSR_TGO:  U32 = U32(1) << 3
+        public static let TSR_BEX:  U32 = U32(1) << 4
+        public static let TSR_COMP: U32 = U32(1) << 5
+        public static let TSR_UND:  U32 = U32(1) << 6
+
+        public static let RSR_BNA: U32 = U32(1) << 0          // no RX buffer available
+        public static let RSR_REC: U32 = U32(1) << 1
+        public static let RSR_OVR: U32 = U32(1) << 2
+
+        // MAN: clause 22 frame, SOF = 01, CODE = 10
+        public static let MAN_SOF:  U32 = U32(1) << 30
+        public static let MAN_READ: U32 = U32(2) << 28
+        public static let MAN_WRITE: U32 = U32(1) << 28
+        public static let MAN_PHYA_SHIFT: U32 = 23
+        public static let MAN_REGA_SHIFT: U32 = 18
+        public static let MAN_CODE: U32 = U32(2) << 16
+
+        // USRIO: RMII bit set selects MII (inverted on SAM3X); CLKEN enables the pads.
+        public static let USRIO_MII:   U32 = U32(1) << 0
+        public static let USRIO_CLKEN: U32 = U32(1) << 1
+
+        // RX descriptor: word 0 = buffer address | WRAP | OWNERSHIP (set by the MAC)
+        public static let RXD_OWNERSHIP: U32 = U32(1) << 0
+        public static let RXD_WRAP:      U32 = U32(1) << 1
+        public static let RXD_ADDR_MASK: U32 = 0xFFFF_FFFC
+        // RX descriptor word 1 (status)
+        public static let RXS_LEN_MASK:  U32 = 0xFFF
+        public static let RXS_SOF:       U32 = U32(1) << 14
+        public static let RXS_EOF:       U32 = U32(1) << 15
+        public static let RX_BUFFER_SIZE: U32 = 128           // fixed by the MAC
+
+        // TX descriptor word 1
+        public static let TXS_LEN_MASK: U32 = 0x7FF
+        public static let TXS_LAST:     U32 = U32(1) << 15
+        public static let TXS_WRAP:     U32 = U32(1) << 30
+        public static let TXS_USED:     U32 = U32(1) << 31    // set: software owns it
+
+        // Peripheral A on PIOB (RMII): PB0 EREFCK, PB1 ETXEN, PB2-3 ETX0-1,
+        // PB4 ECRSDV, PB5-6 ERX0-1, PB7 ERXER, PB8 EMDC, PB9 EMDIO.
+        public static let PIOB_MASK: U32 = 0x3FF
+    }
+
+    // MARK: - PWM
+    public enum PWM {
+        public static let CLK:     U32 = ATSAM3X8E.PWM_BASE + 0x0000
+        public static let ENA:     U32 = ATSAM3X8E.PWM_BASE + 0x0004
+        public static let DIS:     U32 = ATSAM3X8E.PWM_BASE + 0x0008
+        public static let SR:      U32 = ATSAM3X8E.PWM_BASE + 0x000C
+        public static let IER1:    U32 = ATSAM3X8E.PWM_BASE + 0x0010
+        public static let IDR1:    U32 = ATSAM3X8E.PWM_BASE + 0x0014
+        public static let ISR1:    U32 = ATSAM3X8E.PWM_BASE + 0x001C
+        public static let SCM:     U32 = ATSAM3X8E.PWM_BASE + 0x0020
+        public static let DMAR:    U32 = ATSAM3X8E.PWM_BASE + 0x0024
+        public static let SCUC:    U32 = ATSAM3X8E.PWM_BASE + 0x0028
+        public static let SCUP:    U32 = ATSAM3X8E.PWM_BASE + 0x002C
+        public static let SCUPUPD: U32 = ATSAM3X8E.PWM_BASE + 0x0030
+        public static let IER2:    U32 = ATSAM3X8E.PWM_BASE + 0x0034
+        public static let IDR2:    U32 = ATSAM3X8E.PWM_BASE + 0x0038
+        public static let IMR2:    U32 = ATSAM3X8E.PWM_BASE + 0x003C
+        public static let ISR2:    U32 = ATSAM3X8E.PWM_BASE + 0x0040     // clear on read
+        public static let OS:      U32 = ATSAM3X8E.PWM_BASE + 0x0048
+        public static let OSS:     U32 = ATSAM3X8E.PWM_BASE + 0x004C
+        public static let OSC:     U32 = ATSAM3X8E.PWM_BASE + 0x0050
+        public static let WPCR:    U32 = ATSAM3X8E.PWM_BASE + 0x00E4
+
+        // PDC (transmit side only: feeds DMAR)
+        public static let TPR:  U32 = ATSAM3X8E.PWM_BASE + 0x0108
+        public static let TCR:  U32 = ATSAM3X8E.PWM_BASE + 0x010C
+        public static let TNPR: U32 = ATSAM3X8E.PWM_BASE + 0x0118
+        public static let TNCR: U32 = ATSAM3X8E.PWM_BASE + 0x011C
+        public static let PTCR: U32 = ATSAM3X8E.PWM_BASE + 0x0120
+        public static let PTCR_TXTEN:  U32 = U32(1) << 8
+        public static let PTCR_TXTDIS: U32 = U32(1) << 9
+
+        // Channel n registers: CH_BASE + n * CH_STRIDE + offset
+        public static let CH_BASE:   U32 = ATSAM3X8E.PWM_BASE + 0x0200
+        public static let CH_STRIDE: U32 = 0x0020
+        public static let CMR_OFFSET:     U32 = 0x00
+        public static let CDTY_OFFSET:    U32 = 0x04
+        public static let CDTYUPD_OFFSET: U32 = 0x08
+        public static let CPRD_OFFSET:    U32 = 0x0C
+        public static let CPRDUPD_OFFSET: U32 = 0x10
+        public static let CCNT_OFFSET:    U32 = 0x14
+        public static let DT_OFFSET:      U32 = 0x18
+        public static let DTUPD_OFFSET:   U32 = 0x1C
+
+        public static let CHANNELS: U32 = 8
+        public static let COUNTER_MAX: U32 = 0xFFFF
+
+        // CMR
+        public static let CMR_CPRE_MASK: U32 = 0x0F       // 0..10 = MCK / 2^n
+        public static let CMR_CALG:  U32 = U32(1) << 8    // center aligned
+        public static let CMR_CPOL:  U32 = U32(1) << 9    // output starts high
+        public static let CMR_CES:   U32 = U32(1) << 10
+        public static let CMR_DTE:   U32 = U32(1) << 16   // dead-time generator
+        public static let CMR_DTHI:  U32 = U32(1) << 17
+        public static let CMR_DTLI:  U32 = U32(1) << 18
+        public static let CPRE_MAX:  U32 = 10
+
+        // DT: DTH[15:0], DTL[31:16]
+        public static let DT_DTL_SHIFT: U32 = 16
+
+        // SCM
+        public static let SCM_UPDM_SHIFT: U32 = 16
+        public static let SCM_UPDM_MANUAL: U32 = 0 << 16  // write *UPD, then SCUC.UPDULOCK
+        public static let SCM_UPDM_AUTO:   U32 = 1 << 16  // write *UPD, applied each update period
+        public static let SCM_UPDM_PDC:    U32 = 2 << 16  // PDC writes DMAR each update period
+        public static let SCUC_UPDULOCK: U32 = U32(1) << 0
+
+        // ISR2 / IER2
+        public static let IR2_WRDY:   U32 = U32(1) << 0
+        public static let IR2_ENDTX:  U32 = U32(1) << 1
+        public static let IR2_TXBUFE: U32 = U32(1) << 2
+        public static let IR2_UNRE:   U32 = U32(1) << 3
+    }
+
+    // MARK: - CAN (CAN0 / CAN1 share the layout)
+    public enum CAN {
+        public static let MR_OFFSET:   U32 = 0x0000
+        public static let IER_OFFSET:  U32 = 0x0004
+        public static let IDR_OFFSET:  U32 = 0x0008
+        public static let IMR_OFFSET:  U32 = 0x000C
+        public static let SR_OFFSET:   U32 = 0x0010
+        public static let BR_OFFSET:   U32 = 0x0014
+        public static let TIM_OFFSET:  U32 = 0x0018
+        public static let ECR_OFFSET:  U32 = 0x0020
+        public static let TCR_OFFSET:  U32 = 0x0024
+        public static let ACR_OFFSET:  U32 = 0x0028
+        public static let WPMR_OFFSET: U32 = 0x00E4
+
+        // Mailbox n registers: MB_BASE + n * MB_STRIDE + offset
+        public static let MB_BASE:   U32 = 0x0200
+        public static let MB_STRIDE: U32 = 0x0020
+        public static let MMR_OFFSET:  U32 = 0x00
+        public static let MAM_OFFSET:  U32 = 0x04
+        public static let MID_OFFSET:  U32 = 0x08
+        public static let MFID_OFFSET: U32 = 0x0C
+        public static let MSR_OFFSET:  U32 = 0x10
+        public static let MDL_OFFSET:  U32 = 0x14
+        public static let MDH_OFFSET:  U32 = 0x18
+        public static let MCR_OFFSET:  U32 = 0x1C
+
+        public static let MAILBOXES: U32 = 8
+
+        public static let MR_CANEN:  U32 = U32(1) << 0
+        public static let MR_LPM:    U32 = U32(1) << 1
+        public static let MR_ABM:    U32 = U32(1) << 2      // autobaud / listen only
+        public static let MR_OVL:    U32 = U32(1) << 3
+        public static let MR_TIMFRZ: U32 = U32(1) << 6
+        public static let MR_DRPT:   U32 = U32(1) << 7      // no automatic retransmission
+
+        // SR / IER / IDR / IMR (MB0..MB7 = bits 0..7)
+        public static let SR_MB_MASK: U32 = 0xFF
+        public static let SR_ERRA: U32 = U32(1) << 16
+        public static let SR_WARN: U32 = U32(1) << 17
+        public static let SR_ERRP: U32 = U32(1) << 18
+        public static let SR_BOFF: U32 = U32(1) << 19
+        public static let SR_SLEEP:  U32 = U32(1) << 20
+        public static let SR_WAKEUP: U32 = U32(1) << 21
+        public static let SR_CERR: U32 = U32(1) << 24       // CRC
+        public static let SR_SERR: U32 = U32(1) << 25       // stuffing
+        public static let SR_AERR: U32 = U32(1) << 26       // acknowledgment
+        public static let SR_FERR: U32 = U32(1) << 27       // form
+        public static let SR_BERR: U32 = U32(1) << 28       // bit
+        public static let SR_ERRORS: U32 = SR_CERR | SR_SERR | SR_AERR | SR_FERR | SR_BERR   // cleared on SR read
+        public static let SR_RBSY: U32 = U32(1) << 29
+        public static let SR_TBSY: U32 = U32(1) << 30
+
+        // BR: bit time = (1 + PROPAG+1 + PHASE1+1 + PHASE2+1) x (BRP+1) / MCK
+        public static let BR_PHASE2_SHIFT: U32 = 0
+        public static let BR_PHASE1_SHIFT: U32 = 4
+        public static let BR_PROPAG_SHIFT: U32 = 8
+        public static let BR_SJW_SHIFT:    U32 = 12
+        public static let BR_BRP_SHIFT:    U32 = 16
+        public static let BR_SMP:          U32 = U32(1) << 24     // 3 samples per bit
+
+        public static let ECR_REC_MASK:  U32 = 0xFF
+        public static let ECR_TEC_SHIFT: U32 = 16
+
+        public static let MMR_PRIOR_SHIFT: U32 = 16
+        public static let MMR_MOT_SHIFT:   U32 = 24
+        public static let MOT_DISABLED:  U32 = 0
+        public static let MOT_RX:        U32 = 1
+        public static let MOT_RX_OVER:   U32 = 2
+        public static let MOT_TX:        U32 = 3
+
+        // MAM / MID: standard ID in MIDvA (bits 18..28), extended = MIDvA:MIDvB
+        public static let MID_MIDVA_SHIFT: U32 = 18
+        public static let MID_STD_MASK:    U32 = 0x7FF
+        public static let MID_EXT_MASK:    U32 = 0x1FFF_FFFF
+        public static let MID_MIDE:        U32 = U32(1) << 29
+
+        public static let MSR_MTIMESTAMP_MASK: U32 = 0xFFFF
+        public static let MSR_MDLC_SHIFT: U32 = 16
+        public static let MSR_MRTR: U32 = U32(1) << 20
+        public static let MSR_MABT: U32 = U32(1) << 22
+        public static let MSR_MRDY: U32 = U32(1) << 23
+        public static let MSR_MMI:  U32 = U32(1) << 24      // message ignored / overwritten
+
+        public static let MCR_MDLC_SHIFT: U32 = 16
+        public static let MCR_MRTR: U32 = U32(1) << 20
+        public static let MCR_MACR: U32 = U32(1) << 22
+        public static let MCR_MTCR: U32 = U32(1) << 23
+
+        public static let WPMR_KEY: U32 = 0x43_414E << 8     // "CAN"
+
+        // Peripheral A: CANTX0 PA0, CANRX0 PA1 (Due CANTX/CANRX pins);
+        // CANTX1 PB14 (D53), CANRX1 PB15 (DAC0 pin).
+        public static let PIOA_CAN0_MASK: U32 = (U32(1) << 0) | (U32(1) << 1)
+        public static let PIOB_CAN1_MASK: U32 = (U32(1) << 14) | (U32(1) << 15)
+    }
+
+    // MARK: - UOTGHS (USB device mode)
+    public enum UOTGHS {
+        // Device
+        public static let DEVCTRL: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0000
+        public static let DEVISR:  U32 = ATSAM3X8E.UOTGHS_BASE + 0x0004
+        public static let DEVICR:  U32 = ATSAM3X8E.UOTGHS_BASE + 0x0008
+        public static let DEVIMR:  U32 = ATSAM3X8E.UOTGHS_BASE + 0x0010
+        public static let DEVIDR:  U32 = ATSAM3X8E.UOTGHS_BASE + 0x0014
+        public static let DEVIER:  U32 = ATSAM3X8E.UOTGHS_BASE + 0x0018
+        public static let DEVEPT:  U32 = ATSAM3X8E.UOTGHS_BASE + 0x001C
+        public static let DEVFNUM: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0020
+
+        // Per endpoint n: base + 4 * n
+        public static let DEVEPTCFG: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0100
+        public static let DEVEPTISR: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0130
+        public static let DEVEPTICR: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0160
+        public static let DEVEPTIMR: U32 = ATSAM3X8E.UOTGHS_BASE + 0x01C0
+        public static let DEVEPTIER: U32 = ATSAM3X8E.UOTGHS_BASE + 0x01F0
+        public static let DEVEPTIDR: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0220
+
+        // Endpoint DMA channel n (1..6, serves endpoint n): base + 0x10 * n
+        public static let DEVDMA_BASE: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0300
+        public static let DEVDMA_ADDRESS_OFFSET: U32 = 0x04
+        public static let DEVDMA_CONTROL_OFFSET: U32 = 0x08
+        public static let DEVDMA_STATUS_OFFSET:  U32 = 0x0C
+
+        // General
+        public static let CTRL: U32 = ATSAM3X8E.UOTGHS_BASE + 0x0800
+        public static let SR:   U32 = ATSAM3X8E.UOTGHS_BASE + 0x0804
+
+        // FIFO window of endpoint n: UOTGHS_RAM + FIFO_STRIDE * n
+        public static let FIFO_STRIDE: U32 = 0x8000
+
+        // DEVCTRL
+        public static let DEVCTRL_UADD_MASK: U32 = 0x7F
+        public static let DEVCTRL_ADDEN:     U32 = U32(1) << 7
+        public static let DEVCTRL_DETACH:    U32 = U32(1) << 8
+        public static let DEVCTRL_SPDCONF_MASK:   U32 = 3 << 10
+        public static let DEVCTRL_SPDCONF_NORMAL: U32 = 0 << 10    // high speed capable
+        public static let DEVCTRL_SPDCONF_FORCED_FS: U32 = 3 << 10
+
+        // DEVISR / DEVICR / DEVIER
+        public static let DEV_SUSP:   U32 = U32(1) << 0
+        public static let DEV_SOF:    U32 = U32(1) << 2
+        public static let DEV_EORST:  U32 = U32(1) << 3
+        public static let DEV_WAKEUP: U32 = U32(1) << 4
+        public static let DEV_EORSM:  U32 = U32(1) << 5
+        public static let DEV_PEP_SHIFT: U32 = 12         // endpoint n: bit 12 + n
+        public static let DEV_DMA_SHIFT: U32 = 24         // DMA channel n: bit 24 + n
+
+        // DEVEPT
+        public static let DEVEPT_EPRST_SHIFT: U32 = 16
+
+        // DEVEPTCFG
+        public static let EPTCFG_ALLOC:       U32 = U32(1) << 1
+        public static let EPTCFG_EPBK_SHIFT:  U32 = 2       // 0 single, 1 double, 2 triple bank
+        public static let EPTCFG_EPSIZE_SHIFT: U32 = 4      // 8 << n bytes
+        public static let EPTCFG_EPDIR_IN:    U32 = U32(1) << 8
+        public static let EPTCFG_AUTOSW:      U32 = U32(1) << 9
+        public static let EPTCFG_EPTYPE_SHIFT: U32 = 11
+        public static let EPTYPE_CTRL: U32 = 0
+        public static let EPTYPE_BULK: U32 = 2
+        public static let EPTYPE_INTR: U32 = 3
+
+        // DEVEPTISR (ICR/IER/IDR share the low bit positions)
+        public static let EPT_TXINI:    U32 = U32(1) << 0
+        public static let EPT_RXOUTI:   U32 = U32(1) << 1
+        public static let EPT_RXSTPI:   U32 = U32(1) << 2
+        public static let EPT_STALLEDI: U32 = U32(1) << 6
+        public static let EPT_RWALL:    U32 = U32(1) << 16
+        public static let EPT_CFGOK:    U32 = U32(1) << 18
+        public static let EPT_BYCT_SHIFT: U32 = 20
+        public static let EPT_BYCT_MASK:  U32 = 0x7FF
+        public static let EPT_NBUSYBK_SHIFT: U32 = 12
+        public static let EPT_NBUSYBK_MASK:  U32 = 0x3
+
+        // DEVEPTIER / DEVEPTIDR only
+        public static let EPT_FIFOCON: U32 = U32(1) << 14    // IDR: FIFOCONC (release bank)
+        public static let EPT_RSTDT:   U32 = U32(1) << 18    // IER: reset data toggle
+        public static let EPT_STALLRQ: U32 = U32(1) << 19
+
+        // DEVDMA CONTROL / STATUS
+        public static let DMA_CHANN_ENB:  U32 = U32(1) << 0
+        public static let DMA_END_TR_EN:  U32 = U32(1) << 2
+        public static let DMA_END_B_EN:   U32 = U32(1) << 3
+        public static let DMA_BUFF_LENGTH_SHIFT: U32 = 16
+        public static let DMA_STATUS_CHANN_ACT: U32 = U32(1) << 1
+        public static let DMA_STATUS_END_BF_ST: U32 = U32(1) << 5
+        public static let DMA_STATUS_BUFF_COUNT_SHIFT: U32 = 16
+
+        // CTRL
+        public static let CTRL_VBUSHWC: U32 = U32(1) << 8
+        public static let CTRL_OTGPADE: U32 = U32(1) << 12
+        public static let CTRL_FRZCLK:  U32 = U32(1) << 14
+        public static let CTRL_USBE:    U32 = U32(1) << 15
+        public static let CTRL_UIDE:    U32 = U32(1) << 24
+        public static let CTRL_UIMOD_DEVICE: U32 = U32(1) << 25
+
+        // SR
+        public static let SR_VBUS: U32 = U32(1) << 11
+        public static let SR_SPEED_SHIFT: U32 = 12        // 0 full, 1 high, 2 low
+        public static let SR_CLKUSABLE: U32 = U32(1) << 14
+    }
+
+    // MARK: - RSTC (reset controller)
+    public enum RSTC {
+        public static let CR: U32 = ATSAM3X8E.RSTC_BASE + 0x0000
+        public static let SR: U32 = ATSAM3X8E.RSTC_BASE + 0x0004
+        public static let CR_PROCRST: U32 = U32(1) << 0
+        public static let CR_PERRST:  U32 = U32(1) << 2
+        public static let CR_KEY:     U32 = 0xA5 << 24
+
+        // SR.RSTTYP: cause of the last reset
+        public static let SR_RSTTYP_SHIFT: U32 = 8
+        public static let SR_RSTTYP_MASK:  U32 = 0x7 << 8
+        public static let RSTTYP_GENERAL:  U32 = 0         // power-on
+        public static let RSTTYP_BACKUP:   U32 = 1         // wake from backup mode
+        public static let RSTTYP_WATCHDOG: U32 = 2
+        public static let RSTTYP_SOFTWARE: U32 = 3
+        public static let RSTTYP_USER:     U32 = 4         // NRST pin
+    }
+
+    // MARK: - SUPC (supply controller)
+    public enum SUPC {
+        public static let CR:   U32 = ATSAM3X8E.SUPC_BASE + 0x0000
+        public static let WUMR: U32 = ATSAM3X8E.SUPC_BASE + 0x000C
+        public static let SR:   U32 = ATSAM3X8E.SUPC_BASE + 0x0014
+
+        public static let CR_KEY:     U32 = 0xA5 << 24
+        public static let CR_VROFF:   U32 = U32(1) << 2    // core regulator off: backup mode
+        public static let CR_XTALSEL: U32 = U32(1) << 3    // slow clock = 32.768 kHz crystal (one-way)
+
+        public static let WUMR_RTTEN: U32 = U32(1) << 2    // RTT alarm wakes from backup
+        public static let WUMR_RTCEN: U32 = U32(1) << 3
+
+        public static let SR_OSCSEL: U32 = U32(1) << 7     // 1 = crystal selected
+    }
+
+    // MARK: - RTT (real-time timer: 32-bit counter of slow clock / RTPRES)
+    public enum RTT {
+        public static let MR: U32 = ATSAM3X8E.RTT_BASE + 0x0000
+        public static let AR: U32 = ATSAM3X8E.RTT_BASE + 0x0004
+        public static let VR: U32 = ATSAM3X8E.RTT_BASE + 0x0008    // read twice (slow clock domain)
+        public static let SR: U32 = ATSAM3X8E.RTT_BASE + 0x000C    // read clears
+
+        public static let MR_RTPRES_MASK: U32 = 0xFFFF             // 0 = 65536; >= 3
+        public static let MR_ALMIEN:  U32 = U32(1) << 16
+        public static let MR_RTTINCIEN: U32 = U32(1) << 17
+        public static let MR_RTTRST:  U32 = U32(1) << 18           // reload prescaler, clear VR
+
+        public static let SR_ALMS:   U32 = U32(1) << 0
+        public static let SR_RTTINC: U32 = U32(1) << 1
+    }
+
+    // MARK: - RTC (calendar, BCD)
+    public enum RTC {
+        public static let CR:   U32 = ATSAM3X8E.RTC_BASE + 0x0000
+        public static let MR:   U32 = ATSAM3X8E.RTC_BASE + 0x0004
+        public static let TIMR: U32 = ATSAM3X8E.RTC_BASE + 0x0008
+        public static let CALR: U32 = ATSAM3X8E.RTC_BASE + 0x000C
+        public static let SR:   U32 = ATSAM3X8E.RTC_BASE + 0x0018
+        public static let SCCR: U32 = ATSAM3X8E.RTC_BASE + 0x001C
+
+        public static let CR_UPDTIM: U32 = U32(1) << 0
+        public static let CR_UPDCAL: U32 = U32(1) << 1
+        public static let MR_HRMOD:  U32 = U32(1) << 0     // 1 = 12-hour mode (we use 24)
+
+        // TIMR: SEC [6:0], MIN [14:8], HOUR [21:16] (BCD)
+        // CALR: CENT [6:0], YEAR [15:8], MONTH [20:16], DAY (weekday 1..7) [23:21], DATE [29:24]
+        public static let SR_ACKUPD:   U32 = U32(1) << 0
+        public static let SCCR_ACKCLR: U32 = U32(1) << 0
+        public static let SCCR_ALL:    U32 = 0x1F
+    }
+
+    // MARK: - GPBR (8 general-purpose backup registers, kept in backup mode)
+    public enum GPBR {
+        public static let COUNT:  U32 = 8
+        public static let STRIDE: U32 = 4                  // GPBRn = GPBR_BASE + n * STRIDE
+    }
+
+    // MARK: - TC (channel n at TC0_BASE + (n / 3) * BLOCK_STRIDE + (n % 3) * CHANNEL_STRIDE)
+    public enum TC {
+        public static let BLOCK_STRIDE:   U32 = 0x4000
+        public static let CHANNEL_STRIDE: U32 = 0x40
+        public static let CHANNELS:       U32 = 9
+
+        // Channel registers
+        public static let CCR_OFFSET: U32 = 0x00
+        public static let CMR_OFFSET: U32 = 0x04
+        public static let CV_OFFSET:  U32 = 0x10
+        public static let RA_OFFSET:  U32 = 0x14
+        public static let RB_OFFSET:  U32 = 0x18
+        public static let RC_OFFSET:  U32 = 0x1C
+        public static let SR_OFFSET:  U32 = 0x20      // read clears
+        public static let IER_OFFSET: U32 = 0x24
+        public static let IDR_OFFSET: U32 = 0x28
+
+        // Block register
+        public static let WPMR_OFFSET: U32 = 0xE4
+        public static let WPMR_KEY:    U32 = 0x54494D << 8     // "TIM", WPEN = 0
+
+        public static let CCR_CLKEN:  U32 = U32(1) << 0
+        public static let CCR_CLKDIS: U32 = U32(1) << 1
+        public static let CCR_SWTRG:  U32 = U32(1) << 2
+
+        // CMR (waveform mode)
+        public static let CMR_TCCLKS_MCK2:   U32 = 0
+        public static let CMR_TCCLKS_MCK8:   U32 = 1
+        public static let CMR_TCCLKS_MCK32:  U32 = 2
+        public static let CMR_TCCLKS_MCK128: U32 = 3
+        public static let CMR_WAVSEL_UP_RC:  U32 = 2 << 13     // count up, reset on RC compare
+        public static let CMR_WAVE:          U32 = U32(1) << 15
+
+        public static let SR_CPCS:  U32 = U32(1) << 4          // RC compare
+        public static let INT_CPCS: U32 = U32(1) << 4          // IER/IDR
+    }
+
     // MARK: - WDT
     public enum WDT {
-        public static let MR: U32 = ATSAM3X8E.WDT_BASE + 0x0004
+        public static let CR: U32 = ATSAM3X8E.WDT_BASE + 0x0000
+        public static let MR: U32 = ATSAM3X8E.WDT_BASE + 0x0004    // write-once after reset
+        public static let SR: U32 = ATSAM3X8E.WDT_BASE + 0x0008
         public static let WDT_MR_WDDIS: U32 = U32(1) << 15
+
+        public static let CR_KEY:    U32 = 0xA5 << 24
+        public static let CR_WDRSTT: U32 = U32(1) << 0     // restart the counter
+
+        // MR: WDV [11:0] and WDD [27:16] in slow clock / 128 ticks (256 Hz)
+        public static let MR_WDV_MASK:   U32 = 0xFFF
+        public static let MR_WDD_SHIFT:  U32 = 16
+        public static let MR_WDFIEN:     U32 = U32(1) << 12
+        public static let MR_WDRSTEN:    U32 = U32(1) << 13
+        public static let MR_WDRPROC:    U32 = U32(1) << 14    // 1 = processor reset only
+        public static let MR_WDDBGHLT:   U32 = U32(1) << 28    // halted while the debugger halts the core
+        public static let MR_WDIDLEHLT:  U32 = U32(1) << 29    // halted in Sleep (WFI)
+        public static let TICK_HZ:       U32 = 256
+
+        public static let SR_WDUNF: U32 = U32(1) << 0
+        public static let SR_WDERR: U32 = U32(1) << 1
+    }
+
+    // MARK: - NVIC (IRQn = peripheral ID; IDs >= 32 use the *1 registers)
+    public enum NVIC {
+        public static let ISER0: U32 = ATSAM3X8E.NVIC_BASE + 0x000
+        public static let ISER1: U32 = ATSAM3X8E.NVIC_BASE + 0x004
+        public static let ICER0: U32 = ATSAM3X8E.NVIC_BASE + 0x080
+        public static let ICER1: U32 = ATSAM3X8E.NVIC_BASE + 0x084
+        public static let ISPR0: U32 = ATSAM3X8E.NVIC_BASE + 0x100
+        public static let ISPR1: U32 = ATSAM3X8E.NVIC_BASE + 0x104
+        public static let ICPR0: U32 = ATSAM3X8E.NVIC_BASE + 0x180
+        public static let ICPR1: U32 = ATSAM3X8E.NVIC_BASE + 0x184
+        public static let IABR0: U32 = ATSAM3X8E.NVIC_BASE + 0x200
+        public static let IABR1: U32 = ATSAM3X8E.NVIC_BASE + 0x204
+
+        // One priority byte per IRQ (SAM3X implements the top 4 bits)
+        public static let IPR_BASE: U32 = ATSAM3X8E.NVIC_BASE + 0x300
+        public static let PRIO_BITS: U32 = 4
+
+        // Software trigger: write the IRQ number (same as ISPR, one store)
+        public static let STIR: U32 = 0xE000_EF00
+    }
+
+    // MARK: - SCB (priority grouping + system handler priorities)
+    public enum SCB {
+        public static let AIRCR: U32 = ATSAM3X8E.SCB_BASE + 0x0C
+        public static let SHPR1: U32 = ATSAM3X8E.SCB_BASE + 0x18   // byte (exception - 4): MemManage..
+        public static let SHPR2: U32 = ATSAM3X8E.SCB_BASE + 0x1C   // SVCall in [31:24]
+        public static let SHPR3: U32 = ATSAM3X8E.SCB_BASE + 0x20   // PendSV [23:16], SysTick [31:24]
+
+        // AIRCR: writes need VECTKEY; PRIGROUP n = subpriority in bits [n:0]
+        public static let AIRCR_VECTKEY:        U32 = U32(0x05FA) << 16
+        public static let AIRCR_PRIGROUP_SHIFT: U32 = 8
+        public static let AIRCR_PRIGROUP_MASK:  U32 = U32(0x7) << 8
     }
 
     // MARK: - SysTick bits
@@ -416,16 +1389,36 @@ public enum ATSAM3X8E {
         public static let CSR_CLKSRC:  U32 = U32(1) << 2
     }
 
-    // MARK: - Reserved persistent flash page (hardware facts only)
+    // MARK: - DWT bits
+    public enum DWT {
+        public static let DEMCR_TRCENA:   U32 = U32(1) << 24
+        public static let CTRL_CYCCNTENA: U32 = U32(1) << 0
+    }
+
+    // MARK: - Reserved persistent flash pages (hardware facts only)
     public enum NVM {
         // Flash page geometry on SAM3X8E: 256-byte pages.
         public static let PAGE_SIZE: U32 = 256
 
+        // Two consecutive pages (A/B copies) at the very end of flash.
+        public static let PAGE_COUNT: U32 = 2
+
         // Total flash is 512 KiB mapped ending at 0x0010_0000.
-        // The last page address is 0x000F_FF00 (page-aligned).
-        public static let PAGE_ADDR: U32 = 0x000F_FF00
+        // First reserved page address is 0x000F_FE00 (page-aligned).
+        public static let PAGE_ADDR: U32 = 0x000F_FE00
 
         // Bank 1 has 256 KiB => 1024 pages at 256 bytes each => last index = 1023.
-        public static let BANK1_PAGE_INDEX: U32 = 1023
+        // Index of the first reserved page (PAGE_ADDR) inside bank 1.
+        public static let BANK1_PAGE_INDEX: U32 = 1022
+
+        // Flash log ring (FlashLog.swift): 32 pages (8 KiB) right below the KV pages.
+        public static let LOG_PAGE_COUNT: U32 = 32
+        public static let LOG_PAGE_ADDR: U32 = 0x000F_DE00
+        public static let LOG_BANK1_PAGE_INDEX: U32 = 990
+
+        // Flash telemetry metadata (EEFCTelemetry.swift): 2 pages (A/B copies) right below the log.
+        public static let META_PAGE_COUNT: U32 = 2
+        public static let META_PAGE_ADDR: U32 = 0x000F_DC00
+        public static let META_BANK1_PAGE_INDEX: U32 = 988
     }
 }
\ No newline at end of file
@@ -11,14 +11,8 @@
 
 @inline(__always)
 private func pmcEnablePeripheral(_ id: U32) {
-    // SAM3X PMC has two enable registers:
-    //  - PCER0 for IDs 0..31
-    //  - PCER1 for IDs 32..63 (bit = id-32)
-    if id < 32 {
-        write32(ATSAM3X8E.PMC.PCER0, U32(1) << id)
-    } else {
-        write32(ATSAM3X8E.PMC.PCER1, U32(1) << (id - 32))
-    }
+    // Reference-counted (Power.swift): PCER0 / PCER1 picked there.
+    PeripheralClock.acquire(id)
 }
 
 public struct AnalogPIN {
@@ -165,7 +159,7 @@ public struct AnalogPIN {
 
     @inline(__always)
     private func enablePIOClock(_ id: U32) {
-        pmcEnablePeripheral(id)
+        PeripheralClock.holdPIO(id)
     }
 
     @inline(__always)
@@ -194,8 +188,8 @@ private enum ADC {
     static func ensureInit(mckHz: U32, adcClockHz: U32) {
         if inited, mckHz == lastMckHz, adcClockHz == lastAdcHz { return }
 
-        // Enable peripheral clock
-        pmcEnablePeripheral(ATSAM3X8E.ID.ADC)
+        // Enable peripheral clock (one user, not one per re-init)
+        if !inited { pmcEnablePeripheral(ATSAM3X8E.ID.ADC) }
 
         // Reset
         write32(ATSAM3X8E.ADC.CR, ATSAM3X8E.ADC.CR_SWRST)
@@ -282,8 +276,8 @@ private enum DAC {
     static func ensureInit(mckHz: U32) {
         if inited, mckHz == lastMckHz { return }
 
-        // Enable peripheral clock
-        pmcEnablePeripheral(ATSAM3X8E.ID.DACC)
+        // Enable peripheral clock (one user, not one per re-init)
+        if !inited { pmcEnablePeripheral(ATSAM3X8E.ID.DACC) }
 
         // Reset
         write32(ATSAM3X8E.DACC.CR, ATSAM3X8E.DACC.CR_SWRST)
@@ -0,0 +1,173 @@
+//
+// Bench.swift — on-target microbenchmark registry timed with the DWT cycle counter.
+//
+// Goals:
+// - add(name, iterations:, body): register a benchmark. run() calls each
+//   body `iterations` times, timing every call on its own, and reports
+//   min / median / max cycles.
+// - Machine-readable output, stable across builds, so tools/bench.py can
+//   diff two runs (e.g. two commits):
+//     BENCH_BEGIN build=<git describe> cpu_hz=... overhead=... count=...
+//     BENCH name=<name> iters=... min=... median=... max=...
+//     BENCH_END
+//
+// Notes:
+// - The harness cost (two DWT reads + the indirect call of an empty body)
+//   is measured first, subtracted from every sample and printed as overhead.
+// - Per-call timing: an IRQ (SysTick) landing in one call moves max, not
+//   the median. lockIRQ: true masks IRQs around each call (polled code only).
+// - Names are keys for the host diff: keep them stable, no spaces.
+// - Samples are 4 bytes each, allocated per benchmark before timing starts.
+//
+// Dependencies:
+// - Timer.swift: CycleCounter (Board enables it)
+// - MMIO.swift: withIRQLocked
+// - ByteStream.swift: run() (SerialUART, USBSerial)
+//
+
+public final class Bench {
+
+    // MARK: - Public types
+
+    public struct Result {
+        public let name: String
+        public let iterations: U32
+        public let min: U32
+        public let median: U32
+        public let max: U32
+    }
+
+    // MARK: - State
+
+    public let build: String
+    public private(set) var overhead: U32 = 0
+
+    private struct Entry {
+        let name: String
+        let iterations: U32
+        let lockIRQ: Bool
+        let body: () -> Void
+    }
+
+    private var entries: [Entry] = []
+
+    // MARK: - Init
+
+    /// `build`: revision string printed in BENCH_BEGIN (the Makefile passes
+    /// `git describe`).
+    public init(build: String = "unknown") {
+        self.build = build
+    }
+
+    // MARK: - Registry
+
+    public func add(_ name: String, iterations: U32 = 1000, lockIRQ: Bool = false, _ body: @escaping () -> Void) {
+        entries.append(Entry(name: name, iterations: max(iterations, 1), lockIRQ: lockIRQ, body: body))
+    }
+
+    public var count: Int { entries.count }
+
+    // MARK: - Run
+
+    /// Time benchmark `index` (calibrate() first, or overhead is 0).
+    public func measure(_ index: Int) -> Result {
+        let e = entries[index]
+        var samples = [U32](repeating: 0, count: Int(e.iterations))
+        var i = 0
+        while i < samples.count {
+            let dt = e.lockIRQ ? withIRQLocked { Self.time(e.body) } : Self.time(e.body)
+            samples[i] = dt > overhead ? dt - overhead : 0
+            i += 1
+        }
+        samples.sort()
+        return Result(
+            name: e.name,
+            iterations: e.iterations,
+            min: samples[0],
+            median: samples[samples.count / 2],
+            max: samples[samples.count - 1]
+        )
+    }
+
+    /// Harness cost: best of 64 timed calls of an empty body.
+    @discardableResult
+    public func calibrate() -> U32 {
+        let empty: () -> Void = {}
+        var best: U32 = 0xFFFF_FFFF
+        var i = 0
+        while i < 64 {
+            best = Swift.min(best, withIRQLocked { Self.time(empty) })
+            i += 1
+        }
+        overhead = best
+        return best
+    }
+
+    /// Calibrate, run every benchmark in registration order and print the
+    /// report (format in the header).
+    @discardableResult
+    public func run<S: ByteStream>(_ serial: S, cpuHz: U32) -> [Result] {
+        calibrate()
+        serial.writeString("BENCH_BEGIN build=")
+        serial.writeString(build)
+        serial.writeString(" cpu_hz=")
+        serial.writeString(_bench_decU32(cpuHz))
+        serial.writeString(" overhead=")
+        serial.writeString(_bench_decU32(overhead))
+        serial.writeString(" count=")
+        serial.writeString(_bench_decU32(U32(entries.count)))
+        serial.writeString("\r\n")
+
+        var results: [Result] = []
+        var i = 0
+        while i < entries.count {
+            let r = measure(i)
+            results.append(r)
+            serial.writeString("BENCH name=")
+            serial.writeString(r.name)
+            serial.writeString(" iters=")
+            serial.writeString(_bench_decU32(r.iterations))
+            serial.writeString(" min=")
+            serial.writeString(_bench_decU32(r.min))
+            serial.writeString(" median=")
+            serial.writeString(_bench_decU32(r.median))
+            serial.writeString(" max=")
+            serial.writeString(_bench_decU32(r.max))
+            serial.writeString("\r\n")
+            i += 1
+        }
+        serial.writeString("BENCH_END\r\n")
+        return results
+    }
+
+    // MARK: - Internals
+
+    @inline(never)
+    private static func time(_ body: () -> Void) -> U32 {
+        let t0 = CycleCounter.now()
+        body()
+        return CycleCounter.now() &- t0
+    }
+}
+
+// MARK: - Local helpers (file-scoped, unique names)
+
+@inline(__always)
+private func _bench_decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48 // '0'
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
@@ -0,0 +1,149 @@
+//
+// BlockDevice.swift — 512-byte block device interface + RAM disk-image stand-in.
+//
+// Goals:
+// - One small protocol between storage drivers (SDCard) and file layers
+//   (FATLog), so the file layer runs unchanged on a RAM/host disk image.
+// - Async writes: startWrite() returns right away, pollWrite() reports when
+//   the data (and the medium's busy time) is done. Double buffering in the
+//   file layer is built on that.
+// - RAMDisk: the same interface over a byte buffer holding a disk image
+//   (tools/sdimage.py creates one). Good for exercising FATLog without a
+//   card, or for compiling FATLog on a host against a file-backed image.
+//
+// Notes:
+// - Blocks are always 512 bytes; LBAs are block indices (not byte offsets).
+// - Buffers handed to startWrite() must stay untouched until pollWrite()
+//   stops returning .busy.
+// - Generic users (FATLog<Device>) are specialized by the compiler, so the
+//   protocol costs no dynamic dispatch.
+//
+// Dependencies:
+// - MMIO.swift: U32
+//
+
+public enum BlockDeviceError: Swift.Error, Equatable {
+    case notStarted
+    case noCard
+    case unsupportedCard
+    case busy
+    case timeout
+    case command(U32, U32)     // command index, HSMCI SR (or card status)
+    case data(U32)             // HSMCI SR with data error bits
+    case dmaError
+    case outOfRange
+    case misaligned
+
+    /// Short stable identifier (good for logs / UI keys).
+    public var name: String {
+        switch self {
+        case .notStarted: return "not_started"
+        case .noCard: return "no_card"
+        case .unsupportedCard: return "unsupported_card"
+        case .busy: return "busy"
+        case .timeout: return "timeout"
+        case .command: return "command_error"
+        case .data: return "data_error"
+        case .dmaError: return "dma_error"
+        case .outOfRange: return "out_of_range"
+        case .misaligned: return "misaligned"
+        }
+    }
+
+    /// Human-readable message.
+    public var message: String {
+        switch self {
+        case .notStarted: return "Block device not started (call begin())."
+        case .noCard: return "No card answered the initialization sequence."
+        case .unsupportedCard: return "Card type or voltage range not supported."
+        case .busy: return "A write is still in flight."
+        case .timeout: return "Command or data transfer timed out."
+        case .command: return "Card rejected a command (response error)."
+        case .data: return "Data CRC/timeout/overrun error."
+        case .dmaError: return "DMAC reported an AHB error."
+        case .outOfRange: return "Block range beyond the end of the device."
+        case .misaligned: return "Buffer must be 4-byte aligned."
+        }
+    }
+}
+
+public enum BlockWriteState: Equatable {
+    case idle                       // nothing started since the last result
+    case busy                       // data moving or medium programming
+    case done                       // reported once, then .idle
+    case failed(BlockDeviceError)   // reported once, then .idle
+}
+
+public protocol BlockDevice: AnyObject {
+    /// Total 512-byte blocks.
+    var blockCount: U32 { get }
+
+    /// Blocking read of `blocks` blocks into `dst` (4-byte aligned).
+    func read(_ lba: U32, _ dst: UnsafeMutableRawPointer, blocks: U32) throws(BlockDeviceError)
+
+    /// Blocking write (waits for the medium to finish programming).
+    func write(_ lba: U32, _ src: UnsafeRawPointer, blocks: U32) throws(BlockDeviceError)
+
+    /// Start a write and return; `src` must stay untouched until done.
+    func startWrite(_ lba: U32, _ src: UnsafeRawPointer, blocks: U32) throws(BlockDeviceError)
+
+    /// Progress of the last startWrite().
+    func pollWrite() -> BlockWriteState
+}
+
+// MARK: - RAM disk image
+
+/// A disk image in RAM behind the BlockDevice interface. Writes complete at
+/// once; `busyPolls` makes pollWrite() report .busy that many times first,
+/// which stands in for an SD card's programming time.
+public final class RAMDisk: BlockDevice {
+
+    public let image: UnsafeMutableRawPointer
+    public let blockCount: U32
+    public var busyPolls: U32 = 0
+
+    private var pending: U32 = 0
+    private var state: BlockWriteState = .idle
+
+    /// Wrap an existing image (e.g. linked in or received over serial).
+    public init(image: UnsafeMutableRawPointer, blocks: U32) {
+        self.image = image
+        self.blockCount = blocks
+    }
+
+    /// Zero-filled image of `blocks` blocks on the heap.
+    public convenience init(blocks: U32) {
+        let bytes = Int(blocks) * 512
+        let p = UnsafeMutableRawPointer.allocate(byteCount: bytes, alignment: 4)
+        p.initializeMemory(as: UInt8.self, repeating: 0, count: bytes)
+        self.init(image: p, blocks: blocks)
+    }
+
+    public func read(_ lba: U32, _ dst: UnsafeMutableRawPointer, blocks: U32) throws(BlockDeviceError) {
+        try check(lba, blocks)
+        dst.copyMemory(from: image + Int(lba) * 512, byteCount: Int(blocks) * 512)
+    }
+
+    public func write(_ lba: U32, _ src: UnsafeRawPointer, blocks: U32) throws(BlockDeviceError) {
+        if state == .busy { throw .busy }
+        try check(lba, blocks)
+        (image + Int(lba) * 512).copyMemory(from: src, byteCount: Int(blocks) * 512)
+    }
+
+    public func startWrite(_ lba: U32, _ src: UnsafeRawPointer, blocks: U32) throws(BlockDeviceError) {
+        try write(lba, src, blocks: blocks)
+        pending = busyPolls
+        state = .busy
+    }
+
+    public func pollWrite() -> BlockWriteState {
+        if state != .busy { return .idle }
+        if pending > 0 { pending -= 1; return .busy }
+        state = .idle
+        return .done
+    }
+
+    private func check(_ lba: U32, _ blocks: U32) throws(BlockDeviceError) {
+        if blocks == 0 || lba >= blockCount || blocks > blockCount - lba { throw .outOfRange }
+    }
+}
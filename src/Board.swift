@@ -1,10 +1,12 @@
 // Board.swift — clock + UART + SysTick + I2C (board services only)
 //
 // Responsibilities:
-// - Disable watchdog
+// - Disable watchdog (or leave it to Watchdog.begin(): WDT_MR is write-once)
 // - Configure system clock (84 MHz, fallback to 4 MHz)
 // - Initialize UART for logging
+// - Apply the NVIC priority plan (grouping, SysTick level)
 // - Start SysTick (1 ms tick)
+// - Enable the DWT cycle counter (instrumentation / benchmarks)
 // - Create I2C object (no begin here)
 //
 // IMPORTANT:
@@ -16,6 +18,7 @@
 // - MMIO.swift
 // - Clock.swift
 // - Timer.swift
+// - NVIC.swift
 // - SerialUART.swift
 // - I2C.swift
 
@@ -37,11 +40,16 @@ public enum Board {
     @inline(__always)
     public static func initBoard(
         baud: U32 = 115_200,
-        printBootBanner: Bool = true
+        printBootBanner: Bool = true,
+        watchdog: Bool = false
     ) -> Context {
 
-        // 1) Disable watchdog
-        write32(ATSAM3X8E.WDT.MR, ATSAM3X8E.WDT.WDT_MR_WDDIS)
+        // 1) Disable watchdog.
+        // - watchdog: true keeps the reset default (enabled, 16 s) until
+        //   Watchdog.begin() writes the real period; MR accepts one write.
+        if !watchdog {
+            write32(ATSAM3X8E.WDT.MR, ATSAM3X8E.WDT.WDT_MR_WDDIS)
+        }
 
         // 2) Clock setup (84 MHz, fallback to 4 MHz)
         let ok = DueClock.init84MHz()
@@ -60,9 +68,11 @@ public enum Board {
             serial.writeString("\r\n")
         }
 
-        // 4) SysTick (1 ms tick)
+        // 4) SysTick (1 ms tick), after the NVIC priority plan (grouping + SysTick level)
+        NVIC.applyPlan()
         let timer = Timer(cpuHz: cpu)
         timer.startTick1ms()
+        CycleCounter.enable()
 
         // IMPORTANT:
         // - Do NOT enable global IRQs here.
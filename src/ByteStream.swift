@@ -0,0 +1,34 @@
+//
+// ByteStream.swift — byte-oriented serial port interface (UART, USB CDC).
+//
+// Goals:
+// - One small protocol between serial ports (SerialUART, USBSerial) and the
+//   code that prints reports or runs a link protocol over them
+//   (EEFCTelemetry.dump, Profiler.dump, Bench.run, FirmwareUpdater), so that
+//   code takes either port.
+//
+// Notes:
+// - Generic users (FirmwareUpdater<Port>, dump<S: ByteStream>) are
+//   specialized by the compiler, so the protocol costs no dynamic dispatch.
+// - writeString() expands "\n" to "\r\n" on every port; writeByte() sends
+//   the byte as is (binary dumps).
+// - Flow control is the port's: SerialUART waits for the transmitter,
+//   USBSerial waits once and then drops while no host reads (see its header).
+//
+// Dependencies:
+// - MMIO.swift: U8/U32
+//
+
+public protocol ByteStream: AnyObject {
+    /// One byte out, unchanged.
+    func writeByte(_ b: U8)
+
+    /// UTF-8 bytes of `s`, "\n" sent as "\r\n".
+    func writeString(_ s: String)
+
+    /// 8 uppercase hex digits, "0x" first when `prefix`.
+    func writeHex32(_ v: U32, prefix: Bool)
+
+    /// 0...255 if a byte is available, -1 if none.
+    func readByteNonBlocking() -> Int32
+}
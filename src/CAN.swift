@@ -0,0 +1,781 @@
+//
+// CAN.swift — CAN0/CAN1 controller: bit timing, filtered mailbox FIFOs,
+// interrupt-driven RX queue, prioritized TX queue, error accounting.
+//
+// Goals:
+// - Bit timing computed from mckHz: prescaler, propagation/phase segments
+//   and SJW for the requested bitrate at a target sample point (87.5%).
+// - RX through hardware acceptance filtering: each filter (ID + mask) owns
+//   one or more consecutive mailboxes; several mailboxes with the same
+//   filter form a hardware FIFO (the controller fills the lowest free one).
+// - CAN0_Handler/CAN1_Handler drain ready mailboxes (oldest timestamp first)
+//   into a lock-free single-producer/single-consumer queue: the ISR only
+//   moves the head, receive() only moves the tail, no IRQ masking on read.
+// - TX queue sorted by bus arbitration order (lower ID wins, standard before
+//   extended, data before remote, FIFO among equals). When every TX mailbox
+//   holds a frame that would lose arbitration against the queue head, the
+//   worst one is aborted and requeued (no priority inversion).
+// - Error accounting: CRC/stuff/ack/form/bit errors, error passive, bus-off
+//   and recoveries; TEC/REC on demand.
+// - Mode.loopback: no pins and no bus. Frames go through the TX queue and
+//   the same acceptance filters (emulated) into the RX queue, so filters and
+//   the queue code can be exercised on a bare board.
+//
+// Notes:
+// - With global IRQs off, call poll() from the loop. poll(), send() and
+//   resetStats() mask IRQs around their shared state and restore the
+//   caller's PRIMASK (withIRQLocked), so they never turn IRQs on.
+// - The SAM3X CAN has no internal loopback; for a real bus test wire CAN0
+//   and CAN1 through two transceivers (see examples/CAN_example.swift).
+// - Pins: CANTX0 = PA0, CANRX0 = PA1 (Due CANTX/CANRX); CANTX1 = PB14 (D53),
+//   CANRX1 = PB15 (the DAC0 pin). A transceiver is always required.
+// - RX mailboxes are numbered from 0 up, TX mailboxes take the top
+//   `txMailboxes` numbers. Filters are added after begin() and stay until
+//   the next begin().
+// - A standard-ID filter compares MIDvA only, so an extended frame whose top
+//   11 bits match also passes (mask 0 accepts every frame).
+// - Bus-off recovery is automatic (128 x 11 recessive bits); queued frames
+//   wait and go out after it.
+// - Budget at 1 Mbit/s: a frame is at least 47 us; the ISR spends ~2 us on
+//   it. Size rxQueueSize for the longest main-loop stall (64 frames = 3 ms
+//   of a fully loaded bus).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, waitUntil, withIRQLocked, bm_dsb
+// - ATSAM3X8E.swift: CAN registers, PMC, PIO
+// - NVIC.swift: enable/disable(.can0/.can1)
+// - arm/startup.s: CAN0_Handler / CAN1_Handler (IRQ 43 / 44)
+//
+
+// ISR targets. MUST be global and single symbol.
+public var g_can0: CAN? = nil
+public var g_can1: CAN? = nil
+
+public final class CAN {
+
+    // MARK: - Public types
+
+    public enum Port {
+        case can0
+        case can1
+    }
+
+    public enum Mode {
+        case normal
+        case listenOnly      // ABM: receive, never ACK or transmit
+        case loopback        // software only: TX queue -> filters -> RX queue
+    }
+
+    public enum ErrorState {
+        case active
+        case passive         // TEC or REC >= 128
+        case busOff          // TEC >= 256, recovering
+    }
+
+    public struct Frame {
+        public var id: U32
+        public var extended: Bool
+        public var remote: Bool
+        public var length: U8            // DLC 0...8
+        public var dataLow: U32          // bytes 0..3 (byte 0 = bits 0..7)
+        public var dataHigh: U32         // bytes 4..7
+        public var timestamp: U16        // controller bit-time stamp at SOF (RX)
+
+        public init(
+            id: U32,
+            extended: Bool = false,
+            remote: Bool = false,
+            length: U8 = 0,
+            dataLow: U32 = 0,
+            dataHigh: U32 = 0
+        ) {
+            self.id = id
+            self.extended = extended
+            self.remote = remote
+            self.length = length
+            self.dataLow = dataLow
+            self.dataHigh = dataHigh
+            self.timestamp = 0
+        }
+
+        public subscript(i: Int) -> U8 {
+            get {
+                let w = i < 4 ? dataLow : dataHigh
+                return U8((w >> (U32(i & 3) * 8)) & 0xFF)
+            }
+            set {
+                let shift = U32(i & 3) * 8
+                let mask = ~(U32(0xFF) << shift)
+                if i < 4 {
+                    dataLow = (dataLow & mask) | (U32(newValue) << shift)
+                } else {
+                    dataHigh = (dataHigh & mask) | (U32(newValue) << shift)
+                }
+            }
+        }
+
+        /// Bits on the wire without stuffing (incl. 3-bit intermission).
+        public var bits: U32 {
+            (extended ? 67 : 47) + (remote ? 0 : 8 * U32(length))
+        }
+
+        /// Bus arbitration order: smaller wins. Base ID, then IDE (standard
+        /// first), then the 18 extension bits, then RTR (data first).
+        public var arbitrationKey: U32 {
+            let base = extended ? (id >> 18) & 0x7FF : id & 0x7FF
+            let low = extended ? id & 0x3_FFFF : 0
+            return (base << 20) | ((extended ? 1 : 0) << 19) | (low << 1) | (remote ? 1 : 0)
+        }
+    }
+
+    /// Hardware acceptance filter: a frame passes when (frameID ^ id) & mask == 0.
+    public struct Filter {
+        public let id: U32
+        public let mask: U32
+        public let extended: Bool
+
+        public func accepts(_ f: Frame) -> Bool {
+            if extended {
+                return f.extended && ((f.id ^ id) & mask & ATSAM3X8E.CAN.MID_EXT_MASK) == 0
+            }
+            let idA = f.extended ? (f.id >> 18) & ATSAM3X8E.CAN.MID_STD_MASK : f.id
+            return ((idA ^ id) & mask & ATSAM3X8E.CAN.MID_STD_MASK) == 0
+        }
+    }
+
+    public struct Timing {
+        public let prescaler: U32        // BRP + 1 (MCK cycles per quantum)
+        public let quantaPerBit: U32     // 8...25
+        public let propagation: U32      // quanta
+        public let phase1: U32
+        public let phase2: U32
+        public let sjw: U32
+        public let bitrate: U32
+        public let samplePointPermille: U32
+
+        var register: U32 {
+            ((phase2 - 1) << ATSAM3X8E.CAN.BR_PHASE2_SHIFT) |
+                ((phase1 - 1) << ATSAM3X8E.CAN.BR_PHASE1_SHIFT) |
+                ((propagation - 1) << ATSAM3X8E.CAN.BR_PROPAG_SHIFT) |
+                ((sjw - 1) << ATSAM3X8E.CAN.BR_SJW_SHIFT) |
+                ((prescaler - 1) << ATSAM3X8E.CAN.BR_BRP_SHIFT)
+        }
+    }
+
+    public struct Stats {
+        public var rxFrames: U32 = 0
+        public var rxOverruns: U32 = 0       // RX queue full: frame dropped
+        public var rxLost: U32 = 0           // mailbox FIFO full: frame lost in hardware
+        public var rxQueueMax: U32 = 0       // queue depth high-water mark
+        public var txFrames: U32 = 0
+        public var txQueueFull: U32 = 0
+        public var txAborts: U32 = 0         // preempted by a higher-priority frame
+        public var txDropped: U32 = 0
+        public var crcErrors: U32 = 0
+        public var stuffErrors: U32 = 0
+        public var ackErrors: U32 = 0
+        public var formErrors: U32 = 0
+        public var bitErrors: U32 = 0
+        public var errorPassive: U32 = 0
+        public var busOff: U32 = 0
+        public var recoveries: U32 = 0
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case notStarted
+        case invalidBitrate(U32)
+        case invalidConfig
+        case invalidFrame
+        case noMailbox
+        case queueFull
+        case listenOnly
+        case notSynchronized
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .notStarted: return "not_started"
+            case .invalidBitrate: return "invalid_bitrate"
+            case .invalidConfig: return "invalid_config"
+            case .invalidFrame: return "invalid_frame"
+            case .noMailbox: return "no_mailbox"
+            case .queueFull: return "queue_full"
+            case .listenOnly: return "listen_only"
+            case .notSynchronized: return "not_synchronized"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .notStarted: return "CAN not started (call begin())."
+            case .invalidBitrate(let b): return "No bit timing for \(b) bit/s at this MCK."
+            case .invalidConfig: return "Invalid mailbox or queue configuration."
+            case .invalidFrame: return "ID out of range or length > 8."
+            case .noMailbox: return "No free RX mailbox for this filter."
+            case .queueFull: return "TX queue is full."
+            case .listenOnly: return "Transmit not allowed in listen-only mode."
+            case .notSynchronized: return "Controller did not synchronize to the bus (transceiver?)."
+            }
+        }
+    }
+
+    // MARK: - Constants
+
+    public static let defaultSamplePointPermille: U32 = 875
+
+    private static let syncTimeoutSpins: U32 = 2_000_000
+
+    // MARK: - State
+
+    public let port: Port
+    public private(set) var mode: Mode = .normal
+    public private(set) var timing: Timing? = nil
+    public private(set) var stats = Stats()
+    public private(set) var errorState: ErrorState = .active
+
+    private let base: U32
+    private let mckHz: U32
+    private var started = false
+    private var clockHeld = false
+
+    // RX queue: head moved by the ISR only, tail by receive() only.
+    private let rxQueue: UnsafeMutablePointer<Frame>
+    private let rxSize: U32
+    private var rxHead: U32 = 0
+    private var rxTail: U32 = 0
+
+    // TX queue sorted by arbitrationKey, descending: the next frame is last.
+    private let txQueue: UnsafeMutablePointer<Frame>
+    private let txCapacity: Int
+    private var txCount = 0
+
+    // Mailboxes
+    private let filters: UnsafeMutablePointer<Filter>
+    private let txSlots: UnsafeMutablePointer<Frame>     // frame loaded in each TX mailbox
+    private let msrScratch: UnsafeMutablePointer<U32>
+    private var rxMailboxes: U32 = 0
+    private var txMailboxes: U32 = 0
+    private var nextRxMailbox: U32 = 0
+    private var firstTxMailbox: U32 = 8
+    private var txBusy: U32 = 0
+    private var txAborting: U32 = 0
+
+    // MARK: - Init
+
+    /// `rxQueueSize` must be a power of two.
+    public init(_ port: Port = .can0, mckHz: U32, rxQueueSize: Int = 64, txQueueSize: Int = 32) {
+        self.port = port
+        self.base = port == .can0 ? ATSAM3X8E.CAN0_BASE : ATSAM3X8E.CAN1_BASE
+        self.mckHz = mckHz
+        let rx = rxQueueSize > 0 && (rxQueueSize & (rxQueueSize - 1)) == 0 ? rxQueueSize : 64
+        self.rxSize = U32(rx)
+        self.rxQueue = UnsafeMutablePointer<Frame>.allocate(capacity: rx)
+        self.txCapacity = max(txQueueSize, 1)
+        self.txQueue = UnsafeMutablePointer<Frame>.allocate(capacity: txCapacity)
+        self.filters = UnsafeMutablePointer<Filter>.allocate(capacity: Int(ATSAM3X8E.CAN.MAILBOXES))
+        self.txSlots = UnsafeMutablePointer<Frame>.allocate(capacity: Int(ATSAM3X8E.CAN.MAILBOXES))
+        self.msrScratch = UnsafeMutablePointer<U32>.allocate(capacity: Int(ATSAM3X8E.CAN.MAILBOXES))
+    }
+
+    // MARK: - Bit timing
+
+    /// Best split of one bit for `bitrate` at `mckHz`: exact prescaler, the
+    /// sample point closest to the target. Nil if no exact divisor exists
+    /// (at 84 MHz roughly 27 kbit/s ... 1 Mbit/s, standard rates all fit).
+    public static func timing(
+        bitrate: U32,
+        mckHz: U32,
+        samplePointPermille: U32 = CAN.defaultSamplePointPermille
+    ) -> Timing? {
+        if bitrate == 0 || bitrate > 1_000_000 { return nil }
+        var best: Timing? = nil
+        var bestErr: U32 = U32.max
+
+        var tq: U32 = 25
+        while tq >= 8 {
+            let div = bitrate * tq
+            let prescaler = mckHz / div
+            if mckHz % div == 0 && prescaler >= 1 && prescaler <= 128 {
+                // Quanta up to the sample point (sync + PROPAG + PHASE1), at most 17.
+                let before = min((tq * samplePointPermille + 500) / 1000, 17)
+                let phase2 = tq - before
+                let tseg1 = before - 1
+                if phase2 >= 2 && phase2 <= 8 && tseg1 >= 2 {
+                    var phase1 = min(8, max(1, tseg1 / 2))
+                    var prop = tseg1 - phase1
+                    if prop > 8 {
+                        phase1 += prop - 8
+                        prop = 8
+                    }
+                    let sp = before * 1000 / tq
+                    let err = sp > samplePointPermille ? sp - samplePointPermille : samplePointPermille - sp
+                    if phase1 <= 8 && err < bestErr {
+                        bestErr = err
+                        best = Timing(
+                            prescaler: prescaler,
+                            quantaPerBit: tq,
+                            propagation: prop,
+                            phase1: phase1,
+                            phase2: phase2,
+                            sjw: min(4, min(phase1, phase2)),
+                            bitrate: mckHz / (prescaler * tq),
+                            samplePointPermille: sp
+                        )
+                    }
+                }
+            }
+            tq -= 1
+        }
+        return best
+    }
+
+    // MARK: - Setup
+
+    /// Program bit timing, reset every mailbox, reserve the top `txMailboxes`
+    /// for TX and join the bus. Add filters afterwards (nothing is received
+    /// until then).
+    public func begin(bitrate: U32, mode: Mode = .normal, txMailboxes: Int = 2) throws(CAN.Error) {
+        if txMailboxes < 1 || txMailboxes > Int(ATSAM3X8E.CAN.MAILBOXES) - 1 { throw .invalidConfig }
+        guard let t = Self.timing(bitrate: bitrate, mckHz: mckHz) else { throw .invalidBitrate(bitrate) }
+
+        started = false
+        timing = t
+        self.mode = mode
+        errorState = .active
+        rxHead = 0
+        rxTail = 0
+        txCount = 0
+        txBusy = 0
+        txAborting = 0
+        rxMailboxes = 0
+        nextRxMailbox = 0
+        firstTxMailbox = ATSAM3X8E.CAN.MAILBOXES - U32(txMailboxes)
+        self.txMailboxes = (U32(0xFF) << firstTxMailbox) & ATSAM3X8E.CAN.SR_MB_MASK
+
+        if mode == .loopback {
+            started = true
+            return
+        }
+
+        if !clockHeld {
+            PeripheralClock.acquire(port == .can0 ? ATSAM3X8E.ID.CAN0 : ATSAM3X8E.ID.CAN1)
+            clockHeld = true
+        }
+        if port == .can0 {
+            write32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.CAN.PIOA_CAN0_MASK)
+            clearBits32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.CAN.PIOA_CAN0_MASK)
+        } else {
+            write32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.CAN.PIOB_CAN1_MASK)
+            clearBits32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.CAN.PIOB_CAN1_MASK)
+        }
+
+        write32(base + ATSAM3X8E.CAN.WPMR_OFFSET, ATSAM3X8E.CAN.WPMR_KEY)
+        write32(base + ATSAM3X8E.CAN.MR_OFFSET, 0)
+        write32(base + ATSAM3X8E.CAN.IDR_OFFSET, 0xFFFF_FFFF)
+        write32(base + ATSAM3X8E.CAN.BR_OFFSET, t.register)
+
+        var m: U32 = 0
+        while m < ATSAM3X8E.CAN.MAILBOXES {
+            write32(mb(m, ATSAM3X8E.CAN.MMR_OFFSET), 0)
+            write32(mb(m, ATSAM3X8E.CAN.MAM_OFFSET), 0)
+            write32(mb(m, ATSAM3X8E.CAN.MID_OFFSET), 0)
+            if m >= firstTxMailbox {
+                write32(mb(m, ATSAM3X8E.CAN.MMR_OFFSET), ATSAM3X8E.CAN.MOT_TX << ATSAM3X8E.CAN.MMR_MOT_SHIFT)
+            }
+            m += 1
+        }
+
+        _ = read32(base + ATSAM3X8E.CAN.SR_OFFSET)      // drop stale error flags
+        write32(
+            base + ATSAM3X8E.CAN.IER_OFFSET,
+            ATSAM3X8E.CAN.SR_ERRORS | ATSAM3X8E.CAN.SR_ERRP | ATSAM3X8E.CAN.SR_BOFF
+        )
+
+        switch port {
+        case .can0: g_can0 = self
+        case .can1: g_can1 = self
+        }
+        NVIC.enable(port == .can0 ? NVIC.IRQ.can0 : NVIC.IRQ.can1)
+
+        write32(
+            base + ATSAM3X8E.CAN.MR_OFFSET,
+            ATSAM3X8E.CAN.MR_CANEN | (mode == .listenOnly ? ATSAM3X8E.CAN.MR_ABM : 0)
+        )
+        // WAKEUP: 11 recessive bits seen, the controller is on the bus.
+        if !waitBitSet32(base + ATSAM3X8E.CAN.SR_OFFSET, ATSAM3X8E.CAN.SR_WAKEUP, timeout: Self.syncTimeoutSpins) {
+            throw .notSynchronized
+        }
+        started = true
+    }
+
+    /// Leave the bus: controller off, IRQ line off, clock released. Queued
+    /// frames are dropped; begin() starts over.
+    public func end() {
+        started = false
+        if !clockHeld { return }
+        write32(base + ATSAM3X8E.CAN.MR_OFFSET, 0)
+        write32(base + ATSAM3X8E.CAN.IDR_OFFSET, 0xFFFF_FFFF)
+        NVIC.disable(port == .can0 ? NVIC.IRQ.can0 : NVIC.IRQ.can1)
+        PeripheralClock.release(port == .can0 ? ATSAM3X8E.ID.CAN0 : ATSAM3X8E.ID.CAN1)
+        clockHeld = false
+        txCount = 0
+        txBusy = 0
+    }
+
+    /// Accept frames matching `id`/`mask` into `depth` consecutive RX mailboxes
+    /// (a hardware FIFO). Returns the first mailbox number.
+    @discardableResult
+    public func addFilter(id: U32, mask: U32, extended: Bool = false, depth: Int = 1) throws(CAN.Error) -> Int {
+        if !started { throw .notStarted }
+        if depth < 1 || nextRxMailbox + U32(depth) > firstTxMailbox { throw .noMailbox }
+
+        let f = Filter(id: id, mask: mask, extended: extended)
+        let first = nextRxMailbox
+        var i = 0
+        while i < depth {
+            let m = nextRxMailbox
+            filters[Int(m)] = f
+            if mode != .loopback { armRxMailbox(m, f) }
+            withIRQLocked { rxMailboxes |= U32(1) << m }
+            nextRxMailbox += 1
+            i += 1
+        }
+        return Int(first)
+    }
+
+    /// One pass-everything filter over every remaining RX mailbox.
+    @discardableResult
+    public func acceptAll() throws(CAN.Error) -> Int {
+        try addFilter(id: 0, mask: 0, depth: Int(firstTxMailbox) - Int(nextRxMailbox))
+    }
+
+    // MARK: - Transmit
+
+    /// Queue a frame; it goes out in arbitration order (lowest ID first).
+    public func send(_ frame: Frame) throws(CAN.Error) {
+        if !started { throw .notStarted }
+        if mode == .listenOnly { throw .listenOnly }
+        let maxID = frame.extended ? ATSAM3X8E.CAN.MID_EXT_MASK : ATSAM3X8E.CAN.MID_STD_MASK
+        if frame.length > 8 || frame.id > maxID { throw .invalidFrame }
+
+        if mode == .loopback {
+            loopback(frame)
+            return
+        }
+
+        let queued = withIRQLocked { () -> Bool in
+            if !insertTx(frame, ahead: false) {
+                stats.txQueueFull &+= 1
+                return false
+            }
+            loadTx()
+            return true
+        }
+        if !queued { throw .queueFull }
+    }
+
+    /// Frames waiting for a TX mailbox.
+    public var txPending: Int { txCount }
+
+    /// True when nothing is queued and no TX mailbox is busy.
+    public var txIdle: Bool { txCount == 0 && txBusy == 0 }
+
+    // MARK: - Receive
+
+    /// Next received frame (oldest first), nil when the queue is empty.
+    public func receive() -> Frame? {
+        let tail = rxTail
+        if tail == rxHead { return nil }
+        let f = rxQueue[Int(tail & (rxSize - 1))]
+        bm_dsb()                 // slot read before the ISR may reuse it
+        rxTail = tail &+ 1
+        return f
+    }
+
+    /// Frames waiting in the RX queue.
+    public var available: Int { Int(rxHead &- rxTail) }
+
+    // MARK: - Status
+
+    /// Transmit / receive error counters (ECR).
+    public var errorCounters: (tx: U32, rx: U32) {
+        if mode == .loopback { return (0, 0) }
+        let ecr = read32(base + ATSAM3X8E.CAN.ECR_OFFSET)
+        return ((ecr >> ATSAM3X8E.CAN.ECR_TEC_SHIFT) & 0xFF, ecr & ATSAM3X8E.CAN.ECR_REC_MASK)
+    }
+
+    public func resetStats() {
+        withIRQLocked { stats = Stats() }
+    }
+
+    /// Run the interrupt service from the loop (needed with IRQs off).
+    /// PRIMASK is left as found: polled firmware keeps its IRQs off.
+    public func poll() {
+        if mode != .loopback { withIRQLocked { handleInterrupt() } }
+    }
+
+    /// Mailbox + error events. Called from CAN0_Handler / CAN1_Handler.
+    public func handleInterrupt() {
+        let sr = read32(base + ATSAM3X8E.CAN.SR_OFFSET)     // clears the error flags
+        countErrors(sr)
+        let pending = sr & read32(base + ATSAM3X8E.CAN.IMR_OFFSET)
+
+        if (pending & (ATSAM3X8E.CAN.SR_ERRP | ATSAM3X8E.CAN.SR_BOFF | ATSAM3X8E.CAN.SR_ERRA)) != 0 {
+            updateErrorState(sr)
+        }
+        let rx = pending & rxMailboxes
+        if rx != 0 { drainRx(rx) }
+        let tx = pending & txBusy
+        if tx != 0 {
+            retireTx(tx)
+            loadTx()
+        }
+    }
+
+    // MARK: - RX internals
+
+    @inline(__always)
+    private func mb(_ m: U32, _ offset: U32) -> U32 {
+        base + ATSAM3X8E.CAN.MB_BASE + m * ATSAM3X8E.CAN.MB_STRIDE + offset
+    }
+
+    private func armRxMailbox(_ m: U32, _ f: Filter) {
+        let mam: U32
+        let mid: U32
+        if f.extended {
+            mam = (f.mask & ATSAM3X8E.CAN.MID_EXT_MASK) | ATSAM3X8E.CAN.MID_MIDE
+            mid = (f.id & ATSAM3X8E.CAN.MID_EXT_MASK) | ATSAM3X8E.CAN.MID_MIDE
+        } else {
+            mam = (f.mask & ATSAM3X8E.CAN.MID_STD_MASK) << ATSAM3X8E.CAN.MID_MIDVA_SHIFT
+            mid = (f.id & ATSAM3X8E.CAN.MID_STD_MASK) << ATSAM3X8E.CAN.MID_MIDVA_SHIFT
+        }
+        write32(mb(m, ATSAM3X8E.CAN.MMR_OFFSET), 0)
+        write32(mb(m, ATSAM3X8E.CAN.MAM_OFFSET), mam)
+        write32(mb(m, ATSAM3X8E.CAN.MID_OFFSET), mid)
+        write32(mb(m, ATSAM3X8E.CAN.MMR_OFFSET), ATSAM3X8E.CAN.MOT_RX << ATSAM3X8E.CAN.MMR_MOT_SHIFT)
+        write32(base + ATSAM3X8E.CAN.IER_OFFSET, U32(1) << m)
+    }
+
+    /// Copy every ready RX mailbox into the queue, oldest timestamp first
+    /// (a mailbox FIFO refills its lowest free slot, so number order is not
+    /// arrival order), and hand each mailbox back to the controller.
+    private func drainRx(_ ready: U32) {
+        let now = U16(truncatingIfNeeded: read32(base + ATSAM3X8E.CAN.TIM_OFFSET))
+        var left = ready
+        var bits = ready
+        while bits != 0 {
+            let m = U32(bits.trailingZeroBitCount)
+            bits &= bits - 1
+            msrScratch[Int(m)] = read32(mb(m, ATSAM3X8E.CAN.MSR_OFFSET))    // clears MMI: read once
+        }
+
+        while left != 0 {
+            var pick: U32 = 0
+            var oldest: U16 = 0
+            var scan = left
+            var first = true
+            while scan != 0 {
+                let m = U32(scan.trailingZeroBitCount)
+                scan &= scan - 1
+                let age = now &- U16(truncatingIfNeeded: msrScratch[Int(m)])
+                if first || age > oldest {
+                    pick = m
+                    oldest = age
+                    first = false
+                }
+            }
+            left &= ~(U32(1) << pick)
+
+            let msr = msrScratch[Int(pick)]
+            let mid = read32(mb(pick, ATSAM3X8E.CAN.MID_OFFSET))
+            let ext = (mid & ATSAM3X8E.CAN.MID_MIDE) != 0
+            var f = Frame(
+                id: ext ? mid & ATSAM3X8E.CAN.MID_EXT_MASK
+                    : (mid >> ATSAM3X8E.CAN.MID_MIDVA_SHIFT) & ATSAM3X8E.CAN.MID_STD_MASK,
+                extended: ext,
+                remote: (msr & ATSAM3X8E.CAN.MSR_MRTR) != 0,
+                length: U8(min((msr >> ATSAM3X8E.CAN.MSR_MDLC_SHIFT) & 0xF, 8)),
+                dataLow: read32(mb(pick, ATSAM3X8E.CAN.MDL_OFFSET)),
+                dataHigh: read32(mb(pick, ATSAM3X8E.CAN.MDH_OFFSET))
+            )
+            f.timestamp = U16(truncatingIfNeeded: msr & ATSAM3X8E.CAN.MSR_MTIMESTAMP_MASK)
+            write32(mb(pick, ATSAM3X8E.CAN.MCR_OFFSET), ATSAM3X8E.CAN.MCR_MTCR)   // mailbox free again
+
+            if (msr & ATSAM3X8E.CAN.MSR_MMI) != 0 { stats.rxLost &+= 1 }
+            push(f)
+        }
+    }
+
+    /// Producer side of the RX queue (ISR, or send() in loopback mode).
+    @inline(__always)
+    private func push(_ f: Frame) {
+        let head = rxHead
+        let depth = head &- rxTail
+        if depth >= rxSize {
+            stats.rxOverruns &+= 1
+            return
+        }
+        rxQueue[Int(head & (rxSize - 1))] = f
+        bm_dsb()                 // slot written before the head moves
+        rxHead = head &+ 1
+        stats.rxFrames &+= 1
+        if depth + 1 > stats.rxQueueMax { stats.rxQueueMax = depth + 1 }
+    }
+
+    private func loopback(_ f: Frame) {
+        stats.txFrames &+= 1
+        var m: U32 = 0
+        while m < nextRxMailbox {
+            if filters[Int(m)].accepts(f) {
+                push(f)
+                return
+            }
+            m += 1
+        }
+    }
+
+    // MARK: - TX internals
+
+    /// Sorted insert (descending key). `ahead`: before equal keys (a
+    /// preempted frame keeps its place), otherwise after them (FIFO).
+    private func insertTx(_ f: Frame, ahead: Bool) -> Bool {
+        if txCount >= txCapacity { return false }
+        let key = f.arbitrationKey
+        var i = txCount
+        while i > 0 {
+            let k = txQueue[i - 1].arbitrationKey
+            if ahead ? k < key : k <= key {
+                txQueue[i] = txQueue[i - 1]
+                i -= 1
+            } else {
+                break
+            }
+        }
+        txQueue[i] = f
+        txCount += 1
+        return true
+    }
+
+    /// Fill free TX mailboxes from the queue head; preempt when all are
+    /// taken by frames that lose against the head. IRQs must be masked.
+    private func loadTx() {
+        var free = txMailboxes & ~txBusy
+        while txCount > 0 && free != 0 {
+            let m = U32(free.trailingZeroBitCount)
+            free &= free - 1
+            txCount -= 1
+            writeTxMailbox(m, txQueue[txCount])
+        }
+        if txCount == 0 || free != 0 { return }
+
+        let head = txQueue[txCount - 1].arbitrationKey
+        var worst: U32 = 0
+        var victim: U32 = 32
+        var scan = txBusy & ~txAborting
+        while scan != 0 {
+            let m = U32(scan.trailingZeroBitCount)
+            scan &= scan - 1
+            let k = txSlots[Int(m)].arbitrationKey
+            if k > head && k >= worst {
+                worst = k
+                victim = m
+            }
+        }
+        if victim < 32 {
+            txAborting |= U32(1) << victim
+            write32(base + ATSAM3X8E.CAN.ACR_OFFSET, U32(1) << victim)
+        }
+    }
+
+    private func writeTxMailbox(_ m: U32, _ f: Frame) {
+        // PRIOR: top 4 bits of the arbitration key, so the controller also
+        // picks between its own loaded mailboxes in bus order.
+        let prior = f.arbitrationKey >> 27
+        write32(
+            mb(m, ATSAM3X8E.CAN.MMR_OFFSET),
+            (ATSAM3X8E.CAN.MOT_TX << ATSAM3X8E.CAN.MMR_MOT_SHIFT) | (prior << ATSAM3X8E.CAN.MMR_PRIOR_SHIFT)
+        )
+        write32(
+            mb(m, ATSAM3X8E.CAN.MID_OFFSET),
+            f.extended ? f.id | ATSAM3X8E.CAN.MID_MIDE : f.id << ATSAM3X8E.CAN.MID_MIDVA_SHIFT
+        )
+        write32(mb(m, ATSAM3X8E.CAN.MDL_OFFSET), f.dataLow)
+        write32(mb(m, ATSAM3X8E.CAN.MDH_OFFSET), f.dataHigh)
+        txSlots[Int(m)] = f
+        txBusy |= U32(1) << m
+        write32(
+            mb(m, ATSAM3X8E.CAN.MCR_OFFSET),
+            ATSAM3X8E.CAN.MCR_MTCR | (U32(f.length) << ATSAM3X8E.CAN.MCR_MDLC_SHIFT) |
+                (f.remote ? ATSAM3X8E.CAN.MCR_MRTR : 0)
+        )
+        write32(base + ATSAM3X8E.CAN.IER_OFFSET, U32(1) << m)
+    }
+
+    /// TX mailboxes that became ready: sent, or aborted (frame requeued).
+    private func retireTx(_ done: U32) {
+        var bits = done
+        while bits != 0 {
+            let m = U32(bits.trailingZeroBitCount)
+            bits &= bits - 1
+            let bit = U32(1) << m
+            let msr = read32(mb(m, ATSAM3X8E.CAN.MSR_OFFSET))
+            if (msr & ATSAM3X8E.CAN.MSR_MABT) != 0 {
+                stats.txAborts &+= 1
+                if !insertTx(txSlots[Int(m)], ahead: true) { stats.txDropped &+= 1 }
+            } else {
+                stats.txFrames &+= 1
+            }
+            txBusy &= ~bit
+            txAborting &= ~bit
+            write32(base + ATSAM3X8E.CAN.IDR_OFFSET, bit)
+        }
+    }
+
+    // MARK: - Errors
+
+    @inline(__always)
+    private func countErrors(_ sr: U32) {
+        if (sr & ATSAM3X8E.CAN.SR_ERRORS) == 0 { return }
+        if (sr & ATSAM3X8E.CAN.SR_CERR) != 0 { stats.crcErrors &+= 1 }
+        if (sr & ATSAM3X8E.CAN.SR_SERR) != 0 { stats.stuffErrors &+= 1 }
+        if (sr & ATSAM3X8E.CAN.SR_AERR) != 0 { stats.ackErrors &+= 1 }
+        if (sr & ATSAM3X8E.CAN.SR_FERR) != 0 { stats.formErrors &+= 1 }
+        if (sr & ATSAM3X8E.CAN.SR_BERR) != 0 { stats.bitErrors &+= 1 }
+    }
+
+    /// ERRP/BOFF/ERRA are levels: only the transitions out of the current
+    /// state stay enabled, so a passive or bus-off bus cannot storm the IRQ.
+    private func updateErrorState(_ sr: U32) {
+        let ier = base + ATSAM3X8E.CAN.IER_OFFSET
+        let idr = base + ATSAM3X8E.CAN.IDR_OFFSET
+        if (sr & ATSAM3X8E.CAN.SR_BOFF) != 0 {
+            if errorState != .busOff { stats.busOff &+= 1 }
+            errorState = .busOff
+            write32(idr, ATSAM3X8E.CAN.SR_ERRP | ATSAM3X8E.CAN.SR_BOFF)
+            write32(ier, ATSAM3X8E.CAN.SR_ERRA)
+        } else if (sr & ATSAM3X8E.CAN.SR_ERRP) != 0 {
+            if errorState == .active { stats.errorPassive &+= 1 }
+            errorState = .passive
+            write32(idr, ATSAM3X8E.CAN.SR_ERRP)
+            write32(ier, ATSAM3X8E.CAN.SR_BOFF | ATSAM3X8E.CAN.SR_ERRA)
+        } else if (sr & ATSAM3X8E.CAN.SR_ERRA) != 0 {
+            if errorState == .busOff { stats.recoveries &+= 1 }
+            errorState = .active
+            write32(idr, ATSAM3X8E.CAN.SR_ERRA)
+            write32(ier, ATSAM3X8E.CAN.SR_ERRP | ATSAM3X8E.CAN.SR_BOFF)
+        }
+    }
+}
+
+// MARK: - Interrupt handlers
+
+@_cdecl("CAN0_Handler")
+public func CAN0_Handler() {
+    g_can0?.handleInterrupt()
+}
+
+@_cdecl("CAN1_Handler")
+public func CAN1_Handler() {
+    g_can1?.handleInterrupt()
+}
@@ -75,4 +75,38 @@ public enum DueClock {
         bm_isb()
         return true
     }
-}
\ No newline at end of file
+
+    // WAIT mode: every clock stops except the slow clock; a fast-startup
+    // source (FSMR: RTT/RTC alarm, WKUP pins) restarts the 4 MHz RC.
+    // MAINCK must be the RC and PLLA off before WAITMODE is set.
+    // Returns after wakeup with MCK = 4 MHz RC: call init84MHz() again.
+    public static func enterWaitMode(fastStartup: U32) {
+        // 1) MCK = MAINCK, then MAINCK = fast RC, PLLA and crystal off
+        var mckr = read32(ATSAM3X8E.PMC.MCKR)
+        mckr &= ~ATSAM3X8E.PMC.MCKR_CSS_MASK
+        mckr |= ATSAM3X8E.PMC.MCKR_CSS_MAIN
+        write32(ATSAM3X8E.PMC.MCKR, mckr)
+        _ = waitSR(ATSAM3X8E.PMC.SR_MCKRDY)
+
+        var mor = read32(ATSAM3X8E.PMC.CKGR_MOR) | ATSAM3X8E.PMC.MOR_MOSCRCEN
+        mor &= ~ATSAM3X8E.PMC.MOR_MOSCSEL
+        write32(ATSAM3X8E.PMC.CKGR_MOR, mor | ATSAM3X8E.PMC.MOR_KEY)
+        _ = waitSR(ATSAM3X8E.PMC.SR_MOSCSELS)
+
+        write32(ATSAM3X8E.PMC.CKGR_PLLAR, ATSAM3X8E.PMC.PLLAR_OFF)
+        mor &= ~ATSAM3X8E.PMC.MOR_MOSCXTEN
+        write32(ATSAM3X8E.PMC.CKGR_MOR, mor | ATSAM3X8E.PMC.MOR_KEY)
+
+        // 2) Wakeup sources, then WAIT
+        write32(ATSAM3X8E.PMC.FSMR, fastStartup)
+        write32(ATSAM3X8E.PMC.CKGR_MOR, mor | ATSAM3X8E.PMC.MOR_KEY | ATSAM3X8E.PMC.MOR_WAITMODE)
+        _ = waitSR(ATSAM3X8E.PMC.SR_MCKRDY)
+
+        // The core must not run ahead before the RC is back (datasheet).
+        spin(500)
+        var t: U32 = 1_000_000
+        while (read32(ATSAM3X8E.PMC.CKGR_MOR) & ATSAM3X8E.PMC.MOR_MOSCRCEN) == 0 && t != 0 {
+            t &-= 1
+        }
+    }
+}
@@ -0,0 +1,549 @@
+//
+// DMA.swift — DMAC service: channel allocation, single + linked-list (LLI)
+// transfers, completion/error callbacks from DMAC_Handler, per-channel stats.
+//
+// Goals:
+// - One owner for the 6-channel AHB DMAC, shared by SPI, USART, HSMCI, SSC
+//   and memory-to-memory copies: drivers allocate channels, never hardcode them.
+// - Hardware handshaking interface selected per transfer (peripheral side).
+// - Single block (<= 65535 beats) or a chain of blocks (DMA.Chain, LLI in
+//   RAM) that runs without CPU involvement between blocks.
+// - Looping chains (closeLoop() + startLoop()): the last descriptor points
+//   back to the first and the channel runs until aborted, with a callback
+//   per finished block (ping-pong audio, continuous capture).
+// - Completion: callback from DMAC_Handler (IRQ context), or poll()/wait()
+//   from the main loop when interrupts are off. Both retire a channel once.
+// - Stats per channel: transfers, bytes, errors, last/max duration in cycles.
+//
+// Notes:
+// - EBCISR clears on read, so only this file reads it; the bits are kept
+//   in g_dmacStatus until the owning channel retires its transfer.
+// - Channels 3 and 5 have a 32-byte FIFO, the others 8 bytes:
+//   allocate(largeFIFO: true) prefers them (memory copies, bursty devices).
+// - Chain blocks share the channel configuration (flow direction + handshake
+//   interface); only addresses, sizes and increments vary per block.
+// - Buffers and chains must stay alive until the transfer retires.
+// - Callbacks run in IRQ context: keep them short (set a flag, start the next
+//   transfer). Global IRQs are enabled by the application (bm_enable_irq()).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, withIRQLocked, waitUntil
+// - ATSAM3X8E.swift: DMAC registers/bitfields, PMC
+// - NVIC.swift: enable(.dmac)
+// - Timer.swift: CycleCounter (stats)
+//
+
+// MUST be global and single symbol (written from the ISR).
+public var g_dmacAllocated: U32 = 0   // bit ch: channel owned by a driver
+public var g_dmacInFlight: U32 = 0    // bit ch: started, not retired yet
+public var g_dmacStatus: U32 = 0      // EBCISR bits collected, not consumed yet
+public var g_dmacChained: U32 = 0     // bit ch: transfer is an LLI chain (done = CBTC)
+public var g_dmacLooping: U32 = 0     // bit ch: looping chain (BTC = block callback, never done)
+
+public enum DMA {
+
+    // MARK: - Public types
+
+    /// Hardware handshaking interfaces (DMAC CFG SRC_PER / DST_PER).
+    public enum Interface: U32 {
+        case hsmci = 0
+        case spi0Tx = 1
+        case spi0Rx = 2
+        case sscTx = 3
+        case sscRx = 4
+        case spi1Tx = 5
+        case spi1Rx = 6
+        case twi0Tx = 7
+        case twi0Rx = 8
+        case twi1Tx = 9
+        case twi1Rx = 10
+        case usart0Tx = 11
+        case usart0Rx = 12
+        case usart1Tx = 13
+        case usart1Rx = 14
+        case pwm = 15
+    }
+
+    public enum Width: U32 {
+        case byte = 0
+        case halfword = 1
+        case word = 2
+
+        public var bytes: U32 { U32(1) << rawValue }
+    }
+
+    public enum Flow: U32 {
+        case memoryToMemory = 0
+        case memoryToPeripheral = 1
+        case peripheralToMemory = 2
+    }
+
+    public enum FIFO: U32 {
+        case asap = 2       // write out as soon as data is there (RX, latency)
+        case half = 1
+        case alap = 0       // wait for a full burst (TX, bus efficiency)
+    }
+
+    public enum Result: Equatable {
+        case done
+        case error          // AHB error (bad address / bus fault)
+        case aborted        // abort() or wait() timeout
+    }
+
+    public typealias Completion = (Channel, Result) -> Void
+
+    /// Looping chains: called once per finished block.
+    public typealias BlockDone = (Channel) -> Void
+
+    /// One block: `count` beats of `width` from `source` to `destination`.
+    public struct Block {
+        public var source: U32
+        public var destination: U32
+        public var count: U32
+        public var width: Width
+        public var incrementSource: Bool
+        public var incrementDestination: Bool
+
+        /// Increments default to "memory side increments, peripheral side fixed".
+        public init(
+            source: U32,
+            destination: U32,
+            count: U32,
+            width: Width = .byte,
+            flow: Flow = .memoryToMemory,
+            incrementSource: Bool? = nil,
+            incrementDestination: Bool? = nil
+        ) {
+            self.source = source
+            self.destination = destination
+            self.count = count
+            self.width = width
+            self.incrementSource = incrementSource ?? (flow != .peripheralToMemory)
+            self.incrementDestination = incrementDestination ?? (flow != .memoryToPeripheral)
+        }
+    }
+
+    /// Channel configuration: direction + handshaking interface.
+    public struct Config {
+        public var flow: Flow
+        public var interface: Interface?   // nil for memory-to-memory
+        public var fifo: FIFO
+
+        public init(flow: Flow, interface: Interface? = nil, fifo: FIFO? = nil) {
+            self.flow = flow
+            self.interface = interface
+            self.fifo = fifo ?? (flow == .memoryToPeripheral ? .alap : .asap)
+        }
+
+        public static let memoryToMemory = Config(flow: .memoryToMemory)
+    }
+
+    public struct Stats {
+        public var transfers: U32 = 0
+        public var bytes: U32 = 0
+        public var errors: U32 = 0
+        public var aborts: U32 = 0
+        public var lastCycles: U32 = 0
+        public var maxCycles: U32 = 0
+    }
+
+    public static let maxBeatsPerBlock: U32 = ATSAM3X8E.DMAC.CTRLA_BTSIZE_MASK
+
+    // MARK: - Chain (LLI descriptors in RAM)
+
+    /// Linked list of blocks for one channel. Descriptors live on the heap
+    /// (never moves, never freed): build once, reset() and refill per use.
+    public final class Chain {
+        public let capacity: Int
+        public private(set) var count = 0
+        public private(set) var bytes: U32 = 0
+        public private(set) var isLoop = false
+
+        fileprivate let words: UnsafeMutablePointer<U32>
+        fileprivate static let descriptorWords = 5   // SADDR, DADDR, CTRLA, CTRLB, DSCR
+
+        public init(capacity: Int) {
+            self.capacity = capacity
+            self.words = UnsafeMutablePointer<U32>.allocate(capacity: capacity * Self.descriptorWords)
+        }
+
+        public func reset() {
+            count = 0
+            bytes = 0
+            isLoop = false
+        }
+
+        /// False when full or the block is larger than one descriptor.
+        @discardableResult
+        public func append(_ b: Block, flow: Flow) -> Bool {
+            if count >= capacity || b.count == 0 || b.count > DMA.maxBeatsPerBlock { return false }
+
+            let d = words + count * Self.descriptorWords
+            d[0] = b.source
+            d[1] = b.destination
+            d[2] = DMA.ctrlA(b)
+            d[3] = DMA.ctrlB(b, flow: flow, fetch: true)
+            d[4] = 0
+
+            if count > 0 {
+                (d - Self.descriptorWords)[4] = DMA.address(d)
+            }
+            count += 1
+            bytes &+= b.count * b.width.bytes
+            isLoop = false
+            return true
+        }
+
+        /// Point the last descriptor back to the first (for startLoop()).
+        @discardableResult
+        public func closeLoop() -> Bool {
+            if count == 0 { return false }
+            (words + (count - 1) * Self.descriptorWords)[4] = first
+            isLoop = true
+            return true
+        }
+
+        fileprivate var first: U32 { DMA.address(words) }
+    }
+
+    // MARK: - Channel
+
+    public struct Channel: Equatable {
+        public let index: U32
+
+        @inline(__always)
+        var bit: U32 { U32(1) << index }
+
+        /// True from start() until the transfer is retired (IRQ, poll, wait).
+        public var isBusy: Bool { (g_dmacInFlight & bit) != 0 }
+
+        /// Outcome of the last retired transfer.
+        public var lastResult: Result? { DMA.results[Int(index)] }
+
+        public var stats: Stats { DMA.channelStats[Int(index)] }
+
+        /// Single block. False if the channel is busy or the block too large.
+        @discardableResult
+        public func start(_ b: Block, config: Config, completion: Completion? = nil) -> Bool {
+            if isBusy || b.count == 0 || b.count > DMA.maxBeatsPerBlock { return false }
+
+            prepare(completion: completion, bytes: b.count * b.width.bytes, chained: false)
+            write32(reg(ATSAM3X8E.DMAC.SADDR_OFFSET), b.source)
+            write32(reg(ATSAM3X8E.DMAC.DADDR_OFFSET), b.destination)
+            write32(reg(ATSAM3X8E.DMAC.DSCR_OFFSET), 0)
+            write32(reg(ATSAM3X8E.DMAC.CTRLA_OFFSET), DMA.ctrlA(b))
+            write32(reg(ATSAM3X8E.DMAC.CTRLB_OFFSET), DMA.ctrlB(b, flow: config.flow, fetch: false))
+            write32(reg(ATSAM3X8E.DMAC.CFG_OFFSET), DMA.cfg(config) | ATSAM3X8E.DMAC.CFG_SOD)
+            enable(done: ATSAM3X8E.DMAC.EBCI_BTC_SHIFT)
+            return true
+        }
+
+        /// LLI chain: the channel loads every block from RAM and stops after
+        /// the last one (DSCR = 0). False if busy or the chain is empty.
+        @discardableResult
+        public func start(_ chain: Chain, config: Config, completion: Completion? = nil) -> Bool {
+            if isBusy || chain.count == 0 { return false }
+
+            prepare(completion: completion, bytes: chain.bytes, chained: true)
+            write32(reg(ATSAM3X8E.DMAC.DSCR_OFFSET), chain.first)
+            write32(reg(ATSAM3X8E.DMAC.CTRLB_OFFSET), config.flow.rawValue << ATSAM3X8E.DMAC.CTRLB_FC_SHIFT)
+            write32(reg(ATSAM3X8E.DMAC.CFG_OFFSET), DMA.cfg(config))
+            enable(done: ATSAM3X8E.DMAC.EBCI_CBTC_SHIFT)
+            return true
+        }
+
+        /// Looping chain (closeLoop()): runs until abort(); `onBlock` fires
+        /// after every block from DMAC_Handler (or poll()). The completion
+        /// only reports .error / .aborted. False if busy or not a loop.
+        @discardableResult
+        public func startLoop(
+            _ chain: Chain, config: Config, onBlock: @escaping BlockDone, completion: Completion? = nil
+        ) -> Bool {
+            if isBusy || !chain.isLoop { return false }
+
+            prepare(completion: completion, bytes: chain.bytes / U32(chain.count), chained: true)
+            DMA.blockCallbacks[Int(index)] = onBlock
+            withIRQLocked { g_dmacLooping |= bit }
+            write32(reg(ATSAM3X8E.DMAC.DSCR_OFFSET), chain.first)
+            write32(reg(ATSAM3X8E.DMAC.CTRLB_OFFSET), config.flow.rawValue << ATSAM3X8E.DMAC.CTRLB_FC_SHIFT)
+            write32(reg(ATSAM3X8E.DMAC.CFG_OFFSET), DMA.cfg(config))
+            enable(done: ATSAM3X8E.DMAC.EBCI_BTC_SHIFT)
+            return true
+        }
+
+        /// Current source / destination address (where a running transfer is).
+        public var sourceAddress: U32 { read32(reg(ATSAM3X8E.DMAC.SADDR_OFFSET)) }
+        public var destinationAddress: U32 { read32(reg(ATSAM3X8E.DMAC.DADDR_OFFSET)) }
+
+        /// Retire the transfer if the hardware is done (fires the completion).
+        /// Returns the result once; nil while running or when idle. On a
+        /// looping chain: runs the block callback, returns .error/.aborted only.
+        @discardableResult
+        public func poll() -> Result? {
+            if !isBusy { return nil }
+            DMA.collect()
+            if (g_dmacLooping & bit) != 0 {
+                return DMA.serviceLoop(self)
+            }
+            let hwRunning = (read32(ATSAM3X8E.DMAC.CHSR) & bit) != 0
+            let err = (g_dmacStatus & (bit << ATSAM3X8E.DMAC.EBCI_ERR_SHIFT)) != 0
+            if hwRunning && !err { return nil }
+            return DMA.retire(self, err ? .error : .done)
+        }
+
+        /// Spin until retired; aborts the transfer on timeout.
+        public func wait(timeout: U32 = 20_000_000) -> Result {
+            var r: Result? = nil
+            if !waitUntil(timeout, {
+                r = poll()
+                return r != nil || !isBusy
+            }) {
+                abort()
+                return .aborted
+            }
+            return r ?? lastResult ?? .done
+        }
+
+        /// Stop the channel now; the completion fires with .aborted.
+        public func abort() {
+            if !isBusy { return }
+            write32(ATSAM3X8E.DMAC.CHDR, bit)
+            _ = waitUntil(100_000) { (read32(ATSAM3X8E.DMAC.CHSR) & bit) == 0 }
+            DMA.retire(self, .aborted)
+        }
+
+        public func resetStats() {
+            DMA.channelStats[Int(index)] = Stats()
+        }
+
+        // MARK: Internals
+
+        @inline(__always)
+        private func reg(_ offset: U32) -> U32 {
+            ATSAM3X8E.DMAC.CH_BASE + index * ATSAM3X8E.DMAC.CH_STRIDE + offset
+        }
+
+        private func prepare(completion: Completion?, bytes: U32, chained: Bool) {
+            let i = Int(index)
+            DMA.completions[i] = completion
+            DMA.pendingBytes[i] = bytes
+            DMA.results[i] = nil
+
+            // Drop status left over from a previous transfer on this channel.
+            DMA.collect()
+            withIRQLocked {
+                g_dmacStatus &= ~DMA.statusBits(index)
+                if chained { g_dmacChained |= bit } else { g_dmacChained &= ~bit }
+                g_dmacInFlight |= bit
+            }
+        }
+
+        private func enable(done shift: U32) {
+            DMA.startCycles[Int(index)] = CycleCounter.now()
+            write32(ATSAM3X8E.DMAC.EBCIER, (bit << shift) | (bit << ATSAM3X8E.DMAC.EBCI_ERR_SHIFT))
+            write32(ATSAM3X8E.DMAC.CHER, bit)
+        }
+    }
+
+    // MARK: - Service
+
+    /// Enable the DMAC clock + controller and its NVIC line. Idempotent.
+    public static func begin() {
+        if started { return }
+        PeripheralClock.acquire(ATSAM3X8E.ID.DMAC)
+        write32(ATSAM3X8E.DMAC.EBCIDR, 0x003F_3F3F)
+        _ = read32(ATSAM3X8E.DMAC.EBCISR)
+        write32(ATSAM3X8E.DMAC.EN, ATSAM3X8E.DMAC.EN_ENABLE)
+
+        NVIC.enable(.dmac)
+
+        // Initialize the per-channel tables here, not lazily inside the ISR.
+        _ = completions.count + results.count + channelStats.count + pendingBytes.count + startCycles.count +
+            blockCallbacks.count
+        started = true
+    }
+
+    /// Take a free channel. `largeFIFO` prefers channels 3/5 (32-byte FIFO).
+    public static func allocate(largeFIFO: Bool = false) -> Channel? {
+        begin()
+        let order: [U32] = largeFIFO ? [3, 5, 0, 1, 2, 4] : [0, 1, 2, 4, 3, 5]
+        return withIRQLocked {
+            for ch in order where (g_dmacAllocated & (U32(1) << ch)) == 0 {
+                g_dmacAllocated |= U32(1) << ch
+                return Channel(index: ch)
+            }
+            return nil
+        }
+    }
+
+    /// Give a channel back (aborts a transfer still in flight).
+    public static func release(_ ch: Channel) {
+        ch.abort()
+        withIRQLocked { g_dmacAllocated &= ~ch.bit }
+    }
+
+    /// Retire every finished channel (when running without the IRQ).
+    public static func poll() {
+        var ch: U32 = 0
+        while ch < ATSAM3X8E.DMAC.CHANNELS {
+            Channel(index: ch).poll()
+            ch += 1
+        }
+    }
+
+    /// Stats for any channel (allocated or not).
+    public static func stats(_ index: U32) -> Stats { channelStats[Int(index)] }
+
+    // MARK: - ISR side
+
+    /// DMAC_Handler body: retire channels whose done/error bit is set.
+    static func handleIRQ() {
+        collect()
+        var ch: U32 = 0
+        while ch < ATSAM3X8E.DMAC.CHANNELS {
+            let bit = U32(1) << ch
+            if (g_dmacLooping & bit) != 0 {
+                serviceLoop(Channel(index: ch))
+            } else if (g_dmacInFlight & bit) != 0 {
+                let doneShift = (g_dmacChained & bit) != 0
+                    ? ATSAM3X8E.DMAC.EBCI_CBTC_SHIFT
+                    : ATSAM3X8E.DMAC.EBCI_BTC_SHIFT
+                let err = (g_dmacStatus & (bit << ATSAM3X8E.DMAC.EBCI_ERR_SHIFT)) != 0
+                let done = (g_dmacStatus & (bit << doneShift)) != 0
+                if err || done {
+                    retire(Channel(index: ch), err ? .error : .done)
+                }
+            }
+            ch += 1
+        }
+    }
+
+    // MARK: - Internals
+
+    private static var started = false
+    fileprivate static var completions: [Completion?] = [nil, nil, nil, nil, nil, nil]
+    fileprivate static var results: [Result?] = [nil, nil, nil, nil, nil, nil]
+    fileprivate static var channelStats: [Stats] = [Stats(), Stats(), Stats(), Stats(), Stats(), Stats()]
+    fileprivate static var pendingBytes: [U32] = [0, 0, 0, 0, 0, 0]
+    fileprivate static var startCycles: [U32] = [0, 0, 0, 0, 0, 0]
+    fileprivate static var blockCallbacks: [BlockDone?] = [nil, nil, nil, nil, nil, nil]
+
+    /// Fold EBCISR (clear-on-read) into g_dmacStatus.
+    fileprivate static func collect() {
+        withIRQLocked {
+            g_dmacStatus |= read32(ATSAM3X8E.DMAC.EBCISR)
+        }
+    }
+
+    @inline(__always)
+    fileprivate static func statusBits(_ ch: U32) -> U32 {
+        let b = U32(1) << ch
+        return (b << ATSAM3X8E.DMAC.EBCI_BTC_SHIFT) |
+            (b << ATSAM3X8E.DMAC.EBCI_CBTC_SHIFT) |
+            (b << ATSAM3X8E.DMAC.EBCI_ERR_SHIFT)
+    }
+
+    /// Looping channel: error -> retire, finished block -> count + callback.
+    @discardableResult
+    fileprivate static func serviceLoop(_ ch: Channel) -> Result? {
+        let btc = ch.bit << ATSAM3X8E.DMAC.EBCI_BTC_SHIFT
+        let err = ch.bit << ATSAM3X8E.DMAC.EBCI_ERR_SHIFT
+        let st: U32 = withIRQLocked {
+            let v = g_dmacStatus & (btc | err)
+            g_dmacStatus &= ~btc
+            return v
+        }
+        if (st & err) != 0 { return retire(ch, .error) }
+        if (st & btc) == 0 { return nil }
+
+        let i = Int(ch.index)
+        channelStats[i].transfers &+= 1
+        channelStats[i].bytes &+= pendingBytes[i]
+        blockCallbacks[i]?(ch)
+        return nil
+    }
+
+    /// Exactly one caller wins (IRQ or main loop): the in-flight bit is
+    /// cleared under the lock, then stats + completion run outside it.
+    @discardableResult
+    fileprivate static func retire(_ ch: Channel, _ r: Result) -> Result? {
+        let won: Bool = withIRQLocked {
+            if (g_dmacInFlight & ch.bit) == 0 { return false }
+            g_dmacInFlight &= ~ch.bit
+            g_dmacLooping &= ~ch.bit
+            g_dmacStatus &= ~statusBits(ch.index)
+            return true
+        }
+        if !won { return nil }
+        blockCallbacks[Int(ch.index)] = nil
+
+        write32(ATSAM3X8E.DMAC.EBCIDR, statusBits(ch.index))
+
+        let i = Int(ch.index)
+        let cycles = CycleCounter.now() &- startCycles[i]
+        var s = channelStats[i]
+        switch r {
+        case .done:
+            s.transfers &+= 1
+            s.bytes &+= pendingBytes[i]
+            s.lastCycles = cycles
+            if cycles > s.maxCycles { s.maxCycles = cycles }
+        case .error:
+            s.errors &+= 1
+        case .aborted:
+            s.aborts &+= 1
+        }
+        channelStats[i] = s
+        results[i] = r
+
+        let cb = completions[i]
+        completions[i] = nil
+        cb?(ch, r)
+        return r
+    }
+
+    fileprivate static func ctrlA(_ b: Block) -> U32 {
+        (b.count & ATSAM3X8E.DMAC.CTRLA_BTSIZE_MASK) |
+            (b.width.rawValue << ATSAM3X8E.DMAC.CTRLA_SRC_WIDTH_SHIFT) |
+            (b.width.rawValue << ATSAM3X8E.DMAC.CTRLA_DST_WIDTH_SHIFT)
+    }
+
+    /// `fetch`: descriptor fetch enabled (chain) vs. registers only (single).
+    fileprivate static func ctrlB(_ b: Block, flow: Flow, fetch: Bool) -> U32 {
+        var v = flow.rawValue << ATSAM3X8E.DMAC.CTRLB_FC_SHIFT
+        if !fetch { v |= ATSAM3X8E.DMAC.CTRLB_SRC_DSCR | ATSAM3X8E.DMAC.CTRLB_DST_DSCR }
+        if !b.incrementSource { v |= ATSAM3X8E.DMAC.CTRLB_SRC_INCR_FIXED }
+        if !b.incrementDestination { v |= ATSAM3X8E.DMAC.CTRLB_DST_INCR_FIXED }
+        return v
+    }
+
+    fileprivate static func cfg(_ c: Config) -> U32 {
+        var v = ATSAM3X8E.DMAC.CFG_AHB_PROT_1 | (c.fifo.rawValue << ATSAM3X8E.DMAC.CFG_FIFOCFG_SHIFT)
+        if let hs = c.interface {
+            switch c.flow {
+            case .peripheralToMemory:
+                v |= (hs.rawValue << ATSAM3X8E.DMAC.CFG_SRC_PER_SHIFT) | ATSAM3X8E.DMAC.CFG_SRC_H2SEL
+            case .memoryToPeripheral:
+                v |= (hs.rawValue << ATSAM3X8E.DMAC.CFG_DST_PER_SHIFT) | ATSAM3X8E.DMAC.CFG_DST_H2SEL
+            case .memoryToMemory:
+                break
+            }
+        }
+        return v
+    }
+
+    @inline(__always)
+    static func address<T>(_ p: UnsafePointer<T>) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+
+    @inline(__always)
+    static func address<T>(_ p: UnsafeMutablePointer<T>) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+}
+
+@_cdecl("DMAC_Handler")
+public func DMAC_Handler() {
+    DMA.handleIRQ()
+}
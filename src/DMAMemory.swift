@@ -0,0 +1,322 @@
+//
+// DMAMemory.swift — DMA-accelerated memcpy/memset for large RAM buffers.
+//
+// Goals:
+// - dmaCopy(dst:src:len:completion:) / dmaFill(dst:value:len:completion:):
+//   memory-to-memory DMAC transfers with word beats, so framebuffers, ADC
+//   blocks and KV pages move without the CPU's byte loop (support.c).
+// - Below DMAMemory.threshold bytes the CPU copies (DMA setup costs more).
+//   calibrate() measures both paths and picks the crossover on this board.
+// - With a completion the call returns right away and the CPU keeps working;
+//   the completion fires from DMAC_Handler (or DMA.poll() with IRQs off).
+//
+// Notes:
+// - Word beats need src and dst with the same alignment mod 4: unaligned
+//   head/tail bytes are copied by the CPU, mismatched alignment falls back to
+//   the CPU entirely (byte beats are slower than the CPU loop).
+// - One channel (32-byte FIFO preferred) is taken on first use and kept.
+//   A new request waits for the previous async one.
+// - A block moves at most DMA.maxBeatsPerBlock words (256 KiB - 4): larger
+//   requests run as an LLI chain of such blocks, up to maxChainBlocks
+//   (~18 MiB, a whole 16 MiB SMC window). Beyond that, or if the DMAC
+//   refuses the transfer, the result is .error (completion included) and
+//   stats.failures counts it; nothing is copied.
+// - Buffers must stay untouched until the completion fires.
+// - Small/CPU-path requests call the completion synchronously.
+// - The async completion waits in a static slot and the DMA gets a
+//   non-capturing trampoline: no closure context allocated per request
+//   (free() is a no-op, so streaming copies would drain the heap).
+//
+// Dependencies:
+// - DMA.swift: channel allocation, single blocks, LLI chains, completion
+// - Timer.swift: CycleCounter (calibration)
+//
+
+public enum DMAMemory {
+
+    public typealias Completion = (DMA.Result) -> Void
+
+    public struct Stats {
+        public var dmaCalls: U32 = 0
+        public var dmaBytes: U32 = 0
+        public var cpuCalls: U32 = 0
+        public var cpuBytes: U32 = 0
+        public var failures: U32 = 0        // DMAC refused the transfer: nothing moved
+    }
+
+    /// One calibration point: cycles for `bytes` on each path.
+    public struct Sample {
+        public let bytes: U32
+        public let cpuCycles: U32
+        public let dmaCycles: U32
+    }
+
+    /// Requests of at least this many bytes go to the DMAC.
+    public static var threshold: Int = 256
+
+    /// Blocks per request (one LLI descriptor each, 20 bytes of RAM).
+    public static let maxChainBlocks = 72
+
+    public private(set) static var stats = Stats()
+
+    // MARK: - Copy / fill
+
+    /// memcpy through the DMAC (non-overlapping buffers).
+    /// Blocking when `completion` is nil: returns the transfer's result.
+    /// Async: .done once started, .error if the DMAC refused it.
+    @discardableResult
+    public static func copy(
+        dst: UnsafeMutableRawPointer,
+        src: UnsafeRawPointer,
+        len: Int,
+        completion: Completion? = nil
+    ) -> DMA.Result {
+        let d = address(dst)
+        let s = address(src)
+
+        if len < max(threshold, minDMABytes) || ((d ^ s) & 3) != 0 || channel() == nil {
+            cpuCopy(dst, src, len)
+            completion?(.done)
+            return .done
+        }
+        waitIdle()
+
+        // CPU head until both are word aligned, DMA body, CPU tail.
+        let head = Int((4 - (d & 3)) & 3)
+        let words = (len - head) / 4
+        let tail = len - head - words * 4
+        if head > 0 { cpuCopy(dst, src, head) }
+        if tail > 0 { cpuCopy(dst + (len - tail), src + (len - tail), tail) }
+
+        return startWords(
+            source: s + U32(head),
+            destination: d + U32(head),
+            words: U32(words),
+            incrementSource: true,
+            completion: completion
+        )
+    }
+
+    /// memset through the DMAC: the source is one fixed word holding `value`.
+    /// Results as copy().
+    @discardableResult
+    public static func fill(
+        dst: UnsafeMutableRawPointer,
+        value: UInt8,
+        len: Int,
+        completion: Completion? = nil
+    ) -> DMA.Result {
+        if len < max(threshold, minDMABytes) || channel() == nil {
+            cpuFill(dst, value, len)
+            completion?(.done)
+            return .done
+        }
+        waitIdle()
+
+        let d = address(dst)
+        let head = Int((4 - (d & 3)) & 3)
+        let words = (len - head) / 4
+        let tail = len - head - words * 4
+        if head > 0 { cpuFill(dst, value, head) }
+        if tail > 0 { cpuFill(dst + (len - tail), value, tail) }
+
+        pattern.pointee = U32(value) * 0x0101_0101
+        return startWords(
+            source: address(UnsafeRawPointer(pattern)),
+            destination: d + U32(head),
+            words: U32(words),
+            incrementSource: false,
+            completion: completion
+        )
+    }
+
+    /// True while an async copy/fill is still running.
+    public static var isBusy: Bool { dma?.isBusy ?? false }
+
+    // MARK: - Calibration
+
+    /// Time CPU vs DMA for 16, 32, ... up to half of `scratch` and set
+    /// `threshold` to the smallest size where the DMA (setup + wait) wins.
+    /// `samples` receives the measurements (optional). Returns the threshold.
+    @discardableResult
+    public static func calibrate(
+        scratch: UnsafeMutableRawBufferPointer,
+        samples: ((Sample) -> Void)? = nil
+    ) -> Int {
+        guard let base = scratch.baseAddress, scratch.count >= 64, channel() != nil else { return threshold }
+        let half = (scratch.count / 2) & ~3
+        let a = base
+        let b = base + half
+
+        let saved = threshold
+        var chosen = Int.max
+        var n = 16
+        while n <= half {
+            cpuFill(a, 0x5A, n)
+
+            var t0 = CycleCounter.now()
+            cpuCopy(b, UnsafeRawPointer(a), n)
+            let cpu = CycleCounter.now() &- t0
+
+            threshold = 0
+            t0 = CycleCounter.now()
+            copy(dst: b, src: UnsafeRawPointer(a), len: n)
+            let dmaCycles = CycleCounter.now() &- t0
+
+            samples?(Sample(bytes: U32(n), cpuCycles: cpu, dmaCycles: dmaCycles))
+            if dmaCycles <= cpu && chosen == Int.max { chosen = n }
+            n *= 2
+        }
+
+        threshold = chosen == Int.max ? saved : chosen
+        return threshold
+    }
+
+    // MARK: - Internals
+
+    private static let minDMABytes = 8     // head + at least one word
+    private static var dma: DMA.Channel? = nil
+    private static var triedAllocate = false
+    private static let pattern = UnsafeMutablePointer<U32>.allocate(capacity: 1)
+    private static let config = DMA.Config(flow: .memoryToMemory, fifo: .alap)
+    private static var chain: DMA.Chain? = nil
+    private static var pendingCompletion: Completion? = nil
+    private static let trampoline: DMA.Completion = { _, r in
+        let c = DMAMemory.pendingCompletion
+        DMAMemory.pendingCompletion = nil
+        c?(r)
+    }
+
+    private static func channel() -> DMA.Channel? {
+        if dma == nil && !triedAllocate {
+            triedAllocate = true
+            dma = DMA.allocate(largeFIFO: true)
+        }
+        return dma
+    }
+
+    private static func waitIdle() {
+        if let dma, dma.isBusy { _ = dma.wait() }
+    }
+
+    /// One block when it fits, else an LLI chain of maxBeatsPerBlock blocks.
+    private static func startWords(
+        source: U32,
+        destination: U32,
+        words: U32,
+        incrementSource: Bool,
+        completion: Completion?
+    ) -> DMA.Result {
+        guard let dma else { return fail(completion) }
+        if words == 0 {
+            completion?(.done)
+            return .done
+        }
+
+        // One async request at a time (waitIdle), so one slot is enough.
+        pendingCompletion = completion
+        let done: DMA.Completion? = completion == nil ? nil : trampoline
+        let started: Bool
+        if words <= DMA.maxBeatsPerBlock {
+            let block = DMA.Block(
+                source: source, destination: destination, count: words, width: .word,
+                incrementSource: incrementSource
+            )
+            started = dma.start(block, config: config, completion: done)
+        } else {
+            if let lli = buildChain(source, destination, words, incrementSource) {
+                started = dma.start(lli, config: config, completion: done)
+            } else {
+                started = false
+            }
+        }
+        if !started {
+            pendingCompletion = nil
+            return fail(completion)
+        }
+
+        stats.dmaCalls &+= 1
+        stats.dmaBytes &+= words &* 4
+        return completion == nil ? dma.wait() : .done
+    }
+
+    /// nil if `words` needs more than maxChainBlocks blocks. Only called
+    /// with the channel idle (waitIdle), so the descriptors are free.
+    private static func buildChain(_ source: U32, _ destination: U32, _ words: U32, _ incSource: Bool) -> DMA.Chain? {
+        if words > U32(maxChainBlocks) * DMA.maxBeatsPerBlock { return nil }
+        if chain == nil { chain = DMA.Chain(capacity: maxChainBlocks) }
+        guard let chain else { return nil }
+
+        chain.reset()
+        var left = words
+        var offset: U32 = 0
+        while left > 0 {
+            let n = min(left, DMA.maxBeatsPerBlock)
+            let block = DMA.Block(
+                source: incSource ? source + offset : source,
+                destination: destination + offset,
+                count: n,
+                width: .word,
+                incrementSource: incSource
+            )
+            if !chain.append(block, flow: .memoryToMemory) { return nil }
+            offset &+= n * 4
+            left -= n
+        }
+        return chain
+    }
+
+    private static func fail(_ completion: Completion?) -> DMA.Result {
+        stats.failures &+= 1
+        completion?(.error)
+        return .error
+    }
+
+    private static func cpuCopy(_ dst: UnsafeMutableRawPointer, _ src: UnsafeRawPointer, _ n: Int) {
+        stats.cpuCalls &+= 1
+        stats.cpuBytes &+= U32(n)
+        dst.copyMemory(from: src, byteCount: n)
+    }
+
+    private static func cpuFill(_ dst: UnsafeMutableRawPointer, _ value: UInt8, _ n: Int) {
+        stats.cpuCalls &+= 1
+        stats.cpuBytes &+= U32(n)
+        dst.initializeMemory(as: UInt8.self, repeating: value, count: n)
+    }
+
+    @inline(__always)
+    private static func address(_ p: UnsafeRawPointer) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+
+    @inline(__always)
+    private static func address(_ p: UnsafeMutableRawPointer) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+}
+
+// MARK: - Free-function API
+
+/// DMA memcpy for large buffers (CPU below DMAMemory.threshold).
+@inline(__always)
+@discardableResult
+public func dmaCopy(
+    dst: UnsafeMutableRawPointer,
+    src: UnsafeRawPointer,
+    len: Int,
+    completion: DMAMemory.Completion? = nil
+) -> DMA.Result {
+    DMAMemory.copy(dst: dst, src: src, len: len, completion: completion)
+}
+
+/// DMA memset for large buffers (CPU below DMAMemory.threshold).
+@inline(__always)
+@discardableResult
+public func dmaFill(
+    dst: UnsafeMutableRawPointer,
+    value: UInt8,
+    len: Int,
+    completion: DMAMemory.Completion? = nil
+) -> DMA.Result {
+    DMAMemory.fill(dst: dst, value: value, len: len, completion: completion)
+}
@@ -1,10 +1,13 @@
 //
-// EEFC.swift — Key/Value storage on a reserved flash page using SAM3X8E EEFC1.
+// EEFC.swift — Key/Value storage on reserved flash pages using SAM3X8E EEFC1.
 //
 // Goals:
 // - Defensive + informative API (explicit errors, detailed failure reasons).
 // - "UserDefaults-like" single-page KV store: save/load by string key.
+// - Interned keys (EEFCKey): validated + hashed once, lookups compare the
+//   16-bit hash stored in each entry header before touching key bytes.
 // - Convenience helpers for common types (String, U32, Bool, Bytes).
+// - Fixed-layout structs (EEFCRecord) stored as one entry by byte copy.
 // - Provide a convenient error name/message for logging/UI.
 //
 // Project rules:
@@ -12,13 +15,44 @@
 // - This file contains logic + on-flash format only.
 //
 // Notes:
-// - This writes the entire reserved page on each save/remove.
+// - Two pages (A/B) hold alternating copies of the whole KV map.
+// - Each save/remove writes the INACTIVE page with sequence+1, then verifies it.
+//   The active page is never erased, so a reset during EWP loses at most the
+//   update in flight; on load the newest page with a valid CRC wins.
+// - tools/eefcsim.py models this format and tears the write after every
+//   word: keep it in sync when the header or the A/B rules change.
 // - Flash endurance is limited: do not write often.
-// - Make sure linker.ld reserves ATSAM3X8E.NVM.PAGE_ADDR..+PAGE_SIZE.
+// - Make sure linker.ld reserves ATSAM3X8E.NVM.PAGE_ADDR..+PAGE_COUNT*PAGE_SIZE.
+//
+// Async commits:
+// - saveAsync/removeAsync/clearAsync issue EWP and return immediately; the
+//   EEFC1_Handler (FRDY interrupt) marks completion. Code runs from bank 0, so
+//   the CPU keeps working while bank 1 programs.
+// - Call pollCommit() from the main loop: it verifies the page and fires the
+//   completion callback there (never from the ISR).
+// - While a commit is in flight, bank 1 is not readable: loads are served from
+//   the RAM copy of the pending page; sync/async writes return .busy.
+// - When an A/B image runs from bank 1 (FirmwareUpdater), commands run from
+//   RAM and block until done (bm_eefc_cmd_ram); the async API still works.
+//
+// Keys:
+// - Any EEFCKeyRepresentable works as `key:`. String keys are validated and
+//   hashed on every call; `static let kFoo = EEFCKey("foo")` does it once.
+// - Errors never allocate: a missing key reports its hash, not its name.
+//
+// Records:
+// - An EEFCRecord entry is [recordVersion u16 LE][raw struct bytes].
+// - Loads walk the memory-mapped flash page in place (CRC, entry search)
+//   and read the struct straight from flash: no page or value copy.
+// - Layout changes: append fields + bump recordVersion; the default
+//   migration copies the stored prefix over init() defaults.
 //
 // Dependencies:
-// - MMIO.swift: bm_read32/bm_write32, bm_dsb/bm_isb, waitUntil()
+// - MMIO.swift: bm_read32/bm_write32, bm_dsb/bm_isb, waitUntil(), crc32Update
 // - ATSAM3X8E.swift: EEFC regs/bitfields + NVM page geometry
+// - NVIC.swift: enable(.efc1)
+// - EEFCTelemetry.swift: erase counters / latency histogram hooks
+// - Timer.swift: CycleCounter (command latency)
 //
 
 public enum EEFCError: Error {
@@ -38,14 +72,18 @@ public enum EEFCError: Error {
     case crcMismatch(expected: U32, got: U32)
 
     // Key/value semantics
-    case keyNotFound(String)
+    case keyNotFound(hash: U16)
     case typeMismatch(expected: EEFCStorage.ValueType, got: EEFCStorage.ValueType)
     case invalidUTF8
+    case recordVersion(found: U16)    // stored layout that migrate() rejected
+    case recordNotTrivial             // record holds references (not byte-copyable)
 
     // Flash / EEFC failures
     case timeout
     case commandError
     case lockError
+    case verifyFailed
+    case busy
 
     // MARK: - Convenient name/message for logging
 
@@ -68,10 +106,14 @@ public enum EEFCError: Error {
         case .keyNotFound: return "key_not_found"
         case .typeMismatch: return "type_mismatch"
         case .invalidUTF8: return "invalid_utf8"
+        case .recordVersion: return "record_version"
+        case .recordNotTrivial: return "record_not_trivial"
 
         case .timeout: return "timeout"
         case .commandError: return "command_error"
         case .lockError: return "lock_error"
+        case .verifyFailed: return "verify_failed"
+        case .busy: return "busy"
         }
     }
 
@@ -102,12 +144,16 @@ public enum EEFCError: Error {
         case .crcMismatch(let expected, let got):
             return "CRC mismatch (expected \(expected), got \(got))."
 
-        case .keyNotFound(let k):
-            return "Key not found: \(k)"
+        case .keyNotFound(let h):
+            return "Key not found (hash \(h))."
         case .typeMismatch(let expected, let got):
             return "Type mismatch (expected \(expected), got \(got))."
         case .invalidUTF8:
             return "Invalid UTF-8 string data."
+        case .recordVersion(let v):
+            return "Stored record version \(v) cannot be migrated."
+        case .recordNotTrivial:
+            return "Record type is not trivially copyable."
 
         case .timeout:
             return "Flash controller timeout."
@@ -115,6 +161,10 @@ public enum EEFCError: Error {
             return "Flash controller reported a command error."
         case .lockError:
             return "Flash controller reported a lock error."
+        case .verifyFailed:
+            return "Flash readback does not match the written page."
+        case .busy:
+            return "A flash commit is already in flight."
         }
     }
 }
@@ -124,29 +174,333 @@ public enum EEFCLoadResult<T> {
     case success(T)
 }
 
+// MARK: - Keys
+
+/// FNV-1a 32-bit folded to 16 bits. Stored in every entry header.
+@inline(__always)
+func eefcKeyHash(_ b: UnsafeBufferPointer<UInt8>) -> U16 {
+    var h: U32 = 0x811C_9DC5
+    var i = 0
+    while i < b.count {
+        h = (h ^ U32(b[i])) &* 0x0100_0193
+        i += 1
+    }
+    return U16(truncatingIfNeeded: (h >> 16) ^ h)
+}
+
+/// Simple safe charset: [A-Za-z0-9._-], non-empty.
+/// (avoids spaces/utf8 surprises in embedded storage)
+func eefcKeyIsValid(_ b: UnsafeBufferPointer<UInt8>) -> Bool {
+    if b.isEmpty { return false }
+    var i = 0
+    while i < b.count {
+        let c = b[i]
+        let isAZ = (c >= 65 && c <= 90)
+        let isaz = (c >= 97 && c <= 122)
+        let is09 = (c >= 48 && c <= 57)
+        let isOk = isAZ || isaz || is09 || c == 46 || c == 95 || c == 45
+        if !isOk { return false }
+        i += 1
+    }
+    return true
+}
+
+/// Anything usable as an EEFCStorage key.
+public protocol EEFCKeyRepresentable {
+    /// Calls `body` with the key's UTF-8 bytes and hash.
+    /// An invalid key passes an empty buffer (-> .invalidKey).
+    func withEEFCKey<R>(_ body: (UnsafeBufferPointer<UInt8>, U16) -> R) -> R
+}
+
+/// Interned key: bytes live in the binary (StaticString), charset and hash
+/// are computed once. Declare as `static let` / global `let`.
+public struct EEFCKey: EEFCKeyRepresentable {
+    public let name: StaticString
+    public let hash: U16
+    public let isValid: Bool
+
+    public init(_ name: StaticString) {
+        self.name = name
+        let (h, ok) = name.withUTF8Buffer { b in (eefcKeyHash(b), eefcKeyIsValid(b)) }
+        self.hash = h
+        self.isValid = ok
+    }
+
+    @inline(__always)
+    public func withEEFCKey<R>(_ body: (UnsafeBufferPointer<UInt8>, U16) -> R) -> R {
+        if !isValid { return body(UnsafeBufferPointer(start: nil, count: 0), 0) }
+        return name.withUTF8Buffer { body($0, hash) }
+    }
+}
+
+extension String: EEFCKeyRepresentable {
+    public func withEEFCKey<R>(_ body: (UnsafeBufferPointer<UInt8>, U16) -> R) -> R {
+        var s = self
+        return s.withUTF8 { (b) -> R in
+            if !eefcKeyIsValid(b) { return body(UnsafeBufferPointer(start: nil, count: 0), 0) }
+            return body(b, eefcKeyHash(b))
+        }
+    }
+}
+
+// MARK: - Records
+
+/// Fixed-layout struct persisted as a single EEFCStorage entry by byte copy.
+///
+/// Rules for conforming types:
+/// - Only trivial stored properties (integers, Bool, tuples, trivial structs).
+///   String/Array/class fields would persist RAM pointers (-> .recordNotTrivial).
+/// - Changing the layout: append fields at the end and bump `recordVersion`.
+/// - Size: key + 8 bytes of entry overhead + MemoryLayout<Self>.size must fit the page.
+public protocol EEFCRecord {
+    static var recordVersion: U16 { get }
+
+    /// Every field at its default (used for migration and as fallback).
+    init()
+
+    /// Build a value from a stored record with another version or size.
+    /// Return nil to reject it (-> .recordVersion).
+    static func migrate(from version: U16, bytes: UnsafeRawBufferPointer) -> Self?
+}
+
+extension EEFCRecord {
+    /// Default: stored prefix over init() defaults (append-only layouts).
+    public static func migrate(from version: U16, bytes: UnsafeRawBufferPointer) -> Self? {
+        var r = Self()
+        withUnsafeMutableBytes(of: &r) { dst in
+            let n = min(dst.count, bytes.count)
+            if n > 0 { dst.baseAddress!.copyMemory(from: bytes.baseAddress!, byteCount: n) }
+        }
+        return r
+    }
+}
+
+public enum EEFCCommitStatus {
+    case idle
+    case inFlight
+    case completed(EEFCError?)   // reported once, by the pollCommit() that finished it
+}
+
+// MARK: - EEFC1 async command slot (shared with EEFC1_Handler)
+//
+// One async command at a time on EEFC1, shared by every bank-1 client
+// (EEFCStorage, FlashLog): claim (idle -> inFlight), issue, arm FRDY;
+// the ISR marks it done; the owner takes the latched FSR (-> idle).
+
+// MUST be global and single symbol (written from the ISR).
+public var g_eefc1CommitState: U32 = 0
+public var g_eefc1CommitFSR: U32 = 0
+public var g_eefc1CommitEndCycles: U32 = 0
+
+// Command in progress on EEFC1 (telemetry: kind + start time).
+var g_eefc1CmdKind: EEFCCommand = .ewp
+var g_eefc1CmdStartCycles: U32 = 0
+
+// FCMDE/FLOCKE of a command already completed from RAM (running from bank 1):
+// that FSR read cleared them, so they are OR-ed into every later FSR report.
+public var g_eefc1StickyFSR: U32 = 0
+
+public enum EEFCCommand: Int {
+    case ewp = 0    // Erase Page and Write Page
+    case ea  = 1    // Erase All (bank)
+    case wp  = 2    // Write Page (page already erased)
+
+    var fcmd: U32 {
+        switch self {
+        case .ewp: return ATSAM3X8E.EEFC.FCMD_EWP
+        case .ea:  return ATSAM3X8E.EEFC.FCMD_EA
+        case .wp:  return ATSAM3X8E.EEFC.FCMD_WP
+        }
+    }
+}
+
+enum EEFCCommitFlag {
+    static let idle: U32 = 0
+    static let inFlight: U32 = 1
+    static let done: U32 = 2
+}
+
+@inline(__always)
+func eefc1CommitFlag() -> U32 {
+    withIRQLocked { g_eefc1CommitState }
+}
+
+/// Try to own the async slot. False if another client holds it.
+func eefc1Claim() -> Bool {
+    withIRQLocked {
+        if g_eefc1CommitState != EEFCCommitFlag.idle { return false }
+        g_eefc1CommitState = EEFCCommitFlag.inFlight
+        return true
+    }
+}
+
+/// Give the slot back without a result (command could not be issued).
+func eefc1Release() {
+    withIRQLocked { g_eefc1CommitState = EEFCCommitFlag.idle }
+}
+
+/// Owner only, once the flag is `done`: returns the latched FSR and frees the slot.
+func eefc1TakeFSR() -> U32 {
+    let (fsr, end) = withIRQLocked { () -> (U32, U32) in
+        g_eefc1CommitState = EEFCCommitFlag.idle
+        return (g_eefc1CommitFSR, g_eefc1CommitEndCycles)
+    }
+    EEFCTelemetry.noteCompleted(g_eefc1CmdKind, cycles: end &- g_eefc1CmdStartCycles, fsr: fsr)
+    return fsr
+}
+
+/// Unmask FRDY only after FCR was written: it is still high until the command starts.
+func eefc1ArmFRDY() {
+    NVIC.enable(.efc1)
+    setBits32_locked(ATSAM3X8E.EEFC1.FMR, ATSAM3X8E.EEFC.FMR_FRDY)
+}
+
+/// Spin until no async command owns bank 1 (reads are unsafe while it programs).
+func eefc1WaitNotInFlight(timeout: U32 = 20_000_000) -> Bool {
+    waitUntil(timeout) { eefc1CommitFlag() != EEFCCommitFlag.inFlight }
+}
+
+/// Write FCR for `command` on EEFC1 (latch buffer already filled for EWP/WP).
+/// Does not wait for completion. False if the controller never became ready.
+func eefc1Start(_ command: EEFCCommand, pageIndex: U32) -> Bool {
+    if !waitUntil(5_000_000, { (bm_read32(ATSAM3X8E.EEFC1.FSR) & ATSAM3X8E.EEFC.FSR_FRDY) != 0 }) {
+        EEFCTelemetry.noteTimeout(command)
+        return false
+    }
+
+    let cmd =
+        ATSAM3X8E.EEFC.FCR_FKEY_PASSWD |
+        (pageIndex << ATSAM3X8E.EEFC.FCR_FARG_SHIFT) |
+        (command.fcmd & ATSAM3X8E.EEFC.FCR_FCMD_MASK)
+
+    g_eefc1CmdKind = command
+    g_eefc1StickyFSR = 0
+    EEFCTelemetry.noteIssued(command, bank1PageIndex: pageIndex)
+    g_eefc1CmdStartCycles = CycleCounter.now()
+
+    if bm_running_bank() == 1 {
+        // Code runs from bank 1 (A/B image): it cannot be fetched while the
+        // bank programs, so the command runs from RAM with IRQs off and
+        // completes here. Async callers still see FRDY fire right away.
+        let fsr = withIRQLocked {
+            bm_eefc_cmd_ram(ATSAM3X8E.EEFC1.FCR, ATSAM3X8E.EEFC1.FSR, cmd)
+        }
+        g_eefc1StickyFSR = fsr & (ATSAM3X8E.EEFC.FSR_FCMDE | ATSAM3X8E.EEFC.FSR_FLOCKE)
+        return true
+    }
+
+    bm_write32(ATSAM3X8E.EEFC1.FCR, cmd)
+    return true
+}
+
+/// Synchronous completion of the command started by eefc1Start().
+/// Returns FSR (read once: it clears FCMDE/FLOCKE), or nil on timeout.
+func eefc1WaitCommand(timeout: U32 = 20_000_000) -> U32? {
+    if !waitUntil(timeout, { (bm_read32(ATSAM3X8E.EEFC1.FSR) & ATSAM3X8E.EEFC.FSR_FRDY) != 0 }) {
+        EEFCTelemetry.noteTimeout(g_eefc1CmdKind)
+        return nil
+    }
+    let end = CycleCounter.now()
+    let fsr = bm_read32(ATSAM3X8E.EEFC1.FSR) | g_eefc1StickyFSR
+    EEFCTelemetry.noteCompleted(g_eefc1CmdKind, cycles: end &- g_eefc1CmdStartCycles, fsr: fsr)
+    return fsr
+}
+
+/// Non-blocking completion check for a command started without FRDY armed
+/// (slot claimed by the caller). Returns FSR once ready, nil while busy.
+func eefc1PollCommand() -> U32? {
+    let raw = bm_read32(ATSAM3X8E.EEFC1.FSR)
+    if (raw & ATSAM3X8E.EEFC.FSR_FRDY) == 0 { return nil }
+    let fsr = raw | g_eefc1StickyFSR
+    EEFCTelemetry.noteCompleted(g_eefc1CmdKind, cycles: CycleCounter.now() &- g_eefc1CmdStartCycles, fsr: fsr)
+    return fsr
+}
+
+/// Fill the page latch buffer (memory-mapped) and issue EWP on EEFC1.
+/// Does not wait for completion.
+func eefc1StartEWP(addr: U32, pageIndex: U32, src: UnsafePointer<UInt8>, count: Int) -> Bool {
+    if !waitUntil(5_000_000, { (bm_read32(ATSAM3X8E.EEFC1.FSR) & ATSAM3X8E.EEFC.FSR_FRDY) != 0 }) {
+        EEFCTelemetry.noteTimeout(.ewp)
+        return false
+    }
+
+    // Copy page image into flash write buffer (memory-mapped flash), LE words
+    var i = 0
+    while i + 4 <= count {
+        let w =
+            U32(src[i + 0]) |
+            (U32(src[i + 1]) << 8) |
+            (U32(src[i + 2]) << 16) |
+            (U32(src[i + 3]) << 24)
+        bm_write32(addr + U32(i), w)
+        i += 4
+    }
+
+    bm_dsb()
+    bm_isb()
+
+    // EEFC command: Erase Page and Write Page (EWP) on EEFC1
+    return eefc1Start(.ewp, pageIndex: pageIndex)
+}
+
+@_cdecl("EEFC1_Handler")
+public func EEFC1_Handler() {
+    // Reading FSR clears FCMDE/FLOCKE, so latch it for pollCommit().
+    let fsr = bm_read32(ATSAM3X8E.EEFC1.FSR)
+    if (fsr & ATSAM3X8E.EEFC.FSR_FRDY) == 0 { return }
+    g_eefc1CommitEndCycles = CycleCounter.now()
+
+    // FRDY is a level: mask it, or the IRQ re-enters forever while idle.
+    clearBits32(ATSAM3X8E.EEFC1.FMR, ATSAM3X8E.EEFC.FMR_FRDY)
+
+    g_eefc1CommitFSR = fsr | g_eefc1StickyFSR
+    g_eefc1CommitState = EEFCCommitFlag.done
+}
+
 public struct EEFCStorage {
 
+    public typealias CommitCompletion = (EEFCError?) -> Void
+
     // MARK: - On-flash format (not hardware)
 
     private static let magic: U32 = 0x4545_4B56 // "EEKV"
-    private static let version: U32 = 1
+    private static let version: U32 = 3
 
-    private static let headerWords: U32 = 4
+    // Page header (v2+): magic, version, sequence, usedBytes, crc.
+    // CRC covers sequence + usedBytes + payload, so a torn page never validates.
+    private static let headerWords: U32 = 5
     private static var headerBytes: U32 { headerWords * 4 }
 
+    // v1 pages (single-copy format, no sequence) are still accepted on load
+    // as sequence 0, so devices keep their data across the format change.
+    private static let legacyVersion: U32 = 1
+    private static let legacyHeaderBytes: U32 = 16
+
+    // v2 pages use the same header but 4-byte entry headers (no key hash);
+    // their payload is re-encoded in RAM on load and written back as v3.
+    private static let hashlessVersion: U32 = 2
+
+    // Entry header (v3): keyLen (u8), type (u8), valueLen (u16 LE), keyHash (u16 LE)
+    private static let entryHeaderBytes = 6
+    private static let hashlessEntryHeaderBytes = 4
+
+    // A/B copies
+    private static let slotCount: U32 = 2
+
     public enum ValueType: UInt8 {
         case bytes  = 1
         case string = 2
         case u32    = 3
         case bool   = 4
+        case record = 5
     }
 
     // MARK: - Hardware config (from ATSAM3X8E.swift)
 
-    private let pageAddr: U32
+    private let pageAddr: U32          // slot A; slot B follows at pageAddr + pageSize
     private let pageSize: U32
     private let payloadMax: Int
-    private let bank1PageIndex: U32
+    private let bank1PageIndex: U32    // EEFC1 page index of slot A
 
     public init(
         pageAddr: U32 = ATSAM3X8E.NVM.PAGE_ADDR,
@@ -161,99 +515,39 @@ public struct EEFCStorage {
 
     // MARK: - Public API (generic)
 
-    public func load(key: String) -> EEFCLoadResult<[UInt8]> {
-        guard validateKey(key) else { return .failure(.invalidKey) }
-        let keyBytes = utf8Bytes(key)
-
-        let page = readPage()
-        let hdr = parseHeader(page)
-        switch hdr {
-        case .failure(let e): return .failure(e)
-        case .success(let h):
-            let used = Int(h.usedBytes)
-            if used == 0 { return .failure(.empty) }
-            if used > payloadMax { return .failure(.corruptHeader) }
+    public func load<K: EEFCKeyRepresentable>(key: K) -> EEFCLoadResult<[UInt8]> {
+        key.withEEFCKey { (keyBytes, hash) -> EEFCLoadResult<[UInt8]> in
+            if keyBytes.isEmpty { return .failure(.invalidKey) }
 
-            let payload = slice(page, from: Int(Self.headerBytes), count: used)
-            let got = crc32(payload)
-            if got != h.crc { return .failure(.crcMismatch(expected: h.crc, got: got)) }
+            // Only the value is copied out of flash.
+            let r = withActivePayload { (payload) -> EEFCLoadResult<[UInt8]> in
+                if payload.isEmpty { return .failure(.empty) }
 
-            if let found = findEntry(payload: payload, keyBytes: keyBytes) {
-                return .success(found.valueBytes)
+                if let found = findEntry(payload: payload, key: keyBytes, hash: hash) {
+                    return .success(slice(payload, from: found.valueStart, count: found.valueCount))
+                }
+                return .failure(.keyNotFound(hash: hash))
             }
-            return .failure(.keyNotFound(key))
-        }
-    }
-
-    public func save(key: String, value: [UInt8], type: ValueType = .bytes) -> EEFCError? {
-        guard validateKey(key) else { return .invalidKey }
-        let keyBytes = utf8Bytes(key)
-
-        // Defensive size checks
-        if keyBytes.count > 255 { return .keyTooLong(keyBytes.count) }
-        if value.count > 0xFFFF { return .valueTooLarge(value.count) }
-
-        // Load existing map (or empty if not initialized)
-        let oldPayloadResult = readValidPayloadOrEmpty()
-        switch oldPayloadResult {
-        case .failure(let e):
-            // If totally empty/uninitialized, we can still proceed from empty payload.
-            // But if it's corrupted, fail (defensive).
-            switch e {
-            case .empty, .badMagic:
-                break
-            default:
-                return e
+            switch r {
+            case .failure(let e): return .failure(e)
+            case .success(let inner): return inner
             }
-        case .success:
-            break
-        }
-
-        var payload = oldPayloadResult.payloadOrEmpty()
-
-        // Remove existing entry if present
-        payload = removeEntry(payload: payload, keyBytes: keyBytes)
-
-        // Add new entry
-        let entry = encodeEntry(keyBytes: keyBytes, type: type, valueBytes: value)
-
-        // Capacity check
-        let newUsed = payload.count + entry.count
-        if newUsed > payloadMax {
-            return .noRoom(missing: newUsed - payloadMax)
         }
-
-        payload.append(contentsOf: entry)
-
-        // Write full page
-        let err = writePayload(payload)
-        return err
     }
 
-    public func remove(key: String) -> EEFCError? {
-        guard validateKey(key) else { return .invalidKey }
-        let keyBytes = utf8Bytes(key)
+    public func save<K: EEFCKeyRepresentable>(key: K, value: [UInt8], type: ValueType = .bytes) -> EEFCError? {
+        if settlePending() { return .busy }
+        return commit(planSave(key: key, value: value, type: type))
+    }
 
-        let oldPayloadResult = readValidPayloadOrEmpty()
-        switch oldPayloadResult {
-        case .failure(let e):
-            switch e {
-            case .empty, .badMagic:
-                return .keyNotFound(key)
-            default:
-                return e
-            }
-        case .success(let payload):
-            let newPayload = removeEntry(payload: payload, keyBytes: keyBytes)
-            if newPayload.count == payload.count {
-                return .keyNotFound(key)
-            }
-            return writePayload(newPayload)
-        }
+    public func remove<K: EEFCKeyRepresentable>(key: K) -> EEFCError? {
+        if settlePending() { return .busy }
+        return commit(planRemove(key: key))
     }
 
     public func clear() -> EEFCError? {
-        return writePayload([])
+        if settlePending() { return .busy }
+        return commit(planClear())
     }
 
     /// Remove all keys and values from the reserved flash page.
@@ -262,16 +556,55 @@ public struct EEFCStorage {
         return clear()
     }
 
-    public func contains(key: String) -> Bool {
+    public func contains<K: EEFCKeyRepresentable>(key: K) -> Bool {
         switch load(key: key) {
         case .success: return true
         case .failure: return false
         }
     }
 
+    // MARK: - Async commit API
+
+    /// Start a save without waiting for the flash. Returns an error only if the
+    /// commit could not be started; the final result goes to `completion`
+    /// (from pollCommit()) or is returned by pollCommit() as `.completed`.
+    public func saveAsync<K: EEFCKeyRepresentable>(
+        key: K,
+        value: [UInt8],
+        type: ValueType = .bytes,
+        completion: CommitCompletion? = nil
+    ) -> EEFCError? {
+        if settlePending() { return .busy }
+        return commitAsync(planSave(key: key, value: value, type: type), completion: completion)
+    }
+
+    public func removeAsync<K: EEFCKeyRepresentable>(key: K, completion: CommitCompletion? = nil) -> EEFCError? {
+        if settlePending() { return .busy }
+        return commitAsync(planRemove(key: key), completion: completion)
+    }
+
+    public func clearAsync(completion: CommitCompletion? = nil) -> EEFCError? {
+        if settlePending() { return .busy }
+        return commitAsync(planClear(), completion: completion)
+    }
+
+    public var isCommitInFlight: Bool {
+        Self.pending != nil
+    }
+
+    /// Call from the main loop. Finishes a commit whose FRDY interrupt fired:
+    /// checks FSR, verifies the page and runs the completion callback.
+    @discardableResult
+    public func pollCommit() -> EEFCCommitStatus {
+        guard let p = Self.pending else { return .idle }
+        if eefc1CommitFlag() != EEFCCommitFlag.done { return .inFlight }
+        let err = finishPending(p)
+        return .completed(err)
+    }
+
     // MARK: - Convenience typed API
 
-    public func loadString(key: String) -> EEFCLoadResult<String> {
+    public func loadString<K: EEFCKeyRepresentable>(key: K) -> EEFCLoadResult<String> {
         let r = load(key: key)
         switch r {
         case .failure(let e): return .failure(e)
@@ -285,12 +618,12 @@ public struct EEFCStorage {
         }
     }
 
-    public func save(key: String, value: String) -> EEFCError? {
+    public func save<K: EEFCKeyRepresentable>(key: K, value: String) -> EEFCError? {
         let bytes = utf8Bytes(value)
         return save(key: key, value: bytes, type: .string)
     }
 
-    public func loadU32(key: String) -> EEFCLoadResult<U32> {
+    public func loadU32<K: EEFCKeyRepresentable>(key: K) -> EEFCLoadResult<U32> {
         let r = load(key: key)
         switch r {
         case .failure(let e): return .failure(e)
@@ -301,14 +634,14 @@ public struct EEFCStorage {
         }
     }
 
-    public func save(key: String, value: U32) -> EEFCError? {
+    public func save<K: EEFCKeyRepresentable>(key: K, value: U32) -> EEFCError? {
         var bytes = [UInt8]()
         bytes.reserveCapacity(4)
         appendU32LE(value, to: &bytes)
         return save(key: key, value: bytes, type: .u32)
     }
 
-    public func loadBool(key: String) -> EEFCLoadResult<Bool> {
+    public func loadBool<K: EEFCKeyRepresentable>(key: K) -> EEFCLoadResult<Bool> {
         let r = load(key: key)
         switch r {
         case .failure(let e): return .failure(e)
@@ -318,20 +651,201 @@ public struct EEFCStorage {
         }
     }
 
-    public func save(key: String, value: Bool) -> EEFCError? {
+    public func save<K: EEFCKeyRepresentable>(key: K, value: Bool) -> EEFCError? {
         let bytes: [UInt8] = [value ? 1 : 0]
         return save(key: key, value: bytes, type: .bool)
     }
 
+    // MARK: - Record API
+
+    /// Load a record without copying the page: CRC, entry lookup and the
+    /// struct load all read the memory-mapped flash directly.
+    public func loadRecord<R: EEFCRecord, K: EEFCKeyRepresentable>(
+        _ type: R.Type,
+        key: K
+    ) -> EEFCLoadResult<R> {
+        if !_isPOD(R.self) { return .failure(.recordNotTrivial) }
+
+        return key.withEEFCKey { (keyBytes, hash) -> EEFCLoadResult<R> in
+            if keyBytes.isEmpty { return .failure(.invalidKey) }
+
+            let r = withActivePayload { (payload) -> EEFCLoadResult<R> in
+                if payload.isEmpty { return .failure(.empty) }
+
+                guard let found = findEntry(payload: payload, key: keyBytes, hash: hash) else {
+                    return .failure(.keyNotFound(hash: hash))
+                }
+                if found.type != .record {
+                    return .failure(.typeMismatch(expected: .record, got: found.type))
+                }
+                let end = found.valueStart + found.valueCount
+                return decodeRecord(R.self, UnsafeBufferPointer(rebasing: payload[found.valueStart..<end]))
+            }
+            switch r {
+            case .failure(let e): return .failure(e)
+            case .success(let inner): return inner
+            }
+        }
+    }
+
+    /// Stored record, or `R()` defaults if it is missing/unreadable.
+    public func loadRecordOrDefault<R: EEFCRecord, K: EEFCKeyRepresentable>(_ type: R.Type, key: K) -> R {
+        switch loadRecord(R.self, key: key) {
+        case .success(let r): return r
+        case .failure: return R()
+        }
+    }
+
+    public func save<R: EEFCRecord, K: EEFCKeyRepresentable>(key: K, record: R) -> EEFCError? {
+        if !_isPOD(R.self) { return .recordNotTrivial }
+        return save(key: key, value: encodeRecord(record), type: .record)
+    }
+
+    public func saveAsync<R: EEFCRecord, K: EEFCKeyRepresentable>(
+        key: K,
+        record: R,
+        completion: CommitCompletion? = nil
+    ) -> EEFCError? {
+        if !_isPOD(R.self) { return .recordNotTrivial }
+        return saveAsync(key: key, value: encodeRecord(record), type: .record, completion: completion)
+    }
+
+    // MARK: - Internals: record codec
+
+    private func encodeRecord<R: EEFCRecord>(_ record: R) -> [UInt8] {
+        var out = [UInt8]()
+        out.reserveCapacity(2 + MemoryLayout<R>.size)
+        out.append(UInt8(R.recordVersion & 0xFF))
+        out.append(UInt8(R.recordVersion >> 8))
+        withUnsafeBytes(of: record) { raw in out.append(contentsOf: raw) }
+        return out
+    }
+
+    private func decodeRecord<R: EEFCRecord>(_ type: R.Type, _ value: UnsafeBufferPointer<UInt8>) -> EEFCLoadResult<R> {
+        if value.count < 2 { return .failure(.corruptPayload) }
+        let version = U16(value[0]) | (U16(value[1]) << 8)
+        let body = UnsafeRawBufferPointer(rebasing: UnsafeRawBufferPointer(value)[2...])
+
+        // Same layout: one unaligned load from flash.
+        if version == R.recordVersion && body.count == MemoryLayout<R>.size {
+            return .success(body.loadUnaligned(as: R.self))
+        }
+        if let r = R.migrate(from: version, bytes: body) { return .success(r) }
+        return .failure(.recordVersion(found: version))
+    }
+
+    // MARK: - Internals: update planning
+
+    private enum Plan {
+        case write(payload: [UInt8], replacing: ActiveRead)
+        case failure(EEFCError)
+    }
+
+    private func planSave<K: EEFCKeyRepresentable>(key: K, value: [UInt8], type: ValueType) -> Plan {
+        key.withEEFCKey { keyBytes, hash in
+            planSave(key: keyBytes, hash: hash, value: value, type: type)
+        }
+    }
+
+    private func planSave(key keyBytes: UnsafeBufferPointer<UInt8>, hash: U16, value: [UInt8], type: ValueType) -> Plan {
+        if keyBytes.isEmpty { return .failure(.invalidKey) }
+
+        // Defensive size checks
+        if keyBytes.count > 255 { return .failure(.keyTooLong(keyBytes.count)) }
+        if value.count > 0xFFFF { return .failure(.valueTooLarge(value.count)) }
+
+        // Load existing map (or empty if not initialized)
+        let current = readActive()
+        var payload = [UInt8]()
+        switch current {
+        case .failure(let e):
+            // If totally empty/uninitialized, we can still proceed from empty payload.
+            // But if both copies are corrupted, fail (defensive).
+            switch e {
+            case .empty, .badMagic:
+                break
+            default:
+                return .failure(e)
+            }
+        case .success(let snap):
+            payload = snap.payload
+        }
+
+        // Remove existing entry if present
+        payload = removeEntry(payload: payload, key: keyBytes, hash: hash)
+
+        // Add new entry
+        let entry = encodeEntry(key: keyBytes, hash: hash, type: type, valueBytes: value)
+
+        // Capacity check
+        let newUsed = payload.count + entry.count
+        if newUsed > payloadMax {
+            return .failure(.noRoom(missing: newUsed - payloadMax))
+        }
+
+        payload.append(contentsOf: entry)
+        return .write(payload: payload, replacing: current)
+    }
+
+    private func planRemove<K: EEFCKeyRepresentable>(key: K) -> Plan {
+        key.withEEFCKey { keyBytes, hash in
+            planRemove(key: keyBytes, hash: hash)
+        }
+    }
+
+    private func planRemove(key keyBytes: UnsafeBufferPointer<UInt8>, hash: U16) -> Plan {
+        if keyBytes.isEmpty { return .failure(.invalidKey) }
+
+        let current = readActive()
+        switch current {
+        case .failure(let e):
+            switch e {
+            case .empty, .badMagic:
+                return .failure(.keyNotFound(hash: hash))
+            default:
+                return .failure(e)
+            }
+        case .success(let snap):
+            let newPayload = removeEntry(payload: snap.payload, key: keyBytes, hash: hash)
+            if newPayload.count == snap.payload.count {
+                return .failure(.keyNotFound(hash: hash))
+            }
+            return .write(payload: newPayload, replacing: current)
+        }
+    }
+
+    private func planClear() -> Plan {
+        // Written as a new (empty) copy: the old page must not win on next load.
+        return .write(payload: [], replacing: readActive())
+    }
+
+    private func commit(_ plan: Plan) -> EEFCError? {
+        switch plan {
+        case .failure(let e): return e
+        case .write(let payload, let current): return writePayload(payload, replacing: current)
+        }
+    }
+
+    private func commitAsync(_ plan: Plan, completion: CommitCompletion?) -> EEFCError? {
+        switch plan {
+        case .failure(let e): return e
+        case .write(let payload, let current):
+            return startPayload(payload, replacing: current, completion: completion)
+        }
+    }
+
     // MARK: - Internals: header parsing
 
     private struct Header {
+        let sequence: U32
         let usedBytes: U32
         let crc: U32
         let version: U32
     }
 
-    private func parseHeader(_ page: [UInt8]) -> EEFCLoadResult<Header> {
+    private func parseHeader<B: RandomAccessCollection>(_ page: B) -> EEFCLoadResult<Header>
+        where B.Element == UInt8, B.Index == Int
+    {
         if page.count != Int(pageSize) { return .failure(.internalInvariant("page size mismatch")) }
 
         let m = u32LE(page, 0)
@@ -339,60 +853,204 @@ public struct EEFCStorage {
         if m != Self.magic { return .failure(.badMagic) }
 
         let v = u32LE(page, 4)
-        if v != Self.version { return .failure(.unsupportedVersion(found: v)) }
+        if v == Self.legacyVersion {
+            let used = u32LE(page, 8)
+            let crc = u32LE(page, 12)
+            if used > pageSize - Self.legacyHeaderBytes { return .failure(.corruptHeader) }
+            return .success(Header(sequence: 0, usedBytes: used, crc: crc, version: v))
+        }
+        if v != Self.version && v != Self.hashlessVersion { return .failure(.unsupportedVersion(found: v)) }
 
-        let used = u32LE(page, 8)
-        let crc = u32LE(page, 12)
+        let seq = u32LE(page, 8)
+        let used = u32LE(page, 12)
+        let crc = u32LE(page, 16)
 
         if used > U32(payloadMax) { return .failure(.corruptHeader) }
 
-        return .success(Header(usedBytes: used, crc: crc, version: v))
+        return .success(Header(sequence: seq, usedBytes: used, crc: crc, version: v))
+    }
+
+    // MARK: - Internals: A/B slot selection
+
+    private struct Snapshot {
+        let slot: U32
+        let sequence: U32
+        let payload: [UInt8]
     }
 
-    // MARK: - Internals: read/write payload
+    // Validated slot, viewed in place (memory-mapped flash).
+    private struct SlotView {
+        let slot: U32
+        let sequence: U32
+        let version: U32
+        let payload: UnsafeBufferPointer<UInt8>
+    }
+
+    private enum SlotRead {
+        case valid(SlotView)
+        case invalid(EEFCError)
+    }
 
-    private enum PayloadRead {
-        case success([UInt8])
+    private enum ActiveRead {
+        case success(Snapshot)
         case failure(EEFCError)
+    }
 
-        func payloadOrEmpty() -> [UInt8] {
-            switch self {
-            case .success(let p): return p
-            case .failure: return []
-            }
+    @inline(__always)
+    private func slotAddr(_ slot: U32) -> U32 { pageAddr + slot * pageSize }
+
+    @inline(__always)
+    private func slotPageIndex(_ slot: U32) -> U32 { bank1PageIndex + slot }
+
+    @inline(__always)
+    private func mappedPage(_ slot: U32) -> UnsafeBufferPointer<UInt8> {
+        UnsafeBufferPointer(start: UnsafePointer<UInt8>(bitPattern: UInt(slotAddr(slot))), count: Int(pageSize))
+    }
+
+    private func readSlot(_ slot: U32) -> SlotRead {
+        let page = mappedPage(slot)
+        switch parseHeader(page) {
+        case .failure(let e):
+            return .invalid(e)
+        case .success(let h):
+            let legacy = (h.version == Self.legacyVersion)
+            let start = Int(legacy ? Self.legacyHeaderBytes : Self.headerBytes)
+            let payload = UnsafeBufferPointer(rebasing: page[start..<(start + Int(h.usedBytes))])
+            let got = legacy ? crc32(payload) : pageCRC(sequence: h.sequence, payload: payload)
+            if got != h.crc { return .invalid(.crcMismatch(expected: h.crc, got: got)) }
+            return .valid(SlotView(slot: slot, sequence: h.sequence, version: h.version, payload: payload))
         }
     }
 
-    private func readValidPayloadOrEmpty() -> PayloadRead {
-        let page = readPage()
-        let hdr = parseHeader(page)
-        switch hdr {
+    /// Newest valid copy, in place. A torn/blank page only loses if the other one is valid.
+    /// Caller makes sure bank 1 is not programming.
+    private func newestSlot() -> EEFCLoadResult<SlotView> {
+        let a = readSlot(0)
+        let b = readSlot(1)
+        switch (a, b) {
+        case (.valid(let sa), .valid(let sb)):
+            return .success(Self.isNewer(sb.sequence, than: sa.sequence) ? sb : sa)
+        case (.valid(let sa), .invalid):
+            return .success(sa)
+        case (.invalid, .valid(let sb)):
+            return .success(sb)
+        case (.invalid(let ea), .invalid(let eb)):
+            // Prefer reporting real corruption over "never written".
+            return .failure(Self.isBlank(ea) ? eb : ea)
+        }
+    }
+
+    /// Newest copy as an owned (v3) payload, for read-modify-write.
+    /// While a commit is in flight, the pending copy is newest (and bank 1 is busy).
+    private func readActive() -> ActiveRead {
+        if let p = Self.pending { return .success(p.snapshot) }
+
+        // Another EEFC1 client may be programming bank 1: let it finish first.
+        if !eefc1WaitNotInFlight() { return .failure(.timeout) }
+
+        switch newestSlot() {
         case .failure(let e):
             return .failure(e)
-        case .success(let h):
-            let used = Int(h.usedBytes)
-            if used == 0 { return .failure(.empty) }
-            let payload = slice(page, from: Int(Self.headerBytes), count: used)
-            let got = crc32(payload)
-            if got != h.crc { return .failure(.crcMismatch(expected: h.crc, got: got)) }
-            return .success(payload)
+        case .success(let v):
+            let payload = (v.version == Self.version) ? Array(v.payload) : addKeyHashes(v.payload)
+            return .success(Snapshot(slot: v.slot, sequence: v.sequence, payload: payload))
         }
     }
 
-    private func writePayload(_ payload: [UInt8]) -> EEFCError? {
+    /// Newest (v3) payload for lookups: read in place from flash when possible,
+    /// from RAM while a commit is pending or for pre-v3 pages.
+    private func withActivePayload<R>(_ body: (UnsafeBufferPointer<UInt8>) -> R) -> EEFCLoadResult<R> {
+        if let p = Self.pending {
+            return .success(p.snapshot.payload.withUnsafeBufferPointer(body))
+        }
+        if !eefc1WaitNotInFlight() { return .failure(.timeout) }
+
+        switch newestSlot() {
+        case .failure(let e):
+            return .failure(e)
+        case .success(let v):
+            if v.version == Self.version { return .success(body(v.payload)) }
+            return .success(addKeyHashes(v.payload).withUnsafeBufferPointer(body))
+        }
+    }
+
+    /// Also used by EEFCTelemetry's META A/B pages.
+    @inline(__always)
+    static func isNewer(_ a: U32, than b: U32) -> Bool {
+        // Serial-number arithmetic: survives sequence wrap-around.
+        Int32(bitPattern: a &- b) > 0
+    }
+
+    @inline(__always)
+    private static func isBlank(_ e: EEFCError) -> Bool {
+        switch e {
+        case .empty, .badMagic: return true
+        default: return false
+        }
+    }
+
+    // MARK: - Internals: write payload
+
+    private func writePayload(_ payload: [UInt8], replacing current: ActiveRead) -> EEFCError? {
+        if payload.count > payloadMax { return .valueTooLarge(payload.count) }
+
+        let (slot, seq) = nextTarget(current)
+        let page = buildPage(payload, sequence: seq)
+
+        if let e = issueEWP(slot: slot, page: page) { return e }
+        guard let fsr = eefc1WaitCommand() else { return .timeout }
+
+        return checkResult(fsr: fsr, addr: slotAddr(slot), page: page)
+    }
+
+    private func startPayload(
+        _ payload: [UInt8],
+        replacing current: ActiveRead,
+        completion: CommitCompletion?
+    ) -> EEFCError? {
         if payload.count > payloadMax { return .valueTooLarge(payload.count) }
 
-        if !waitReady(timeout: 5_000_000) { return .timeout }
+        let (slot, seq) = nextTarget(current)
+        let page = buildPage(payload, sequence: seq)
+
+        if !eefc1Claim() { return .busy }
 
+        // Publish the pending copy BEFORE the command: readers switch to RAM now.
+        Self.pending = PendingCommit(
+            snapshot: Snapshot(slot: slot, sequence: seq, payload: payload),
+            addr: slotAddr(slot),
+            page: page,
+            completion: completion
+        )
+
+        if let e = issueEWP(slot: slot, page: page) {
+            Self.pending = nil
+            eefc1Release()
+            return e
+        }
+
+        eefc1ArmFRDY()
+        return nil
+    }
+
+    // Target = the page NOT holding the active copy.
+    private func nextTarget(_ current: ActiveRead) -> (slot: U32, sequence: U32) {
+        if case .success(let snap) = current {
+            return ((snap.slot + 1) % Self.slotCount, snap.sequence &+ 1)
+        }
+        return (0, 1)
+    }
+
+    private func buildPage(_ payload: [UInt8], sequence seq: U32) -> [UInt8] {
         // Build full page image: [header][payload][padding=0xFF]
         var page = [UInt8]()
         page.reserveCapacity(Int(pageSize))
 
-        // Header placeholder
         appendU32LE(Self.magic, to: &page)
         appendU32LE(Self.version, to: &page)
+        appendU32LE(seq, to: &page)
         appendU32LE(U32(payload.count), to: &page)
-        appendU32LE(crc32(payload), to: &page)
+        appendU32LE(pageCRC(sequence: seq, payload: payload), to: &page)
 
         // Payload
         page.append(contentsOf: payload)
@@ -407,188 +1065,181 @@ public struct EEFCStorage {
                 i += 1
             }
         }
+        return page
+    }
+
+    private func issueEWP(slot: U32, page: [UInt8]) -> EEFCError? {
+        let ok = page.withUnsafeBufferPointer { p -> Bool in
+            eefc1StartEWP(addr: slotAddr(slot), pageIndex: slotPageIndex(slot),
+                          src: p.baseAddress!, count: p.count)
+        }
+        return ok ? nil : .timeout
+    }
 
-        // Copy page image into flash write buffer (memory-mapped flash)
+    private func checkResult(fsr: U32, addr: U32, page: [UInt8]) -> EEFCError? {
+        if (fsr & ATSAM3X8E.EEFC.FSR_FCMDE) != 0 { return .commandError }
+        if (fsr & ATSAM3X8E.EEFC.FSR_FLOCKE) != 0 { return .lockError }
+
+        // Verify through the memory-mapped view. Only a page that reads back
+        // intact (and so carries a valid CRC) can become the active copy.
         var off: U32 = 0
         while off < pageSize {
-            let w = u32LE(page, Int(off))
-            bm_write32(pageAddr + off, w)
+            if bm_read32(addr + off) != u32LE(page, Int(off)) { return .verifyFailed }
             off &+= 4
         }
 
-        bm_dsb()
-        bm_isb()
-
-        // EEFC command: Erase Page and Write Page (EWP) on EEFC1
-        let cmd =
-            ATSAM3X8E.EEFC.FCR_FKEY_PASSWD |
-            (bank1PageIndex << ATSAM3X8E.EEFC.FCR_FARG_SHIFT) |
-            (ATSAM3X8E.EEFC.FCMD_EWP & ATSAM3X8E.EEFC.FCR_FCMD_MASK)
+        return nil
+    }
 
-        bm_write32(ATSAM3X8E.EEFC1.FCR, cmd)
+    // MARK: - Internals: async commit bookkeeping
 
-        if !waitReady(timeout: 20_000_000) { return .timeout }
+    private struct PendingCommit {
+        let snapshot: Snapshot
+        let addr: U32
+        let page: [UInt8]
+        let completion: CommitCompletion?
+    }
 
-        let fsr = bm_read32(ATSAM3X8E.EEFC1.FSR)
-        if (fsr & ATSAM3X8E.EEFC.FSR_FCMDE) != 0 { return .commandError }
-        if (fsr & ATSAM3X8E.EEFC.FSR_FLOCKE) != 0 { return .lockError }
+    private static var pending: PendingCommit? = nil
 
-        return nil
+    /// Returns true while an in-flight command still owns bank 1.
+    /// Our own commit, if already finished, is completed here (callback included).
+    private func settlePending() -> Bool {
+        guard let p = Self.pending else {
+            // Another EEFC1 client (e.g. FlashLog) owns the controller.
+            return eefc1CommitFlag() != EEFCCommitFlag.idle
+        }
+        if eefc1CommitFlag() != EEFCCommitFlag.done { return true }
+        _ = finishPending(p)
+        return false
     }
 
-    @inline(__always)
-    private func waitReady(timeout: U32) -> Bool {
-        waitUntil(timeout) {
-            (bm_read32(ATSAM3X8E.EEFC1.FSR) & ATSAM3X8E.EEFC.FSR_FRDY) != 0
-        }
+    private func finishPending(_ p: PendingCommit) -> EEFCError? {
+        let fsr = eefc1TakeFSR()
+        let err = checkResult(fsr: fsr, addr: p.addr, page: p.page)
+
+        // Drop the RAM copy first: the callback may start the next commit.
+        Self.pending = nil
+        p.completion?(err)
+        return err
     }
 
     // MARK: - Internals: entry encode/parse
 
-    private func encodeEntry(keyBytes: [UInt8], type: ValueType, valueBytes: [UInt8]) -> [UInt8] {
-        // Entry header: keyLen (u8), type (u8), valueLen (u16 LE)
+    private func encodeEntry(key: UnsafeBufferPointer<UInt8>, hash: U16, type: ValueType, valueBytes: [UInt8]) -> [UInt8] {
+        // Entry header: keyLen (u8), type (u8), valueLen (u16 LE), keyHash (u16 LE)
         var out = [UInt8]()
-        out.reserveCapacity(1 + 1 + 2 + keyBytes.count + valueBytes.count)
+        out.reserveCapacity(Self.entryHeaderBytes + key.count + valueBytes.count)
 
-        out.append(UInt8(truncatingIfNeeded: keyBytes.count))
+        out.append(UInt8(truncatingIfNeeded: key.count))
         out.append(type.rawValue)
         out.append(UInt8(valueBytes.count & 0xFF))
         out.append(UInt8((valueBytes.count >> 8) & 0xFF))
+        out.append(UInt8(hash & 0xFF))
+        out.append(UInt8(hash >> 8))
 
-        out.append(contentsOf: keyBytes)
+        out.append(contentsOf: key)
         out.append(contentsOf: valueBytes)
         return out
     }
 
     private struct FoundEntry {
         let type: ValueType
-        let valueBytes: [UInt8]
+        let valueStart: Int
+        let valueCount: Int
+    }
+
+    /// Hash first, then length, then bytes: non-matching entries cost one compare.
+    @inline(__always)
+    private func entryMatches<B: RandomAccessCollection>(
+        _ payload: B, at i: Int, key: UnsafeBufferPointer<UInt8>, hash: U16
+    ) -> Bool where B.Element == UInt8, B.Index == Int {
+        let h = U16(payload[i + 4]) | (U16(payload[i + 5]) << 8)
+        if h != hash { return false }
+        if Int(payload[i + 0]) != key.count { return false }
+
+        let keyStart = i + Self.entryHeaderBytes
+        var k = 0
+        while k < key.count {
+            if payload[keyStart + k] != key[k] { return false }
+            k += 1
+        }
+        return true
     }
 
-    private func findEntry(payload: [UInt8], keyBytes: [UInt8]) -> FoundEntry? {
+    /// End offset of the entry at `i`, or nil if it runs past the payload / is corrupt.
+    @inline(__always)
+    private func entryEnd<B: RandomAccessCollection>(
+        _ payload: B, at i: Int, headerBytes: Int
+    ) -> Int? where B.Element == UInt8, B.Index == Int {
+        if i + headerBytes > payload.count { return nil }
+        let keyLen = Int(payload[i + 0])
+        let valueLen = Int(payload[i + 2]) | (Int(payload[i + 3]) << 8)
+        if keyLen == 0 { return nil }
+        let end = i + headerBytes + keyLen + valueLen
+        if end > payload.count { return nil }
+        return end
+    }
+
+    private func findEntry(payload: UnsafeBufferPointer<UInt8>, key: UnsafeBufferPointer<UInt8>, hash: U16) -> FoundEntry? {
         var i = 0
-        while i + 4 <= payload.count {
-            let keyLen = Int(payload[i + 0])
-            let typeRaw = payload[i + 1]
-            let valueLen = Int(payload[i + 2]) | (Int(payload[i + 3]) << 8)
-
-            let headerSize = 4
-            let keyStart = i + headerSize
-            let keyEnd = keyStart + keyLen
-            let valStart = keyEnd
-            let valEnd = valStart + valueLen
-
-            if keyLen == 0 { return nil }
-            if keyEnd > payload.count { return nil }
-            if valEnd > payload.count { return nil }
-
-            if keyLen == keyBytes.count {
-                var match = true
-                var k = 0
-                while k < keyLen {
-                    if payload[keyStart + k] != keyBytes[k] { match = false; break }
-                    k += 1
-                }
-                if match {
-                    guard let t = ValueType(rawValue: typeRaw) else { return nil }
-                    let value = slice(payload, from: valStart, count: valueLen)
-                    return FoundEntry(type: t, valueBytes: value)
-                }
+        while let end = entryEnd(payload, at: i, headerBytes: Self.entryHeaderBytes) {
+            if entryMatches(payload, at: i, key: key, hash: hash) {
+                guard let t = ValueType(rawValue: payload[i + 1]) else { return nil }
+                let valStart = i + Self.entryHeaderBytes + Int(payload[i + 0])
+                return FoundEntry(type: t, valueStart: valStart, valueCount: end - valStart)
             }
-
-            i = valEnd
+            i = end
         }
         return nil
     }
 
-    private func removeEntry(payload: [UInt8], keyBytes: [UInt8]) -> [UInt8] {
+    private func removeEntry(payload: [UInt8], key: UnsafeBufferPointer<UInt8>, hash: U16) -> [UInt8] {
         var out = [UInt8]()
         out.reserveCapacity(payload.count)
 
         var i = 0
-        while i + 4 <= payload.count {
-            let keyLen = Int(payload[i + 0])
-            let valueLen = Int(payload[i + 2]) | (Int(payload[i + 3]) << 8)
-            let headerSize = 4
-
-            let keyStart = i + headerSize
-            let keyEnd = keyStart + keyLen
-            let valEnd = keyEnd + valueLen
-
-            if keyLen == 0 { return out } // stop on corruption defensively
-            if keyEnd > payload.count { return out }
-            if valEnd > payload.count { return out }
-
-            var isTarget = (keyLen == keyBytes.count)
-            if isTarget {
-                var k = 0
-                while k < keyLen {
-                    if payload[keyStart + k] != keyBytes[k] { isTarget = false; break }
-                    k += 1
-                }
-            }
-
-            if !isTarget {
+        // stop on corruption defensively
+        while let end = entryEnd(payload, at: i, headerBytes: Self.entryHeaderBytes) {
+            if !entryMatches(payload, at: i, key: key, hash: hash) {
                 // copy entry bytes as-is
-                let entryLen = valEnd - i
-                var j = 0
-                while j < entryLen {
-                    out.append(payload[i + j])
+                var j = i
+                while j < end {
+                    out.append(payload[j])
                     j += 1
                 }
             }
-
-            i = valEnd
+            i = end
         }
 
         return out
     }
 
-    // MARK: - Internals: key validation
-
-    private func validateKey(_ key: String) -> Bool {
-        let b = utf8Bytes(key)
-        if b.isEmpty { return false }
-        // Simple safe charset: [A-Za-z0-9._-]
-        // (avoids spaces/utf8 surprises in embedded storage)
-        var i = 0
-        while i < b.count {
-            let c = b[i]
-            let isAZ = (c >= 65 && c <= 90)
-            let isaz = (c >= 97 && c <= 122)
-            let is09 = (c >= 48 && c <= 57)
-            let isOk = isAZ || isaz || is09 || c == 46 || c == 95 || c == 45
-            if !isOk { return false }
-            i += 1
-        }
-        return true
-    }
-
-    // MARK: - Internals: page read
-
-    private func readPage() -> [UInt8] {
-        let total = Int(pageSize)
+    /// v1/v2 payload (4-byte entry headers) -> v3 payload with key hashes.
+    private func addKeyHashes(_ p: UnsafeBufferPointer<UInt8>) -> [UInt8] {
         var out = [UInt8]()
-        out.reserveCapacity(total)
+        out.reserveCapacity(p.count + 32)
 
-        var off: U32 = 0
-        while off < pageSize {
-            let w = bm_read32(pageAddr + off)
-            out.append(UInt8((w >> 0) & 0xFF))
-            out.append(UInt8((w >> 8) & 0xFF))
-            out.append(UInt8((w >> 16) & 0xFF))
-            out.append(UInt8((w >> 24) & 0xFF))
-            off &+= 4
+        var i = 0
+        while let end = entryEnd(p, at: i, headerBytes: Self.hashlessEntryHeaderBytes) {
+            let keyStart = i + Self.hashlessEntryHeaderBytes
+            let keyEnd = keyStart + Int(p[i + 0])
+            let hash = eefcKeyHash(UnsafeBufferPointer(rebasing: p[keyStart..<keyEnd]))
+
+            out.append(contentsOf: p[i..<keyStart])
+            out.append(UInt8(hash & 0xFF))
+            out.append(UInt8(hash >> 8))
+            out.append(contentsOf: p[keyStart..<end])
+            i = end
         }
-
-        // Ensure exact length
-        if out.count > total { out.removeLast(out.count - total) }
         return out
     }
 
     // MARK: - Small utilities (no Foundation)
 
-    private func slice(_ a: [UInt8], from: Int, count: Int) -> [UInt8] {
+    private func slice<B: RandomAccessCollection>(_ a: B, from: Int, count: Int) -> [UInt8]
+        where B.Element == UInt8, B.Index == Int
+    {
         if count <= 0 { return [] }
         var out = [UInt8]()
         out.reserveCapacity(count)
@@ -625,7 +1276,9 @@ public struct EEFCStorage {
         return s
     }
 
-    private func u32LE(_ a: [UInt8], _ offset: Int) -> U32 {
+    private func u32LE<B: RandomAccessCollection>(_ a: B, _ offset: Int) -> U32
+        where B.Element == UInt8, B.Index == Int
+    {
         U32(a[offset + 0]) |
         (U32(a[offset + 1]) << 8) |
         (U32(a[offset + 2]) << 16) |
@@ -639,19 +1292,15 @@ public struct EEFCStorage {
         out.append(UInt8((v >> 24) & 0xFF))
     }
 
-    // MARK: - CRC32 (small, tableless)
+    // MARK: - CRC32 (crc32Update, MMIO.swift)
 
-    private func crc32(_ bytes: [UInt8]) -> U32 {
-        var crc: U32 = 0xFFFF_FFFF
-        for b in bytes {
-            crc ^= U32(b)
-            var i = 0
-            while i < 8 {
-                let lsb = (crc & 1) != 0
-                crc = (crc >> 1) ^ (lsb ? 0xEDB8_8320 : 0)
-                i += 1
-            }
-        }
-        return ~crc
+    private func crc32(_ bytes: UnsafeBufferPointer<UInt8>) -> U32 {
+        ~crc32Update(0xFFFF_FFFF, bytes)
+    }
+
+    // CRC of a v2 page: sequence + usedBytes (LE) followed by the payload.
+    private func pageCRC<B: Collection>(sequence: U32, payload: B) -> U32 where B.Element == UInt8 {
+        let hdr = crc32Update(crc32Update(0xFFFF_FFFF, word: sequence), word: U32(payload.count))
+        return ~crc32Update(hdr, payload)
     }
 }
\ No newline at end of file
@@ -0,0 +1,471 @@
+//
+// EEFCTelemetry.swift — Flash wear + latency counters for EEFC1 commands.
+//
+// Goals:
+// - Predict endurance in the field: per-page erase counters for every reserved
+//   bank-1 page (META A/B + FlashLog ring + KV A/B), kept across resets.
+// - See how long the controller takes: latency histogram per command (EWP/EA/WP).
+// - Count timeout / command (FCMDE) / lock (FLOCKE) errors.
+// - Cheap reads: everything lives in RAM, getters are plain loads.
+//
+// Metadata page format (PAGE_SIZE bytes, LE words), version 2:
+//   [magic][version][sequence][count][firstIndex]
+//   [erases][bankErases][untrackedErases][timeouts][commandErrors][lockErrors][persists]
+//   [pageErases x count][crc][0xFF pad]
+//   CRC covers every word between magic and crc, so a torn page never validates.
+//   Version 1 (single page at 0x000FDD00, no sequence) is still loaded, as
+//   sequence 0: that address is META slot 1 now.
+//
+// Notes:
+// - Hooks are called by the EEFC1 helpers in EEFC.swift (every client goes
+//   through them), so EEFCStorage and FlashLog (and any later client) are counted.
+// - Counters are only written back by persist(): the metadata pages wear out
+//   too, so call it rarely (e.g. every N erases or before a planned reset).
+//   Erases since the last persist() are lost on power failure.
+// - persist() writes the META page NOT holding the newest copy, with
+//   sequence+1, like EEFCStorage's A/B pages: a reset during the erase/program
+//   leaves the previous copy valid. begin() loads the newest valid one.
+// - The page image is built in one static PAGE_SIZE buffer (no per-call arrays).
+// - Latency histograms are RAM only (per boot). Bucket k counts commands that
+//   took < 2^k µs (last bucket: everything longer).
+// - Latency comes from CycleCounter (DWT), enabled by Board.initBoard().
+//
+// Dependencies:
+// - EEFC.swift: EEFCCommand, EEFC1 async slot + command helpers
+// - ATSAM3X8E.swift: NVM geometry (META/LOG/KV pages)
+// - MMIO.swift: bm_read32, crc32Update
+// - ByteStream.swift: dump() (SerialUART, USBSerial)
+//
+
+public enum EEFCTelemetry {
+
+    // MARK: - Public types
+
+    public struct Counters {
+        public var erases: U32 = 0            // page erases (EWP), all pages
+        public var bankErases: U32 = 0        // EA commands
+        public var untrackedErases: U32 = 0   // EWP outside the reserved pages
+        public var timeouts: U32 = 0
+        public var commandErrors: U32 = 0
+        public var lockErrors: U32 = 0
+        public var persists: U32 = 0
+    }
+
+    public struct Latency {
+        public let count: U32
+        public let minUs: U32
+        public let maxUs: U32
+        public let totalUs: U32
+
+        public var averageUs: U32 { count == 0 ? 0 : totalUs / count }
+    }
+
+    // MARK: - Geometry
+
+    public static let histogramBuckets = 16
+
+    /// Tracked pages: META page .. last KV page (bank-1 page indices).
+    public static let firstTrackedIndex: U32 = ATSAM3X8E.NVM.META_BANK1_PAGE_INDEX
+    public static let trackedPageCount: Int = Int(
+        ATSAM3X8E.NVM.BANK1_PAGE_INDEX + ATSAM3X8E.NVM.PAGE_COUNT - ATSAM3X8E.NVM.META_BANK1_PAGE_INDEX
+    )
+
+    private static let magic: U32 = 0x4C45_5446 // "FTEL"
+    private static let version: U32 = 2
+    private static let counterWords = 7
+    private static let headerWords = 5
+    private static let legacyVersion: U32 = 1
+    private static let legacyHeaderWords = 4
+    private static let slotCount: U32 = ATSAM3X8E.NVM.META_PAGE_COUNT
+
+    private static let commandCount = 3
+    // Per command: count, min, max, total, buckets...
+    private static let latencyStride = 4 + histogramBuckets
+
+    // MARK: - State (RAM)
+
+    private static var state = Counters()
+    private static var eraseTable: [U32] = []
+    private static var latencyTable: [U32] = []
+    private static var cyclesPerUs: U32 = 84
+    private static var dirty = false
+    private static var started = false
+    private static let page = UnsafeMutablePointer<UInt8>.allocate(capacity: Int(ATSAM3X8E.NVM.PAGE_SIZE))
+
+    // MARK: - Setup
+
+    /// Load persisted counters (added to anything counted before begin()).
+    /// Newest valid META copy wins; none valid starts from zero. Later calls only
+    /// update cpuHz: the page is loaded once per boot, never added twice.
+    public static func begin(cpuHz: U32) {
+        cyclesPerUs = cpuHz / 1_000_000 == 0 ? 1 : cpuHz / 1_000_000
+        if started { return }
+        started = true
+        ensureStorage()
+
+        _ = eefc1WaitNotInFlight()
+        guard let newest = newestSlot() else { return }
+        let base = slotAddr(newest.slot)
+        let h = bm_read32(base + 4) == legacyVersion ? legacyHeaderWords : headerWords
+        let count = Int(bm_read32(base + word(h - 2)))
+        let firstIndex = bm_read32(base + word(h - 1))
+
+        var c = Counters()
+        c.erases          = bm_read32(base + word(h + 0))
+        c.bankErases      = bm_read32(base + word(h + 1))
+        c.untrackedErases = bm_read32(base + word(h + 2))
+        c.timeouts        = bm_read32(base + word(h + 3))
+        c.commandErrors   = bm_read32(base + word(h + 4))
+        c.lockErrors      = bm_read32(base + word(h + 5))
+        c.persists        = bm_read32(base + word(h + 6))
+
+        state.erases          &+= c.erases
+        state.bankErases      &+= c.bankErases
+        state.untrackedErases &+= c.untrackedErases
+        state.timeouts        &+= c.timeouts
+        state.commandErrors   &+= c.commandErrors
+        state.lockErrors      &+= c.lockErrors
+        state.persists        &+= c.persists
+
+        // By page index: a v1 page tracked one META page less.
+        let first = h + counterWords
+        var i = 0
+        while i < count {
+            if let t = trackedSlot(firstIndex + U32(i)) {
+                eraseTable[t] &+= bm_read32(base + word(first + i))
+            }
+            i += 1
+        }
+    }
+
+    // MARK: - Read API
+
+    public static var counters: Counters { state }
+
+    /// True when RAM counters changed since the last persist().
+    public static var isDirty: Bool { dirty }
+
+    /// Erase count of a reserved page (bank-1 page index), nil if not tracked.
+    public static func pageErases(bank1PageIndex: U32) -> U32? {
+        guard let i = trackedSlot(bank1PageIndex) else { return nil }
+        ensureStorage()
+        return eraseTable[i]
+    }
+
+    /// Most-worn tracked page.
+    public static func maxPageErases() -> (bank1PageIndex: U32, erases: U32) {
+        ensureStorage()
+        var best = 0
+        var i = 1
+        while i < trackedPageCount {
+            if eraseTable[i] > eraseTable[best] { best = i }
+            i += 1
+        }
+        return (firstTrackedIndex + U32(best), eraseTable[best])
+    }
+
+    public static func latency(_ command: EEFCCommand) -> Latency {
+        ensureStorage()
+        let o = command.rawValue * latencyStride
+        return Latency(count: latencyTable[o], minUs: latencyTable[o + 1], maxUs: latencyTable[o + 2], totalUs: latencyTable[o + 3])
+    }
+
+    /// Commands that took < 2^bucket µs (and >= 2^(bucket-1) µs).
+    public static func histogram(_ command: EEFCCommand, bucket: Int) -> U32 {
+        if bucket < 0 || bucket >= histogramBuckets { return 0 }
+        ensureStorage()
+        return latencyTable[command.rawValue * latencyStride + 4 + bucket]
+    }
+
+    public static func resetLatency() {
+        ensureStorage()
+        var i = 0
+        while i < latencyTable.count {
+            latencyTable[i] = 0
+            i += 1
+        }
+    }
+
+    // MARK: - Hooks (EEFC.swift)
+
+    static func noteIssued(_ command: EEFCCommand, bank1PageIndex: U32) {
+        ensureStorage()
+        switch command {
+        case .ewp:
+            state.erases &+= 1
+            if let i = trackedSlot(bank1PageIndex) {
+                eraseTable[i] &+= 1
+            } else {
+                state.untrackedErases &+= 1
+            }
+        case .ea:
+            state.bankErases &+= 1
+            var i = 0
+            while i < trackedPageCount {
+                eraseTable[i] &+= 1
+                i += 1
+            }
+        case .wp:
+            return
+        }
+        dirty = true
+    }
+
+    static func noteCompleted(_ command: EEFCCommand, cycles: U32, fsr: U32) {
+        ensureStorage()
+        if (fsr & ATSAM3X8E.EEFC.FSR_FCMDE) != 0 { state.commandErrors &+= 1; dirty = true }
+        if (fsr & ATSAM3X8E.EEFC.FSR_FLOCKE) != 0 { state.lockErrors &+= 1; dirty = true }
+
+        let us = cycles / cyclesPerUs
+        let o = command.rawValue * latencyStride
+        if latencyTable[o] == 0 || us < latencyTable[o + 1] { latencyTable[o + 1] = us }
+        if us > latencyTable[o + 2] { latencyTable[o + 2] = us }
+        latencyTable[o] &+= 1
+        latencyTable[o + 3] &+= us
+
+        // Bucket = bit width of µs (0 -> 0, 1 -> 1, 2..3 -> 2, ...)
+        var b = 32 - us.leadingZeroBitCount
+        if b >= histogramBuckets { b = histogramBuckets - 1 }
+        latencyTable[o + 4 + b] &+= 1
+    }
+
+    static func noteTimeout(_ command: EEFCCommand) {
+        state.timeouts &+= 1
+        dirty = true
+    }
+
+    // MARK: - Persist
+
+    /// Write the counters to the older META page (one EWP, synchronous).
+    /// Returns .busy if another EEFC1 command is in flight.
+    @discardableResult
+    public static func persist() -> EEFCError? {
+        if !dirty { return nil }
+        ensureStorage()
+        if !eefc1Claim() { return .busy }
+
+        let newest = newestSlot()
+        let slot = newest.map { ($0.slot + 1) % slotCount } ?? 0
+        let seq = newest.map { $0.sequence &+ 1 } ?? 1
+
+        // The image already counts this erase (and this persist).
+        let target = Int(ATSAM3X8E.NVM.META_BANK1_PAGE_INDEX + slot - firstTrackedIndex)
+        putWord(0, magic)
+        putWord(1, version)
+        putWord(2, seq)
+        putWord(3, U32(trackedPageCount))
+        putWord(4, firstTrackedIndex)
+        putWord(headerWords + 0, state.erases &+ 1)
+        putWord(headerWords + 1, state.bankErases)
+        putWord(headerWords + 2, state.untrackedErases)
+        putWord(headerWords + 3, state.timeouts)
+        putWord(headerWords + 4, state.commandErrors)
+        putWord(headerWords + 5, state.lockErrors)
+        putWord(headerWords + 6, state.persists &+ 1)
+        let first = headerWords + counterWords
+        var i = 0
+        while i < trackedPageCount {
+            putWord(first + i, i == target ? eraseTable[i] &+ 1 : eraseTable[i])
+            i += 1
+        }
+
+        let words = first + trackedPageCount
+        var crc: U32 = 0xFFFF_FFFF
+        i = 1
+        while i < words {
+            crc = crc32Update(crc, word: pageWord(i))
+            i += 1
+        }
+        putWord(words, ~crc)
+        var b = word(words + 1)
+        while b < ATSAM3X8E.NVM.PAGE_SIZE {
+            page[Int(b)] = 0xFF
+            b += 1
+        }
+
+        let ok = eefc1StartEWP(
+            addr: slotAddr(slot),
+            pageIndex: ATSAM3X8E.NVM.META_BANK1_PAGE_INDEX + slot,
+            src: UnsafePointer(page), count: Int(ATSAM3X8E.NVM.PAGE_SIZE)
+        )
+        if !ok { eefc1Release(); return .timeout }
+
+        let fsr = eefc1WaitCommand()
+        eefc1Release()
+        guard let fsr else { return .timeout }
+        if (fsr & ATSAM3X8E.EEFC.FSR_FCMDE) != 0 { return .commandError }
+        if (fsr & ATSAM3X8E.EEFC.FSR_FLOCKE) != 0 { return .lockError }
+        if readSlot(slot) != seq { return .verifyFailed }
+
+        state.persists &+= 1
+        dirty = false
+        return nil
+    }
+
+    // MARK: - Dump (shell / telemetry)
+
+    /// One `key=value` per line; histograms as `lat_<cmd>_lt<2^k>us=<n>` (non-zero only).
+    public static func dump<S: ByteStream>(_ serial: S) {
+        let c = state
+        line(serial, "erases", c.erases)
+        line(serial, "bank_erases", c.bankErases)
+        line(serial, "untracked_erases", c.untrackedErases)
+        line(serial, "timeouts", c.timeouts)
+        line(serial, "command_errors", c.commandErrors)
+        line(serial, "lock_errors", c.lockErrors)
+        line(serial, "persists", c.persists)
+
+        let worst = maxPageErases()
+        line(serial, "max_page_index", worst.bank1PageIndex)
+        line(serial, "max_page_erases", worst.erases)
+
+        var i = 0
+        while i < trackedPageCount {
+            serial.writeString("page_")
+            serial.writeString(_etel_decU32(firstTrackedIndex + U32(i)))
+            line(serial, "_erases", eraseTable[i])
+            i += 1
+        }
+
+        dumpLatency(serial, .ewp, "ewp")
+        dumpLatency(serial, .ea, "ea")
+        dumpLatency(serial, .wp, "wp")
+    }
+
+    // MARK: - Internals
+
+    private static func dumpLatency<S: ByteStream>(_ serial: S, _ command: EEFCCommand, _ name: String) {
+        let l = latency(command)
+        serial.writeString("lat_"); serial.writeString(name)
+        line(serial, "_count", l.count)
+        if l.count == 0 { return }
+        serial.writeString("lat_"); serial.writeString(name)
+        line(serial, "_min_us", l.minUs)
+        serial.writeString("lat_"); serial.writeString(name)
+        line(serial, "_avg_us", l.averageUs)
+        serial.writeString("lat_"); serial.writeString(name)
+        line(serial, "_max_us", l.maxUs)
+
+        var b = 0
+        while b < histogramBuckets {
+            let n = histogram(command, bucket: b)
+            if n != 0 {
+                serial.writeString("lat_"); serial.writeString(name)
+                serial.writeString(b == histogramBuckets - 1 ? "_ge" : "_lt")
+                let edge = b == histogramBuckets - 1 ? U32(1) << U32(b - 1) : U32(1) << U32(b)
+                serial.writeString(_etel_decU32(edge))
+                line(serial, "us", n)
+            }
+            b += 1
+        }
+    }
+
+    private static func line<S: ByteStream>(_ serial: S, _ key: String, _ value: U32) {
+        serial.writeString(key)
+        serial.writeString("=")
+        serial.writeString(_etel_decU32(value))
+        serial.writeString("\r\n")
+    }
+
+    private static func ensureStorage() {
+        if eraseTable.isEmpty {
+            eraseTable.reserveCapacity(trackedPageCount)
+            while eraseTable.count < trackedPageCount { eraseTable.append(0) }
+        }
+        if latencyTable.isEmpty {
+            let n = commandCount * latencyStride
+            latencyTable.reserveCapacity(n)
+            while latencyTable.count < n { latencyTable.append(0) }
+        }
+    }
+
+    @inline(__always)
+    private static func trackedSlot(_ bank1PageIndex: U32) -> Int? {
+        if bank1PageIndex < firstTrackedIndex { return nil }
+        let i = Int(bank1PageIndex - firstTrackedIndex)
+        return i < trackedPageCount ? i : nil
+    }
+
+    @inline(__always)
+    private static func word(_ i: Int) -> U32 { U32(i) * 4 }
+
+    @inline(__always)
+    private static func slotAddr(_ slot: U32) -> U32 {
+        ATSAM3X8E.NVM.META_PAGE_ADDR + slot * ATSAM3X8E.NVM.PAGE_SIZE
+    }
+
+    @inline(__always)
+    private static func putWord(_ i: Int, _ w: U32) {
+        page[4 * i + 0] = UInt8(truncatingIfNeeded: w)
+        page[4 * i + 1] = UInt8(truncatingIfNeeded: w >> 8)
+        page[4 * i + 2] = UInt8(truncatingIfNeeded: w >> 16)
+        page[4 * i + 3] = UInt8(truncatingIfNeeded: w >> 24)
+    }
+
+    @inline(__always)
+    private static func pageWord(_ i: Int) -> U32 {
+        U32(page[4 * i]) | (U32(page[4 * i + 1]) << 8) | (U32(page[4 * i + 2]) << 16) | (U32(page[4 * i + 3]) << 24)
+    }
+
+    /// Sequence of a valid META copy (v1: 0), nil if blank/torn/corrupt.
+    private static func readSlot(_ slot: U32) -> U32? {
+        let base = slotAddr(slot)
+        if bm_read32(base) != magic { return nil }
+        let v = bm_read32(base + 4)
+        let h: Int
+        if v == version {
+            h = headerWords
+        } else if v == legacyVersion {
+            h = legacyHeaderWords
+        } else {
+            return nil
+        }
+
+        let count = bm_read32(base + word(h - 2))
+        if count > ATSAM3X8E.NVM.PAGE_SIZE / 4 - U32(h + counterWords + 1) { return nil }
+        let words = h + counterWords + Int(count)
+        var crc: U32 = 0xFFFF_FFFF
+        var i = 1
+        while i < words {
+            crc = crc32Update(crc, word: bm_read32(base + word(i)))
+            i += 1
+        }
+        if ~crc != bm_read32(base + word(words)) { return nil }
+        return v == version ? bm_read32(base + 8) : 0
+    }
+
+    /// Newest valid copy (EEFCStorage's rule: serial-number sequence order).
+    private static func newestSlot() -> (slot: U32, sequence: U32)? {
+        switch (readSlot(0), readSlot(1)) {
+        case let (a?, b?):
+            return EEFCStorage.isNewer(b, than: a) ? (1, b) : (0, a)
+        case let (a?, nil):
+            return (0, a)
+        case let (nil, b?):
+            return (1, b)
+        case (nil, nil):
+            return nil
+        }
+    }
+}
+
+// MARK: - Local helpers (file-scoped, unique names)
+
+private func _etel_decU32(_ value: U32) -> String {
+    var v = value
+    var buf = [UInt8](repeating: 0, count: 10)
+    var i = 0
+
+    repeat {
+        buf[i] = UInt8(v % 10) + 48 // '0'
+        v /= 10
+        i += 1
+    } while v > 0
+
+    var s = ""
+    while i > 0 {
+        i -= 1
+        s.append(Character(UnicodeScalar(buf[i])))
+    }
+    return s
+}
@@ -0,0 +1,502 @@
+//
+// EMAC.swift — 10/100 Ethernet MAC (RMII) with descriptor rings in .eth_dma.
+//
+// Goals:
+// - UDP telemetry at tens of Mbit/s: the MAC's DMA moves frames between
+//   the wire and RAM, the CPU only builds headers.
+// - RX and TX descriptor rings, RX buffers and the transmit packet pool all
+//   live in one dedicated SRAM section (.eth_dma, see support.c and
+//   arm/sections.ld): outside .bss and the heap, laid out once at begin().
+//   Its size comes from `make ETH_DMA_SIZE=...` (default 0: images without
+//   Ethernet keep the RAM, and begin() throws .areaTooSmall).
+// - Zero-copy RX: the MAC writes frames into consecutive 128-byte ring
+//   buffers, so a frame that does not wrap the ring is already contiguous
+//   and receive() hands out a pointer into the ring. Only a frame that
+//   wraps is copied once into a pool buffer (counted as rxBounces).
+// - Zero-copy TX: allocate() returns a pool buffer, the frame is built in
+//   place and transmit() points a TX descriptor at it; poll() returns the
+//   buffer to the pool once the MAC marks the descriptor used.
+// - PHY over MDIO: address scan, reset, autonegotiation, speed/duplex
+//   applied to the MAC on refreshLink().
+// - Implements EthernetDevice, so NetStack (ARP/IPv4/UDP) runs on it or on
+//   a FramePipe with no network.
+//
+// Notes:
+// - The Due has no PHY: wire an RMII PHY board (LAN8720, KSZ8081, DP83848
+//   in RMII mode) to PB0..PB9 (EREFCK, ETXEN, ETX0-1, ECRSDV, ERX0-1,
+//   ERXER, EMDC, EMDIO); the PHY supplies the 50 MHz reference clock.
+// - Polled: no EMAC interrupt. Call poll() (or NetStack.poll()) from the
+//   loop often enough for the RX ring (32 x 128 B = ~2 full frames at a
+//   time plus small ones; ~330 us of back-to-back 100 Mbit/s traffic).
+// - Area layout (ETH_DMA_SIZE=17408, 17 KiB):
+//     RX descriptors  32 x 8      TX descriptors  8 x 8
+//     RX buffers      32 x 128    pool            8 x 1536 (what is left)
+// - Descriptors are read/written with read32/write32 (the MAC changes them
+//   behind the compiler's back).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, waitUntil, bm_eth_dma_area/size
+// - EthernetDevice.swift: EthernetDevice, PacketPool, MACAddress
+// - ATSAM3X8E.swift: EMAC registers/descriptor bits, PMC, PIO
+//
+
+public final class EMAC: EthernetDevice {
+
+    // MARK: - Public types
+
+    public struct Link: Equatable {
+        public var up: Bool = false
+        public var mbps: U32 = 0         // 10 or 100
+        public var fullDuplex: Bool = false
+    }
+
+    public struct Stats {
+        public var rxFrames: U32 = 0
+        public var rxBytes: U32 = 0
+        public var rxBounces: U32 = 0        // frame wrapped the ring: copied once
+        public var rxDropped: U32 = 0        // wrapped frame, no pool buffer for it
+        public var rxFragments: U32 = 0      // partial frames discarded
+        public var rxNoBuffer: U32 = 0       // MAC found the ring full (BNA)
+        public var rxOverruns: U32 = 0       // MAC FIFO overrun (ROV)
+        public var rxCRCErrors: U32 = 0      // FCSE
+        public var txFrames: U32 = 0
+        public var txBytes: U32 = 0
+        public var txRingFull: U32 = 0
+        public var txUnderruns: U32 = 0
+        public var txErrors: U32 = 0         // retry limit / AHB error (TX ring reset)
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case areaTooSmall
+        case noPHY
+        case mdioTimeout
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .areaTooSmall: return "area_too_small"
+            case .noPHY: return "no_phy"
+            case .mdioTimeout: return "mdio_timeout"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .areaTooSmall: return "The .eth_dma area cannot hold the rings and a pool (build with ETH_DMA_SIZE=17408)."
+            case .noPHY: return "No PHY answered on MDIO (check EMDC/EMDIO and power)."
+            case .mdioTimeout: return "MDIO transfer did not finish."
+            }
+        }
+    }
+
+    // MARK: - Constants
+
+    public static let rxBuffers = 32
+    public static let txDescriptors = 8
+
+    private static let rxBufferSize = Int(ATSAM3X8E.EMAC.RX_BUFFER_SIZE)
+    private static let mdioTimeoutSpins: U32 = 100_000
+    private static let minFrame = 60                    // without FCS; shorter frames are padded
+    private static let bounceFlag: U32 = 0x8000_0000
+
+    // PHY registers / bits (IEEE 802.3 clause 22)
+    private static let phyBMCR: U32 = 0
+    private static let phyBMSR: U32 = 1
+    private static let phyID1: U32 = 2
+    private static let phyANAR: U32 = 4
+    private static let phyANLPAR: U32 = 5
+    private static let bmcrReset: U32 = 1 << 15
+    private static let bmcrAutoNeg: U32 = 1 << 12
+    private static let bmcrRestartAutoNeg: U32 = 1 << 9
+    private static let bmsrLink: U32 = 1 << 2
+    private static let bmsrAutoNegDone: U32 = 1 << 5
+
+    // MARK: - State
+
+    public let macAddress: MACAddress
+    public private(set) var link = Link()
+    public private(set) var stats = Stats()
+    public private(set) var phyAddress: U32 = 0xFF
+    public private(set) var pool: PacketPool? = nil
+
+    private let mckHz: U32
+    private var clockHeld = false
+    private var rxDesc: U32 = 0                 // addresses in the .eth_dma area
+    private var txDesc: U32 = 0
+    private var rxBuf: U32 = 0
+    private var rxIndex = 0
+    private var txHead = 0
+    private var txTail = 0
+    private var txInFlight = 0
+    private let txSlot: UnsafeMutablePointer<Int32>
+
+    // MARK: - Init
+
+    public init(mckHz: U32, mac: MACAddress) {
+        self.mckHz = mckHz
+        self.macAddress = mac
+        self.txSlot = UnsafeMutablePointer<Int32>.allocate(capacity: Self.txDescriptors)
+    }
+
+    // MARK: - Setup
+
+    /// Clock, pins, rings, MAC address, PHY reset + autonegotiation. Waits up
+    /// to ~`linkWaitMs` for a link; a missing link is not an error (see
+    /// refreshLink()), a missing PHY is.
+    @discardableResult
+    public func begin(linkWaitMs: U32 = 3000) throws(EMAC.Error) -> Link {
+        // No .eth_dma area (ETH_DMA_SIZE=0): fail before touching clock or pins.
+        try layoutArea()
+        if !clockHeld {
+            PeripheralClock.acquire(ATSAM3X8E.ID.EMAC)
+            clockHeld = true
+        }
+        write32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.EMAC.PIOB_MASK)
+        clearBits32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.EMAC.PIOB_MASK)
+
+        write32(ATSAM3X8E.EMAC.NCR, 0)
+        write32(ATSAM3X8E.EMAC.IDR, 0xFFFF_FFFF)
+        write32(ATSAM3X8E.EMAC.NCR, ATSAM3X8E.EMAC.NCR_CLRSTAT)
+        write32(ATSAM3X8E.EMAC.RSR, ATSAM3X8E.EMAC.RSR_BNA | ATSAM3X8E.EMAC.RSR_REC | ATSAM3X8E.EMAC.RSR_OVR)
+        write32(ATSAM3X8E.EMAC.TSR, 0x7F)
+        _ = read32(ATSAM3X8E.EMAC.ISR)
+
+        // MDC = MCK / 64 (1.3 MHz at 84 MHz, limit 2.5 MHz); FCS stripped on RX.
+        write32(ATSAM3X8E.EMAC.NCFGR, ATSAM3X8E.EMAC.NCFGR_CLK_64 | ATSAM3X8E.EMAC.NCFGR_DRFCS)
+        write32(ATSAM3X8E.EMAC.USRIO, ATSAM3X8E.EMAC.USRIO_CLKEN)       // RMII
+
+        initRings()
+
+        write32(ATSAM3X8E.EMAC.HRB, 0)
+        write32(ATSAM3X8E.EMAC.HRT, 0)
+        write32(
+            ATSAM3X8E.EMAC.SA1B,
+            U32(macAddress[0]) | (U32(macAddress[1]) << 8) | (U32(macAddress[2]) << 16) | (U32(macAddress[3]) << 24)
+        )
+        write32(ATSAM3X8E.EMAC.SA1T, U32(macAddress[4]) | (U32(macAddress[5]) << 8))
+
+        write32(ATSAM3X8E.EMAC.NCR, ATSAM3X8E.EMAC.NCR_MPE)
+        try findPHY()
+        try mdioWrite(Self.phyBMCR, Self.bmcrReset)
+        _ = waitUntil(Self.mdioTimeoutSpins * 10) {
+            ((try? mdioRead(Self.phyBMCR)) ?? Self.bmcrReset) & Self.bmcrReset == 0
+        }
+        try mdioWrite(Self.phyBMCR, Self.bmcrAutoNeg | Self.bmcrRestartAutoNeg)
+
+        write32(ATSAM3X8E.EMAC.NCR, ATSAM3X8E.EMAC.NCR_MPE | ATSAM3X8E.EMAC.NCR_RE | ATSAM3X8E.EMAC.NCR_TE)
+
+        // ~1 ms per step: one MDIO read + spin.
+        var waited: U32 = 0
+        while waited < linkWaitMs {
+            if let bmsr = try? mdioRead(Self.phyBMSR),
+               (bmsr & (Self.bmsrLink | Self.bmsrAutoNegDone)) == (Self.bmsrLink | Self.bmsrAutoNegDone) {
+                break
+            }
+            spin(mckHz / 4000)
+            waited += 1
+        }
+        return refreshLink()
+    }
+
+    /// Read link state from the PHY and apply speed/duplex to the MAC.
+    /// Call about once a second (two MDIO reads, ~100 us).
+    @discardableResult
+    public func refreshLink() -> Link {
+        _ = try? mdioRead(Self.phyBMSR)                 // link bit latches low: read twice
+        let bmsr = (try? mdioRead(Self.phyBMSR)) ?? 0
+        var l = Link()
+        l.up = (bmsr & Self.bmsrLink) != 0
+        if l.up {
+            let common = ((try? mdioRead(Self.phyANAR)) ?? 0) & ((try? mdioRead(Self.phyANLPAR)) ?? 0)
+            if (common & 0x0100) != 0 {
+                l.mbps = 100; l.fullDuplex = true
+            } else if (common & 0x0080) != 0 {
+                l.mbps = 100
+            } else if (common & 0x0040) != 0 {
+                l.mbps = 10; l.fullDuplex = true
+            } else {
+                l.mbps = 10
+            }
+        }
+        if l != link && l.up {
+            var cfg = read32(ATSAM3X8E.EMAC.NCFGR) & ~(ATSAM3X8E.EMAC.NCFGR_SPD | ATSAM3X8E.EMAC.NCFGR_FD)
+            if l.mbps == 100 { cfg |= ATSAM3X8E.EMAC.NCFGR_SPD }
+            if l.fullDuplex { cfg |= ATSAM3X8E.EMAC.NCFGR_FD }
+            write32(ATSAM3X8E.EMAC.NCFGR, cfg)
+        }
+        link = l
+        return l
+    }
+
+    public var linkUp: Bool { link.up }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - EthernetDevice: transmit
+
+    public func allocate() -> PacketBuffer? {
+        if let b = pool?.allocate() { return b }
+        poll()                                  // sent frames may be waiting to be reclaimed
+        return pool?.allocate()
+    }
+
+    public func free(_ buffer: PacketBuffer) {
+        pool?.free(buffer.slot)
+    }
+
+    public func transmit(_ buffer: PacketBuffer, length: Int) -> Bool {
+        if length <= 0 || length > buffer.capacity { return false }
+        if txInFlight == Self.txDescriptors { reclaimTx() }
+        if txInFlight == Self.txDescriptors {
+            stats.txRingFull &+= 1
+            return false
+        }
+
+        var len = length
+        if len < Self.minFrame {
+            (buffer.data + len).initialize(repeating: 0, count: Self.minFrame - len)
+            len = Self.minFrame
+        }
+
+        let d = txDesc + U32(txHead) * 8
+        txSlot[txHead] = Int32(buffer.slot)
+        write32(d, U32(UInt(bitPattern: buffer.data)))
+        // Clearing USED hands the descriptor to the MAC.
+        write32(
+            d + 4,
+            U32(len) | ATSAM3X8E.EMAC.TXS_LAST |
+                (txHead == Self.txDescriptors - 1 ? ATSAM3X8E.EMAC.TXS_WRAP : 0)
+        )
+        txHead = (txHead + 1) % Self.txDescriptors
+        txInFlight += 1
+        setBits32(ATSAM3X8E.EMAC.NCR, ATSAM3X8E.EMAC.NCR_TSTART)
+
+        stats.txFrames &+= 1
+        stats.txBytes &+= U32(len)
+        return true
+    }
+
+    // MARK: - EthernetDevice: receive
+
+    public func receive() -> ReceivedFrame? {
+        var scanned = 0
+        while scanned < Self.rxBuffers {
+            let first = rxIndex
+            if !owned(first) { return nil }
+            if (rxStatus(first) & ATSAM3X8E.EMAC.RXS_SOF) == 0 {
+                // Tail of a frame whose start was lost.
+                giveBack(first, 1)
+                rxIndex = (first + 1) % Self.rxBuffers
+                stats.rxFragments &+= 1
+                scanned += 1
+                continue
+            }
+
+            // Walk to EOF; stop if the MAC is still writing the frame.
+            var n = 1
+            var last = first
+            var restart = false
+            while (rxStatus(last) & ATSAM3X8E.EMAC.RXS_EOF) == 0 {
+                let next = (last + 1) % Self.rxBuffers
+                if n == Self.rxBuffers || !owned(next) { return nil }
+                if (rxStatus(next) & ATSAM3X8E.EMAC.RXS_SOF) != 0 {
+                    // A new frame started before EOF: drop the partial one.
+                    giveBack(first, n)
+                    rxIndex = next
+                    stats.rxFragments &+= 1
+                    restart = true
+                    break
+                }
+                last = next
+                n += 1
+            }
+            if restart {
+                scanned += n
+                continue
+            }
+
+            let length = Int(rxStatus(last) & ATSAM3X8E.EMAC.RXS_LEN_MASK)
+            rxIndex = (last + 1) % Self.rxBuffers
+            stats.rxFrames &+= 1
+            stats.rxBytes &+= U32(length)
+
+            if first + n <= Self.rxBuffers {
+                let p = UnsafeMutablePointer<UInt8>(bitPattern: UInt(rxBuf + U32(first * Self.rxBufferSize)))!
+                return ReceivedFrame(data: p, length: length, token: U32(first) | (U32(n) << 8))
+            }
+
+            // Wrapped: copy into a pool buffer and give the ring back now.
+            guard let pool, let b = pool.allocate() else {
+                giveBack(first, n)
+                stats.rxDropped &+= 1
+                scanned += n
+                continue
+            }
+            let head = (Self.rxBuffers - first) * Self.rxBufferSize
+            let src = UnsafeMutablePointer<UInt8>(bitPattern: UInt(rxBuf))!
+            b.data.update(from: src + first * Self.rxBufferSize, count: min(head, length))
+            if length > head { (b.data + head).update(from: src, count: length - head) }
+            giveBack(first, n)
+            stats.rxBounces &+= 1
+            return ReceivedFrame(data: b.data, length: length, token: Self.bounceFlag | U32(b.slot))
+        }
+        return nil
+    }
+
+    public func release(_ frame: ReceivedFrame) {
+        if (frame.token & Self.bounceFlag) != 0 {
+            pool?.free(Int(frame.token & 0xFF))
+        } else {
+            giveBack(Int(frame.token & 0xFF), Int((frame.token >> 8) & 0xFF))
+        }
+    }
+
+    /// Reclaim sent buffers and fold the MAC's error counters into stats.
+    public func poll() {
+        reclaimTx()
+
+        let rsr = read32(ATSAM3X8E.EMAC.RSR)
+        if (rsr & ATSAM3X8E.EMAC.RSR_BNA) != 0 {
+            stats.rxNoBuffer &+= 1
+            write32(ATSAM3X8E.EMAC.RSR, ATSAM3X8E.EMAC.RSR_BNA)
+        }
+        if (rsr & ATSAM3X8E.EMAC.RSR_OVR) != 0 { write32(ATSAM3X8E.EMAC.RSR, ATSAM3X8E.EMAC.RSR_OVR) }
+        stats.rxOverruns &+= read32(ATSAM3X8E.EMAC.ROV)           // clear on read
+        stats.rxCRCErrors &+= read32(ATSAM3X8E.EMAC.FCSE)
+
+        let tsr = read32(ATSAM3X8E.EMAC.TSR)
+        if (tsr & ATSAM3X8E.EMAC.TSR_UND) != 0 {
+            stats.txUnderruns &+= 1
+            write32(ATSAM3X8E.EMAC.TSR, ATSAM3X8E.EMAC.TSR_UND)
+        }
+        if (tsr & (ATSAM3X8E.EMAC.TSR_RLES | ATSAM3X8E.EMAC.TSR_BEX)) != 0 {
+            stats.txErrors &+= 1
+            write32(ATSAM3X8E.EMAC.TSR, ATSAM3X8E.EMAC.TSR_RLES | ATSAM3X8E.EMAC.TSR_BEX)
+            resetTx()
+        }
+    }
+
+    // MARK: - Rings
+
+    private func layoutArea() throws(EMAC.Error) {
+        let area = bm_eth_dma_area()
+        let size = bm_eth_dma_size()
+        rxDesc = area
+        txDesc = rxDesc + U32(Self.rxBuffers * 8)
+        rxBuf = txDesc + U32(Self.txDescriptors * 8)
+        let poolBase = rxBuf + U32(Self.rxBuffers * Self.rxBufferSize)
+        let used = poolBase - area
+        if size < used + U32(PacketPool.bufferSize) { throw .areaTooSmall }
+        if pool == nil {
+            pool = PacketPool(
+                area: UnsafeMutablePointer<UInt8>(bitPattern: UInt(poolBase))!,
+                count: Int((size - used) / U32(PacketPool.bufferSize))
+            )
+        }
+    }
+
+    private func initRings() {
+        var i = 0
+        while i < Self.rxBuffers {
+            let addr = rxBuf + U32(i * Self.rxBufferSize)
+            write32(rxDesc + U32(i) * 8, addr | (i == Self.rxBuffers - 1 ? ATSAM3X8E.EMAC.RXD_WRAP : 0))
+            write32(rxDesc + U32(i) * 8 + 4, 0)
+            i += 1
+        }
+        rxIndex = 0
+        write32(ATSAM3X8E.EMAC.RBQP, rxDesc)
+        resetTx()
+    }
+
+    /// All TX descriptors back to software, in-flight buffers to the pool.
+    private func resetTx() {
+        clearBits32(ATSAM3X8E.EMAC.NCR, ATSAM3X8E.EMAC.NCR_TE)
+        var i = 0
+        while i < Self.txDescriptors {
+            if i < txInFlight { pool?.free(Int(txSlot[(txTail + i) % Self.txDescriptors])) }
+            write32(txDesc + U32(i) * 8, 0)
+            write32(
+                txDesc + U32(i) * 8 + 4,
+                ATSAM3X8E.EMAC.TXS_USED | (i == Self.txDescriptors - 1 ? ATSAM3X8E.EMAC.TXS_WRAP : 0)
+            )
+            i += 1
+        }
+        txHead = 0
+        txTail = 0
+        txInFlight = 0
+        write32(ATSAM3X8E.EMAC.TBQP, txDesc)
+        if (read32(ATSAM3X8E.EMAC.NCR) & ATSAM3X8E.EMAC.NCR_RE) != 0 {
+            setBits32(ATSAM3X8E.EMAC.NCR, ATSAM3X8E.EMAC.NCR_TE)
+        }
+    }
+
+    private func reclaimTx() {
+        while txInFlight > 0 {
+            let d = txDesc + U32(txTail) * 8
+            if (read32(d + 4) & ATSAM3X8E.EMAC.TXS_USED) == 0 { return }
+            pool?.free(Int(txSlot[txTail]))
+            txTail = (txTail + 1) % Self.txDescriptors
+            txInFlight -= 1
+        }
+    }
+
+    @inline(__always)
+    private func owned(_ i: Int) -> Bool {
+        (read32(rxDesc + U32(i) * 8) & ATSAM3X8E.EMAC.RXD_OWNERSHIP) != 0
+    }
+
+    @inline(__always)
+    private func rxStatus(_ i: Int) -> U32 {
+        read32(rxDesc + U32(i) * 8 + 4)
+    }
+
+    /// Clear OWNERSHIP on `count` descriptors from `first` (ring order).
+    private func giveBack(_ first: Int, _ count: Int) {
+        var i = first
+        var k = 0
+        while k < count {
+            let d = rxDesc + U32(i) * 8
+            write32(d, read32(d) & ~ATSAM3X8E.EMAC.RXD_OWNERSHIP)
+            i = (i + 1) % Self.rxBuffers
+            k += 1
+        }
+    }
+
+    // MARK: - MDIO
+
+    private func findPHY() throws(EMAC.Error) {
+        var a: U32 = 0
+        while a < 32 {
+            phyAddress = a
+            let id = try mdioRead(Self.phyID1)
+            if id != 0xFFFF && id != 0 { return }
+            a += 1
+        }
+        phyAddress = 0xFF
+        throw .noPHY
+    }
+
+    private func mdioRead(_ reg: U32) throws(EMAC.Error) -> U32 {
+        try mdio(ATSAM3X8E.EMAC.MAN_READ, reg, 0)
+        return read32(ATSAM3X8E.EMAC.MAN) & 0xFFFF
+    }
+
+    private func mdioWrite(_ reg: U32, _ value: U32) throws(EMAC.Error) {
+        try mdio(ATSAM3X8E.EMAC.MAN_WRITE, reg, value)
+    }
+
+    private func mdio(_ op: U32, _ reg: U32, _ value: U32) throws(EMAC.Error) {
+        write32(
+            ATSAM3X8E.EMAC.MAN,
+            ATSAM3X8E.EMAC.MAN_SOF | op | ATSAM3X8E.EMAC.MAN_CODE |
+                ((phyAddress & 0x1F) << ATSAM3X8E.EMAC.MAN_PHYA_SHIFT) |
+                ((reg & 0x1F) << ATSAM3X8E.EMAC.MAN_REGA_SHIFT) | (value & 0xFFFF)
+        )
+        if !waitBitSet32(ATSAM3X8E.EMAC.NSR, ATSAM3X8E.EMAC.NSR_IDLE, timeout: Self.mdioTimeoutSpins) {
+            throw .mdioTimeout
+        }
+    }
+}
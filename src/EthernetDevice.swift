@@ -0,0 +1,241 @@
+//
+// EthernetDevice.swift — Ethernet frame device interface, packet pool and a
+// RAM frame-pipe stand-in.
+//
+// Goals:
+// - One small protocol between the MAC driver (EMAC) and the protocol layer
+//   (NetStack), so ARP/IPv4/UDP runs unchanged on a RAM pipe with no network.
+// - Zero copy both ways: transmit buffers come from the device's pool and
+//   are built in place; received frames are handed out as a pointer into the
+//   device's receive memory until release().
+// - PacketPool: fixed-size buffers with a free bitmask, no heap use after
+//   init (the EMAC pool lives in the .eth_dma section).
+// - FramePipe: two connected ends (a, b) in RAM. A frame transmitted on one
+//   end is received on the other, buffer and all; `lossEvery` drops frames
+//   on purpose to exercise the loss counters.
+//
+// Notes:
+// - Frames exclude the FCS (the MAC appends and strips it).
+// - A ReceivedFrame must be released before the next receive() call.
+// - transmit() takes the buffer on success; on failure it stays with the
+//   caller (free() it or retry).
+// - Generic users (NetStack<Device>) are specialized by the compiler, so the
+//   protocol costs no dynamic dispatch.
+//
+// Dependencies:
+// - MMIO.swift: U32
+//
+
+public struct MACAddress: Equatable {
+    public let hi: U16          // bytes 0..1
+    public let lo: U32          // bytes 2..5
+
+    public init(_ b0: U8, _ b1: U8, _ b2: U8, _ b3: U8, _ b4: U8, _ b5: U8) {
+        hi = (U16(b0) << 8) | U16(b1)
+        lo = (U32(b2) << 24) | (U32(b3) << 16) | (U32(b4) << 8) | U32(b5)
+    }
+
+    /// Read 6 bytes in wire order.
+    public init(bytes p: UnsafePointer<UInt8>) {
+        self.init(p[0], p[1], p[2], p[3], p[4], p[5])
+    }
+
+    /// Write 6 bytes in wire order.
+    public func store(to p: UnsafeMutablePointer<UInt8>) {
+        p[0] = U8(hi >> 8)
+        p[1] = U8(hi & 0xFF)
+        p[2] = U8(lo >> 24)
+        p[3] = U8((lo >> 16) & 0xFF)
+        p[4] = U8((lo >> 8) & 0xFF)
+        p[5] = U8(lo & 0xFF)
+    }
+
+    public static let broadcast = MACAddress(0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF)
+
+    public var isBroadcast: Bool { self == .broadcast }
+
+    /// Byte `i` (0...5) in wire order.
+    public subscript(i: Int) -> U8 {
+        i < 2 ? U8((hi >> (8 * U16(1 - i))) & 0xFF) : U8((lo >> (8 * U32(5 - i))) & 0xFF)
+    }
+}
+
+/// A transmit buffer from a device pool: build the frame at `data`.
+public struct PacketBuffer {
+    public let data: UnsafeMutablePointer<UInt8>
+    public let capacity: Int
+    let slot: Int
+}
+
+/// A received frame, valid until the device's release().
+public struct ReceivedFrame {
+    public let data: UnsafeMutablePointer<UInt8>
+    public let length: Int
+    let token: U32              // device-private (descriptors or pool slot)
+}
+
+public protocol EthernetDevice: AnyObject {
+    var macAddress: MACAddress { get }
+    var linkUp: Bool { get }
+
+    /// Free transmit buffer, nil when the pool is exhausted.
+    func allocate() -> PacketBuffer?
+
+    /// Return a buffer that will not be transmitted.
+    func free(_ buffer: PacketBuffer)
+
+    /// Queue `length` bytes of `buffer`; the device frees it when sent.
+    func transmit(_ buffer: PacketBuffer, length: Int) -> Bool
+
+    /// Next received frame (nil when none is complete).
+    func receive() -> ReceivedFrame?
+
+    /// Hand the frame's memory back to the device.
+    func release(_ frame: ReceivedFrame)
+
+    /// Housekeeping: reclaim sent buffers, collect counters.
+    func poll()
+}
+
+// MARK: - Packet pool
+
+/// Up to 32 fixed-size buffers carved from one memory area.
+public final class PacketPool {
+
+    public static let bufferSize = 1536          // 1514-byte frame, 32-byte aligned
+
+    public let count: Int
+    private let base: UnsafeMutablePointer<UInt8>
+    private var freeMask: U32
+
+    /// `area` must hold count x bufferSize bytes and stay alive.
+    public init(area: UnsafeMutablePointer<UInt8>, count: Int) {
+        self.base = area
+        self.count = min(count, 32)
+        self.freeMask = self.count == 32 ? 0xFFFF_FFFF : (U32(1) << U32(self.count)) - 1
+    }
+
+    /// Heap-backed pool.
+    public convenience init(count: Int) {
+        let n = min(count, 32)
+        let p = UnsafeMutableRawPointer.allocate(byteCount: n * Self.bufferSize, alignment: 8)
+        self.init(area: p.assumingMemoryBound(to: UInt8.self), count: n)
+    }
+
+    public var available: Int { freeMask.nonzeroBitCount }
+
+    public func allocate() -> PacketBuffer? {
+        var slot = 0
+        let ok = withIRQLocked { () -> Bool in
+            if freeMask == 0 { return false }
+            slot = freeMask.trailingZeroBitCount
+            freeMask &= ~(U32(1) << U32(slot))
+            return true
+        }
+        if !ok { return nil }
+        return PacketBuffer(data: base + slot * Self.bufferSize, capacity: Self.bufferSize, slot: slot)
+    }
+
+    public func free(_ slot: Int) {
+        if slot < 0 || slot >= count { return }
+        withIRQLocked { freeMask |= U32(1) << U32(slot) }
+    }
+
+    public func buffer(_ slot: Int) -> UnsafeMutablePointer<UInt8> {
+        base + slot * Self.bufferSize
+    }
+}
+
+// MARK: - RAM frame pipe
+
+/// Two Ethernet ends joined in RAM: what `a` transmits, `b` receives and
+/// vice versa. Both ends share one pool; a frame moves without a copy.
+public final class FramePipe {
+
+    public let a: End
+    public let b: End
+    let pool: PacketPool
+
+    /// Drop every Nth transmitted frame (0 = never).
+    public var lossEvery: U32 = 0
+    public private(set) var lost: U32 = 0
+    private var sent: U32 = 0
+
+    public init(buffers: Int = 8, queueDepth: Int = 8) {
+        pool = PacketPool(count: buffers)
+        a = End(mac: MACAddress(0x02, 0, 0, 0, 0, 0x0A), depth: queueDepth)
+        b = End(mac: MACAddress(0x02, 0, 0, 0, 0, 0x0B), depth: queueDepth)
+        a.pipe = self
+        b.pipe = self
+    }
+
+    /// Frame delivery from `from` to the other end; false drops it.
+    func deliver(_ buffer: PacketBuffer, length: Int, from: End) -> Bool {
+        sent &+= 1
+        if lossEvery != 0 && sent % lossEvery == 0 {
+            lost &+= 1
+            pool.free(buffer.slot)
+            return true                 // the wire took it, the frame is gone
+        }
+        let to = from === a ? b : a
+        return to.enqueue(buffer.slot, length)
+    }
+
+    public final class End: EthernetDevice {
+
+        public let macAddress: MACAddress
+        public var linkUp = true
+        public private(set) var received: U32 = 0
+        public private(set) var overruns: U32 = 0
+
+        fileprivate var pipe: FramePipe? = nil
+        private let slots: UnsafeMutablePointer<Int32>
+        private let lengths: UnsafeMutablePointer<U16>
+        private let depth: U32
+        private var head: U32 = 0
+        private var tail: U32 = 0
+
+        init(mac: MACAddress, depth: Int) {
+            self.macAddress = mac
+            self.depth = U32(max(depth, 1))
+            self.slots = UnsafeMutablePointer<Int32>.allocate(capacity: Int(self.depth))
+            self.lengths = UnsafeMutablePointer<U16>.allocate(capacity: Int(self.depth))
+        }
+
+        public func allocate() -> PacketBuffer? { pipe?.pool.allocate() }
+
+        public func free(_ buffer: PacketBuffer) { pipe?.pool.free(buffer.slot) }
+
+        public func transmit(_ buffer: PacketBuffer, length: Int) -> Bool {
+            guard let pipe, linkUp, length > 0, length <= buffer.capacity else { return false }
+            return pipe.deliver(buffer, length: length, from: self)
+        }
+
+        public func receive() -> ReceivedFrame? {
+            guard let pipe, head != tail else { return nil }
+            let i = Int(tail % depth)
+            tail &+= 1
+            received &+= 1
+            let slot = Int(slots[i])
+            return ReceivedFrame(data: pipe.pool.buffer(slot), length: Int(lengths[i]), token: U32(slot))
+        }
+
+        public func release(_ frame: ReceivedFrame) {
+            pipe?.pool.free(Int(frame.token))
+        }
+
+        public func poll() {}
+
+        fileprivate func enqueue(_ slot: Int, _ length: Int) -> Bool {
+            if head &- tail >= depth {
+                overruns &+= 1
+                return false
+            }
+            let i = Int(head % depth)
+            slots[i] = Int32(slot)
+            lengths[i] = U16(length)
+            head &+= 1
+            return true
+        }
+    }
+}
@@ -0,0 +1,609 @@
+//
+// FATLog.swift — Append-only log into a preallocated, contiguous FAT32 file.
+//
+// Goals:
+// - Gigabytes of logging on an SD card, readable on any PC as a plain file.
+// - Minimal FAT32: mount (MBR or superfloppy), find one 8.3 file in the root
+//   directory, check its cluster chain is contiguous. After that the file is
+//   a flat block range: appends never touch the FAT or the directory, so a
+//   reset can't corrupt the file system.
+// - Double buffering: two RAM buffers of `bufferBlocks` blocks. A full buffer
+//   goes to the card with startWrite() (multi-block DMA) while appends fill
+//   the other one, so logging continues through the card's busy periods.
+// - Works on any BlockDevice: SDCard on the board, RAMDisk (or a host-side
+//   file-backed device) with a disk image from tools/sdimage.py.
+//
+// File layout (block 0 of the file = header, data from block 1):
+//   [magic "FLOG" u32][version u16][headerBlocks u16][used u32][~used u32][syncs u32][0 ...]
+//   `used` = data bytes; the directory entry keeps the full preallocated size.
+//
+// Notes:
+// - Create the file with tools/sdimage.py (zero-filled, contiguous). Files
+//   written by a PC are usually contiguous too, but not zero-filled.
+// - sync() writes the partial buffer and the header. On mount, data written
+//   after the last sync is recovered by scanning up to syncEveryBlocks +
+//   2 buffers past `used` for non-zero blocks (trailing zero bytes of the
+//   log are trimmed - log text/records rarely end in zeros).
+// - Auto sync (syncEveryBlocks) runs from poll() with the card idle and
+//   blocks for one header write (a few ms).
+// - append() never waits: with both buffers busy the record is dropped and
+//   counted (stats.overruns).
+// - Sizes are U32 bytes: a log holds at most 4 GiB - 1 (the FAT32 file limit).
+//
+// Dependencies:
+// - BlockDevice.swift: BlockDevice, BlockDeviceError, BlockWriteState
+// - MMIO.swift: U32, waitUntil
+//
+
+public final class FATLog<Device: BlockDevice> {
+
+    // MARK: - Public types
+
+    public struct Config {
+        public let name: StaticString       // 8.3 name in the root directory
+        public let bufferBlocks: U32        // per buffer (two buffers)
+        public let syncEveryBlocks: U32     // header update period (0 = sync() only)
+        public let maxRetries: U32          // failed writes retried, then skipped
+
+        public init(
+            name: StaticString = "LOG.BIN",
+            bufferBlocks: U32 = 16,
+            syncEveryBlocks: U32 = 2048,
+            maxRetries: U32 = 2
+        ) {
+            self.name = name
+            self.bufferBlocks = bufferBlocks == 0 ? 1 : bufferBlocks
+            self.syncEveryBlocks = syncEveryBlocks
+            self.maxRetries = maxRetries
+        }
+    }
+
+    /// Geometry found by mount().
+    public struct Volume {
+        public let partitionLBA: U32
+        public let sectorsPerCluster: U32
+        public let fatLBA: U32
+        public let dataLBA: U32
+        public let rootCluster: U32
+        public let clusterCount: U32
+        public let fileLBA: U32            // first block of the log file (header)
+        public let fileBlocks: U32         // preallocated blocks (header included)
+    }
+
+    public struct Stats {
+        public var appended: U32 = 0       // bytes accepted
+        public var dropped: U32 = 0        // bytes rejected (overrun / full)
+        public var overruns: U32 = 0       // appends rejected: both buffers busy
+        public var writes: U32 = 0         // buffers written to the device
+        public var blocksWritten: U32 = 0
+        public var writeErrors: U32 = 0
+        public var lostBlocks: U32 = 0     // skipped after maxRetries
+        public var syncs: U32 = 0
+        public var recovered: U32 = 0      // bytes found after `used` on mount
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case device(BlockDeviceError)
+        case noFileSystem
+        case unsupportedSectorSize
+        case badName
+        case fileNotFound
+        case notContiguous
+        case fileTooSmall
+        case notMounted
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .device(let e): return e.name
+            case .noFileSystem: return "no_file_system"
+            case .unsupportedSectorSize: return "unsupported_sector_size"
+            case .badName: return "bad_name"
+            case .fileNotFound: return "file_not_found"
+            case .notContiguous: return "not_contiguous"
+            case .fileTooSmall: return "file_too_small"
+            case .notMounted: return "not_mounted"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .device(let e): return e.message
+            case .noFileSystem: return "No FAT32 volume (MBR partition 0x0B/0x0C or boot sector)."
+            case .unsupportedSectorSize: return "Only 512-byte sectors are supported."
+            case .badName: return "Log name must be an 8.3 name (e.g. LOG.BIN)."
+            case .fileNotFound: return "Log file not found in the root directory."
+            case .notContiguous: return "Log file is fragmented (preallocate it with tools/sdimage.py)."
+            case .fileTooSmall: return "Log file must hold the header and one buffer."
+            case .notMounted: return "Log not mounted (call mount())."
+            }
+        }
+    }
+
+    // MARK: - Constants
+
+    public static var magic: U32 { 0x474F_4C46 }      // "FLOG"
+    public static var version: U32 { 1 }
+
+    private static var blockBytes: Int { 512 }
+    private static var endOfChain: U32 { 0x0FFF_FFF8 }
+    private static var syncTimeoutSpins: U32 { 50_000_000 }
+
+    // MARK: - State
+
+    public let device: Device
+    public let config: Config
+    public private(set) var volume: Volume? = nil
+    public private(set) var stats = Stats()
+
+    private let bufferBytes: Int
+    private let buffers: UnsafeMutableRawPointer      // 2 x bufferBytes, never freed
+    private let sector: UnsafeMutableRawPointer       // directory / header scratch
+    private let fatSector: UnsafeMutableRawPointer
+    private var fatCached: U32 = 0xFFFF_FFFF
+
+    private var dataLBA: U32 = 0          // file block 1
+    private var dataBlocks: U32 = 0
+
+    private var fill = 0                  // buffer being filled (0/1)
+    private var fillBlock: U32 = 0        // data block where the fill buffer starts
+    private var fillUsed = 0              // bytes in the fill buffer
+
+    private var inFlight = false
+    private var flightBuffer = 0
+    private var flightBlock: U32 = 0
+    private var flightBlocks: U32 = 0
+    private var retries: U32 = 0
+
+    private var durable: U32 = 0          // data bytes known to be on the device
+    private var recorded: U32 = 0         // `used` in the header
+
+    // MARK: - Init
+
+    public init(device: Device, config: Config = Config()) {
+        self.device = device
+        self.config = config
+        self.bufferBytes = Int(config.bufferBlocks) * Self.blockBytes
+        self.buffers = UnsafeMutableRawPointer.allocate(byteCount: 2 * bufferBytes, alignment: 4)
+        self.sector = UnsafeMutableRawPointer.allocate(byteCount: Self.blockBytes, alignment: 4)
+        self.fatSector = UnsafeMutableRawPointer.allocate(byteCount: Self.blockBytes, alignment: 4)
+    }
+
+    // MARK: - Mount
+
+    /// Find the volume and the log file, read its header and recover data
+    /// written after the last sync. Appends continue at the end.
+    public func mount() throws(Error) {
+        volume = nil
+        inFlight = false
+        fatCached = 0xFFFF_FFFF
+
+        guard let name = Self.shortName(config.name) else { throw .badName }
+        let v = try findVolume()
+        let (first, size) = try findFile(v, name)
+
+        // Walk the chain once: every next cluster must be the following one.
+        var c = first
+        var clusters: U32 = 1
+        while true {
+            let next = try nextCluster(v, c)
+            if next >= Self.endOfChain { break }
+            if next != c + 1 { throw .notContiguous }
+            c = next
+            clusters += 1
+            if clusters > v.clusterCount { throw .noFileSystem }
+        }
+
+        var blocks = clusters * v.sectorsPerCluster
+        let sizeBlocks = size / 512
+        if sizeBlocks < blocks { blocks = sizeBlocks }          // stay inside the file size
+        if blocks > 0x7F_FFFF { blocks = 0x7F_FFFF }            // 4 GiB - 512 bytes of data
+        if blocks < 1 + config.bufferBlocks { throw .fileTooSmall }
+
+        let fileLBA = v.dataLBA + (first - 2) * v.sectorsPerCluster
+        volume = Volume(
+            partitionLBA: v.partitionLBA,
+            sectorsPerCluster: v.sectorsPerCluster,
+            fatLBA: v.fatLBA,
+            dataLBA: v.dataLBA,
+            rootCluster: v.rootCluster,
+            clusterCount: v.clusterCount,
+            fileLBA: fileLBA,
+            fileBlocks: blocks
+        )
+        dataLBA = fileLBA + 1
+        dataBlocks = blocks - 1
+
+        // Header: `used`, or a fresh log when the block was never written.
+        try readBlock(fileLBA, sector)
+        var used: U32 = 0
+        if load32(sector, 0) == Self.magic && load32(sector, 12) == ~load32(sector, 8) {
+            used = min(load32(sector, 8), dataBlocks * 512)
+            stats.syncs = load32(sector, 16)
+        }
+        recorded = used
+
+        let end = try recover(from: used)
+        stats.recovered = end - used
+
+        // Resume: the fill buffer starts at the block holding the end.
+        fill = 0
+        fillBlock = end / 512
+        fillUsed = Int(end % 512)
+        if fillUsed > 0 { try readBlock(dataLBA + fillBlock, buffers) }
+        durable = end
+        if end != used { try writeHeader(end) }
+    }
+
+    // MARK: - Append
+
+    /// Copy `count` bytes into the log. False (and counted) if the log is
+    /// full or both buffers are busy. Never waits for the device.
+    @discardableResult
+    public func append(_ p: UnsafeRawPointer, count: Int) -> Bool {
+        if volume == nil || count <= 0 { return false }
+        poll()
+
+        let end = Int(fillBlock) * 512 + fillUsed
+        let otherFree = !inFlight && fillUsed < bufferBytes
+        let room = (otherFree ? bufferBytes : 0) + (bufferBytes - fillUsed)
+        if count > Int(dataBlocks) * 512 - end || count > room {
+            if count <= Int(dataBlocks) * 512 - end { stats.overruns &+= 1 }
+            stats.dropped &+= U32(count)
+            return false
+        }
+
+        var src = p
+        var left = count
+        while left > 0 {
+            let n = min(left, bufferBytes - fillUsed)
+            if n == 0 {                 // device refused the full buffer: keep what fit
+                stats.dropped &+= U32(left)
+                stats.appended &+= U32(count - left)
+                return false
+            }
+            (buffer(fill) + fillUsed).copyMemory(from: src, byteCount: n)
+            fillUsed += n
+            src += n
+            left -= n
+            if fillUsed == bufferBytes && !inFlight { launch() }
+        }
+        stats.appended &+= U32(count)
+        return true
+    }
+
+    @discardableResult
+    public func append(_ bytes: UnsafeRawBufferPointer) -> Bool {
+        guard let base = bytes.baseAddress else { return false }
+        return append(base, count: bytes.count)
+    }
+
+    @discardableResult
+    public func append(_ s: StaticString) -> Bool {
+        append(UnsafeRawPointer(s.utf8Start), count: s.utf8CodeUnitCount)
+    }
+
+    // MARK: - Progress / sync
+
+    /// Finish device writes, start the next full buffer, auto sync.
+    /// Call from the main loop (append() calls it too).
+    public func poll() {
+        if volume == nil { return }
+        if inFlight {
+            switch device.pollWrite() {
+            case .busy:
+                return
+            case .done, .idle:
+                inFlight = false
+                retries = 0
+                stats.writes &+= 1
+                stats.blocksWritten &+= flightBlocks
+                let end = (flightBlock + flightBlocks) * 512
+                if end > durable { durable = end }
+            case .failed:
+                stats.writeErrors &+= 1
+                retries += 1
+                if retries <= config.maxRetries && start(flightBuffer, flightBlock, flightBlocks) { return }
+                inFlight = false
+                retries = 0
+                stats.lostBlocks &+= flightBlocks
+            }
+        }
+
+        if fillUsed == bufferBytes { launch() }
+
+        if !inFlight && config.syncEveryBlocks > 0 && durable &- recorded >= config.syncEveryBlocks * 512 {
+            _ = try? writeHeader(durable)
+        }
+    }
+
+    /// Write everything buffered (the partial block too) and the header.
+    /// Blocks until the device is done.
+    @discardableResult
+    public func sync() -> Bool {
+        if volume == nil { return false }
+        if !drain() { return false }
+
+        if fillUsed > 0 {
+            let blocks = (fillUsed + Self.blockBytes - 1) / Self.blockBytes
+            let padded = blocks * Self.blockBytes
+            (buffer(fill) + fillUsed).initializeMemory(as: UInt8.self, repeating: 0, count: padded - fillUsed)
+            do throws(BlockDeviceError) {
+                try device.write(dataLBA + fillBlock, buffer(fill), blocks: U32(blocks))
+            } catch {
+                stats.writeErrors &+= 1
+                return false
+            }
+            stats.blocksWritten &+= U32(blocks)
+        }
+        durable = fillBlock * 512 + U32(fillUsed)
+        return (try? writeHeader(durable)) != nil
+    }
+
+    /// Start over: `used` = 0 and the recovery window zeroed, so old data is
+    /// not picked up again by the next mount.
+    @discardableResult
+    public func reset() -> Bool {
+        if volume == nil || !drain() { return false }
+        buffers.initializeMemory(as: UInt8.self, repeating: 0, count: bufferBytes)
+        var b: U32 = 0
+        let window = min(recoveryWindow, dataBlocks)
+        while b < window {
+            let n = min(config.bufferBlocks, window - b)
+            if (try? device.write(dataLBA + b, buffers, blocks: n)) == nil { return false }
+            b += n
+        }
+        fill = 0
+        fillBlock = 0
+        fillUsed = 0
+        durable = 0
+        return (try? writeHeader(0)) != nil
+    }
+
+    /// Bytes in the log (buffered included).
+    public var size: U32 { fillBlock * 512 + U32(fillUsed) }
+
+    /// Bytes the file can hold.
+    public var capacity: U32 { dataBlocks * 512 }
+
+    /// Bytes safely on the device (`used` in the header may lag behind).
+    public var durableSize: U32 { durable }
+
+    public var isMounted: Bool { volume != nil }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - Buffers / device writes
+
+    @inline(__always)
+    private func buffer(_ i: Int) -> UnsafeMutableRawPointer {
+        buffers + i * bufferBytes
+    }
+
+    /// Hand the full fill buffer to the device and switch to the other one.
+    private func launch() {
+        if inFlight || fillUsed < bufferBytes { return }
+        if !start(fill, fillBlock, config.bufferBlocks) {
+            stats.writeErrors &+= 1
+            return              // stays full; poll() tries again
+        }
+        fill ^= 1
+        fillBlock += config.bufferBlocks
+        fillUsed = 0
+    }
+
+    private func start(_ buf: Int, _ block: U32, _ blocks: U32) -> Bool {
+        do throws(BlockDeviceError) {
+            try device.startWrite(dataLBA + block, buffer(buf), blocks: blocks)
+        } catch {
+            return false
+        }
+        inFlight = true
+        flightBuffer = buf
+        flightBlock = block
+        flightBlocks = blocks
+        return true
+    }
+
+    /// Wait for the in-flight buffer (and a full fill buffer behind it).
+    private func drain() -> Bool {
+        waitUntil(Self.syncTimeoutSpins) {
+            poll()
+            return !inFlight && fillUsed < bufferBytes
+        }
+    }
+
+    private func writeHeader(_ used: U32) throws(Error) {
+        guard let v = volume else { throw .notMounted }
+        sector.initializeMemory(as: UInt8.self, repeating: 0, count: Self.blockBytes)
+        store32(sector, 0, Self.magic)
+        store32(sector, 4, Self.version | (1 << 16))
+        store32(sector, 8, used)
+        store32(sector, 12, ~used)
+        store32(sector, 16, stats.syncs &+ 1)
+        do throws(BlockDeviceError) {
+            try device.write(v.fileLBA, sector, blocks: 1)
+        } catch {
+            stats.writeErrors &+= 1
+            throw .device(error)
+        }
+        recorded = used
+        stats.syncs &+= 1
+    }
+
+    // MARK: - Recovery
+
+    /// Blocks that can hold data newer than the header.
+    private var recoveryWindow: U32 { config.syncEveryBlocks + 2 * config.bufferBlocks + 1 }
+
+    /// End of data: scan blocks after `used` while they hold non-zero bytes.
+    private func recover(from used: U32) throws(Error) -> U32 {
+        var end = used
+        var block = used / 512
+        let last = min(dataBlocks, block + recoveryWindow)
+        while block < last {
+            try readBlock(dataLBA + block, sector)
+            var i = Self.blockBytes
+            while i > 0 && sector.load(fromByteOffset: i - 1, as: UInt8.self) == 0 { i -= 1 }
+            if i == 0 { break }
+            let e = block * 512 + U32(i)
+            if e > end { end = e }
+            block += 1
+        }
+        return end
+    }
+
+    // MARK: - FAT32
+
+    /// Volume geometry (file fields still 0).
+    private func findVolume() throws(Error) -> Volume {
+        try readBlock(0, sector)
+        if load16(sector, 510) != 0xAA55 { throw .noFileSystem }
+
+        var part: U32 = 0
+        if !isBootSector() {
+            var found = false
+            for i in 0..<4 {
+                let e = 446 + 16 * i
+                let type = sector.load(fromByteOffset: e + 4, as: UInt8.self)
+                if type == 0x0B || type == 0x0C {
+                    part = load32(sector, e + 8)
+                    found = true
+                    break
+                }
+            }
+            if !found { throw .noFileSystem }
+            try readBlock(part, sector)
+            if !isBootSector() { throw .noFileSystem }
+        }
+
+        if load16(sector, 11) != 512 { throw .unsupportedSectorSize }
+        let spc = U32(sector.load(fromByteOffset: 13, as: UInt8.self))
+        let reserved = load16(sector, 14)
+        let fats = U32(sector.load(fromByteOffset: 16, as: UInt8.self))
+        let total = load32(sector, 32)
+        let fatSize = load32(sector, 36)
+        let root = load32(sector, 44)
+
+        let fatLBA = part + reserved
+        let dataLBA = fatLBA + fats * fatSize
+        if spc == 0 || fats == 0 || root < 2 || total <= dataLBA - part { throw .noFileSystem }
+
+        return Volume(
+            partitionLBA: part,
+            sectorsPerCluster: spc,
+            fatLBA: fatLBA,
+            dataLBA: dataLBA,
+            rootCluster: root,
+            clusterCount: (total - (dataLBA - part)) / spc,
+            fileLBA: 0,
+            fileBlocks: 0
+        )
+    }
+
+    /// FAT32 boot sector: jump, 512-byte sectors, power-of-two cluster,
+    /// no FAT16 size, FAT32 size set.
+    private func isBootSector() -> Bool {
+        let jump = sector.load(fromByteOffset: 0, as: UInt8.self)
+        let spc = sector.load(fromByteOffset: 13, as: UInt8.self)
+        return (jump == 0xEB || jump == 0xE9) &&
+            load16(sector, 11) == 512 &&
+            spc != 0 && (spc & (spc - 1)) == 0 &&
+            load16(sector, 22) == 0 &&
+            load32(sector, 36) != 0
+    }
+
+    /// Root directory lookup: (first cluster, size).
+    private func findFile(_ v: Volume, _ name: [UInt8]) throws(Error) -> (U32, U32) {
+        var cluster = v.rootCluster
+        var hops: U32 = 0
+        while cluster >= 2 && cluster < Self.endOfChain {
+            let lba = v.dataLBA + (cluster - 2) * v.sectorsPerCluster
+            for s in 0..<v.sectorsPerCluster {
+                try readBlock(lba + s, sector)
+                var e = 0
+                while e < Self.blockBytes {
+                    let first = sector.load(fromByteOffset: e, as: UInt8.self)
+                    if first == 0x00 { throw .fileNotFound }      // end of directory
+                    let attr = sector.load(fromByteOffset: e + 11, as: UInt8.self)
+                    if first != 0xE5 && attr != 0x0F && (attr & 0x18) == 0 && matches(e, name) {
+                        let c = (load16(sector, e + 20) << 16) | load16(sector, e + 26)
+                        if c < 2 { throw .fileTooSmall }
+                        return (c, load32(sector, e + 28))
+                    }
+                    e += 32
+                }
+            }
+            cluster = try nextCluster(v, cluster)
+            hops += 1
+            if hops > v.clusterCount { throw .noFileSystem }
+        }
+        throw .fileNotFound
+    }
+
+    private func matches(_ entry: Int, _ name: [UInt8]) -> Bool {
+        for i in 0..<11 where sector.load(fromByteOffset: entry + i, as: UInt8.self) != name[i] {
+            return false
+        }
+        return true
+    }
+
+    private func nextCluster(_ v: Volume, _ c: U32) throws(Error) -> U32 {
+        let lba = v.fatLBA + (c * 4) / 512
+        if lba != fatCached {
+            try readBlock(lba, fatSector)
+            fatCached = lba
+        }
+        return load32(fatSector, Int((c * 4) % 512)) & 0x0FFF_FFFF
+    }
+
+    /// "log.bin" -> "LOG     BIN" (directory entry form).
+    private static func shortName(_ s: StaticString) -> [UInt8]? {
+        var out = [UInt8](repeating: 0x20, count: 11)
+        var i = 0
+        var ext = false
+        let p = s.utf8Start
+        for k in 0..<s.utf8CodeUnitCount {
+            var c = p[k]
+            if c == 0x2E {                      // '.'
+                if ext { return nil }
+                ext = true
+                i = 8
+                continue
+            }
+            if c >= 0x61 && c <= 0x7A { c -= 0x20 }
+            if c <= 0x20 || c >= 0x7F || (!ext && i >= 8) || i >= 11 { return nil }
+            out[i] = c
+            i += 1
+        }
+        return out[0] == 0x20 ? nil : out
+    }
+
+    // MARK: - Small helpers
+
+    private func readBlock(_ lba: U32, _ dst: UnsafeMutableRawPointer) throws(Error) {
+        do throws(BlockDeviceError) {
+            try device.read(lba, dst, blocks: 1)
+        } catch {
+            throw .device(error)
+        }
+    }
+
+    @inline(__always)
+    private func load16(_ p: UnsafeMutableRawPointer, _ off: Int) -> U32 {
+        U32(p.loadUnaligned(fromByteOffset: off, as: UInt16.self))
+    }
+
+    @inline(__always)
+    private func load32(_ p: UnsafeMutableRawPointer, _ off: Int) -> U32 {
+        p.loadUnaligned(fromByteOffset: off, as: U32.self)
+    }
+
+    @inline(__always)
+    private func store32(_ p: UnsafeMutableRawPointer, _ off: Int, _ v: U32) {
+        p.storeBytes(of: v, toByteOffset: off, as: U32.self)
+    }
+}
@@ -0,0 +1,818 @@
+//
+// FirmwareUpdater.swift — In-application A/B firmware update over the UART.
+//
+// Goals:
+// - Update without BOSSA / SAM-BA (no erase button, no 1200 bps touch).
+// - Stream a framed image over a ByteStream (SerialUART or USBSerial) into
+//   the INACTIVE flash bank while the previous page programs: receiving
+//   page N+1 overlaps EWP of page N.
+// - CRC32 of the whole image is checked in flash before anything switches.
+// - Switch = GPNVM2 (boot bank) + reset. The old bank stays intact until the
+//   next update, so a bad transfer never bricks the board.
+// - Report achieved bytes/s.
+// - Delta updates: the host diffs the new image against what is already in
+//   flash (page CRCs from HASH) and only sends the pages that changed. Pages
+//   that already match are skipped, pages found in the running bank are
+//   copied locally; neither is transferred, and skipped pages are not erased.
+//
+// Images:
+// - An image only runs from the bank it was linked for (absolute addresses).
+//   `make images` builds firmware_bank0.bin (0x00080000) and firmware_bank1.bin
+//   (0x000C0000); the host asks HELLO for the target bank and sends that file.
+// - Bank 1 images end before the reserved NVM pages (META + LOG + KV).
+//
+// Frames (LE, CRC32 over type..payload):
+//   host -> device: [0xA5][type u8][seq u16][len u16][payload][crc u32]
+//   device -> host: [0x5A][type u8][seq u16][len u16][payload][crc u32]
+//   HELLO  0x01  -> ACK [proto u8][running bank u8][target bank u8][boot bank u8]
+//                       [page size u16][max image u32]
+//   BEGIN  0x02  [size u32][crc u32]            -> ACK
+//   DATA   0x03  [offset u32][<= 256 bytes]     -> ACK [next offset u32]
+//   END    0x04                                 -> ACK [bytes u32][ms u32][bytes/s u32][stalls u32]
+//   SWITCH 0x05                                 -> ACK, then reset into the new bank
+//   ABORT  0x06                                 -> ACK
+//   PAGE   0x07  [offset u32][op u8][src page u16][crc u32]   -> ACK [next offset u32]
+//                op 0 = skip (target page already holds it), 1 = copy from
+//                the running bank's page `src`; crc = CRC32 of the new page
+//                (256 bytes, 0xFF padded). A mismatch NAKs crc_mismatch and
+//                the host sends that page as DATA instead.
+//   HASH   0x08  [bank u8][first page u16][count u8 <= 32]  -> ACK [crc u32 x count]
+//   NAK    0x81  [code u8][detail u32]
+//   END (proto 2) appends [written u32][copied u32][skipped u32].
+// - DATA is ACKed as soon as the page is buffered, not when it is programmed.
+//   The host sends the next frame on ACK (one frame in flight).
+// - PAGE/DATA offsets must come in order; every page of the image is covered
+//   by exactly one DATA or PAGE frame. The whole-image CRC32 check at END
+//   stays the only gate for SWITCH (it reads, it does not wear).
+// - A repeated frame (same seq) gets the previous reply again: lost ACKs are
+//   harmless; the host simply retries after a timeout.
+//
+// Notes:
+// - poll() is non-blocking until BEGIN. During the transfer the updater owns
+//   the UART and the CPU (the UART has no RX FIFO, one byte every ~87 µs at
+//   115200), and returns on END, ABORT, error or inactivity timeout.
+// - Bank 1 programming goes through the shared EEFC1 slot (KV/FlashLog wait).
+// - GPNVM commands run from RAM (bm_eefc_cmd_ram): EEFC0 owns bank 0 too.
+//
+// Dependencies:
+// - ByteStream.swift (SerialUART, USBSerial), Timer.swift
+// - EEFC.swift: EEFC1 slot + command helpers (eefc1Claim/eefc1StartEWP/eefc1PollCommand)
+// - MMIO.swift: bm_running_bank, bm_eefc_cmd_ram, crc32Update
+// - ATSAM3X8E.swift: EEFC0/EEFC1, RSTC, flash bank geometry
+//
+
+public enum FirmwareUpdateError: Error {
+    case badFrame
+    case unexpected(type: U8)
+    case imageTooLarge(Int)
+    case badOffset(expected: U32, got: U32)
+    case flashTimeout
+    case flashError(fsr: U32)
+    case crcMismatch(expected: U32, got: U32)
+    case notVerified
+    case gpnvmFailed
+    case timeout
+
+    /// Wire code (NAK payload).
+    public var code: U8 {
+        switch self {
+        case .badFrame: return 1
+        case .unexpected: return 2
+        case .imageTooLarge: return 3
+        case .badOffset: return 4
+        case .flashTimeout: return 5
+        case .flashError: return 6
+        case .crcMismatch: return 7
+        case .notVerified: return 8
+        case .gpnvmFailed: return 9
+        case .timeout: return 10
+        }
+    }
+
+    /// Short stable identifier (good for logs / UI keys).
+    public var name: String {
+        switch self {
+        case .badFrame: return "bad_frame"
+        case .unexpected: return "unexpected_frame"
+        case .imageTooLarge: return "image_too_large"
+        case .badOffset: return "bad_offset"
+        case .flashTimeout: return "flash_timeout"
+        case .flashError: return "flash_error"
+        case .crcMismatch: return "crc_mismatch"
+        case .notVerified: return "not_verified"
+        case .gpnvmFailed: return "gpnvm_failed"
+        case .timeout: return "timeout"
+        }
+    }
+
+    var detail: U32 {
+        switch self {
+        case .unexpected(let t): return U32(t)
+        case .imageTooLarge(let n): return U32(truncatingIfNeeded: n)
+        case .badOffset(let expected, _): return expected
+        case .flashError(let fsr): return fsr
+        case .crcMismatch(_, let got): return got
+        default: return 0
+        }
+    }
+}
+
+// MARK: - Protocol constants
+
+/// Shared by every FirmwareUpdater specialization (generic classes have no
+/// static stored properties).
+private enum FWU {
+    static let protocolVersion: U8 = 2
+    static let sofHost: U8 = 0xA5
+    static let sofDevice: U8 = 0x5A
+
+    enum Kind {
+        static let hello: U8  = 0x01
+        static let begin: U8  = 0x02
+        static let data: U8   = 0x03
+        static let end: U8    = 0x04
+        static let switchBank: U8 = 0x05
+        static let abort: U8  = 0x06
+        static let page: U8   = 0x07
+        static let hash: U8   = 0x08
+        static let ack: U8    = 0x80
+        static let nak: U8    = 0x81
+    }
+
+    static let pageSize = Int(ATSAM3X8E.NVM.PAGE_SIZE)
+    static let maxPayload = 4 + pageSize
+    static let headerBytes = 5            // type, seq, len
+    static let maxHashes = 32
+
+    enum PageOp {
+        static let skip: U8 = 0
+        static let copy: U8 = 1
+    }
+
+    // Payload is staged at tx[6...] by stage*(), then reply() frames it.
+    static let txHeader = 1 + headerBytes
+}
+
+public final class FirmwareUpdater<Port: ByteStream> {
+
+    // MARK: - Public types
+
+    public enum Phase {
+        case idle
+        case receiving
+        case verified
+        case failed(FirmwareUpdateError)
+    }
+
+    public struct Report {
+        public let bytes: U32
+        public let elapsedMs: U32
+        public let bytesPerSecond: U32
+        public let stalls: U32        // DATA frames that waited for the flash
+        public let pagesWritten: U32  // literal + copied
+        public let pagesCopied: U32
+        public let pagesSkipped: U32
+    }
+
+    // MARK: - Dependencies / config
+
+    private let serial: Port
+    private let timer: Timer
+    private let timeoutMs: U32
+
+    // MARK: - State
+
+    public private(set) var phase: Phase = .idle
+    public private(set) var report: Report? = nil
+
+    // RX parser: frame = header + payload + crc (no SOF)
+    private var rx: [UInt8]
+    private var rxCount = 0
+    private var rxActive = false
+
+    // Last reply, replayed for a repeated seq
+    private var tx: [UInt8]
+    private var txCount = 0
+    private var txStaged = 0
+    private var lastSeq: U32 = 0xFFFF_FFFF
+
+    // Image
+    private var targetBank: U32 = 0
+    private var imageSize: U32 = 0
+    private var imageCRC: U32 = 0
+    private var nextOffset: U32 = 0
+    private var startMs: U32 = 0
+    private var stalls: U32 = 0
+    private var pagesWritten: U32 = 0
+    private var pagesCopied: U32 = 0
+    private var pagesSkipped: U32 = 0
+
+    // Two page buffers: one programming, one filling/ready
+    private var pages: [UInt8]
+    private var pageOffset: [U32] = [0, 0]
+    private var programming = -1
+    private var ready = -1
+
+    // MARK: - Init
+
+    public init(serial: Port, timer: Timer, timeoutMs: U32 = 3_000) {
+        self.serial = serial
+        self.timer = timer
+        self.timeoutMs = timeoutMs
+        self.rx = Self.filled(FWU.headerBytes + FWU.maxPayload + 4)
+        self.tx = Self.filled(1 + FWU.headerBytes + 4 * FWU.maxHashes + 4)
+        self.pages = Self.filled(2 * FWU.pageSize)
+    }
+
+    // MARK: - Public API
+
+    /// Bank this firmware runs from (0/1).
+    public var runningBank: U32 { bm_running_bank() }
+
+    /// Bank the next image goes to: always the one NOT running.
+    public var inactiveBank: U32 { runningBank == 0 ? 1 : 0 }
+
+    /// Largest image the inactive bank can hold.
+    public var maxImageSize: U32 { bankLimit(inactiveBank) }
+
+    /// Call from the main loop. Drains available UART bytes; a BEGIN frame
+    /// runs the whole transfer before returning.
+    public func poll() {
+        while true {
+            let c = serial.readByteNonBlocking()
+            if c < 0 { return }
+            feed(UInt8(truncatingIfNeeded: c))
+        }
+    }
+
+    /// For applications that read the UART themselves: hand every byte here.
+    public func feed(_ b: UInt8) {
+        if collect(b) { handleFrame() }
+    }
+
+    // MARK: - Frame parsing
+
+    private var payloadLength: Int { Int(rx[3]) | (Int(rx[4]) << 8) }
+
+    /// Returns true when `rx` holds a complete frame (header + payload + crc).
+    private func collect(_ b: UInt8) -> Bool {
+        if !rxActive {
+            if b == FWU.sofHost {
+                rxActive = true
+                rxCount = 0
+            }
+            return false
+        }
+
+        rx[rxCount] = b
+        rxCount += 1
+
+        if rxCount == FWU.headerBytes && payloadLength > FWU.maxPayload {
+            rxActive = false      // garbage length: resync on next SOF
+            return false
+        }
+        if rxCount >= FWU.headerBytes && rxCount == FWU.headerBytes + payloadLength + 4 {
+            rxActive = false
+            return true
+        }
+        return false
+    }
+
+    private func handleFrame() {
+        let len = payloadLength
+        let crcAt = FWU.headerBytes + len
+        var crc: U32 = 0xFFFF_FFFF
+        var i = 0
+        while i < crcAt {
+            crc = crc32Update(crc, rx[i])
+            i += 1
+        }
+        if ~crc != getU32(rx, crcAt) { return }   // corrupt: host retries
+
+        let type = rx[0]
+        let seq = U32(rx[1]) | (U32(rx[2]) << 8)
+
+        // Repeated frame: our reply was lost, send it again.
+        // (HELLO starts a session: never a replay.)
+        if seq == lastSeq && txCount > 0 && type != FWU.Kind.hello {
+            resend()
+            return
+        }
+        lastSeq = seq
+
+        if case .receiving = phase {
+            handleTransferFrame(type, seq, len)
+            return
+        }
+
+        switch type {
+        case FWU.Kind.hello:
+            stage8(FWU.protocolVersion)
+            stage8(U8(runningBank))
+            stage8(U8(inactiveBank))
+            stage8(U8(bootBank() ?? 0xFF))
+            stage16(U16(FWU.pageSize))
+            stage32(maxImageSize)
+            reply(FWU.Kind.ack, seq)
+
+        case FWU.Kind.begin:
+            if len != 8 { nak(seq, .badFrame); return }
+            begin(seq, size: getU32(rx, FWU.headerBytes), crc: getU32(rx, FWU.headerBytes + 4))
+
+        case FWU.Kind.hash:
+            if len != 4 { nak(seq, .badFrame); return }
+            hashPages(
+                seq,
+                bank: U32(rx[FWU.headerBytes]),
+                first: U32(rx[FWU.headerBytes + 1]) | (U32(rx[FWU.headerBytes + 2]) << 8),
+                count: U32(rx[FWU.headerBytes + 3])
+            )
+
+        case FWU.Kind.switchBank:
+            switchBank(seq)
+
+        case FWU.Kind.abort:
+            phase = .idle
+            reply(FWU.Kind.ack, seq)
+
+        default:
+            nak(seq, .unexpected(type: type))
+        }
+    }
+
+    private func begin(_ seq: U32, size: U32, crc: U32) {
+        if size == 0 || size > maxImageSize {
+            fail(seq, .imageTooLarge(Int(size)))
+            return
+        }
+
+        targetBank = inactiveBank
+        imageSize = size
+        imageCRC = crc
+        nextOffset = 0
+        stalls = 0
+        pagesWritten = 0
+        pagesCopied = 0
+        pagesSkipped = 0
+        programming = -1
+        ready = -1
+        report = nil
+        phase = .receiving
+        startMs = timer.millis()
+
+        reply(FWU.Kind.ack, seq)
+        receiveImage()
+    }
+
+    // MARK: - Transfer loop (owns UART + CPU until END)
+
+    private func receiveImage() {
+        var lastRx = timer.millis()
+
+        while case .receiving = phase {
+            pumpFlash()
+
+            let c = serial.readByteNonBlocking()
+            if c < 0 {
+                if (timer.millis() &- lastRx) > timeoutMs { abandon(.timeout) }
+                continue
+            }
+            lastRx = timer.millis()
+            if collect(UInt8(truncatingIfNeeded: c)) { handleFrame() }
+        }
+    }
+
+    private func handleTransferFrame(_ type: U8, _ seq: U32, _ len: Int) {
+        switch type {
+        case FWU.Kind.data:
+            if len < 5 { nak(seq, .badFrame); return }
+            let offset = getU32(rx, FWU.headerBytes)
+            let count = len - 4
+            if offset != nextOffset || count > FWU.pageSize
+                || (count < FWU.pageSize && offset + U32(count) != imageSize) {
+                nak(seq, .badOffset(expected: nextOffset, got: offset))
+                return
+            }
+            acceptPage(offset: offset, count: count, from: nil)
+            if case .failed(let e) = phase { nak(seq, e); return }
+
+            stage32(nextOffset)
+            reply(FWU.Kind.ack, seq)
+
+        case FWU.Kind.page:
+            if len != 11 { nak(seq, .badFrame); return }
+            pageOp(
+                seq,
+                offset: getU32(rx, FWU.headerBytes),
+                op: rx[FWU.headerBytes + 4],
+                src: U32(rx[FWU.headerBytes + 5]) | (U32(rx[FWU.headerBytes + 6]) << 8),
+                crc: getU32(rx, FWU.headerBytes + 7)
+            )
+
+        case FWU.Kind.end:
+            finish(seq)
+
+        case FWU.Kind.abort:
+            drainFlash()
+            phase = .idle
+            reply(FWU.Kind.ack, seq)
+
+        default:
+            nak(seq, .unexpected(type: type))
+        }
+    }
+
+    private func finish(_ seq: U32) {
+        if nextOffset != imageSize {
+            fail(seq, .badOffset(expected: imageSize, got: nextOffset))
+            return
+        }
+        drainFlash()
+        if case .failed(let e) = phase { nak(seq, e); return }
+
+        let got = flashCRC(base: bankBase(targetBank), size: imageSize)
+        if got != imageCRC {
+            fail(seq, .crcMismatch(expected: imageCRC, got: got))
+            return
+        }
+
+        let ms = timer.millis() &- startMs
+        let bps = ms == 0 ? imageSize : U32((UInt64(imageSize) * 1000) / UInt64(ms))
+        report = Report(
+            bytes: imageSize, elapsedMs: ms, bytesPerSecond: bps, stalls: stalls,
+            pagesWritten: pagesWritten, pagesCopied: pagesCopied, pagesSkipped: pagesSkipped
+        )
+        phase = .verified
+
+        stage32(imageSize)
+        stage32(ms)
+        stage32(bps)
+        stage32(stalls)
+        stage32(pagesWritten)
+        stage32(pagesCopied)
+        stage32(pagesSkipped)
+        reply(FWU.Kind.ack, seq)
+    }
+
+    // MARK: - Delta
+
+    /// Skip / copy one page. Both check the page CRC first, so a stale host
+    /// view of the flash costs one NAK (then DATA), never a wrong image.
+    private func pageOp(_ seq: U32, offset: U32, op: U8, src: U32, crc: U32) {
+        if offset != nextOffset || offset >= imageSize {
+            nak(seq, .badOffset(expected: nextOffset, got: offset))
+            return
+        }
+        let page = U32(FWU.pageSize)
+        let count = imageSize - offset < page ? Int(imageSize - offset) : FWU.pageSize
+
+        switch op {
+        case FWU.PageOp.skip:
+            // The target bank can't be read while it programs.
+            drainFlash()
+            if case .failed(let e) = phase { nak(seq, e); return }
+            let got = flashCRC(base: bankBase(targetBank) + offset, size: page)
+            if got != crc { nak(seq, .crcMismatch(expected: crc, got: got)); return }
+            nextOffset = offset + U32(count)
+            pagesSkipped &+= 1
+
+        case FWU.PageOp.copy:
+            let running = runningBank
+            if src >= bankLimit(running) / page { nak(seq, .badFrame); return }
+            let from = bankBase(running) + src * page
+            let got = flashCRC(base: from, size: page)
+            if got != crc { nak(seq, .crcMismatch(expected: crc, got: got)); return }
+            acceptPage(offset: offset, count: count, from: from)
+            if case .failed(let e) = phase { nak(seq, e); return }
+            pagesCopied &+= 1
+
+        default:
+            nak(seq, .badFrame)
+            return
+        }
+
+        stage32(nextOffset)
+        reply(FWU.Kind.ack, seq)
+    }
+
+    /// CRC32 of `count` whole pages of `bank` (what the host diffs against).
+    private func hashPages(_ seq: U32, bank: U32, first: U32, count: U32) {
+        let page = U32(FWU.pageSize)
+        if bank > 1 || count == 0 || count > U32(FWU.maxHashes)
+            || (first + count) * page > bankLimit(bank) {
+            nak(seq, .badFrame)
+            return
+        }
+        var i: U32 = 0
+        while i < count {
+            stage32(flashCRC(base: bankBase(bank) + (first + i) * page, size: page))
+            i += 1
+        }
+        reply(FWU.Kind.ack, seq)
+    }
+
+    private func switchBank(_ seq: U32) {
+        guard case .verified = phase else {
+            nak(seq, .notVerified)
+            return
+        }
+
+        let cmd = targetBank == 1 ? ATSAM3X8E.EEFC.FCMD_SGPB : ATSAM3X8E.EEFC.FCMD_CGPB
+        _ = gpnvmCommand(cmd, bit: ATSAM3X8E.EEFC.GPNVM_BOOT_BANK)
+        if bootBank() != targetBank {
+            fail(seq, .gpnvmFailed)
+            return
+        }
+
+        reply(FWU.Kind.ack, seq)
+        _ = waitUntil(5_000_000) { (read32(ATSAM3X8E.UART.SR) & ATSAM3X8E.UART.SR_TXEMPTY) != 0 }
+
+        write32(
+            ATSAM3X8E.RSTC.CR,
+            ATSAM3X8E.RSTC.CR_KEY | ATSAM3X8E.RSTC.CR_PROCRST | ATSAM3X8E.RSTC.CR_PERRST
+        )
+        while true { bm_nop() }
+    }
+
+    // MARK: - Page pipeline
+
+    /// Copy the DATA payload (or the flash page at `from`) into a free page
+    /// buffer (waits for the flash only if both buffers are busy) and queue it
+    /// for programming.
+    private func acceptPage(offset: U32, count: Int, from: U32?) {
+        var free = freeBuffer()
+        if free < 0 {
+            stalls &+= 1
+            while free < 0 {
+                pumpFlash()
+                if case .failed = phase { return }
+                free = freeBuffer()
+            }
+        }
+
+        let o = free * FWU.pageSize
+        var i = 0
+        if let from {
+            // Whole page: the CRC the host sent covers all 256 bytes.
+            while i < FWU.pageSize {
+                let w = bm_read32(from + U32(i))
+                pages[o + i + 0] = UInt8(truncatingIfNeeded: w)
+                pages[o + i + 1] = UInt8(truncatingIfNeeded: w >> 8)
+                pages[o + i + 2] = UInt8(truncatingIfNeeded: w >> 16)
+                pages[o + i + 3] = UInt8(truncatingIfNeeded: w >> 24)
+                i += 4
+            }
+        }
+        while i < count {
+            pages[o + i] = rx[FWU.headerBytes + 4 + i]
+            i += 1
+        }
+        while i < FWU.pageSize {
+            pages[o + i] = 0xFF
+            i += 1
+        }
+
+        pageOffset[free] = offset
+        ready = free
+        nextOffset = offset + U32(count)
+        pagesWritten &+= 1
+        pumpFlash()
+    }
+
+    private func freeBuffer() -> Int {
+        var i = 0
+        while i < 2 {
+            if i != programming && i != ready { return i }
+            i += 1
+        }
+        return -1
+    }
+
+    /// Finish the page in flight (if done), then start the ready one.
+    private func pumpFlash() {
+        if programming >= 0 {
+            guard let fsr = pollProgram() else { return }
+            programming = -1
+            if (fsr & (ATSAM3X8E.EEFC.FSR_FCMDE | ATSAM3X8E.EEFC.FSR_FLOCKE)) != 0 {
+                abandon(.flashError(fsr: fsr))
+                return
+            }
+        }
+        if ready >= 0 {
+            if startProgram(ready) {
+                programming = ready
+                ready = -1
+            }
+        }
+    }
+
+    private func drainFlash() {
+        var spins: U32 = 20_000_000
+        while (programming >= 0 || ready >= 0) && spins > 0 {
+            pumpFlash()
+            if case .failed = phase { return }
+            spins &-= 1
+        }
+        if spins == 0 { abandon(.flashTimeout) }
+    }
+
+    private func startProgram(_ buffer: Int) -> Bool {
+        let addr = bankBase(targetBank) + pageOffset[buffer]
+        let page = (addr - bankBase(targetBank)) / ATSAM3X8E.NVM.PAGE_SIZE
+
+        let ok = pages.withUnsafeBufferPointer { p -> Bool in
+            let src = p.baseAddress! + buffer * FWU.pageSize
+            if targetBank == 1 {
+                // Shared with KV/FlashLog: retry on the next pump if they own it.
+                if !eefc1Claim() { return false }
+                if !eefc1StartEWP(addr: addr, pageIndex: page, src: src, count: FWU.pageSize) {
+                    eefc1Release()
+                    abandon(.flashTimeout)
+                    return false
+                }
+                return true
+            }
+            if !_fwu_startEWP0(addr: addr, pageIndex: page, src: src, count: FWU.pageSize) {
+                abandon(.flashTimeout)
+                return false
+            }
+            return true
+        }
+        return ok
+    }
+
+    private func pollProgram() -> U32? {
+        if targetBank == 1 {
+            guard let fsr = eefc1PollCommand() else { return nil }
+            eefc1Release()
+            return fsr
+        }
+        let fsr = bm_read32(ATSAM3X8E.EEFC0.FSR)
+        return (fsr & ATSAM3X8E.EEFC.FSR_FRDY) != 0 ? fsr : nil
+    }
+
+    // MARK: - Flash helpers
+
+    @inline(__always)
+    private func bankBase(_ bank: U32) -> U32 {
+        bank == 0 ? ATSAM3X8E.FLASH_BASE : ATSAM3X8E.FLASH_BANK1_BASE
+    }
+
+    /// Bytes of `bank` an image may use (bank 1 stops at the NVM pages).
+    private func bankLimit(_ bank: U32) -> U32 {
+        bank == 0
+            ? ATSAM3X8E.FLASH_BANK_SIZE
+            : ATSAM3X8E.NVM.META_PAGE_ADDR - ATSAM3X8E.FLASH_BANK1_BASE
+    }
+
+    private func flashCRC(base: U32, size: U32) -> U32 {
+        var crc: U32 = 0xFFFF_FFFF
+        var off: U32 = 0
+        while off < size {
+            let w = bm_read32(base + (off & ~U32(3)))
+            crc = crc32Update(crc, UInt8(truncatingIfNeeded: w >> ((off & 3) * 8)))
+            off &+= 1
+        }
+        return ~crc
+    }
+
+    /// GPNVM commands always go to EEFC0 and run from RAM.
+    private func gpnvmCommand(_ fcmd: U32, bit: U32) -> U32 {
+        let cmd =
+            ATSAM3X8E.EEFC.FCR_FKEY_PASSWD |
+            (bit << ATSAM3X8E.EEFC.FCR_FARG_SHIFT) |
+            (fcmd & ATSAM3X8E.EEFC.FCR_FCMD_MASK)
+        return withIRQLocked {
+            bm_eefc_cmd_ram(ATSAM3X8E.EEFC0.FCR, ATSAM3X8E.EEFC0.FSR, cmd)
+        }
+    }
+
+    /// Current GPNVM2 (boot bank), nil if the controller did not answer.
+    private func bootBank() -> U32? {
+        let fsr = gpnvmCommand(ATSAM3X8E.EEFC.FCMD_GGPB, bit: 0)
+        if (fsr & ATSAM3X8E.EEFC.FSR_FRDY) == 0 { return nil }
+        let bits = read32(ATSAM3X8E.EEFC0.FRR)
+        return (bits >> ATSAM3X8E.EEFC.GPNVM_BOOT_BANK) & 1
+    }
+
+    // MARK: - Replies
+
+    // Payload is staged at tx[6...] by stage*(), then reply() frames it.
+    private func stage8(_ v: U8) {
+        tx[FWU.txHeader + txStaged] = v
+        txStaged += 1
+    }
+
+    private func stage16(_ v: U16) {
+        stage8(U8(v & 0xFF))
+        stage8(U8(v >> 8))
+    }
+
+    private func stage32(_ v: U32) {
+        stage16(U16(v & 0xFFFF))
+        stage16(U16(v >> 16))
+    }
+
+    private func reply(_ type: U8, _ seq: U32) {
+        tx[0] = FWU.sofDevice
+        tx[1] = type
+        tx[2] = U8(seq & 0xFF)
+        tx[3] = U8((seq >> 8) & 0xFF)
+        tx[4] = U8(txStaged & 0xFF)
+        tx[5] = U8((txStaged >> 8) & 0xFF)
+
+        let n = FWU.txHeader + txStaged
+        var crc: U32 = 0xFFFF_FFFF
+        var i = 1
+        while i < n {
+            crc = crc32Update(crc, tx[i])
+            i += 1
+        }
+        putU32(~crc, &tx, n)
+
+        txCount = n + 4
+        txStaged = 0
+        resend()
+    }
+
+    private func resend() {
+        var i = 0
+        while i < txCount {
+            serial.writeByte(tx[i])
+            i += 1
+        }
+    }
+
+    private func nak(_ seq: U32, _ e: FirmwareUpdateError) {
+        stage8(e.code)
+        stage32(e.detail)
+        reply(FWU.Kind.nak, seq)
+    }
+
+    private func fail(_ seq: U32, _ e: FirmwareUpdateError) {
+        abandon(e)
+        nak(seq, e)
+    }
+
+    /// Stop the transfer: let the page in flight finish, drop the rest.
+    private func abandon(_ e: FirmwareUpdateError) {
+        phase = .failed(e)
+        if programming >= 0 {
+            _ = waitUntil(20_000_000) { pollProgram() != nil }
+            programming = -1
+        }
+        ready = -1
+    }
+
+    // MARK: - Small utilities
+
+    private static func filled(_ n: Int) -> [UInt8] {
+        var a = [UInt8]()
+        a.reserveCapacity(n)
+        while a.count < n { a.append(0) }
+        return a
+    }
+
+    @inline(__always)
+    private func getU32(_ a: [UInt8], _ o: Int) -> U32 {
+        U32(a[o]) | (U32(a[o + 1]) << 8) | (U32(a[o + 2]) << 16) | (U32(a[o + 3]) << 24)
+    }
+
+    @inline(__always)
+    private func putU32(_ v: U32, _ a: inout [UInt8], _ o: Int) {
+        a[o + 0] = U8(v & 0xFF)
+        a[o + 1] = U8((v >> 8) & 0xFF)
+        a[o + 2] = U8((v >> 16) & 0xFF)
+        a[o + 3] = U8((v >> 24) & 0xFF)
+    }
+}
+
+// MARK: - Local helpers (file-scoped, unique names)
+
+/// EWP on EEFC0 (bank 0). Only used while running from bank 1.
+private func _fwu_startEWP0(addr: U32, pageIndex: U32, src: UnsafePointer<UInt8>, count: Int) -> Bool {
+    if !waitUntil(5_000_000, { (bm_read32(ATSAM3X8E.EEFC0.FSR) & ATSAM3X8E.EEFC.FSR_FRDY) != 0 }) {
+        return false
+    }
+
+    var i = 0
+    while i + 4 <= count {
+        let w =
+            U32(src[i + 0]) |
+            (U32(src[i + 1]) << 8) |
+            (U32(src[i + 2]) << 16) |
+            (U32(src[i + 3]) << 24)
+        bm_write32(addr + U32(i), w)
+        i += 4
+    }
+
+    bm_dsb()
+    bm_isb()
+
+    let cmd =
+        ATSAM3X8E.EEFC.FCR_FKEY_PASSWD |
+        (pageIndex << ATSAM3X8E.EEFC.FCR_FARG_SHIFT) |
+        (ATSAM3X8E.EEFC.FCMD_EWP & ATSAM3X8E.EEFC.FCR_FCMD_MASK)
+    bm_write32(ATSAM3X8E.EEFC0.FCR, cmd)
+    return true
+}
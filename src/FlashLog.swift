@@ -0,0 +1,741 @@
+//
+// FlashLog.swift — Append-only time-series log on a ring of bank-1 flash pages (EEFC1).
+//
+// Goals:
+// - Record sensor samples on the device between host connections.
+// - Compact records: varint(delta time) + varint(zigzag(delta value)).
+// - One EWP per FULL page: the writer fills a 256-byte RAM page first.
+// - Non-blocking: full pages are programmed through the shared EEFC1 async
+//   slot (EEFC1_Handler) while new records go into the second RAM page.
+// - Readers iterate oldest -> newest or seek by time.
+//
+// On-flash page format (PAGE_SIZE bytes):
+//   [magic u32][seq u32][baseTime u32][count u16 | used u16][crc u32][records...][0xFF pad]
+//   CRC covers seq, baseTime, count/used and the record bytes.
+//   First record is relative to baseTime and value 0.
+//
+// Ring + compaction:
+// - Pages are written in ring order with an increasing sequence number;
+//   on mount the newest valid page tells where the head is.
+// - When the ring is full, the two oldest pages are merged (decimated) into the
+//   second-oldest slot before the oldest slot is reused, so old history gets
+//   sparser instead of disappearing. With compaction off, the oldest page is dropped.
+// - A reset between the merge and the head write can show the oldest page's
+//   records twice (once decimated). Nothing is lost.
+//
+// Notes:
+// - Call poll() from the main loop (finishes/starts page programming).
+// - Timestamps are Timer.millis() values (U32 ms, wraps after ~49 days).
+// - No allocations in the append path (the heap in support.c never frees).
+// - Make sure linker.ld reserves ATSAM3X8E.NVM.LOG_PAGE_ADDR..+LOG_PAGE_COUNT*PAGE_SIZE.
+//
+// Dependencies:
+// - MMIO.swift: bm_read32, waitUntil(), crc32Update
+// - ATSAM3X8E.swift: NVM log geometry
+// - EEFC.swift: EEFC1 async command slot (eefc1Claim/eefc1StartEWP/eefc1TakeFSR...)
+//
+
+public final class FlashLog {
+
+    // MARK: - Public types
+
+    public struct Config {
+        public let pageAddr: U32
+        public let bank1PageIndex: U32
+        public let pageCount: U32
+        public let compaction: Bool
+
+        public init(
+            pageAddr: U32 = ATSAM3X8E.NVM.LOG_PAGE_ADDR,
+            bank1PageIndex: U32 = ATSAM3X8E.NVM.LOG_BANK1_PAGE_INDEX,
+            pageCount: U32 = ATSAM3X8E.NVM.LOG_PAGE_COUNT,
+            compaction: Bool = true
+        ) {
+            self.pageAddr = pageAddr
+            self.bank1PageIndex = bank1PageIndex
+            self.pageCount = pageCount < 2 ? 2 : pageCount
+            self.compaction = compaction
+        }
+    }
+
+    public struct Record {
+        public let timeMs: U32
+        public let value: Int32
+    }
+
+    public struct Stats {
+        public var records: U32 = 0        // accepted by append()
+        public var dropped: U32 = 0        // rejected: both RAM pages busy
+        public var recordBytes: U32 = 0    // encoded record bytes (no page headers)
+        public var pagesWritten: U32 = 0
+        public var compactions: U32 = 0
+        public var flashErrors: U32 = 0
+        public var firstMs: U32 = 0
+        public var lastMs: U32 = 0
+
+        /// Sustained append rate over the logged time span (records/s).
+        public var recordsPerSecond: U32 {
+            let span = lastMs &- firstMs
+            if records < 2 || span == 0 { return 0 }
+            return U32((UInt64(records - 1) * 1000) / UInt64(span))
+        }
+
+        /// Average encoded record size in 1/100 byte (no Float on this target).
+        public var bytesPerRecordX100: U32 {
+            if records == 0 { return 0 }
+            return (recordBytes * 100) / records
+        }
+
+        /// Flash consumed per record (headers + padding), in 1/100 byte.
+        public var flashBytesPerRecordX100: U32 {
+            if records == 0 { return 0 }
+            return U32((UInt64(pagesWritten) * UInt64(ATSAM3X8E.NVM.PAGE_SIZE) * 100) / UInt64(records))
+        }
+    }
+
+    // MARK: - On-flash format (not hardware)
+
+    private static let magic: U32 = 0x474F_4C46 // "FLOG"
+    private static let headerBytes: Int = 20
+
+    private let cfg: Config
+    private let pageSize: Int
+
+    // MARK: - Writer state
+
+    // Three page images in one buffer (no per-page allocation):
+    // two for the fill/program ping-pong, one for compaction.
+    private var buf: [UInt8]
+    private var fillBuf: Int = 0
+    private var fillUsed: Int = 0        // record bytes in the fill page
+    private var fillCount: Int = 0
+    private var fillBase: U32 = 0
+    private var lastTime: U32 = 0
+    private var lastValue: Int32 = 0
+
+    private enum Stage {
+        case idle
+        case compactPending
+        case compacting
+        case writePending
+        case writing
+    }
+
+    private var stage: Stage = .idle
+    private var sealedBuf: Int = 1
+    private var sealedPos: U32 = 0
+    private var mergedPos: U32 = 0
+
+    private var headPos: U32 = 0
+    private var nextSeq: U32 = 1
+
+    public private(set) var stats = Stats()
+
+    // MARK: - Init / mount
+
+    public init(config: Config = Config()) {
+        self.cfg = config
+        self.pageSize = Int(ATSAM3X8E.NVM.PAGE_SIZE)
+
+        var b = [UInt8]()
+        b.reserveCapacity(3 * pageSize)
+        var i = 0
+        while i < 3 * pageSize {
+            b.append(0xFF)
+            i += 1
+        }
+        self.buf = b
+
+        mount()
+        resetFill()
+    }
+
+    /// Scan the ring: the newest valid page decides head and next sequence.
+    private func mount() {
+        _ = eefc1WaitNotInFlight()
+
+        var found = false
+        var bestSeq: U32 = 0
+        var bestPos: U32 = 0
+
+        var pos: U32 = 0
+        while pos < cfg.pageCount {
+            if let h = readHeader(pos) {
+                if !found || Self.isNewer(h.seq, than: bestSeq) {
+                    found = true
+                    bestSeq = h.seq
+                    bestPos = pos
+                }
+            }
+            pos += 1
+        }
+
+        if found {
+            headPos = (bestPos + 1) % cfg.pageCount
+            nextSeq = bestSeq &+ 1
+        } else {
+            headPos = 0
+            nextSeq = 1
+        }
+    }
+
+    // MARK: - Writer API
+
+    /// Append one sample. Returns false if it was dropped (both RAM pages busy).
+    @discardableResult
+    public func append(timeMs: U32, value: Int32) -> Bool {
+        pump()
+
+        if fillCount == 0 { startPage(at: timeMs) }
+
+        var n = recordLength(timeMs: timeMs, value: value)
+        if Self.headerBytes + fillUsed + n > pageSize {
+            if !seal() {
+                stats.dropped &+= 1
+                return false
+            }
+            startPage(at: timeMs)
+            n = recordLength(timeMs: timeMs, value: value)
+        }
+
+        let base = fillBuf * pageSize + Self.headerBytes + fillUsed
+        var o = putVarint(timeMs &- lastTime, at: base)
+        o += putVarint(Self.zigzag(value &- lastValue), at: base + o)
+
+        fillUsed += o
+        fillCount += 1
+        lastTime = timeMs
+        lastValue = value
+
+        if stats.records == 0 { stats.firstMs = timeMs }
+        stats.lastMs = timeMs
+        stats.records &+= 1
+        stats.recordBytes &+= U32(n)
+        return true
+    }
+
+    /// Call from the main loop: completes and starts page programming.
+    public func poll() {
+        pump()
+    }
+
+    /// Program the partial RAM page now (e.g. before sleep or a host dump)
+    /// and wait until everything sealed is in flash.
+    public func flush(timeout: U32 = 20_000_000) -> Bool {
+        if !waitPipelineIdle(timeout: timeout) { return false }
+        if fillCount > 0 {
+            if !seal() { return false }
+        }
+        return waitPipelineIdle(timeout: timeout)
+    }
+
+    public var isProgramming: Bool {
+        switch stage {
+        case .idle: return false
+        default: return true
+        }
+    }
+
+    // MARK: - Reader API
+
+    /// Oldest -> newest, including records still in the RAM page.
+    public func cursor() -> Cursor {
+        _ = waitPipelineIdle(timeout: 20_000_000)
+        _ = eefc1WaitNotInFlight()
+
+        // Collect valid pages and order them by sequence (insertion sort, <= ring size).
+        var positions = [U32]()
+        var seqs = [U32]()
+        var bases = [U32]()
+        var pos: U32 = 0
+        while pos < cfg.pageCount {
+            if let h = readHeader(pos) {
+                var i = seqs.count
+                positions.append(pos)
+                seqs.append(h.seq)
+                bases.append(h.baseTime)
+                while i > 0 && Self.isNewer(seqs[i - 1], than: h.seq) {
+                    positions[i] = positions[i - 1]
+                    seqs[i] = seqs[i - 1]
+                    bases[i] = bases[i - 1]
+                    i -= 1
+                }
+                positions[i] = pos
+                seqs[i] = h.seq
+                bases[i] = h.baseTime
+            }
+            pos += 1
+        }
+
+        // Snapshot of the RAM tail (one copy per cursor, not per record).
+        var tail = [UInt8]()
+        tail.reserveCapacity(fillUsed)
+        var i = 0
+        let start = fillBuf * pageSize + Self.headerBytes
+        while i < fillUsed {
+            tail.append(buf[start + i])
+            i += 1
+        }
+
+        return Cursor(
+            log: self,
+            positions: positions,
+            seqs: seqs,
+            bases: bases,
+            tail: tail,
+            tailCount: fillCount,
+            tailBase: fillBase
+        )
+    }
+
+    /// First record with timeMs >= `timeMs`.
+    public func seek(timeMs: U32) -> Cursor {
+        var c = cursor()
+        c.seek(timeMs)
+        return c
+    }
+
+    public struct Cursor {
+        private let log: FlashLog
+        private let positions: [U32]
+        private let seqs: [U32]
+        private let bases: [U32]
+        private let tail: [UInt8]
+        private let tailCount: Int
+        private let tailBase: U32
+
+        private var pageIdx: Int = -1      // positions.count => RAM tail
+        private var reader: PageReader? = nil
+        private var peeked: Record? = nil
+
+        fileprivate init(
+            log: FlashLog,
+            positions: [U32],
+            seqs: [U32],
+            bases: [U32],
+            tail: [UInt8],
+            tailCount: Int,
+            tailBase: U32
+        ) {
+            self.log = log
+            self.positions = positions
+            self.seqs = seqs
+            self.bases = bases
+            self.tail = tail
+            self.tailCount = tailCount
+            self.tailBase = tailBase
+        }
+
+        public mutating func next() -> Record? {
+            if let p = peeked {
+                peeked = nil
+                return p
+            }
+            while true {
+                if reader != nil {
+                    if let r = reader!.next(log: log, tail: tail) { return r }
+                    reader = nil
+                }
+                pageIdx += 1
+                if pageIdx > positions.count { return nil }
+                reader = openPage(pageIdx)
+            }
+        }
+
+        fileprivate mutating func seek(_ t: U32) {
+            // Binary search: last page whose baseTime <= t (pages are time-ordered).
+            var lo = 0
+            var hi = positions.count
+            while lo < hi {
+                let mid = (lo + hi) / 2
+                if FlashLog.isAtOrAfter(t, bases[mid]) { lo = mid + 1 } else { hi = mid }
+            }
+            pageIdx = lo > 0 ? lo - 2 : -1
+            reader = nil
+
+            while let r = next() {
+                if FlashLog.isAtOrAfter(r.timeMs, t) {
+                    peeked = r
+                    return
+                }
+            }
+        }
+
+        private func openPage(_ idx: Int) -> PageReader? {
+            if idx == positions.count {
+                if tailCount == 0 { return nil }
+                return PageReader(addr: 0, inTail: true, end: FlashLog.headerBytes + tail.count,
+                                  remaining: tailCount, time: tailBase)
+            }
+            // The page may have been recycled since the cursor was built.
+            _ = eefc1WaitNotInFlight()
+            guard let h = log.readHeader(positions[idx]), h.seq == seqs[idx] else { return nil }
+            return PageReader(addr: log.pageAddr(positions[idx]), inTail: false,
+                              end: FlashLog.headerBytes + h.used, remaining: h.count, time: h.baseTime)
+        }
+    }
+
+    // MARK: - Internals: record decoding
+
+    fileprivate struct PageReader {
+        let addr: U32
+        let inTail: Bool
+        let end: Int
+        var offset: Int = FlashLog.headerBytes
+        var remaining: Int
+        var time: U32
+        var value: Int32 = 0
+
+        init(addr: U32, inTail: Bool, end: Int, remaining: Int, time: U32) {
+            self.addr = addr
+            self.inTail = inTail
+            self.end = end
+            self.remaining = remaining
+            self.time = time
+        }
+
+        mutating func next(log: FlashLog, tail: [UInt8]) -> Record? {
+            if remaining == 0 { return nil }
+            guard let dt = varint(log: log, tail: tail),
+                  let dv = varint(log: log, tail: tail) else {
+                remaining = 0
+                return nil
+            }
+            time = time &+ dt
+            value = value &+ FlashLog.unzigzag(dv)
+            remaining -= 1
+            return Record(timeMs: time, value: value)
+        }
+
+        private mutating func varint(log: FlashLog, tail: [UInt8]) -> U32? {
+            var v: U32 = 0
+            var shift: U32 = 0
+            while offset < end && shift < 35 {
+                let b = inTail ? tail[offset - FlashLog.headerBytes] : _flog_flashByte(addr + U32(offset))
+                offset += 1
+                v |= U32(b & 0x7F) << shift
+                if (b & 0x80) == 0 { return v }
+                shift += 7
+            }
+            return nil
+        }
+    }
+
+    // MARK: - Internals: page header
+
+    fileprivate struct PageHeader {
+        let seq: U32
+        let baseTime: U32
+        let count: Int
+        let used: Int
+    }
+
+    /// Valid header + CRC, or nil (erased, torn or foreign page).
+    fileprivate func readHeader(_ pos: U32) -> PageHeader? {
+        let addr = pageAddr(pos)
+        if bm_read32(addr) != Self.magic { return nil }
+
+        let seq = bm_read32(addr + 4)
+        let base = bm_read32(addr + 8)
+        let cu = bm_read32(addr + 12)
+        let count = Int(cu & 0xFFFF)
+        let used = Int(cu >> 16)
+        if Self.headerBytes + used > pageSize { return nil }
+
+        var crc: U32 = 0xFFFF_FFFF
+        var i = 4
+        while i < 16 {
+            crc = crc32Update(crc, _flog_flashByte(addr + U32(i)))
+            i += 1
+        }
+        i = 0
+        while i < used {
+            crc = crc32Update(crc, _flog_flashByte(addr + U32(Self.headerBytes + i)))
+            i += 1
+        }
+        if ~crc != bm_read32(addr + 16) { return nil }
+
+        return PageHeader(seq: seq, baseTime: base, count: count, used: used)
+    }
+
+    @inline(__always)
+    fileprivate func pageAddr(_ pos: U32) -> U32 {
+        cfg.pageAddr + pos * U32(pageSize)
+    }
+
+    // MARK: - Internals: page building
+
+    private func resetFill() {
+        fillUsed = 0
+        fillCount = 0
+    }
+
+    private func startPage(at t: U32) {
+        fillBase = t
+        lastTime = t
+        lastValue = 0
+    }
+
+    private func recordLength(timeMs: U32, value: Int32) -> Int {
+        Self.varintLen(timeMs &- lastTime) + Self.varintLen(Self.zigzag(value &- lastValue))
+    }
+
+    /// Write header + CRC + 0xFF padding for the page image at buf[b * pageSize].
+    private func finishImage(_ b: Int, seq: U32, baseTime: U32, count: Int, used: Int) {
+        let o = b * pageSize
+        putU32(Self.magic, at: o)
+        putU32(seq, at: o + 4)
+        putU32(baseTime, at: o + 8)
+        putU32(U32(count & 0xFFFF) | (U32(used) << 16), at: o + 12)
+
+        var i = Self.headerBytes + used
+        while i < pageSize {
+            buf[o + i] = 0xFF
+            i += 1
+        }
+
+        var crc: U32 = 0xFFFF_FFFF
+        i = 4
+        while i < 16 {
+            crc = crc32Update(crc, buf[o + i])
+            i += 1
+        }
+        i = 0
+        while i < used {
+            crc = crc32Update(crc, buf[o + Self.headerBytes + i])
+            i += 1
+        }
+        putU32(~crc, at: o + 16)
+    }
+
+    /// Hand the fill page to the programming pipeline. False if it is still busy.
+    private func seal() -> Bool {
+        pump()
+        guard case .idle = stage else { return false }
+        if fillCount == 0 { return true }
+
+        finishImage(fillBuf, seq: nextSeq, baseTime: fillBase, count: fillCount, used: fillUsed)
+
+        sealedBuf = fillBuf
+        sealedPos = headPos
+        fillBuf = (fillBuf == 0) ? 1 : 0
+        headPos = (headPos + 1) % cfg.pageCount
+        nextSeq &+= 1
+        resetFill()
+
+        stage = .writePending
+
+        // Ring full? Merge the two oldest pages before the oldest slot is reused.
+        if cfg.compaction && cfg.pageCount >= 3 {
+            _ = eefc1WaitNotInFlight()
+            let next = (sealedPos + 1) % cfg.pageCount
+            if let h0 = readHeader(sealedPos), let h1 = readHeader(next) {
+                if buildMerged(h0, at: sealedPos, h1, at: next) {
+                    mergedPos = next
+                    stage = .compactPending
+                }
+            }
+        }
+
+        pump()
+        return true
+    }
+
+    /// Decimate the records of two pages into buf[2] (keeps the newer page's seq).
+    private func buildMerged(_ h0: PageHeader, at p0: U32, _ h1: PageHeader, at p1: U32) -> Bool {
+        let total = h0.count + h1.count
+        if total == 0 { return false }
+
+        let o = 2 * pageSize
+        var factor = 2
+        while factor <= total {
+            var r0 = PageReader(addr: pageAddr(p0), inTail: false, end: Self.headerBytes + h0.used,
+                                remaining: h0.count, time: h0.baseTime)
+            var r1 = PageReader(addr: pageAddr(p1), inTail: false, end: Self.headerBytes + h1.used,
+                                remaining: h1.count, time: h1.baseTime)
+
+            var used = 0
+            var count = 0
+            var base: U32 = 0
+            var t: U32 = 0
+            var v: Int32 = 0
+            var idx = 0
+            var fits = true
+
+            while true {
+                var rec = r0.next(log: self, tail: [])
+                if rec == nil { rec = r1.next(log: self, tail: []) }
+                guard let r = rec else { break }
+
+                if idx % factor == 0 {
+                    if count == 0 {
+                        base = r.timeMs
+                        t = base
+                        v = 0
+                    }
+                    let dt = r.timeMs &- t
+                    let dv = Self.zigzag(r.value &- v)
+                    let n = Self.varintLen(dt) + Self.varintLen(dv)
+                    if Self.headerBytes + used + n > pageSize {
+                        fits = false
+                        break
+                    }
+                    var w = putVarint(dt, at: o + Self.headerBytes + used)
+                    w += putVarint(dv, at: o + Self.headerBytes + used + w)
+                    used += w
+                    count += 1
+                    t = r.timeMs
+                    v = r.value
+                }
+                idx += 1
+            }
+
+            if fits {
+                finishImage(2, seq: h1.seq, baseTime: base, count: count, used: used)
+                return true
+            }
+            factor += 1
+        }
+        return false
+    }
+
+    // MARK: - Internals: programming pipeline
+
+    private func pump() {
+        switch stage {
+        case .idle:
+            return
+
+        case .compactPending:
+            if startProgram(buffer: 2, pos: mergedPos) { stage = .compacting }
+
+        case .writePending:
+            if startProgram(buffer: sealedBuf, pos: sealedPos) { stage = .writing }
+
+        case .compacting, .writing:
+            if eefc1CommitFlag() != EEFCCommitFlag.done { return }
+            let fsr = eefc1TakeFSR()
+
+            let compacting: Bool
+            if case .compacting = stage { compacting = true } else { compacting = false }
+            let b = compacting ? 2 : sealedBuf
+            let pos = compacting ? mergedPos : sealedPos
+            if !programOk(fsr: fsr, buffer: b, pos: pos) { stats.flashErrors &+= 1 }
+
+            if compacting {
+                stats.compactions &+= 1
+                stage = .writePending
+                pump()
+            } else {
+                stats.pagesWritten &+= 1
+                stage = .idle
+            }
+        }
+    }
+
+    private func startProgram(buffer b: Int, pos: U32) -> Bool {
+        if !eefc1Claim() { return false }   // KV commit in flight: retry on next poll
+
+        let ok = buf.withUnsafeBufferPointer { p -> Bool in
+            eefc1StartEWP(
+                addr: pageAddr(pos),
+                pageIndex: cfg.bank1PageIndex + pos,
+                src: p.baseAddress! + b * pageSize,
+                count: pageSize
+            )
+        }
+
+        if !ok {
+            eefc1Release()
+            stats.flashErrors &+= 1
+            return false
+        }
+        eefc1ArmFRDY()
+        return true
+    }
+
+    private func programOk(fsr: U32, buffer b: Int, pos: U32) -> Bool {
+        if (fsr & (ATSAM3X8E.EEFC.FSR_FCMDE | ATSAM3X8E.EEFC.FSR_FLOCKE)) != 0 { return false }
+        let addr = pageAddr(pos)
+        var off = 0
+        while off < pageSize {
+            let w =
+                U32(buf[b * pageSize + off + 0]) |
+                (U32(buf[b * pageSize + off + 1]) << 8) |
+                (U32(buf[b * pageSize + off + 2]) << 16) |
+                (U32(buf[b * pageSize + off + 3]) << 24)
+            if bm_read32(addr + U32(off)) != w { return false }
+            off += 4
+        }
+        return true
+    }
+
+    private func waitPipelineIdle(timeout: U32) -> Bool {
+        waitUntil(timeout) {
+            pump()
+            if case .idle = stage { return true }
+            return false
+        }
+    }
+
+    // MARK: - Small utilities
+
+    @inline(__always)
+    private func putU32(_ v: U32, at o: Int) {
+        buf[o + 0] = UInt8(v & 0xFF)
+        buf[o + 1] = UInt8((v >> 8) & 0xFF)
+        buf[o + 2] = UInt8((v >> 16) & 0xFF)
+        buf[o + 3] = UInt8((v >> 24) & 0xFF)
+    }
+
+    /// Unsigned LEB128. Returns bytes written.
+    @inline(__always)
+    private func putVarint(_ value: U32, at o: Int) -> Int {
+        var v = value
+        var n = 0
+        while v >= 0x80 {
+            buf[o + n] = UInt8(v & 0x7F) | 0x80
+            v >>= 7
+            n += 1
+        }
+        buf[o + n] = UInt8(v)
+        return n + 1
+    }
+
+    @inline(__always)
+    private static func varintLen(_ v: U32) -> Int {
+        if v < (U32(1) << 7) { return 1 }
+        if v < (U32(1) << 14) { return 2 }
+        if v < (U32(1) << 21) { return 3 }
+        if v < (U32(1) << 28) { return 4 }
+        return 5
+    }
+
+    @inline(__always)
+    fileprivate static func zigzag(_ v: Int32) -> U32 {
+        U32(bitPattern: (v << 1) ^ (v >> 31))
+    }
+
+    @inline(__always)
+    fileprivate static func unzigzag(_ v: U32) -> Int32 {
+        Int32(bitPattern: (v >> 1) ^ (0 &- (v & 1)))
+    }
+
+    @inline(__always)
+    fileprivate static func isNewer(_ a: U32, than b: U32) -> Bool {
+        Int32(bitPattern: a &- b) > 0
+    }
+
+    @inline(__always)
+    fileprivate static func isAtOrAfter(_ a: U32, _ b: U32) -> Bool {
+        Int32(bitPattern: a &- b) >= 0
+    }
+}
+
+// MARK: - Local helpers (file-scoped, unique names)
+
+@inline(__always)
+private func _flog_flashByte(_ addr: U32) -> UInt8 {
+    let w = bm_read32(addr & ~U32(3))
+    return UInt8(truncatingIfNeeded: w >> ((addr & 3) * 8))
+}
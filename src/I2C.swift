@@ -54,6 +54,7 @@ public final class I2C {
     private static let PTCR_TXTDIS: U32 = (U32(1) << 9)
 
     private var mode: Mode = .idle
+    private var clockHeld = false
 
     // ---------- Master TX state ----------
     private var masterTxAddress: UInt8 = 0
@@ -169,6 +170,18 @@ public final class I2C {
         slaveTxLen = 0
     }
 
+    /// Disable master/slave and release the TWI + PIO clocks. begin() again to reuse.
+    public func end() {
+        if !clockHeld { return }
+        write32(REG_CR, ATSAM3X8E.TWI.CR_SVDIS | ATSAM3X8E.TWI.CR_MSDIS)
+        PeripheralClock.release(bus == .wire ? ATSAM3X8E.ID.TWI1 : ATSAM3X8E.ID.TWI0)
+        PeripheralClock.release(ATSAM3X8E.ID.PIOB)
+        PeripheralClock.release(ATSAM3X8E.ID.PIOA)
+        clockHeld = false
+        mode = .idle
+        slaveState = .idle
+    }
+
     /// Set bus speed (Master only)
     public func setClock(_ hz: U32) {
         if hz == 0 { return }
@@ -413,21 +426,22 @@ public final class I2C {
 
     @inline(__always)
     private func configurePinsAndClock() {
-        pmcEnable(peripheralID: ATSAM3X8E.ID.PIOA)
-        pmcEnable(peripheralID: ATSAM3X8E.ID.PIOB)
+        // Clocks once per begin()..end(): begin() may be called again to switch mode.
+        if !clockHeld {
+            pmcEnable(peripheralID: ATSAM3X8E.ID.PIOA)
+            pmcEnable(peripheralID: ATSAM3X8E.ID.PIOB)
+            pmcEnable(peripheralID: bus == .wire ? ATSAM3X8E.ID.TWI1 : ATSAM3X8E.ID.TWI0)
+            clockHeld = true
+        }
 
-        switch bus {
-        case .wire:
+        if bus == .wire {
             configureWirePins_TWI1_PB12_PB13()
-            pmcEnable(peripheralID: ATSAM3X8E.ID.TWI1)
-        case .wire1:
-            pmcEnable(peripheralID: ATSAM3X8E.ID.TWI0)
         }
     }
 
     @inline(__always)
     private func pmcEnable(peripheralID: U32) {
-        write32(ATSAM3X8E.PMC.PCER0, U32(1) << peripheralID)
+        PeripheralClock.acquire(peripheralID)
     }
 
     private func configureWirePins_TWI1_PB12_PB13() {
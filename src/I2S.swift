@@ -0,0 +1,466 @@
+//
+// I2S.swift — I2S audio streaming on the SSC with DMAC ping-pong buffers.
+//
+// Goals:
+// - Digital audio in and out (I2S codecs, MEMS microphones, DACs) with the
+//   CPU touching samples only in a processing callback, once per half buffer.
+// - Master (SSC drives BCLK/WS from MCK) or slave (codec drives them);
+//   16-bit, 24-bit (in 32-bit slots) or 32-bit stereo frames.
+// - Ping-pong: each direction is one looping DMA chain over two halves. When
+//   a half completes, the processor gets the input half just captured and
+//   the output half just played, and fills the output half in place.
+// - Fits fixed-point DSP: samples are interleaved L/R Int16 (Q15) or Int32
+//   (Q31, 24-bit samples left-justified), the block size is fixed.
+// - Reports underruns/overruns (processing late), SSC overruns, processing
+//   cycles per block (CPU load) and the end-to-end latency.
+//
+// Notes:
+// - Clocking (master): BCLK = MCK / (2 * DIV), so sample rates are
+//   approximate: 48 kHz / 16-bit -> DIV 27 -> 48.6 kHz (+1.3 %). clock()
+//   reports the rate actually produced. The SSC has no MCLK output: a codec
+//   that needs one runs as master (I2S slave here) or takes its own crystal.
+// - Duplex: the receiver shares the transmitter's clock and frame start, so
+//   input half N and output half N line up; latency = 2 halves + 1 frame.
+// - Config.loopback connects TD->RD inside the SSC (no codec needed).
+// - Master mode always runs the transmitter (it generates the clocks); with
+//   .input it sends silence.
+// - The processor runs from DMAC_Handler (IRQ context) or from poll() when
+//   IRQs are off. It must finish within one half buffer; "late" is counted.
+// - Buffers are allocated on the heap at the first begin() and reused when
+//   a later begin() fits in them.
+// - The SSC clock is held from begin() to stop(); start() takes it again
+//   after a stop() (the SSC keeps its configuration while gated).
+// - Pins: TK = D23 (PA14), TF = D24 (PA15), TD = A0 (PA16);
+//   RF = A8 (PB17), RD = A9 (PB18), RK = A10 (PB19).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32
+// - DMA.swift: two channels, looping LLI chains (sscTx / sscRx interfaces)
+// - ATSAM3X8E.swift: SSC registers/bitfields, PMC, PIO
+// - Timer.swift: CycleCounter (processing time)
+//
+
+public final class I2S {
+
+    // MARK: - Public types
+
+    public enum Role {
+        case master             // SSC drives BCLK (TK) and WS (TF)
+        case slave              // codec drives BCLK and WS
+    }
+
+    public enum Format {
+        case s16                // 16-bit slots, Int16 in memory
+        case s24                // 32-bit slots, Int32 in memory (sample << 8)
+        case s32                // 32-bit slots, Int32 in memory
+
+        public var slotBits: U32 { self == .s16 ? 16 : 32 }
+        public var bytesPerSample: Int { self == .s16 ? 2 : 4 }
+    }
+
+    public enum Direction {
+        case output
+        case input
+        case duplex
+    }
+
+    public enum Half {
+        case first
+        case second
+    }
+
+    public struct Config {
+        public var sampleRate: U32
+        public var format: Format
+        public var role: Role
+        public var direction: Direction
+        public var framesPerHalf: Int       // stereo frames per half buffer
+        public var loopback: Bool
+
+        public init(
+            sampleRate: U32 = 48_000,
+            format: Format = .s16,
+            role: Role = .master,
+            direction: Direction = .duplex,
+            framesPerHalf: Int = 64,
+            loopback: Bool = false
+        ) {
+            self.sampleRate = sampleRate
+            self.format = format
+            self.role = role
+            self.direction = direction
+            self.framesPerHalf = framesPerHalf
+            self.loopback = loopback
+        }
+    }
+
+    /// Master clock derived from MCK.
+    public struct Clock {
+        public let divider: U32             // CMR.DIV
+        public let bitClockHz: U32
+        public let sampleRate: U32          // actually produced
+        public let errorPpm: Int32          // vs. requested
+    }
+
+    /// One half buffer handed to the processor: interleaved L/R samples.
+    public struct Block {
+        public let half: Half
+        public let frames: Int
+        public let format: Format
+        public let input: UnsafeMutableRawPointer?      // nil for .output
+        public let output: UnsafeMutableRawPointer?     // nil for .input
+
+        public var input16: UnsafeMutablePointer<Int16>? { input?.assumingMemoryBound(to: Int16.self) }
+        public var output16: UnsafeMutablePointer<Int16>? { output?.assumingMemoryBound(to: Int16.self) }
+        public var input32: UnsafeMutablePointer<Int32>? { input?.assumingMemoryBound(to: Int32.self) }
+        public var output32: UnsafeMutablePointer<Int32>? { output?.assumingMemoryBound(to: Int32.self) }
+    }
+
+    public typealias Processor = (Block) -> Void
+
+    public struct Stats {
+        public var blocks: U32 = 0
+        public var underruns: U32 = 0           // output half still playing when written
+        public var overruns: U32 = 0            // input half overwritten before processed
+        public var sscOverruns: U32 = 0         // RHR overwritten (DMA starved)
+        public var lastProcessCycles: U32 = 0
+        public var maxProcessCycles: U32 = 0
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case invalidConfig
+        case sampleRateUnreachable
+        case noDMAChannel
+        case dmaStartFailed
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .invalidConfig: return "invalid_config"
+            case .sampleRateUnreachable: return "sample_rate_unreachable"
+            case .noDMAChannel: return "no_dma_channel"
+            case .dmaStartFailed: return "dma_start_failed"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .invalidConfig: return "framesPerHalf must be 1...16383 and the rate non-zero."
+            case .sampleRateUnreachable: return "Sample rate not reachable with BCLK = MCK / (2 * DIV)."
+            case .noDMAChannel: return "No free DMAC channel."
+            case .dmaStartFailed: return "DMA channel busy; stop() first."
+            }
+        }
+    }
+
+    // MARK: - State
+
+    public private(set) var stats = Stats()
+    public private(set) var config = Config()
+    public private(set) var clock: Clock? = nil
+    public private(set) var isRunning = false
+
+    private let mckHz: U32
+    private var clockHeld = false
+    private var processor: Processor? = nil
+    private var txDMA: DMA.Channel? = nil
+    private var rxDMA: DMA.Channel? = nil
+    private let txChain = DMA.Chain(capacity: 2)
+    private let rxChain = DMA.Chain(capacity: 2)
+    private var txBuf: UnsafeMutableRawPointer? = nil
+    private var rxBuf: UnsafeMutableRawPointer? = nil
+    private var bufBytes = 0                    // capacity of each buffer (both halves)
+    private var halfBytes = 0
+
+    // MARK: - Init
+
+    public init(mckHz: U32) {
+        self.mckHz = mckHz
+    }
+
+    /// Closest master clock for `sampleRate` (nil if out of DIV range).
+    public static func clock(sampleRate: U32, format: Format, mckHz: U32) -> Clock? {
+        if sampleRate == 0 { return nil }
+        let bclk = UInt64(sampleRate) * 2 * UInt64(format.slotBits)
+        let div = (UInt64(mckHz) + bclk) / (2 * bclk)           // round(MCK / (2 * bclk))
+        if div == 0 || div > UInt64(ATSAM3X8E.SSC.CMR_DIV_MASK) { return nil }
+        let actualBclk = UInt64(mckHz) / (2 * div)
+        let actualRate = actualBclk / (2 * UInt64(format.slotBits))
+        let ppm = (Int64(actualRate) - Int64(sampleRate)) * 1_000_000 / Int64(sampleRate)
+        return Clock(divider: U32(div), bitClockHz: U32(actualBclk), sampleRate: U32(actualRate), errorPpm: Int32(ppm))
+    }
+
+    // MARK: - Setup
+
+    /// Configure SSC + DMA (stopped). `processor` is called once per half.
+    @discardableResult
+    public func begin(_ config: Config, processor: @escaping Processor) throws(I2S.Error) -> Clock? {
+        if config.framesPerHalf <= 0 || config.framesPerHalf > 16383 || config.sampleRate == 0 {
+            throw .invalidConfig
+        }
+        stop()
+
+        var clk: Clock? = nil
+        if config.role == .master {
+            guard let c = Self.clock(sampleRate: config.sampleRate, format: config.format, mckHz: mckHz) else {
+                throw .sampleRateUnreachable
+            }
+            clk = c
+        }
+
+        if txDMA == nil && usesTx(config) {
+            guard let ch = DMA.allocate() else { throw .noDMAChannel }
+            txDMA = ch
+        }
+        if rxDMA == nil && config.direction != .output {
+            guard let ch = DMA.allocate() else { throw .noDMAChannel }
+            rxDMA = ch
+        }
+
+        self.config = config
+        self.clock = clk
+        self.processor = processor
+        allocateBuffers()
+
+        holdClock()
+        write32(ATSAM3X8E.SSC.CR, ATSAM3X8E.SSC.CR_SWRST)
+        write32(ATSAM3X8E.SSC.IDR, 0xFFFF_FFFF)
+        configurePins(config)
+        configureSSC(config, clk)
+        return clk
+    }
+
+    /// Start streaming from the first half (output starts with silence).
+    public func start() throws(I2S.Error) {
+        if isRunning { return }
+        holdClock()
+        if let tx = txBuf { tx.initializeMemory(as: UInt8.self, repeating: 0, count: bufBytes) }
+
+        let width: DMA.Width = config.format == .s16 ? .halfword : .word
+        let beats = U32(config.framesPerHalf * 2)
+        let rx = config.direction != .output
+
+        if let ch = rxDMA, rx, let buf = rxBuf {
+            let flow = DMA.Flow.peripheralToMemory
+            rxChain.reset()
+            for h in [Half.first, Half.second] {
+                rxChain.append(
+                    DMA.Block(source: ATSAM3X8E.SSC.RHR, destination: address(buf) + U32(offset(h)),
+                              count: beats, width: width, flow: flow),
+                    flow: flow
+                )
+            }
+            rxChain.closeLoop()
+            if !ch.startLoop(rxChain, config: DMA.Config(flow: flow, interface: .sscRx),
+                             onBlock: { _ in self.rxBlockDone() }) {
+                throw .dmaStartFailed
+            }
+        }
+        if let ch = txDMA, let buf = txBuf {
+            let flow = DMA.Flow.memoryToPeripheral
+            txChain.reset()
+            for h in [Half.first, Half.second] {
+                txChain.append(
+                    DMA.Block(source: address(buf) + U32(offset(h)), destination: ATSAM3X8E.SSC.THR,
+                              count: beats, width: width, flow: flow),
+                    flow: flow
+                )
+            }
+            txChain.closeLoop()
+            if !ch.startLoop(txChain, config: DMA.Config(flow: flow, interface: .sscTx),
+                             onBlock: { _ in self.txBlockDone() }) {
+                rxDMA?.abort()
+                throw .dmaStartFailed
+            }
+        }
+
+        _ = read32(ATSAM3X8E.SSC.SR)
+        // Receiver first: in duplex it waits for the transmitter's first frame.
+        write32(ATSAM3X8E.SSC.CR, (rx ? ATSAM3X8E.SSC.CR_RXEN : 0) | (txDMA != nil ? ATSAM3X8E.SSC.CR_TXEN : 0))
+        isRunning = true
+    }
+
+    /// Stop streaming and release the SSC clock.
+    public func stop() {
+        if isRunning {
+            write32(ATSAM3X8E.SSC.CR, ATSAM3X8E.SSC.CR_TXDIS | ATSAM3X8E.SSC.CR_RXDIS)
+            txDMA?.abort()
+            rxDMA?.abort()
+            isRunning = false
+        }
+        if clockHeld {
+            PeripheralClock.release(ATSAM3X8E.ID.SSC)
+            clockHeld = false
+        }
+    }
+
+    /// Service the DMA channels when IRQs are off (runs the processor).
+    public func poll() {
+        rxDMA?.poll()
+        txDMA?.poll()
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - Figures
+
+    /// Input sample to output sample through the processor (duplex), or
+    /// processor write to end of playback (output), in frames.
+    public var latencyFrames: U32 {
+        U32(2 * config.framesPerHalf + 1)
+    }
+
+    public var latencyMicros: U32 {
+        let rate = clock?.sampleRate ?? config.sampleRate
+        return rate == 0 ? 0 : U32(UInt64(latencyFrames) * 1_000_000 / UInt64(rate))
+    }
+
+    /// Worst processing time as a share of the half-buffer period.
+    public var cpuLoadPermille: U32 {
+        let rate = UInt64(clock?.sampleRate ?? config.sampleRate)
+        if rate == 0 { return 0 }
+        let budget = UInt64(mckHz) * UInt64(config.framesPerHalf) / rate
+        return budget == 0 ? 0 : U32(UInt64(stats.maxProcessCycles) * 1000 / budget)
+    }
+
+    // MARK: - Block callbacks (DMAC_Handler or poll())
+
+    private func txBlockDone() {
+        // Duplex is paced by the receiver; output-only by the transmitter.
+        if config.direction != .output { return }
+        guard let ch = txDMA, let tx = txBuf else { return }
+        let playing = halfOf(ch.sourceAddress, tx)
+        let free: Half = playing == .first ? .second : .first
+        run(free, input: nil, output: tx + offset(free))
+        if halfOf(ch.sourceAddress, tx) == free { stats.underruns &+= 1 }
+    }
+
+    private func rxBlockDone() {
+        guard let ch = rxDMA, let rx = rxBuf else { return }
+        if (read32(ATSAM3X8E.SSC.SR) & ATSAM3X8E.SSC.SR_OVRUN) != 0 { stats.sscOverruns &+= 1 }
+        let filling = halfOf(ch.destinationAddress, rx)
+        let done: Half = filling == .first ? .second : .first
+
+        var out: UnsafeMutableRawPointer? = nil
+        if config.direction == .duplex, let tx = txBuf { out = tx + offset(done) }
+        run(done, input: rx + offset(done), output: out)
+
+        if halfOf(ch.destinationAddress, rx) == done { stats.overruns &+= 1 }
+        if config.direction == .duplex, let t = txDMA, let tx = txBuf, halfOf(t.sourceAddress, tx) == done {
+            stats.underruns &+= 1
+        }
+    }
+
+    private func run(_ half: Half, input: UnsafeMutableRawPointer?, output: UnsafeMutableRawPointer?) {
+        let t0 = CycleCounter.now()
+        processor?(Block(half: half, frames: config.framesPerHalf, format: config.format, input: input, output: output))
+        let dt = CycleCounter.now() &- t0
+        stats.blocks &+= 1
+        stats.lastProcessCycles = dt
+        if dt > stats.maxProcessCycles { stats.maxProcessCycles = dt }
+    }
+
+    // MARK: - Internals
+
+    private func holdClock() {
+        if clockHeld { return }
+        PeripheralClock.acquire(ATSAM3X8E.ID.SSC)
+        clockHeld = true
+    }
+
+    private func usesTx(_ c: Config) -> Bool {
+        c.direction != .input || c.role == .master
+    }
+
+    @inline(__always)
+    private func offset(_ h: Half) -> Int {
+        h == .first ? 0 : halfBytes
+    }
+
+    @inline(__always)
+    private func halfOf(_ address: U32, _ base: UnsafeMutableRawPointer) -> Half {
+        address &- self.address(base) < U32(halfBytes) ? .first : .second
+    }
+
+    @inline(__always)
+    private func address(_ p: UnsafeMutableRawPointer) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+
+    private func allocateBuffers() {
+        halfBytes = config.framesPerHalf * 2 * config.format.bytesPerSample
+        let need = 2 * halfBytes
+        if need > bufBytes {
+            // Bump heap: grow only, never freed.
+            txBuf = UnsafeMutableRawPointer.allocate(byteCount: need, alignment: 4)
+            rxBuf = UnsafeMutableRawPointer.allocate(byteCount: need, alignment: 4)
+            bufBytes = need
+        }
+    }
+
+    private func configurePins(_ c: Config) {
+        if usesTx(c) {
+            write32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.SSC.PIOA_TX_MASK)
+            setBits32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.SSC.PIOA_TX_MASK)   // B
+        }
+        if c.direction != .output && !c.loopback {
+            write32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.SSC.PIOB_RX_MASK)
+            clearBits32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.SSC.PIOB_RX_MASK) // A
+        }
+    }
+
+    private func configureSSC(_ c: Config, _ clk: Clock?) {
+        let bits = c.format.slotBits
+        let datlen = (bits - 1) & ATSAM3X8E.SSC.FMR_DATLEN_MASK
+        let delay1 = U32(1) << ATSAM3X8E.SSC.CMR_STTDLY_SHIFT       // I2S: data one BCLK after WS
+
+        // Transmitter
+        if c.role == .master {
+            write32(ATSAM3X8E.SSC.CMR, clk?.divider ?? 1)
+            // WS = TF: low for one slot (left), high for the next (right).
+            write32(
+                ATSAM3X8E.SSC.TCMR,
+                ATSAM3X8E.SSC.CMR_CKS_MCK | ATSAM3X8E.SSC.CMR_CKO_CONTINUOUS | ATSAM3X8E.SSC.CMR_START_FALLING |
+                    delay1 | ((bits - 1) << ATSAM3X8E.SSC.CMR_PERIOD_SHIFT)
+            )
+            write32(
+                ATSAM3X8E.SSC.TFMR,
+                datlen | ATSAM3X8E.SSC.FMR_MSBF | (U32(1) << ATSAM3X8E.SSC.FMR_DATNB_SHIFT) |
+                    ATSAM3X8E.SSC.FMR_FSOS_NEGATIVE |
+                    (((bits - 1) & 0x0F) << ATSAM3X8E.SSC.FMR_FSLEN_SHIFT) |
+                    (((bits - 1) >> 4) << ATSAM3X8E.SSC.FMR_FSLEN_EXT_SHIFT)
+            )
+        } else {
+            // One word per WS edge: L on falling, R on rising.
+            write32(
+                ATSAM3X8E.SSC.TCMR,
+                ATSAM3X8E.SSC.CMR_CKS_PIN | ATSAM3X8E.SSC.CMR_START_EDGE | delay1
+            )
+            write32(ATSAM3X8E.SSC.TFMR, datlen | ATSAM3X8E.SSC.FMR_MSBF | ATSAM3X8E.SSC.FMR_FSOS_NONE)
+        }
+
+        // Receiver
+        if c.direction != .output {
+            let loop = c.loopback ? ATSAM3X8E.SSC.FMR_LOOP : 0
+            if usesTx(c) {
+                // Same clock and frame start as the transmitter.
+                write32(
+                    ATSAM3X8E.SSC.RCMR,
+                    ATSAM3X8E.SSC.CMR_CKS_TK | ATSAM3X8E.SSC.CMR_CKI | ATSAM3X8E.SSC.CMR_START_TRANSMIT | delay1
+                )
+                let words: U32 = c.role == .master ? 1 : 0
+                write32(ATSAM3X8E.SSC.RFMR, datlen | loop | ATSAM3X8E.SSC.FMR_MSBF | (words << ATSAM3X8E.SSC.FMR_DATNB_SHIFT))
+            } else {
+                // Slave, input only: RK/RF pins, one word per WS edge.
+                write32(
+                    ATSAM3X8E.SSC.RCMR,
+                    ATSAM3X8E.SSC.CMR_CKS_PIN | ATSAM3X8E.SSC.CMR_CKI | ATSAM3X8E.SSC.CMR_START_EDGE | delay1
+                )
+                write32(ATSAM3X8E.SSC.RFMR, datlen | loop | ATSAM3X8E.SSC.FMR_MSBF)
+            }
+        }
+    }
+}
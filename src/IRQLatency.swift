@@ -0,0 +1,209 @@
+//
+// IRQLatency.swift — interrupt latency suite (entry, tail-chaining, preemption).
+//
+// Goals:
+// - Measure, in CPU cycles (DWT), for two software-pended IRQs A and B at
+//   given priorities and grouping:
+//   - entry:      pend A from thread mode -> first line of A's handler
+//   - tail-chain: exit of the first handler -> first line of the second
+//                 (both pended while PRIMASK is set)
+//   - preempt:    A pends B -> first line of B's handler. If B cannot
+//                 preempt, this includes the rest of A (holdCycles).
+// - configs: one entry per grouping / priority pair worth comparing.
+//
+// Notes:
+// - A and B are the TC6 / TC7 vectors (NVIC.IRQ.latencyA / .latencyB): the
+//   TCs are never clocked, the lines are pended by software only.
+// - Numbers include the Swift prologue and one DWT read; the cost of two
+//   back-to-back DWT reads is subtracted. Flash wait states show up as
+//   jitter (min/max).
+// - run() leaves IRQs enabled (PRIMASK cleared) and the previous grouping
+//   restored. SysTick and other enabled IRQs may land in a sample: read min
+//   as the cost, max as the jitter.
+//
+// Dependencies:
+// - NVIC.swift: pend/enable/disable, grouping, priorities
+// - Timer.swift: CycleCounter (Board enables it)
+// - MMIO.swift: bm_enable_irq/bm_disable_irq, bm_dsb/bm_isb, spin
+// - arm/startup.s: TC6_Handler / TC7_Handler (IRQ 33 / 34)
+//
+
+// ISR targets. MUST be global and single symbol.
+public var g_irqLatMode: U32 = 0
+public var g_irqLatAEntry: U32 = 0
+public var g_irqLatAExit: U32 = 0
+public var g_irqLatBEntry: U32 = 0
+public var g_irqLatBExit: U32 = 0
+public var g_irqLatPendAt: U32 = 0
+
+public enum IRQLatency {
+
+    // MARK: - Public types
+
+    public struct Config {
+        public let name: String
+        public let grouping: NVIC.Grouping
+        public let aPreempt: U32
+        public let aSub: U32
+        public let bPreempt: U32
+        public let bSub: U32
+    }
+
+    public struct Span {
+        public var min: U32 = 0xFFFF_FFFF
+        public var max: U32 = 0
+
+        mutating func add(_ v: U32) {
+            if v < min { min = v }
+            if v > max { max = v }
+        }
+    }
+
+    public struct Result {
+        public let name: String
+        public let entry: Span
+        public let tailChain: Span
+        public let preempt: Span
+        public let preempted: Bool          // B ran before A returned
+    }
+
+    // MARK: - Configurations
+
+    /// B is always the more urgent IRQ (or equal).
+    public static let configs: [Config] = [
+        // Equal priority: B waits for A, then tail-chains.
+        Config(name: "same_level", grouping: .preempt2, aPreempt: 2, aSub: 0, bPreempt: 2, bSub: 0),
+        // Sub only: B first when both pend, but never preempts.
+        Config(name: "sub_only", grouping: .preempt2, aPreempt: 2, aSub: 1, bPreempt: 2, bSub: 0),
+        // The plan's shape: B one preempt level above A.
+        Config(name: "preempt", grouping: .preempt2, aPreempt: 2, aSub: 0, bPreempt: 1, bSub: 0),
+        // Reset grouping: the same bytes as sub_only now preempt.
+        Config(name: "preempt4", grouping: .preempt4, aPreempt: 9, aSub: 0, bPreempt: 8, bSub: 0),
+        // No preemption at all, 16 sub levels.
+        Config(name: "preempt0", grouping: .preempt0, aPreempt: 0, aSub: 9, bPreempt: 0, bSub: 8),
+    ]
+
+    /// Busy time in A after it pends B (spin() iterations).
+    public static var holdCycles: U32 = 100
+
+    static let modeEntry: U32 = 0
+    static let modeTailChain: U32 = 1
+    static let modePreempt: U32 = 2
+
+    private static let a = NVIC.IRQ.latencyA.rawValue
+    private static let b = NVIC.IRQ.latencyB.rawValue
+
+    // MARK: - Run
+
+    public static func runAll(samples: U32 = 32) -> [Result] {
+        var out: [Result] = []
+        for c in configs { out.append(run(c, samples: samples)) }
+        return out
+    }
+
+    /// `samples` of each measurement under `config`.
+    public static func run(_ config: Config, samples: U32 = 32) -> Result {
+        let saved = NVIC.grouping
+        NVIC.setGrouping(config.grouping)
+        NVIC.setPriority(a, preempt: config.aPreempt, sub: config.aSub)
+        NVIC.setPriority(b, preempt: config.bPreempt, sub: config.bSub)
+        NVIC.clearPending(a)
+        NVIC.clearPending(b)
+        NVIC.enable(a)
+        NVIC.enable(b)
+        bm_enable_irq()
+
+        let overhead = readCost()
+        var entry = Span()
+        var tail = Span()
+        var preempt = Span()
+        var preempted = true
+
+        var i: U32 = 0
+        while i < samples {
+            entry.add(measureEntry() &- overhead)
+            tail.add(measureTailChain() &- overhead)
+            let p = measurePreempt()
+            preempt.add(p.delay &- overhead)
+            if !p.preempted { preempted = false }
+            i += 1
+        }
+
+        NVIC.disable(a)
+        NVIC.disable(b)
+        NVIC.setGrouping(saved)
+        return Result(name: config.name, entry: entry, tailChain: tail, preempt: preempt, preempted: preempted)
+    }
+
+    // MARK: - Measurements
+
+    private static func measureEntry() -> U32 {
+        g_irqLatMode = modeEntry
+        let t0 = CycleCounter.now()
+        NVIC.pend(a)
+        bm_dsb()
+        bm_isb()
+        return g_irqLatAEntry &- t0
+    }
+
+    private static func measureTailChain() -> U32 {
+        g_irqLatMode = modeTailChain
+        bm_disable_irq()
+        NVIC.pend(a)
+        NVIC.pend(b)
+        bm_dsb()
+        bm_enable_irq()
+        bm_isb()
+        // Both ran: the second entry minus the first exit.
+        let bFirst = (g_irqLatAEntry &- g_irqLatBEntry) < 0x8000_0000
+        return bFirst ? g_irqLatAEntry &- g_irqLatBExit : g_irqLatBEntry &- g_irqLatAExit
+    }
+
+    private struct Preemption {
+        let delay: U32
+        let preempted: Bool
+    }
+
+    private static func measurePreempt() -> Preemption {
+        g_irqLatMode = modePreempt
+        NVIC.pend(a)
+        bm_dsb()
+        bm_isb()
+        let delay = g_irqLatBEntry &- g_irqLatPendAt
+        return Preemption(delay: delay, preempted: delay < (g_irqLatAExit &- g_irqLatPendAt))
+    }
+
+    /// Two back-to-back DWT reads (what every sample carries on top).
+    private static func readCost() -> U32 {
+        var best: U32 = 0xFFFF_FFFF
+        var i = 0
+        while i < 8 {
+            let c0 = CycleCounter.now()
+            let c1 = CycleCounter.now()
+            best = min(best, c1 &- c0)
+            i += 1
+        }
+        return best
+    }
+}
+
+// MARK: - Interrupt handlers
+
+@_cdecl("TC6_Handler")
+public func TC6_Handler() {
+    g_irqLatAEntry = CycleCounter.now()
+    if g_irqLatMode == IRQLatency.modePreempt {
+        g_irqLatPendAt = CycleCounter.now()
+        NVIC.pend(NVIC.IRQ.latencyB.rawValue)
+        bm_dsb()
+        bm_isb()
+        spin(IRQLatency.holdCycles)
+    }
+    g_irqLatAExit = CycleCounter.now()
+}
+
+@_cdecl("TC7_Handler")
+public func TC7_Handler() {
+    g_irqLatBEntry = CycleCounter.now()
+    g_irqLatBExit = CycleCounter.now()
+}
@@ -19,12 +19,22 @@ public func bm_enable_irq() -> Void
 @_silgen_name("bm_disable_irq")
 public func bm_disable_irq() -> Void
 
+// Retorna o PRIMASK anterior e mascara IRQs; bm_irq_restore() desfaz.
+@_silgen_name("bm_irq_save")
+public func bm_irq_save() -> U32
+
+@_silgen_name("bm_irq_restore")
+public func bm_irq_restore(_ primask: U32) -> Void
+
 @_silgen_name("bm_dsb")
 public func bm_dsb() -> Void
 
 @_silgen_name("bm_isb")
 public func bm_isb() -> Void
 
+@_silgen_name("bm_wfi")
+public func bm_wfi() -> Void
+
 // ✅ Volatile MMIO shims (support.c)
 // Esses garantem que o acesso não será otimizado/“cacheado” pelo compilador.
 @_silgen_name("bm_read32")
@@ -33,6 +43,37 @@ public func bm_read32(_ addr: U32) -> U32
 @_silgen_name("bm_write32")
 public func bm_write32(_ addr: U32, _ value: U32) -> Void
 
+@_silgen_name("bm_read8")
+public func bm_read8(_ addr: U32) -> U8
+
+@_silgen_name("bm_write8")
+public func bm_write8(_ addr: U32, _ value: U8) -> Void
+
+// ✅ Flash (support.c): banco em execução + comando EEFC rodando da RAM.
+// bm_eefc_cmd_ram: chamar com IRQs desabilitadas; retorna FSR.
+@_silgen_name("bm_running_bank")
+public func bm_running_bank() -> U32
+
+@_silgen_name("bm_eefc_cmd_ram")
+public func bm_eefc_cmd_ram(_ fcr: U32, _ fsr: U32, _ cmd: U32) -> U32
+
+// ✅ EMAC (support.c): área de DMA em .eth_dma (descritores + buffers).
+@_silgen_name("bm_eth_dma_area")
+public func bm_eth_dma_area() -> U32
+
+@_silgen_name("bm_eth_dma_size")
+public func bm_eth_dma_size() -> U32
+
+// ✅ SRAM externa (support.c): seção .ext_sram + arena livre até o fim da SRAM.
+@_silgen_name("bm_ext_sram_base")
+public func bm_ext_sram_base() -> U32
+
+@_silgen_name("bm_ext_sram_free")
+public func bm_ext_sram_free() -> U32
+
+@_silgen_name("bm_ext_sram_end")
+public func bm_ext_sram_end() -> U32
+
 // MARK: - MMIO primitives (volatile-safe)
 
 // Mantém o helper de ponteiro só pra casos muito específicos,
@@ -94,11 +135,13 @@ public func writeMasked32(_ addr: U32, _ mask: U32, _ value: U32) {
 // Em muitos MCUs, alguns registradores têm SET/CLEAR dedicados (melhor),
 // mas quando você é obrigado a fazer RMW no mesmo endereço,
 // isso evita race com IRQ (não resolve concorrência com DMA/segundo core).
+// Restaura o PRIMASK de antes: chamado com IRQs desligadas (poll() em loop
+// sem interrupções, ou aninhado), não as religa.
 @inline(__always)
 public func withIRQLocked<T>(_ body: () -> T) -> T {
-    bm_disable_irq()
+    let primask = bm_irq_save()
     let result = body()
-    bm_enable_irq()
+    bm_irq_restore(primask)
     return result
 }
 
@@ -158,4 +201,34 @@ public func waitBitSet32(_ addr: U32, _ mask: U32, timeout: U32) -> Bool {
 @inline(__always)
 public func waitBitClear32(_ addr: U32, _ mask: U32, timeout: U32) -> Bool {
     waitUntil(timeout) { (read32(addr) & mask) == 0 }
+}
+
+// MARK: - CRC32 (polinômio do zlib, bit a bit, sem tabela)
+
+// Único CRC32 do firmware (EEFC, FlashLog, EEFCTelemetry, FirmwareUpdater,
+// Profiler, Bench). Estado começa em 0xFFFF_FFFF; resultado = ~estado.
+@inline(__always)
+func crc32Update(_ state: U32, _ byte: U8) -> U32 {
+    var crc = state ^ U32(byte)
+    var i = 0
+    while i < 8 {
+        crc = (crc >> 1) ^ ((crc & 1) != 0 ? 0xEDB8_8320 : 0)
+        i += 1
+    }
+    return crc
+}
+
+func crc32Update<B: Sequence>(_ state: U32, _ bytes: B) -> U32 where B.Element == U8 {
+    var crc = state
+    for b in bytes { crc = crc32Update(crc, b) }
+    return crc
+}
+
+// Palavra em little-endian (4 bytes, LSB primeiro).
+@inline(__always)
+func crc32Update(_ state: U32, word w: U32) -> U32 {
+    var crc = crc32Update(state, U8(truncatingIfNeeded: w))
+    crc = crc32Update(crc, U8(truncatingIfNeeded: w >> 8))
+    crc = crc32Update(crc, U8(truncatingIfNeeded: w >> 16))
+    return crc32Update(crc, U8(truncatingIfNeeded: w >> 24))
 }
\ No newline at end of file
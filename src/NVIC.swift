@@ -0,0 +1,270 @@
+//
+// NVIC.swift — interrupt enable/pend, priority grouping and the priority plan.
+//
+// Goals:
+// - One place for the NVIC registers: enable/disable/pend/clear per IRQ,
+//   priority (preempt + sub) under the current grouping, system handler
+//   priorities (SVCall, PendSV, SysTick).
+// - A static priority plan: every IRQ the firmware uses is a case of
+//   NVIC.IRQ with its level in plannedLevel. Drivers call NVIC.enable(.x),
+//   which applies the planned level before enabling the line.
+//
+// Notes:
+// - Plan checks done by the compiler:
+//   - IRQ raw values are peripheral IDs: two drivers claiming one IRQ do
+//     not compile (duplicate raw value).
+//   - plannedLevel is an exhaustive switch: a new IRQ without a level does
+//     not compile.
+// - NOT checked by the compiler: Preempt / Sub have 4 cases each because
+//   planGrouping is .preempt2 (2 + 2 bits), and Level.encoded packs them
+//   with planGrouping.subBits. Changing planGrouping means resizing both
+//   enums by hand.
+// - The plan's meaning holds only while AIRCR is at .preempt2. The bytes
+//   are written once (applyPlan(), enable(_: IRQ)); under another grouping
+//   the same bytes split differently: .preempt4 (reset) makes sub levels
+//   preempt, .preempt0 removes preemption. Board.initBoard() calls
+//   applyPlan(); IRQLatency.run() switches the grouping for its
+//   measurement and restores it afterwards.
+// - SAM3X implements the top 4 priority bits (16 levels).
+// - Lower number = more urgent. An IRQ preempts only with a lower preempt
+//   level; sub only orders pending IRQs of the same preempt level.
+// - IRQLatency.swift measures entry, tail-chaining and preemption per grouping.
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, bm_read8/bm_write8
+// - ATSAM3X8E.swift: NVIC, SCB, ID
+//
+
+public enum NVIC {
+
+    // MARK: - Public types
+
+    /// AIRCR.PRIGROUP values, named by the preempt bits they leave (of 4).
+    public enum Grouping: U32 {
+        case preempt4 = 3           // 16 preempt levels, no sub (reset behaviour)
+        case preempt3 = 4           // 8 preempt x 2 sub
+        case preempt2 = 5           // 4 preempt x 4 sub (the plan)
+        case preempt1 = 6           // 2 preempt x 8 sub
+        case preempt0 = 7           // no preemption, 16 sub
+
+        public var preemptBits: U32 { 7 - rawValue }
+        public var subBits: U32 { ATSAM3X8E.NVIC.PRIO_BITS - preemptBits }
+    }
+
+    /// Decoded priority under a grouping.
+    public struct Priority: Equatable {
+        public let preempt: U32
+        public let sub: U32
+    }
+
+    /// Plan preempt levels: 2 bits, matching planGrouping by hand.
+    public enum Preempt: U32 {
+        case critical = 0           // must interrupt other handlers
+        case high = 1               // hardware deadlines (FIFOs, PDC refill)
+        case normal = 2
+        case low = 3                // no deadline (wakeups, bookkeeping)
+    }
+
+    /// Plan sub levels: 2 bits, matching planGrouping by hand. Order among
+    /// pending IRQs of one Preempt.
+    public enum Sub: U32 {
+        case first = 0
+        case second = 1
+        case third = 2
+        case fourth = 3
+    }
+
+    public struct Level: Equatable {
+        public let preempt: Preempt
+        public let sub: Sub
+
+        public init(_ preempt: Preempt, _ sub: Sub = .first) {
+            self.preempt = preempt
+            self.sub = sub
+        }
+
+        /// IPR byte for planGrouping (implemented bits at the top). Decodes
+        /// to (preempt, sub) only while the NVIC runs at planGrouping.
+        public var encoded: U8 {
+            U8(((preempt.rawValue << NVIC.planGrouping.subBits) | sub.rawValue) << (8 - ATSAM3X8E.NVIC.PRIO_BITS))
+        }
+    }
+
+    public enum SystemHandler: U32 {
+        case svcall = 11
+        case pendSV = 14
+        case sysTick = 15
+
+        /// SHPR byte: one per exception number from 4 (MemManage).
+        var priorityAddr: U32 { ATSAM3X8E.SCB.SHPR1 + rawValue - 4 }
+    }
+
+    // MARK: - Priority plan
+
+    public static let planGrouping: Grouping = .preempt2
+
+    /// Every IRQ with a handler in this firmware (raw value = peripheral ID).
+    public enum IRQ: U32, CaseIterable {
+        case rtt = 3
+        case efc1 = 7
+        case latencyA = 33          // TC6 vector, IRQLatency only
+        case latencyB = 34          // TC7 vector, IRQLatency only
+        case tc8 = 35               // Profiler
+        case pwm = 36
+        case dmac = 39
+        case uotghs = 40
+        case can0 = 43
+        case can1 = 44
+
+        public var plannedLevel: Level {
+            switch self {
+            case .tc8: return Level(.critical)              // samples other handlers
+            case .pwm: return Level(.high, .first)          // PDC duty refill before underrun
+            case .dmac: return Level(.high, .second)        // ping-pong buffer refill
+            case .can0: return Level(.high, .third)         // 8 mailboxes
+            case .can1: return Level(.high, .third)
+            case .uotghs: return Level(.normal, .second)    // the host retries NAKed transfers
+            case .efc1: return Level(.normal, .third)
+            case .rtt: return Level(.low, .first)
+            case .latencyA: return Level(.low, .fourth)     // IRQLatency sets its own
+            case .latencyB: return Level(.low, .fourth)
+            }
+        }
+    }
+
+    /// Millis tick: below the hardware deadlines, above bookkeeping.
+    public static let sysTickLevel = Level(.normal, .first)
+    public static let pendSVLevel = Level(.low, .fourth)
+
+    /// Grouping + system handler levels. IRQ levels are written by enable(_: IRQ).
+    public static func applyPlan() {
+        setGrouping(planGrouping)
+        setPriority(.sysTick, sysTickLevel)
+        setPriority(.pendSV, pendSVLevel)
+    }
+
+    /// Planned level, stale pending bit cleared, line enabled.
+    public static func enable(_ irq: IRQ) {
+        setPriority(irq.rawValue, irq.plannedLevel)
+        clearPending(irq.rawValue)
+        enable(irq.rawValue)
+    }
+
+    public static func disable(_ irq: IRQ) {
+        disable(irq.rawValue)
+    }
+
+    public static func clearPending(_ irq: IRQ) {
+        clearPending(irq.rawValue)
+    }
+
+    // MARK: - Lines
+
+    // ISER/ICER/ISPR/ICPR are write-1: no read-modify-write.
+
+    @inline(__always)
+    public static func enable(_ id: U32) {
+        write32(id < 32 ? ATSAM3X8E.NVIC.ISER0 : ATSAM3X8E.NVIC.ISER1, bit(id))
+    }
+
+    /// Masks the line; a handler already running finishes.
+    @inline(__always)
+    public static func disable(_ id: U32) {
+        write32(id < 32 ? ATSAM3X8E.NVIC.ICER0 : ATSAM3X8E.NVIC.ICER1, bit(id))
+    }
+
+    /// Software trigger (runs the handler once enabled and unmasked).
+    @inline(__always)
+    public static func pend(_ id: U32) {
+        write32(id < 32 ? ATSAM3X8E.NVIC.ISPR0 : ATSAM3X8E.NVIC.ISPR1, bit(id))
+    }
+
+    @inline(__always)
+    public static func clearPending(_ id: U32) {
+        write32(id < 32 ? ATSAM3X8E.NVIC.ICPR0 : ATSAM3X8E.NVIC.ICPR1, bit(id))
+    }
+
+    public static func isEnabled(_ id: U32) -> Bool {
+        (read32(id < 32 ? ATSAM3X8E.NVIC.ISER0 : ATSAM3X8E.NVIC.ISER1) & bit(id)) != 0
+    }
+
+    public static func isPending(_ id: U32) -> Bool {
+        (read32(id < 32 ? ATSAM3X8E.NVIC.ISPR0 : ATSAM3X8E.NVIC.ISPR1) & bit(id)) != 0
+    }
+
+    /// Handler running (or preempted while running).
+    public static func isActive(_ id: U32) -> Bool {
+        (read32(id < 32 ? ATSAM3X8E.NVIC.IABR0 : ATSAM3X8E.NVIC.IABR1) & bit(id)) != 0
+    }
+
+    // MARK: - Grouping
+
+    public static func setGrouping(_ grouping: Grouping) {
+        write32(
+            ATSAM3X8E.SCB.AIRCR,
+            ATSAM3X8E.SCB.AIRCR_VECTKEY | (grouping.rawValue << ATSAM3X8E.SCB.AIRCR_PRIGROUP_SHIFT)
+        )
+    }
+
+    /// PRIGROUP 0..3 all leave 4 preempt bits on SAM3X.
+    public static var grouping: Grouping {
+        let raw = (read32(ATSAM3X8E.SCB.AIRCR) & ATSAM3X8E.SCB.AIRCR_PRIGROUP_MASK) >> ATSAM3X8E.SCB.AIRCR_PRIGROUP_SHIFT
+        return Grouping(rawValue: max(raw, Grouping.preempt4.rawValue)) ?? .preempt4
+    }
+
+    // MARK: - Priority
+
+    @inline(__always)
+    public static func setPriority(_ id: U32, _ level: Level) {
+        setRawPriority(id, level.encoded)
+    }
+
+    /// Numeric levels under the current grouping. False (nothing written)
+    /// if either does not fit its bits.
+    @discardableResult
+    public static func setPriority(_ id: U32, preempt: U32, sub: U32 = 0) -> Bool {
+        guard let byte = encode(preempt: preempt, sub: sub, grouping: grouping) else { return false }
+        setRawPriority(id, byte)
+        return true
+    }
+
+    public static func priority(of id: U32) -> Priority {
+        decode(rawPriority(id), grouping: grouping)
+    }
+
+    public static func setPriority(_ handler: SystemHandler, _ level: Level) {
+        bm_write8(handler.priorityAddr, level.encoded)
+    }
+
+    public static func priority(of handler: SystemHandler) -> Priority {
+        decode(bm_read8(handler.priorityAddr), grouping: grouping)
+    }
+
+    /// IPR byte as stored (low 4 bits read as 0).
+    @inline(__always)
+    public static func rawPriority(_ id: U32) -> U8 {
+        bm_read8(ATSAM3X8E.NVIC.IPR_BASE + id)
+    }
+
+    @inline(__always)
+    public static func setRawPriority(_ id: U32, _ byte: U8) {
+        bm_write8(ATSAM3X8E.NVIC.IPR_BASE + id, byte)
+    }
+
+    public static func encode(preempt: U32, sub: U32, grouping: Grouping) -> U8? {
+        if preempt >= (U32(1) << grouping.preemptBits) || sub >= (U32(1) << grouping.subBits) { return nil }
+        return U8(((preempt << grouping.subBits) | sub) << (8 - ATSAM3X8E.NVIC.PRIO_BITS))
+    }
+
+    public static func decode(_ byte: U8, grouping: Grouping) -> Priority {
+        let v = U32(byte) >> (8 - ATSAM3X8E.NVIC.PRIO_BITS)
+        return Priority(preempt: v >> grouping.subBits, sub: v & ((U32(1) << grouping.subBits) - 1))
+    }
+
+    // MARK: - Internals
+
+    @inline(__always)
+    private static func bit(_ id: U32) -> U32 {
+        U32(1) << (id & 31)
+    }
+}
@@ -0,0 +1,556 @@
+//
+// NetStack.swift — minimal ARP / IPv4 / UDP (+ ICMP echo) over an EthernetDevice.
+//
+// Goals:
+// - Enough of IPv4 to stream UDP telemetry to a PC and take commands back:
+//   ARP (answer + resolve, 4-entry cache), IPv4 without options or
+//   fragments, UDP, ping replies.
+// - Zero copy: received payloads are handed to listeners as a pointer into
+//   the device's receive memory; makeDatagram() returns a device buffer with
+//   the payload area at a fixed offset, headers are written in front of it
+//   on send().
+// - Generic over the device: NetStack<EMAC> on the wire, NetStack<FramePipe.End>
+//   for a self-test with no network.
+//
+// Notes:
+// - Single-threaded: call poll() from the main loop (it also polls the
+//   device). Listeners run inside poll().
+// - The first send() to an unknown address sends an ARP request and throws
+//   arpPending; retry later (requests are rate-limited to one per 100 ms).
+//   Frames received from an on-link host refresh its cache entry, so
+//   replying to a sender never waits for ARP.
+// - UDP checksum: checked on receive when non-zero, generated on send only
+//   if Config.udpChecksum (0 = "no checksum" is legal in IPv4 and saves a
+//   pass over the payload).
+// - Addresses are U32 in host order: 192.168.1.50 = 0xC0A8_0132 (see ipv4()).
+//
+// Dependencies:
+// - EthernetDevice.swift: EthernetDevice, PacketBuffer, MACAddress
+// - Timer.swift: CycleCounter (ARP rate limit)
+//
+
+/// Constants shared by every NetStack specialization (generic classes have
+/// no static stored properties).
+enum Net {
+    static let ethHeader = 14
+    static let ipHeader = 20
+    static let udpHeader = 8
+    static let payloadOffset = ethHeader + ipHeader + udpHeader     // 42
+    static let maxPayload = 1500 - ipHeader - udpHeader             // 1472
+
+    static let typeIPv4: U16 = 0x0800
+    static let typeARP: U16 = 0x0806
+    static let protoICMP: U8 = 1
+    static let protoUDP: U8 = 17
+    static let arpCacheSize = 4
+    static let maxListeners = 4
+    static let framesPerPoll = 16
+
+    @inline(__always)
+    static func get16(_ p: UnsafeMutablePointer<UInt8>, _ o: Int) -> U16 {
+        (U16(p[o]) << 8) | U16(p[o + 1])
+    }
+
+    @inline(__always)
+    static func put16(_ p: UnsafeMutablePointer<UInt8>, _ o: Int, _ v: U16) {
+        p[o] = U8(v >> 8)
+        p[o + 1] = U8(v & 0xFF)
+    }
+
+    @inline(__always)
+    static func get32(_ p: UnsafeMutablePointer<UInt8>, _ o: Int) -> U32 {
+        (U32(get16(p, o)) << 16) | U32(get16(p, o + 2))
+    }
+
+    @inline(__always)
+    static func put32(_ p: UnsafeMutablePointer<UInt8>, _ o: Int, _ v: U32) {
+        put16(p, o, U16(v >> 16))
+        put16(p, o + 2, U16(v & 0xFFFF))
+    }
+
+    /// One's-complement sum of `count` bytes (big-endian words), not folded.
+    static func sum(_ p: UnsafeMutablePointer<UInt8>, _ count: Int, _ initial: U32 = 0) -> U32 {
+        var s = initial
+        var i = 0
+        while i + 1 < count {
+            s &+= U32(get16(p, i))
+            i += 2
+        }
+        if i < count { s &+= U32(p[i]) << 8 }
+        return s
+    }
+
+    static func fold(_ s: U32) -> U16 {
+        var v = s
+        while (v >> 16) != 0 { v = (v & 0xFFFF) &+ (v >> 16) }
+        return ~U16(v)
+    }
+}
+
+public final class NetStack<Device: EthernetDevice> {
+
+    // MARK: - Public types
+
+    public struct Config {
+        public var ip: U32
+        public var netmask: U32
+        public var gateway: U32
+        public var udpChecksum: Bool
+
+        public init(ip: U32, netmask: U32 = 0xFFFF_FF00, gateway: U32 = 0, udpChecksum: Bool = false) {
+            self.ip = ip
+            self.netmask = netmask
+            self.gateway = gateway
+            self.udpChecksum = udpChecksum
+        }
+    }
+
+    /// A received UDP datagram; `payload` is valid only inside the listener.
+    public struct UDPPacket {
+        public let sourceIP: U32
+        public let sourcePort: U16
+        public let destinationPort: U16
+        public let payload: UnsafeRawBufferPointer
+    }
+
+    /// A transmit buffer with room for the headers in front of `payload`.
+    public struct Datagram {
+        let buffer: PacketBuffer
+        public var payload: UnsafeMutablePointer<UInt8> { buffer.data + Net.payloadOffset }
+        public var capacity: Int { min(buffer.capacity - Net.payloadOffset, Net.maxPayload) }
+    }
+
+    public struct Stats {
+        public var rxFrames: U32 = 0
+        public var rxARP: U32 = 0
+        public var rxUDP: U32 = 0
+        public var rxICMP: U32 = 0
+        public var rxIgnored: U32 = 0        // not for us / unknown type or protocol
+        public var rxBadChecksum: U32 = 0
+        public var rxFragments: U32 = 0      // IPv4 fragments are not reassembled
+        public var rxNoListener: U32 = 0
+        public var txUDP: U32 = 0
+        public var txARP: U32 = 0
+        public var txICMP: U32 = 0
+        public var txBusy: U32 = 0           // device refused the frame
+        public var arpMisses: U32 = 0
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case linkDown
+        case noBuffer
+        case tooLarge
+        case arpPending
+        case deviceBusy
+        case listenersFull
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .linkDown: return "link_down"
+            case .noBuffer: return "no_buffer"
+            case .tooLarge: return "too_large"
+            case .arpPending: return "arp_pending"
+            case .deviceBusy: return "device_busy"
+            case .listenersFull: return "listeners_full"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .linkDown: return "The Ethernet link is down."
+            case .noBuffer: return "No free transmit buffer."
+            case .tooLarge: return "Payload exceeds 1472 bytes."
+            case .arpPending: return "Destination MAC unknown yet; ARP request sent, retry."
+            case .deviceBusy: return "The device transmit ring is full."
+            case .listenersFull: return "All UDP listener slots are in use."
+            }
+        }
+    }
+
+    private struct ARPEntry {
+        var ip: U32 = 0
+        var mac = MACAddress.broadcast
+        var lastUsed: U32 = 0
+    }
+
+    private struct Listener {
+        var port: U16
+        var handler: (UDPPacket) -> Void
+    }
+
+    // MARK: - State
+
+    public let device: Device
+    public var config: Config
+    public private(set) var stats = Stats()
+
+    private let mckHz: U32
+    private var arp: [ARPEntry]
+    private var listeners: [Listener] = []
+    private var useClock: U32 = 0
+    private var lastARPRequest: U32 = 0
+    private var arpRequested = false
+    private var ipID: U16 = 1
+
+    // MARK: - Init
+
+    public init(device: Device, config: Config, mckHz: U32) {
+        self.device = device
+        self.config = config
+        self.mckHz = mckHz
+        self.arp = [ARPEntry](repeating: ARPEntry(), count: Net.arpCacheSize)
+        self.listeners.reserveCapacity(Net.maxListeners)
+    }
+
+    /// a.b.c.d -> U32 (host order).
+    public static func ipv4(_ a: U8, _ b: U8, _ c: U8, _ d: U8) -> U32 {
+        (U32(a) << 24) | (U32(b) << 16) | (U32(c) << 8) | U32(d)
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    /// Deliver UDP datagrams for `port` to `handler` (from poll()).
+    public func listen(port: U16, _ handler: @escaping (UDPPacket) -> Void) throws(NetStack.Error) {
+        var i = 0
+        while i < listeners.count {
+            if listeners[i].port == port {
+                listeners[i].handler = handler
+                return
+            }
+            i += 1
+        }
+        if listeners.count == Net.maxListeners { throw .listenersFull }
+        listeners.append(Listener(port: port, handler: handler))
+    }
+
+    // MARK: - Receive
+
+    /// Poll the device and process up to 16 frames.
+    public func poll() {
+        device.poll()
+        var n = 0
+        while n < Net.framesPerPoll, let f = device.receive() {
+            stats.rxFrames &+= 1
+            handleFrame(f.data, f.length)
+            device.release(f)
+            n += 1
+        }
+    }
+
+    private func handleFrame(_ p: UnsafeMutablePointer<UInt8>, _ length: Int) {
+        if length < Net.ethHeader {
+            stats.rxIgnored &+= 1
+            return
+        }
+        let dst = MACAddress(bytes: p)
+        if dst != device.macAddress && !dst.isBroadcast {
+            stats.rxIgnored &+= 1
+            return
+        }
+        switch Net.get16(p, 12) {
+        case Net.typeARP: handleARP(p, length)
+        case Net.typeIPv4: handleIPv4(p, length)
+        default: stats.rxIgnored &+= 1
+        }
+    }
+
+    private func handleARP(_ p: UnsafeMutablePointer<UInt8>, _ length: Int) {
+        let a = Net.ethHeader
+        if length < a + 28 || Net.get16(p, a) != 1 || Net.get16(p, a + 2) != Net.typeIPv4 {
+            stats.rxIgnored &+= 1
+            return
+        }
+        stats.rxARP &+= 1
+        let op = Net.get16(p, a + 6)
+        let senderMAC = MACAddress(bytes: p + a + 8)
+        let senderIP = Net.get32(p, a + 14)
+        let targetIP = Net.get32(p, a + 24)
+
+        // RFC 826: refresh a known sender; add it if the packet is for us.
+        if targetIP == config.ip {
+            learn(senderIP, senderMAC)
+        } else {
+            refresh(senderIP, senderMAC)
+            return
+        }
+        if op == 1 {
+            sendARP(op: 2, targetMAC: senderMAC, targetIP: senderIP)
+        }
+    }
+
+    private func handleIPv4(_ p: UnsafeMutablePointer<UInt8>, _ length: Int) {
+        let ip = Net.ethHeader
+        if length < ip + Net.ipHeader || (p[ip] >> 4) != 4 {
+            stats.rxIgnored &+= 1
+            return
+        }
+        let ihl = Int(p[ip] & 0x0F) * 4
+        let total = Int(Net.get16(p, ip + 2))
+        if ihl < Net.ipHeader || total < ihl || ip + total > length {
+            stats.rxIgnored &+= 1
+            return
+        }
+        if Net.fold(Net.sum(p + ip, ihl)) != 0 {
+            stats.rxBadChecksum &+= 1
+            return
+        }
+        let dst = Net.get32(p, ip + 16)
+        if dst != config.ip && dst != 0xFFFF_FFFF && dst != (config.ip | ~config.netmask) {
+            stats.rxIgnored &+= 1
+            return
+        }
+        if (Net.get16(p, ip + 6) & 0x3FFF) != 0 {          // MF or fragment offset
+            stats.rxFragments &+= 1
+            return
+        }
+        let src = Net.get32(p, ip + 12)
+        if isLocal(src) { refresh(src, MACAddress(bytes: p + 6)) }
+
+        switch p[ip + 9] {
+        case Net.protoUDP: handleUDP(p, ip + ihl, total - ihl, src, dst)
+        case Net.protoICMP: handleICMP(p, ip, ihl, total)
+        default: stats.rxIgnored &+= 1
+        }
+    }
+
+    /// `dst` is the IP header's destination (ours, or a broadcast): the
+    /// checksum covers it through the pseudo-header.
+    private func handleUDP(_ p: UnsafeMutablePointer<UInt8>, _ u: Int, _ available: Int, _ src: U32, _ dst: U32) {
+        if available < Net.udpHeader {
+            stats.rxIgnored &+= 1
+            return
+        }
+        let len = Int(Net.get16(p, u + 4))
+        if len < Net.udpHeader || len > available {
+            stats.rxIgnored &+= 1
+            return
+        }
+        if Net.get16(p, u + 6) != 0 {
+            var s = pseudoSum(src, dst, U16(len))
+            s = Net.sum(p + u, len, s)
+            if Net.fold(s) != 0 {
+                stats.rxBadChecksum &+= 1
+                return
+            }
+        }
+        stats.rxUDP &+= 1
+        let port = Net.get16(p, u + 2)
+        var i = 0
+        while i < listeners.count {
+            if listeners[i].port == port {
+                listeners[i].handler(UDPPacket(
+                    sourceIP: src,
+                    sourcePort: Net.get16(p, u),
+                    destinationPort: port,
+                    payload: UnsafeRawBufferPointer(start: p + u + Net.udpHeader, count: len - Net.udpHeader)
+                ))
+                return
+            }
+            i += 1
+        }
+        stats.rxNoListener &+= 1
+    }
+
+    /// Echo request -> echo reply, same payload, straight back to the sender's MAC.
+    private func handleICMP(_ p: UnsafeMutablePointer<UInt8>, _ ip: Int, _ ihl: Int, _ total: Int) {
+        let icmp = ip + ihl
+        if total - ihl < 8 || p[icmp] != 8 {
+            stats.rxIgnored &+= 1
+            return
+        }
+        stats.rxICMP &+= 1
+        let frameLength = ip + total
+        guard let b = device.allocate() else { return }
+        if frameLength > b.capacity {
+            device.free(b)
+            return
+        }
+        let q = b.data
+        q.update(from: p, count: frameLength)
+        MACAddress(bytes: p + 6).store(to: q)
+        device.macAddress.store(to: q + 6)
+        Net.put32(q, ip + 12, config.ip)
+        Net.put32(q, ip + 16, Net.get32(p, ip + 12))
+        q[ip + 8] = 64
+        Net.put16(q, ip + 10, 0)
+        Net.put16(q, ip + 10, Net.fold(Net.sum(q + ip, ihl)))
+        q[icmp] = 0
+        Net.put16(q, icmp + 2, 0)
+        Net.put16(q, icmp + 2, Net.fold(Net.sum(q + icmp, total - ihl)))
+        if device.transmit(b, length: frameLength) {
+            stats.txICMP &+= 1
+        } else {
+            device.free(b)
+            stats.txBusy &+= 1
+        }
+    }
+
+    // MARK: - Transmit
+
+    /// A buffer to build a payload in place (up to `capacity` bytes).
+    public func makeDatagram() throws(NetStack.Error) -> Datagram {
+        guard let b = device.allocate() else { throw .noBuffer }
+        return Datagram(buffer: b)
+    }
+
+    /// Return a datagram that will not be sent.
+    public func discard(_ datagram: Datagram) {
+        device.free(datagram.buffer)
+    }
+
+    /// Send `length` payload bytes of `datagram`. On success the device owns
+    /// the buffer; on error it stays with the caller (retry or discard()).
+    public func send(
+        _ datagram: Datagram, length: Int, to ip: U32, port: U16, from sourcePort: U16
+    ) throws(NetStack.Error) {
+        if length < 0 || length > datagram.capacity { throw .tooLarge }
+        if !device.linkUp { throw .linkDown }
+        guard let mac = resolve(ip) else { throw .arpPending }
+
+        let p = datagram.buffer.data
+        let udpLength = Net.udpHeader + length
+        let ipLength = Net.ipHeader + udpLength
+
+        mac.store(to: p)
+        device.macAddress.store(to: p + 6)
+        Net.put16(p, 12, Net.typeIPv4)
+
+        let h = Net.ethHeader
+        p[h] = 0x45
+        p[h + 1] = 0
+        Net.put16(p, h + 2, U16(ipLength))
+        Net.put16(p, h + 4, ipID)
+        Net.put16(p, h + 6, 0x4000)                         // don't fragment
+        p[h + 8] = 64
+        p[h + 9] = Net.protoUDP
+        Net.put16(p, h + 10, 0)
+        Net.put32(p, h + 12, config.ip)
+        Net.put32(p, h + 16, ip)
+        Net.put16(p, h + 10, Net.fold(Net.sum(p + h, Net.ipHeader)))
+
+        let u = h + Net.ipHeader
+        Net.put16(p, u, sourcePort)
+        Net.put16(p, u + 2, port)
+        Net.put16(p, u + 4, U16(udpLength))
+        Net.put16(p, u + 6, 0)
+        if config.udpChecksum {
+            var c = Net.fold(Net.sum(p + u, udpLength, pseudoSum(config.ip, ip, U16(udpLength))))
+            if c == 0 { c = 0xFFFF }                        // 0 means "none"
+            Net.put16(p, u + 6, c)
+        }
+
+        if !device.transmit(datagram.buffer, length: Net.ethHeader + ipLength) {
+            stats.txBusy &+= 1
+            throw .deviceBusy
+        }
+        ipID &+= 1
+        stats.txUDP &+= 1
+    }
+
+    /// Copying convenience: one datagram from `bytes`.
+    public func send(
+        to ip: U32, port: U16, from sourcePort: U16, _ bytes: UnsafeRawPointer, count: Int
+    ) throws(NetStack.Error) {
+        if count > Net.maxPayload { throw .tooLarge }
+        let d = try makeDatagram()
+        d.payload.update(from: bytes.assumingMemoryBound(to: UInt8.self), count: count)
+        do throws(NetStack.Error) {
+            try send(d, length: count, to: ip, port: port, from: sourcePort)
+        } catch {
+            discard(d)
+            throw error
+        }
+    }
+
+    // MARK: - ARP
+
+    /// Cached MAC for `ip` (or its gateway); sends a rate-limited request on a miss.
+    public func resolve(_ ip: U32) -> MACAddress? {
+        if ip == 0xFFFF_FFFF || ip == (config.ip | ~config.netmask) { return .broadcast }
+        let hop = isLocal(ip) ? ip : config.gateway
+        var i = 0
+        while i < Net.arpCacheSize {
+            if arp[i].ip == hop && arp[i].ip != 0 {
+                useClock &+= 1
+                arp[i].lastUsed = useClock
+                return arp[i].mac
+            }
+            i += 1
+        }
+        stats.arpMisses &+= 1
+        let now = CycleCounter.now()
+        if !arpRequested || (now &- lastARPRequest) >= mckHz / 10 {
+            arpRequested = true
+            lastARPRequest = now
+            sendARP(op: 1, targetMAC: .broadcast, targetIP: hop)
+        }
+        return nil
+    }
+
+    private func isLocal(_ ip: U32) -> Bool {
+        (ip & config.netmask) == (config.ip & config.netmask)
+    }
+
+    /// Update an existing entry only.
+    private func refresh(_ ip: U32, _ mac: MACAddress) {
+        var i = 0
+        while i < Net.arpCacheSize {
+            if arp[i].ip == ip {
+                arp[i].mac = mac
+                return
+            }
+            i += 1
+        }
+    }
+
+    /// Insert or update, evicting the least recently used entry.
+    private func learn(_ ip: U32, _ mac: MACAddress) {
+        if ip == 0 { return }
+        var victim = 0
+        var i = 0
+        while i < Net.arpCacheSize {
+            if arp[i].ip == ip {
+                victim = i
+                break
+            }
+            if arp[i].lastUsed < arp[victim].lastUsed { victim = i }
+            i += 1
+        }
+        useClock &+= 1
+        arp[victim] = ARPEntry(ip: ip, mac: mac, lastUsed: useClock)
+    }
+
+    private func sendARP(op: U16, targetMAC: MACAddress, targetIP: U32) {
+        guard let b = device.allocate() else {
+            return
+        }
+        let p = b.data
+        targetMAC.store(to: p)
+        device.macAddress.store(to: p + 6)
+        Net.put16(p, 12, Net.typeARP)
+        let a = Net.ethHeader
+        Net.put16(p, a, 1)                                  // Ethernet
+        Net.put16(p, a + 2, Net.typeIPv4)
+        p[a + 4] = 6
+        p[a + 5] = 4
+        Net.put16(p, a + 6, op)
+        device.macAddress.store(to: p + a + 8)
+        Net.put32(p, a + 14, config.ip)
+        (op == 1 ? MACAddress(0, 0, 0, 0, 0, 0) : targetMAC).store(to: p + a + 18)
+        Net.put32(p, a + 24, targetIP)
+        if device.transmit(b, length: a + 28) {
+            stats.txARP &+= 1
+        } else {
+            device.free(b)
+            stats.txBusy &+= 1
+        }
+    }
+
+    private func pseudoSum(_ src: U32, _ dst: U32, _ udpLength: U16) -> U32 {
+        (src >> 16) &+ (src & 0xFFFF) &+ (dst >> 16) &+ (dst & 0xFFFF) &+ U32(Net.protoUDP) &+ U32(udpLength)
+    }
+}
@@ -153,6 +153,6 @@ public struct PIN {
 
     @inline(__always)
     private func enablePIOClock(_ id: U32) {
-        write32(ATSAM3X8E.PMC.PCER0, U32(1) << id)
+        PeripheralClock.holdPIO(id)
     }
 }
\ No newline at end of file
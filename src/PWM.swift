@@ -0,0 +1,422 @@
+//
+// PWM.swift — PWM controller: 8 channels, dead-time, synchronous channels,
+// PDC-driven duty-cycle tables.
+//
+// Goals:
+// - Motors and LEDs from hardware instead of toggled PINs: 16-bit counters
+//   clocked from MCK / 2^n, so 84 MHz gives 1.28 kHz at 16 bits or 20 kHz at
+//   ~12 bits with no CPU time.
+// - Left- or center-aligned waveforms; complementary PWMH/PWML outputs with
+//   dead-time (half bridges: the two switches never conduct together).
+// - Synchronous channels: a group sharing channel 0's counter, whose duty
+//   cycles change together at the same update period.
+// - PDC duty tables: the PDC feeds one set of group duty cycles per update
+//   period, so a whole commutation sequence plays with no CPU per step.
+// - plan() / maxFrequency() report what a frequency costs in resolution
+//   for a given mckHz (and the other way round).
+//
+// Notes:
+// - Duty is in counter ticks (0...period, Plan.period); setDutyPermille()
+//   scales. Duty = PWMH high time (the Arduino convention; inverted: low).
+// - Duty writes go to the *UPD registers and take effect at the end of the
+//   period: never a glitch or a runt pulse.
+// - Dead-time: PWMH rises DTH ticks late, PWML rises DTL ticks late. The
+//   hardware requires DTH <= period - duty and DTL <= duty, so duty is
+//   clamped to [deadTicks, period - deadTicks] on channels that use it.
+// - Synchronous channels take period, clock and alignment from channel 0.
+//   Table entries are U16 duty values, one per group channel in ascending
+//   channel order, one set per update period.
+// - A looping table re-arms the PDC next-buffer pointer once per pass, from
+//   PWM_Handler (with IRQs on) or poll(): no work per step.
+// - The PWM clock is taken once by the first configure/start/duty write and
+//   released when stop() / stopDutyTable() leave no channel and no table
+//   running (channel registers survive the gating).
+// - Pins (Due, peripheral B on PIOC):
+//     PWML0..3 = D34/36/38/40   PWMH0..3 = D35/37/39/41
+//     PWML4..7 = D9/D8/D7/D6    PWMH5 = D44, PWMH6 = D45 (PWMH4/7 not routed)
+//
+// Dependencies:
+// - MMIO.swift: read32/write32/setBits32
+// - ATSAM3X8E.swift: PWM registers/bitfields, PMC, PIO
+// - NVIC.swift: enable(.pwm)
+// - arm/startup.s: PWM_Handler (IRQ 36)
+//
+
+// ISR target. MUST be global and single symbol.
+public var g_pwm: PWM? = nil
+
+public final class PWM {
+
+    // MARK: - Public types
+
+    public enum Alignment {
+        case left
+        case center
+    }
+
+    /// Which pins of a channel are driven.
+    public enum Output {
+        case high                   // PWMHx only
+        case low                    // PWMLx only
+        case complementary          // PWMHx + PWMLx (with dead-time)
+    }
+
+    /// Clock/period chosen for a frequency.
+    public struct Plan {
+        public let prescalerShift: U32      // channel clock = MCK >> prescalerShift
+        public let period: U32              // counter ticks per PWM period (duty range)
+        public let actualHz: U32
+        public let resolutionBits: U32      // floor(log2(period))
+        public let tickPs: U32              // one duty step, picoseconds
+    }
+
+    public struct Stats {
+        public var tablePasses: U32 = 0     // PDC table completed (looping)
+        public var underruns: U32 = 0       // update period came with no PDC data
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case invalidChannel
+        case pinNotRouted
+        case frequencyOutOfRange
+        case deadTimeTooLong
+        case notSynchronous
+        case tableTooLong
+        case tableRunning
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .invalidChannel: return "invalid_channel"
+            case .pinNotRouted: return "pin_not_routed"
+            case .frequencyOutOfRange: return "frequency_out_of_range"
+            case .deadTimeTooLong: return "dead_time_too_long"
+            case .notSynchronous: return "not_synchronous"
+            case .tableTooLong: return "table_too_long"
+            case .tableRunning: return "table_running"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .invalidChannel: return "PWM channel must be 0...7."
+            case .pinNotRouted: return "That PWM output has no pin on the Due."
+            case .frequencyOutOfRange: return "Frequency not reachable with a 16-bit counter at this MCK."
+            case .deadTimeTooLong: return "Dead-time must be under half the period."
+            case .notSynchronous: return "No synchronous group (channel 0 must be part of it)."
+            case .tableTooLong: return "Duty table exceeds 65535 PDC transfers."
+            case .tableRunning: return "A PDC duty table is playing; stop it first."
+            }
+        }
+    }
+
+    // MARK: - State
+
+    public private(set) var stats = Stats()
+    public private(set) var syncChannels: U32 = 0          // SCM bit mask
+    public private(set) var tableRunning = false
+
+    private let mckHz: U32
+    private var clockHeld = false
+    private var enabledChannels: U32 = 0
+    private var periods: [U32]
+    private var deadTicks: [U32]
+    private var table: UnsafePointer<U16>? = nil
+    private var tableCount: U32 = 0
+    private var tableLoop = false
+
+    // MARK: - Init
+
+    public init(mckHz: U32) {
+        self.mckHz = mckHz
+        self.periods = [U32](repeating: 0, count: Int(ATSAM3X8E.PWM.CHANNELS))
+        self.deadTicks = [U32](repeating: 0, count: Int(ATSAM3X8E.PWM.CHANNELS))
+    }
+
+    // MARK: - Frequency / resolution
+
+    /// Smallest prescaler (best resolution) whose 16-bit counter reaches
+    /// `frequencyHz`. Center alignment counts up and down: half the frequency
+    /// for the same period.
+    public static func plan(frequencyHz: U32, alignment: Alignment = .left, mckHz: U32) -> Plan? {
+        if frequencyHz == 0 { return nil }
+        let div: UInt64 = alignment == .center ? 2 : 1
+        var shift: U32 = 0
+        while shift <= ATSAM3X8E.PWM.CPRE_MAX {
+            let clk = UInt64(mckHz >> shift)
+            let den = UInt64(frequencyHz) * div
+            let period = (clk + den / 2) / den
+            if period < 2 { return nil }
+            if period <= UInt64(ATSAM3X8E.PWM.COUNTER_MAX) {
+                return Plan(
+                    prescalerShift: shift,
+                    period: U32(period),
+                    actualHz: U32(clk / (period * div)),
+                    resolutionBits: 31 - U32(U32(period).leadingZeroBitCount),
+                    tickPs: U32(1_000_000_000_000 / clk)
+                )
+            }
+            shift += 1
+        }
+        return nil
+    }
+
+    /// Highest frequency with `bits` of duty resolution (prescaler 1).
+    public static func maxFrequency(bits: U32, alignment: Alignment = .left, mckHz: U32) -> U32 {
+        if bits == 0 || bits > 16 { return 0 }
+        let div: U32 = alignment == .center ? 2 : 1
+        return mckHz / ((U32(1) << bits) * div)
+    }
+
+    // MARK: - Channels
+
+    /// Configure one independent channel (stopped; call start()). Returns
+    /// the plan actually used.
+    @discardableResult
+    public func configure(
+        channel: Int,
+        frequencyHz: U32,
+        alignment: Alignment = .left,
+        output: Output = .high,
+        deadTimeNs: U32 = 0,
+        inverted: Bool = false
+    ) throws(PWM.Error) -> Plan {
+        if channel < 0 || channel >= Int(ATSAM3X8E.PWM.CHANNELS) { throw .invalidChannel }
+        if tableRunning && (syncChannels & (U32(1) << U32(channel))) != 0 { throw .tableRunning }
+        guard let plan = Self.plan(frequencyHz: frequencyHz, alignment: alignment, mckHz: mckHz) else {
+            throw .frequencyOutOfRange
+        }
+        try setupChannel(channel, plan, alignment, output, deadTimeNs, inverted)
+        return plan
+    }
+
+    /// Configure `channels` (bit mask, must include channel 0) as one
+    /// synchronous group; duty updates apply every `updateEvery` periods.
+    @discardableResult
+    public func configureSynchronous(
+        channels: U32,
+        frequencyHz: U32,
+        alignment: Alignment = .left,
+        output: Output = .complementary,
+        deadTimeNs: U32 = 0,
+        updateEvery: U32 = 1
+    ) throws(PWM.Error) -> Plan {
+        if (channels & 1) == 0 || channels > 0xFF { throw .notSynchronous }
+        if tableRunning { throw .tableRunning }
+        guard let plan = Self.plan(frequencyHz: frequencyHz, alignment: alignment, mckHz: mckHz) else {
+            throw .frequencyOutOfRange
+        }
+        var ch = 0
+        while ch < Int(ATSAM3X8E.PWM.CHANNELS) {
+            if (channels & (U32(1) << U32(ch))) != 0 {
+                try setupChannel(ch, plan, alignment, output, deadTimeNs, false)
+            }
+            ch += 1
+        }
+        syncChannels = channels
+        write32(ATSAM3X8E.PWM.SCM, channels | ATSAM3X8E.PWM.SCM_UPDM_MANUAL)
+        write32(ATSAM3X8E.PWM.SCUP, min(max(updateEvery, 1), 16) - 1)
+        return plan
+    }
+
+    /// Start channels (bit mask). Starting channel 0 starts its whole group.
+    public func start(_ channels: U32) {
+        holdClock()
+        write32(ATSAM3X8E.PWM.ENA, channels & 0xFF)
+        enabledChannels |= groupMask(channels)
+    }
+
+    /// Stop channels (bit mask); the outputs return to their idle level.
+    /// The clock is released once nothing runs.
+    public func stop(_ channels: U32) {
+        write32(ATSAM3X8E.PWM.DIS, channels & 0xFF)
+        enabledChannels &= ~groupMask(channels)
+        releaseClockIfIdle()
+    }
+
+    /// Duty in ticks (0...plan.period), applied at the end of the period.
+    /// Group channels wait for commitSynchronous().
+    public func setDuty(_ channel: Int, _ ticks: U32) {
+        if channel < 0 || channel >= Int(ATSAM3X8E.PWM.CHANNELS) { return }
+        holdClock()
+        write32(channelReg(channel, ATSAM3X8E.PWM.CDTYUPD_OFFSET), clampDuty(channel, ticks))
+    }
+
+    public func setDutyPermille(_ channel: Int, _ permille: U32) {
+        if channel < 0 || channel >= Int(ATSAM3X8E.PWM.CHANNELS) { return }
+        setDuty(channel, U32((UInt64(periods[channel]) * UInt64(min(permille, 1000)) + 500) / 1000))
+    }
+
+    /// One duty per group channel (ascending channel order), all applied at
+    /// the same update period.
+    public func setSynchronousDuties(_ duties: UnsafePointer<U16>) throws(PWM.Error) {
+        if syncChannels == 0 { throw .notSynchronous }
+        if tableRunning { throw .tableRunning }
+        holdClock()
+        var ch = 0
+        var i = 0
+        while ch < Int(ATSAM3X8E.PWM.CHANNELS) {
+            if (syncChannels & (U32(1) << U32(ch))) != 0 {
+                write32(channelReg(ch, ATSAM3X8E.PWM.CDTYUPD_OFFSET), clampDuty(ch, U32(duties[i])))
+                i += 1
+            }
+            ch += 1
+        }
+        write32(ATSAM3X8E.PWM.SCUC, ATSAM3X8E.PWM.SCUC_UPDULOCK)
+    }
+
+    // MARK: - PDC duty tables
+
+    /// Play `steps` sets of group duties (steps x group size U16 entries),
+    /// one set per update period. `loop` repeats the table until
+    /// stopDutyTable(); with IRQs on PWM_Handler re-arms it, otherwise call
+    /// poll() at least once per pass. The table must stay alive.
+    public func playDutyTable(_ entries: UnsafePointer<U16>, steps: Int, loop: Bool = false) throws(PWM.Error) {
+        if syncChannels == 0 { throw .notSynchronous }
+        let count = U32(steps) * U32(syncChannels.nonzeroBitCount)
+        if steps <= 0 || count > 0xFFFF { throw .tableTooLong }
+
+        holdClock()
+        write32(ATSAM3X8E.PWM.PTCR, ATSAM3X8E.PWM.PTCR_TXTDIS)
+        table = entries
+        tableCount = count
+        tableLoop = loop
+        let addr = U32(UInt(bitPattern: entries))
+        write32(ATSAM3X8E.PWM.TPR, addr)
+        write32(ATSAM3X8E.PWM.TCR, count)
+        write32(ATSAM3X8E.PWM.TNPR, loop ? addr : 0)
+        write32(ATSAM3X8E.PWM.TNCR, loop ? count : 0)
+        _ = read32(ATSAM3X8E.PWM.ISR2)
+
+        write32(ATSAM3X8E.PWM.SCM, syncChannels | ATSAM3X8E.PWM.SCM_UPDM_PDC)
+        if loop {
+            g_pwm = self
+            write32(ATSAM3X8E.PWM.IER2, ATSAM3X8E.PWM.IR2_ENDTX | ATSAM3X8E.PWM.IR2_UNRE)
+            NVIC.enable(.pwm)
+        }
+        tableRunning = true
+        write32(ATSAM3X8E.PWM.PTCR, ATSAM3X8E.PWM.PTCR_TXTEN)
+    }
+
+    /// Stop the PDC; the group keeps the last duty set (manual updates again).
+    public func stopDutyTable() {
+        write32(ATSAM3X8E.PWM.IDR2, ATSAM3X8E.PWM.IR2_ENDTX | ATSAM3X8E.PWM.IR2_UNRE)
+        write32(ATSAM3X8E.PWM.PTCR, ATSAM3X8E.PWM.PTCR_TXTDIS)
+        write32(ATSAM3X8E.PWM.SCM, syncChannels | ATSAM3X8E.PWM.SCM_UPDM_MANUAL)
+        tableRunning = false
+        tableLoop = false
+        table = nil
+        releaseClockIfIdle()
+    }
+
+    /// True once a non-looping table has been fully consumed.
+    public var tableDone: Bool {
+        tableRunning && read32(ATSAM3X8E.PWM.TCR) == 0 && read32(ATSAM3X8E.PWM.TNCR) == 0
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    /// Re-arm a looping table and count underruns. Called from PWM_Handler;
+    /// call from the loop when IRQs are off.
+    public func poll() {
+        handleInterrupt()
+    }
+
+    public func handleInterrupt() {
+        let isr = read32(ATSAM3X8E.PWM.ISR2)                // clear on read
+        if (isr & ATSAM3X8E.PWM.IR2_UNRE) != 0 { stats.underruns &+= 1 }
+        if (isr & ATSAM3X8E.PWM.IR2_ENDTX) != 0 && tableLoop, let t = table {
+            // The PDC moved next -> current: queue the table again behind it.
+            write32(ATSAM3X8E.PWM.TNPR, U32(UInt(bitPattern: t)))
+            write32(ATSAM3X8E.PWM.TNCR, tableCount)
+            stats.tablePasses &+= 1
+        }
+    }
+
+    // MARK: - Internals
+
+    private func setupChannel(
+        _ ch: Int, _ plan: Plan, _ alignment: Alignment, _ output: Output, _ deadTimeNs: U32, _ inverted: Bool
+    ) throws(PWM.Error) {
+        let (high, low) = Self.pins(ch)
+        var pins: U32 = 0
+        switch output {
+        case .high: pins = high
+        case .low: pins = low
+        case .complementary: pins = high != 0 && low != 0 ? high | low : 0
+        }
+        if pins == 0 { throw .pinNotRouted }
+
+        let tickHz = UInt64(mckHz >> plan.prescalerShift)
+        let dt = output == .complementary ? U32((UInt64(deadTimeNs) * tickHz + 999_999_999) / 1_000_000_000) : 0
+        if dt > 0xFFFF || dt * 2 >= plan.period { throw .deadTimeTooLong }
+
+        holdClock()
+        write32(ATSAM3X8E.PWM.DIS, U32(1) << U32(ch))
+        enabledChannels &= ~(U32(1) << U32(ch))
+
+        var cmr = plan.prescalerShift
+        if alignment == .center { cmr |= ATSAM3X8E.PWM.CMR_CALG }
+        if inverted { cmr |= ATSAM3X8E.PWM.CMR_CPOL }
+        if dt != 0 { cmr |= ATSAM3X8E.PWM.CMR_DTE }
+        write32(channelReg(ch, ATSAM3X8E.PWM.CMR_OFFSET), cmr)
+        write32(channelReg(ch, ATSAM3X8E.PWM.CPRD_OFFSET), plan.period)
+        write32(channelReg(ch, ATSAM3X8E.PWM.CDTY_OFFSET), dt)
+        write32(channelReg(ch, ATSAM3X8E.PWM.DT_OFFSET), dt | (dt << ATSAM3X8E.PWM.DT_DTL_SHIFT))
+        periods[ch] = plan.period
+        deadTicks[ch] = dt
+
+        write32(ATSAM3X8E.PIOC_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, pins)
+        setBits32(ATSAM3X8E.PIOC_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, pins)      // peripheral B
+    }
+
+    private func holdClock() {
+        if clockHeld { return }
+        PeripheralClock.acquire(ATSAM3X8E.ID.PWM)
+        clockHeld = true
+    }
+
+    private func releaseClockIfIdle() {
+        if !clockHeld || enabledChannels != 0 || tableRunning { return }
+        PeripheralClock.release(ATSAM3X8E.ID.PWM)
+        clockHeld = false
+    }
+
+    // Channel 0 starts/stops its whole synchronous group.
+    private func groupMask(_ channels: U32) -> U32 {
+        let m = channels & 0xFF
+        return (m & 1) != 0 ? m | syncChannels : m
+    }
+
+    @inline(__always)
+    private func channelReg(_ ch: Int, _ offset: U32) -> U32 {
+        ATSAM3X8E.PWM.CH_BASE + U32(ch) * ATSAM3X8E.PWM.CH_STRIDE + offset
+    }
+
+    @inline(__always)
+    private func clampDuty(_ ch: Int, _ ticks: U32) -> U32 {
+        let dt = deadTicks[ch]
+        return min(max(ticks, dt), periods[ch] - dt)
+    }
+
+    /// (PWMH, PWML) pin masks on PIOC; 0 = not routed on the Due.
+    private static func pins(_ ch: Int) -> (U32, U32) {
+        switch ch {
+        case 0...3: return (U32(1) << U32(3 + 2 * ch), U32(1) << U32(2 + 2 * ch))
+        case 4: return (0, U32(1) << 21)
+        case 5: return (U32(1) << 19, U32(1) << 22)
+        case 6: return (U32(1) << 18, U32(1) << 23)
+        default: return (0, U32(1) << 24)
+        }
+    }
+}
+
+// MARK: - Interrupt handler
+
+@_cdecl("PWM_Handler")
+public func PWM_Handler() {
+    g_pwm?.handleInterrupt()
+}
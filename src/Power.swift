@@ -0,0 +1,281 @@
+//
+// Power.swift — reference-counted peripheral clocks + low-power mode choice.
+//
+// Goals:
+// - PeripheralClock: acquire()/release() per user of a peripheral. The PMC
+//   clock (PCER/PCDR 0/1) is on while at least one user holds it. Drivers
+//   acquire once in begin() (a clockHeld flag: calling begin() again does
+//   not stack users) and release in stop()/end()/detach(); disableUnused()
+//   gates every clock nobody holds (left on by the bootloader, or released).
+// - PIO controllers are the exception: PIN/AnalogPIN are values with no
+//   end(), so holdPIO() takes one user per controller on first use and never
+//   releases it. A PIO clock, once used, stays on (inputs and pin-change
+//   IRQs need it anyway).
+// - Power: pick the deepest mode (run, Sleep, WAIT, backup) whose measured
+//   wakeup latency fits the caller's budget and pays off before the next
+//   deadline, then sleep on the RTT through TimeKeeper.
+// - measureLatency(): alarm edge to "back in the caller at full clock" for
+//   Sleep and WAIT; measureBackupLatency() does the same across the
+//   backup-mode reset (read on the next boot by begin()).
+//
+// Notes:
+// - Latency is measured on the RTT: the ticks since the alarm edge plus the
+//   DWT cycles to the next edge, so the resolution is cycles, not ticks.
+// - A mode is used only if the idle time is at least residencyFactor x its
+//   latency (default 4): shorter sleeps cost more than they save.
+// - idle() wakes early by the chosen mode's latency so the deadline is met.
+// - Backup mode loses RAM (the deadline is reached through a reset): it is
+//   chosen only with allowBackup.
+// - GPBR5..6 belong to Power (backup latency measurement).
+// - support.c (arc4random_buf) re-enables the TRNG clock itself.
+//
+// Dependencies:
+// - MMIO.swift: read32/write32
+// - ATSAM3X8E.swift: PMC, ID, GPBR
+// - TimeKeeper.swift: sleep/sleepInBackup, now(), lastAlarm
+// - Timer.swift: Timer, CycleCounter
+//
+
+public enum PeripheralClock {
+
+    /// Peripheral IDs with a PMC clock gate (0..7 are system peripherals).
+    public static let firstID: U32 = 8
+    public static let lastID: U32 = 44
+
+    private static var users = [U8](repeating: 0, count: 45)
+    private static var pioHeld: UInt64 = 0      // bit per ID held by holdPIO()
+
+    /// One more user: the clock is enabled on the first.
+    public static func acquire(_ id: U32) {
+        if id > lastID { return }
+        if users[Int(id)] == 0 { enable(id) }
+        if users[Int(id)] < 0xFF { users[Int(id)] &+= 1 }
+    }
+
+    /// One user less: the clock is disabled with the last.
+    public static func release(_ id: U32) {
+        if id > lastID || users[Int(id)] == 0 { return }
+        users[Int(id)] &-= 1
+        if users[Int(id)] == 0 { disable(id) }
+    }
+
+    /// PIO controller clock for PIN/AnalogPIN: one permanent user per
+    /// controller, however many pin values are created.
+    public static func holdPIO(_ id: U32) {
+        if id > lastID || (pioHeld & (UInt64(1) << UInt64(id))) != 0 { return }
+        pioHeld |= UInt64(1) << UInt64(id)
+        acquire(id)
+    }
+
+    public static func userCount(_ id: U32) -> U32 {
+        id > lastID ? 0 : U32(users[Int(id)])
+    }
+
+    public static func isEnabled(_ id: U32) -> Bool {
+        if id < 32 { return (read32(ATSAM3X8E.PMC.PCSR0) & (U32(1) << id)) != 0 }
+        return (read32(ATSAM3X8E.PMC.PCSR1) & (U32(1) << (id - 32))) != 0
+    }
+
+    /// Gate every enabled clock without a user. Returns how many were gated.
+    @discardableResult
+    public static func disableUnused() -> U32 {
+        var gated: U32 = 0
+        var id = firstID
+        while id <= lastID {
+            if users[Int(id)] == 0 && isEnabled(id) {
+                disable(id)
+                gated += 1
+            }
+            id += 1
+        }
+        return gated
+    }
+
+    // PCER/PCDR are write-1: no read-modify-write.
+    @inline(__always)
+    private static func enable(_ id: U32) {
+        if id < 32 {
+            write32(ATSAM3X8E.PMC.PCER0, U32(1) << id)
+        } else {
+            write32(ATSAM3X8E.PMC.PCER1, U32(1) << (id - 32))
+        }
+    }
+
+    @inline(__always)
+    private static func disable(_ id: U32) {
+        if id < 32 {
+            write32(ATSAM3X8E.PMC.PCDR0, U32(1) << id)
+        } else {
+            write32(ATSAM3X8E.PMC.PCDR1, U32(1) << (id - 32))
+        }
+    }
+}
+
+public final class Power {
+
+    // MARK: - Public types
+
+    public enum Mode {
+        case run                    // deadline too close: stay awake
+        case sleep                  // WFI
+        case wait                   // all clocks off but the slow clock
+        case backup                 // core off, reset on wakeup
+    }
+
+    /// Wakeup latency per mode, microseconds.
+    public struct Latency {
+        public var sleepUs: U32
+        public var waitUs: U32
+        public var backupUs: U32
+    }
+
+    public struct Stats {
+        public var run: U32 = 0
+        public var sleep: U32 = 0
+        public var wait: U32 = 0
+        public var sleptMs: U32 = 0
+        public var lateWakeups: U32 = 0     // woke after the deadline
+    }
+
+    // MARK: - State
+
+    /// Conservative until measureLatency() runs.
+    public private(set) var latency = Latency(sleepUs: 100, waitUs: 5_000, backupUs: 50_000)
+    public private(set) var stats = Stats()
+    public var residencyFactor: U32 = 4
+    public var allowBackup = false
+
+    private let timeKeeper: TimeKeeper
+    private let timer: Timer
+
+    // GPBR5: alarm tick (low 32 bits), GPBR6: tag while a measurement runs.
+    private static let tag: U32 = 0x5057_5200          // "PWR"
+    private static let gpbrTarget: U32 = ATSAM3X8E.GPBR_BASE + 5 * ATSAM3X8E.GPBR.STRIDE
+    private static let gpbrTag: U32 = ATSAM3X8E.GPBR_BASE + 6 * ATSAM3X8E.GPBR.STRIDE
+
+    // MARK: - Init
+
+    /// `timeKeeper` must have run begin().
+    public init(timeKeeper: TimeKeeper, timer: Timer) {
+        self.timeKeeper = timeKeeper
+        self.timer = timer
+    }
+
+    /// Gate unused peripheral clocks and finish a backup latency
+    /// measurement started before the reset. Call once drivers are up.
+    @discardableResult
+    public func begin() -> U32 {
+        if read32(Self.gpbrTag) == Self.tag {
+            write32(Self.gpbrTag, 0)
+            if timeKeeper.wokeFromBackup {
+                let now = timeKeeper.now()
+                var target = (now & ~UInt64(0xFFFF_FFFF)) | UInt64(read32(Self.gpbrTarget))
+                if target > now { target &-= UInt64(1) << 32 }
+                if let us = sinceTickUs(target) { latency.backupUs = us }
+            }
+        }
+        return PeripheralClock.disableUnused()
+    }
+
+    // MARK: - Latency
+
+    /// Worst of `samples` wakeups per mode (a few ms each); updates `latency`.
+    @discardableResult
+    public func measureLatency(samples: U32 = 4) -> Latency {
+        latency.sleepUs = worst(.sleep, samples)
+        latency.waitUs = worst(.wait, samples)
+        return latency
+    }
+
+    /// Backup mode for `ms`; the next boot's begin() sets latency.backupUs.
+    public func measureBackupLatency(ms: U32 = 50) -> Never {
+        let target = timeKeeper.now() + timeKeeper.ticks(ms: ms)
+        write32(Self.gpbrTarget, U32(truncatingIfNeeded: target))
+        write32(Self.gpbrTag, Self.tag)
+        timeKeeper.sleepInBackup(untilTick: target)
+    }
+
+    // MARK: - Mode choice
+
+    /// Deepest mode that wakes within `latencyBudgetUs` and pays off in
+    /// `idleMs`.
+    public func choose(idleMs: U32, latencyBudgetUs: U32) -> Mode {
+        let idleUs = UInt64(idleMs) * 1000
+        if allowBackup && fits(latency.backupUs, latencyBudgetUs, idleUs) { return .backup }
+        if fits(latency.waitUs, latencyBudgetUs, idleUs) { return .wait }
+        if idleMs >= 2 && fits(latency.sleepUs, latencyBudgetUs, idleUs) { return .sleep }
+        return .run
+    }
+
+    /// Sleep until `deadline` (Timer.millis() time) in the mode choose()
+    /// picks; returns it. With .backup this does not return.
+    @discardableResult
+    public func idle(until deadline: U32, latencyBudgetUs: U32) -> Mode {
+        let left = deadline &- timer.millis()
+        if (left & 0x8000_0000) != 0 || left == 0 { return count(.run) }
+        let mode = choose(idleMs: left, latencyBudgetUs: latencyBudgetUs)
+
+        let wakeEarlyMs: U32
+        switch mode {
+        case .run: return count(.run)
+        case .sleep: wakeEarlyMs = (latency.sleepUs + 999) / 1000
+        case .wait: wakeEarlyMs = (latency.waitUs + 999) / 1000
+        case .backup:
+            timeKeeper.sleepInBackup(ms: left - min((latency.backupUs + 999) / 1000, left))
+        }
+        if left <= wakeEarlyMs { return count(.run) }
+
+        let slept = timeKeeper.sleep(ms: left - wakeEarlyMs, mode: mode == .wait ? .wait : .sleep)
+        stats.sleptMs &+= slept
+        let over = timer.millis() &- deadline
+        if (over & 0x8000_0000) == 0 && over != 0 { stats.lateWakeups &+= 1 }
+        return count(mode)
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - Internals
+
+    @inline(__always)
+    private func fits(_ latencyUs: U32, _ budgetUs: U32, _ idleUs: UInt64) -> Bool {
+        latencyUs <= budgetUs && idleUs >= UInt64(latencyUs) * UInt64(residencyFactor)
+    }
+
+    private func count(_ mode: Mode) -> Mode {
+        switch mode {
+        case .run: stats.run &+= 1
+        case .sleep: stats.sleep &+= 1
+        case .wait: stats.wait &+= 1
+        case .backup: break
+        }
+        return mode
+    }
+
+    private func worst(_ mode: TimeKeeper.SleepMode, _ samples: U32) -> U32 {
+        var worstUs: U32 = 0
+        var i: U32 = 0
+        while i < samples {
+            timeKeeper.sleep(ms: 3, mode: mode)
+            if let us = sinceTickUs(timeKeeper.lastAlarm) { worstUs = max(worstUs, us) }
+            i += 1
+        }
+        return worstUs
+    }
+
+    /// Time since the RTT reached `target`: whole ticks from the counter,
+    /// the fraction from DWT cycles up to the next tick edge.
+    private func sinceTickUs(_ target: UInt64) -> U32? {
+        let v = timeKeeper.now()
+        if v < target { return nil }                      // another IRQ woke us early
+        let c0 = CycleCounter.now()
+        while timeKeeper.now() == v {}
+        let toEdge = UInt64(CycleCounter.now() &- c0)
+
+        let hz = UInt64(timer.cpuHz)
+        let tickCycles = hz / UInt64(timeKeeper.tickHz)
+        let cycles = (v - target + 1) * tickCycles - min(toEdge, tickCycles)
+        return U32(truncatingIfNeeded: cycles * 1_000_000 / hz)
+    }
+}
@@ -0,0 +1,266 @@
+//
+// Random.swift — hardware TRNG + xoshiro128** PRNG.
+//
+// Goals:
+// - TRNG: true random words from the SAM3X TRNG (one per 84 MCK cycles) for
+//   seeds, nonces and keys. arc4random_buf (support.c) reads the same
+//   peripheral, so Swift's hashing seed and SystemRandomNumberGenerator
+//   differ on every boot.
+// - Xoshiro128: xoshiro128** (Blackman/Vigna), 128-bit state, one U32 per
+//   call; fill() writes whole words for bulk buffers (test patterns, noise,
+//   dither). Seeded from the TRNG, or from a fixed seed for reproducible
+//   runs. Conforms to RandomNumberGenerator (shuffle(), random(in:)).
+// - Random.measure(): bytes per 1000 cycles of each source on this board.
+//
+// Notes:
+// - Xoshiro128 is NOT cryptographic: secrets come from TRNG.
+// - TRNG.next() busy-waits for DATRDY (at most 84 MCK cycles); IRQ 41 is
+//   not used.
+// - Health check: two equal consecutive TRNG words (p = 2^-32) count as
+//   stats.repeats; a stuck or unclocked TRNG shows up there and as timeouts.
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, waitBitSet32
+// - ATSAM3X8E.swift: TRNG registers, PMC
+// - Timer.swift: CycleCounter (measure())
+//
+
+public enum TRNG {
+
+    public struct Stats {
+        public var words: U32 = 0
+        public var timeouts: U32 = 0        // DATRDY did not come
+        public var repeats: U32 = 0         // word equal to the previous one
+    }
+
+    public private(set) static var stats = Stats()
+
+    private static var started = false
+    private static var last: U32 = 0
+
+    /// Clock and enable the TRNG (idempotent; next() calls it).
+    public static func begin() {
+        if started { return }
+        PeripheralClock.acquire(ATSAM3X8E.ID.TRNG)
+        write32(ATSAM3X8E.TRNG.CR, ATSAM3X8E.TRNG.CR_KEY | ATSAM3X8E.TRNG.CR_ENABLE)
+        started = true
+    }
+
+    /// One fresh 32-bit word.
+    public static func next() -> U32 {
+        if !started { begin() }
+        if !waitBitSet32(ATSAM3X8E.TRNG.ISR, ATSAM3X8E.TRNG.ISR_DATRDY, timeout: 1000) {
+            stats.timeouts &+= 1
+        }
+        let w = read32(ATSAM3X8E.TRNG.ODATA)
+        if w == last { stats.repeats &+= 1 }
+        last = w
+        stats.words &+= 1
+        return w
+    }
+
+    /// Fill `buf` with TRNG output, one word per 4 bytes.
+    public static func fill(_ buf: UnsafeMutableRawBufferPointer) {
+        guard let base = buf.baseAddress else { return }
+        var i = 0
+        while i + 4 <= buf.count {
+            (base + i).storeBytes(of: next(), as: U32.self)
+            i += 4
+        }
+        if i < buf.count {
+            var w = next()
+            while i < buf.count {
+                (base + i).storeBytes(of: U8(truncatingIfNeeded: w), as: U8.self)
+                w >>= 8
+                i += 1
+            }
+        }
+    }
+
+    public static func resetStats() {
+        stats = Stats()
+    }
+}
+
+/// xoshiro128**: 2^128 - 1 period, passes BigCrush, a handful of cycles per
+/// word on the Cortex-M3 (shifts, xors, two multiplies).
+public struct Xoshiro128: RandomNumberGenerator {
+
+    private var s0: U32
+    private var s1: U32
+    private var s2: U32
+    private var s3: U32
+
+    /// Seeded from the TRNG.
+    public init() {
+        self.init(words: TRNG.next(), TRNG.next(), TRNG.next(), TRNG.next())
+    }
+
+    /// Reproducible sequence: `seed` expanded with splitmix64.
+    public init(seed: UInt64) {
+        var x = seed
+        let a = Self.splitmix64(&x)
+        let b = Self.splitmix64(&x)
+        self.init(words: U32(truncatingIfNeeded: a), U32(truncatingIfNeeded: a >> 32),
+                  U32(truncatingIfNeeded: b), U32(truncatingIfNeeded: b >> 32))
+    }
+
+    private init(words a: U32, _ b: U32, _ c: U32, _ d: U32) {
+        s0 = a
+        s1 = b
+        s2 = c
+        s3 = d
+        if (s0 | s1 | s2 | s3) == 0 { s0 = 1 }  // the all-zero state is a fixed point
+    }
+
+    @inline(__always)
+    public mutating func nextWord() -> U32 {
+        let result = rotl(s1 &* 5, 7) &* 9
+        let t = s1 << 9
+        s2 ^= s0
+        s3 ^= s1
+        s1 ^= s2
+        s0 ^= s3
+        s2 ^= t
+        s3 = rotl(s3, 11)
+        return result
+    }
+
+    /// RandomNumberGenerator: two words.
+    public mutating func next() -> UInt64 {
+        let hi = UInt64(nextWord())
+        return (hi << 32) | UInt64(nextWord())
+    }
+
+    /// Uniform in 0..<bound (Lemire's multiply-shift, no modulo bias).
+    public mutating func next(below bound: U32) -> U32 {
+        if bound == 0 { return 0 }
+        var m = UInt64(nextWord()) * UInt64(bound)
+        if U32(truncatingIfNeeded: m) < bound {
+            let threshold = (0 &- bound) % bound
+            while U32(truncatingIfNeeded: m) < threshold {
+                m = UInt64(nextWord()) * UInt64(bound)
+            }
+        }
+        return U32(truncatingIfNeeded: m >> 32)
+    }
+
+    /// Fill `buf`: aligned word stores with the state kept in registers,
+    /// bytes only for an unaligned head / short tail.
+    public mutating func fill(_ buf: UnsafeMutableRawBufferPointer) {
+        guard let base = buf.baseAddress else { return }
+        var n = buf.count
+        var p = base
+
+        while n > 0 && (UInt(bitPattern: p) & 3) != 0 {
+            p.storeBytes(of: U8(truncatingIfNeeded: nextWord()), as: U8.self)
+            p += 1
+            n -= 1
+        }
+
+        var a = s0, b = s1, c = s2, d = s3
+        let words = p.assumingMemoryBound(to: U32.self)
+        let count = n / 4
+        var i = 0
+        while i < count {
+            words[i] = rotl(b &* 5, 7) &* 9
+            let t = b << 9
+            c ^= a
+            d ^= b
+            b ^= c
+            a ^= d
+            c ^= t
+            d = rotl(d, 11)
+            i += 1
+        }
+        s0 = a
+        s1 = b
+        s2 = c
+        s3 = d
+
+        p += count * 4
+        n -= count * 4
+        if n > 0 {
+            var w = nextWord()
+            while n > 0 {
+                p.storeBytes(of: U8(truncatingIfNeeded: w), as: U8.self)
+                w >>= 8
+                p += 1
+                n -= 1
+            }
+        }
+    }
+
+    @inline(__always)
+    private func rotl(_ x: U32, _ k: U32) -> U32 {
+        (x << k) | (x >> (32 - k))
+    }
+
+    private static func splitmix64(_ x: inout UInt64) -> UInt64 {
+        x &+= 0x9E37_79B9_7F4A_7C15
+        var z = x
+        z = (z ^ (z >> 30)) &* 0xBF58_476D_1CE4_E5B9
+        z = (z ^ (z >> 27)) &* 0x94D0_49BB_1331_11EB
+        return z ^ (z >> 31)
+    }
+}
+
+public enum Random {
+
+    /// Bytes produced per 1000 CPU cycles (higher is faster).
+    public struct Throughput {
+        public let bytes: U32
+        public let trng: U32                // TRNG.fill
+        public let system: U32              // SystemRandomNumberGenerator (arc4random_buf)
+        public let xoshiroWords: U32        // nextWord() stored one at a time
+        public let xoshiroFill: U32         // Xoshiro128.fill
+    }
+
+    /// Time each source filling `scratch` (overwritten).
+    public static func measure(scratch: UnsafeMutableRawBufferPointer) -> Throughput {
+        let bytes = scratch.count & ~7
+        guard let base = scratch.baseAddress, bytes > 0 else {
+            return Throughput(bytes: 0, trng: 0, system: 0, xoshiroWords: 0, xoshiroFill: 0)
+        }
+        let region = UnsafeMutableRawBufferPointer(start: base, count: bytes)
+
+        var t0 = CycleCounter.now()
+        TRNG.fill(region)
+        let trng = CycleCounter.now() &- t0
+
+        var system = SystemRandomNumberGenerator()
+        t0 = CycleCounter.now()
+        var i = 0
+        while i < bytes {
+            (base + i).storeBytes(of: system.next(), as: UInt64.self)
+            i += 8
+        }
+        let sys = CycleCounter.now() &- t0
+
+        var x = Xoshiro128(seed: 1)
+        t0 = CycleCounter.now()
+        i = 0
+        while i < bytes {
+            (base + i).storeBytes(of: x.nextWord(), as: U32.self)
+            i += 4
+        }
+        let words = CycleCounter.now() &- t0
+
+        t0 = CycleCounter.now()
+        x.fill(region)
+        let fill = CycleCounter.now() &- t0
+
+        return Throughput(
+            bytes: U32(bytes),
+            trng: perKiloCycle(bytes, trng),
+            system: perKiloCycle(bytes, sys),
+            xoshiroWords: perKiloCycle(bytes, words),
+            xoshiroFill: perKiloCycle(bytes, fill)
+        )
+    }
+
+    private static func perKiloCycle(_ bytes: Int, _ cycles: U32) -> U32 {
+        if cycles == 0 { return 0 }
+        return U32(UInt64(bytes) * 1000 / UInt64(cycles))
+    }
+}
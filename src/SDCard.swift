@@ -0,0 +1,542 @@
+//
+// SDCard.swift — SD/SDHC card on the HSMCI controller (4-bit bus, DMA blocks).
+//
+// Goals:
+// - Gigabytes of local storage behind the BlockDevice interface.
+// - Card bring-up: CMD0/CMD8/ACMD41/CMD2/CMD3/CMD9/CMD7, then ACMD6 for the
+//   4-bit bus and CMD6 for high-speed mode (MCCK 42 MHz from 84 MHz MCK).
+// - Multi-block read/write (CMD18/CMD25 + CMD12) moved by one DMAC channel:
+//   the CPU only issues commands.
+// - Async writes: startWrite() returns after the command, pollWrite() walks
+//   data -> stop -> card programming (busy on DAT0) without blocking, so a
+//   file layer can fill its second buffer while the card is busy.
+// - Stats: blocks, transfers, card busy time (last/max cycles).
+//
+// Notes:
+// - Pins (peripheral A): MCCK PA19 (D42), MCCDA PA20 (D43), MCDA0..3
+//   PA21..PA24. The Due has no card slot: wire a breakout; MCDA1..3 share
+//   pins with A3..A5 and MCDA0 with the TX LED, so those can't be used.
+//   Internal pull-ups are enabled on CMD/DAT (external 10k-50k are better).
+// - SD v1 (SDSC, byte addressed) and v2 SDHC/SDXC (block addressed).
+//   MMC and SPI-mode cards are not supported.
+// - Clocks: MCCK = MCK / (2 * (CLKDIV + 1)): 400 kHz identification,
+//   21 MHz default speed, 42 MHz high speed (when the card accepts CMD6).
+// - Buffers must be 4-byte aligned (word DMA beats on the FIFO register).
+// - A single DMA block is at most 65535 words, so one transfer moves up to
+//   maxBlocksPerTransfer blocks; read()/write() split longer requests.
+// - Cycle counts use the DWT counter (CPU clock = MCK here).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, waitUntil, spin
+// - DMA.swift: one channel with the HSMCI handshaking interface
+// - BlockDevice.swift: BlockDevice, BlockDeviceError, BlockWriteState
+// - ATSAM3X8E.swift: HSMCI registers/bitfields, PMC, PIO
+// - Timer.swift: CycleCounter
+//
+
+public final class SDCard: BlockDevice {
+
+    // MARK: - Public types
+
+    public enum Kind {
+        case sdsc      // byte addressed, <= 2 GB
+        case sdhc      // block addressed (SDHC/SDXC)
+    }
+
+    public struct Info {
+        public let kind: Kind
+        public let rca: U32
+        public let blockCount: U32
+        public let busWidth: U32        // 1 or 4
+        public let clockHz: U32         // MCCK actually programmed
+        public let highSpeed: Bool
+
+        public var megabytes: U32 { blockCount / 2048 }
+    }
+
+    public struct Stats {
+        public var blocksRead: U32 = 0
+        public var blocksWritten: U32 = 0
+        public var reads: U32 = 0
+        public var writes: U32 = 0
+        public var errors: U32 = 0
+        public var lastBusyCycles: U32 = 0     // card programming after the last write
+        public var maxBusyCycles: U32 = 0
+        public var lastWriteCycles: U32 = 0    // startWrite() -> .done
+        public var maxWriteCycles: U32 = 0
+    }
+
+    // MARK: - Constants
+
+    public static let maxBlocksPerTransfer: U32 = DMA.maxBeatsPerBlock / 128
+
+    private static let timeoutSpins: U32 = 20_000_000
+    private static let identifyHz: U32 = 400_000
+    private static let defaultSpeedHz: U32 = 25_000_000
+    private static let highSpeedHz: U32 = 50_000_000
+    private static let ocrVoltages: U32 = 0x00FF_8000    // 2.7 .. 3.6 V
+    private static let ocrHCS: U32 = U32(1) << 30
+    private static let ocrBusy: U32 = U32(1) << 31        // 1 = power-up finished
+    private static let r1Errors: U32 = 0xFDF8_0000        // card status error bits
+    private static let busyTimeoutMs: U32 = 500
+
+    private static let rxConfig = DMA.Config(flow: .peripheralToMemory, interface: .hsmci)
+    private static let txConfig = DMA.Config(flow: .memoryToPeripheral, interface: .hsmci)
+
+    // MARK: - State
+
+    public private(set) var info: Info? = nil
+    public private(set) var stats = Stats()
+    public var blockCount: U32 { info?.blockCount ?? 0 }
+
+    private let mckHz: U32
+    private var clockHeld = false
+    private var dma: DMA.Channel? = nil
+    private var addressShift: U32 = 0      // 9 for byte-addressed SDSC
+
+    private enum Stage { case idle, data, programming }
+    private var stage: Stage = .idle
+    private var writeMulti = false
+    private var writeBlocks: U32 = 0
+    private var writeStart: U32 = 0
+    private var busyStart: U32 = 0
+
+    private enum Response { case none, r1, r1b, r2, r3, r6, r7 }
+
+    // MARK: - Init
+
+    public init(mckHz: U32) {
+        self.mckHz = mckHz
+    }
+
+    // MARK: - Setup
+
+    /// Power the controller, identify the card and switch it to the fastest
+    /// bus it supports (`fourBit`, `highSpeed` can force the slower ones).
+    @discardableResult
+    public func begin(fourBit: Bool = true, highSpeed: Bool = true) throws(BlockDeviceError) -> Info {
+        info = nil
+        stage = .idle
+        if !clockHeld {
+            PeripheralClock.acquire(ATSAM3X8E.ID.HSMCI)
+            clockHeld = true
+        }
+        if dma == nil { dma = DMA.allocate() }
+        if dma == nil { throw .dmaError }
+
+        let pioa = ATSAM3X8E.PIOA_BASE
+        write32(pioa + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.HSMCI.PIOA_MASK)
+        clearBits32(pioa + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.HSMCI.PIOA_MASK)
+        write32(pioa + ATSAM3X8E.PIOX.PUER_OFFSET, ATSAM3X8E.HSMCI.PIOA_MASK & ~(U32(1) << 19))
+
+        write32(ATSAM3X8E.HSMCI.WPMR, ATSAM3X8E.HSMCI.WPMR_KEY)
+        write32(ATSAM3X8E.HSMCI.CR, ATSAM3X8E.HSMCI.CR_SWRST)
+        write32(ATSAM3X8E.HSMCI.CR, ATSAM3X8E.HSMCI.CR_MCIDIS | ATSAM3X8E.HSMCI.CR_PWSDIS)
+        write32(ATSAM3X8E.HSMCI.IDR, 0xFFFF_FFFF)
+        write32(ATSAM3X8E.HSMCI.DTOR, ATSAM3X8E.HSMCI.DTOR_MAX)
+        write32(ATSAM3X8E.HSMCI.CSTOR, ATSAM3X8E.HSMCI.CSTOR_MAX)
+        write32(ATSAM3X8E.HSMCI.CFG, ATSAM3X8E.HSMCI.CFG_FIFOMODE | ATSAM3X8E.HSMCI.CFG_FERRCTRL)
+        write32(ATSAM3X8E.HSMCI.SDCR, ATSAM3X8E.HSMCI.SDCR_SDCBUS_1)
+        write32(ATSAM3X8E.HSMCI.DMA, 0)
+        var clock = setClock(Self.identifyHz)
+        write32(ATSAM3X8E.HSMCI.CR, ATSAM3X8E.HSMCI.CR_MCIEN | ATSAM3X8E.HSMCI.CR_PWSDIS)
+
+        // 74 clocks with CMD high, then reset to idle.
+        _ = try command(0, 0, .none, flags: ATSAM3X8E.HSMCI.CMDR_SPCMD_INIT | ATSAM3X8E.HSMCI.CMDR_OPDCMD)
+        _ = try command(0, 0, .none)
+
+        // CMD8: only v2 cards answer (echo of the check pattern).
+        var v2 = true
+        do throws(BlockDeviceError) {
+            let r = try command(8, 0x1AA, .r7)
+            if (r & 0xFFF) != 0x1AA { throw BlockDeviceError.unsupportedCard }
+        } catch .command {
+            v2 = false
+        }
+
+        // ACMD41 until the card leaves power-up (up to ~1 s).
+        let arg = Self.ocrVoltages | (v2 ? Self.ocrHCS : 0)
+        var ocr: U32 = 0
+        var tries = 0
+        while true {
+            do throws(BlockDeviceError) {
+                _ = try command(55, 0, .r1)
+                ocr = try command(41, arg, .r3)
+            } catch .command {
+                throw .noCard
+            }
+            if (ocr & Self.ocrBusy) != 0 { break }
+            tries += 1
+            if tries >= 1000 { throw .noCard }
+            spin(mckHz / 4000)           // ~1 ms
+        }
+        let kind: Kind = (v2 && (ocr & Self.ocrHCS) != 0) ? .sdhc : .sdsc
+        addressShift = kind == .sdhc ? 0 : 9
+
+        _ = try command(2, 0, .r2)                   // CID (not kept)
+        let rca = try command(3, 0, .r6) & 0xFFFF_0000
+        _ = try command(9, rca, .r2)
+        let blocks = readCapacity()
+        if blocks == 0 { throw .unsupportedCard }
+        _ = try command(7, rca, .r1b)
+        try waitNotBusy()
+
+        clock = setClock(Self.defaultSpeedHz)
+
+        var width: U32 = 1
+        if fourBit {
+            _ = try command(55, rca, .r1)
+            _ = try command(6, 2, .r1)
+            write32(ATSAM3X8E.HSMCI.SDCR, ATSAM3X8E.HSMCI.SDCR_SDCBUS_4)
+            width = 4
+        }
+        if kind == .sdsc { _ = try command(16, 512, .r1) }
+
+        var hs = false
+        if highSpeed && switchHighSpeed() {
+            setBits32(ATSAM3X8E.HSMCI.CFG, ATSAM3X8E.HSMCI.CFG_HSMODE)
+            clock = setClock(Self.highSpeedHz)
+            hs = true
+        }
+
+        let i = Info(kind: kind, rca: rca >> 16, blockCount: blocks, busWidth: width, clockHz: clock, highSpeed: hs)
+        info = i
+        return i
+    }
+
+    // MARK: - BlockDevice
+
+    /// Blocking multi-block read (DMA, split every maxBlocksPerTransfer).
+    public func read(_ lba: U32, _ dst: UnsafeMutableRawPointer, blocks: U32) throws(BlockDeviceError) {
+        try check(lba, blocks, Self.address(UnsafeRawPointer(dst)))
+        if stage != .idle { throw .busy }
+
+        var done: U32 = 0
+        while done < blocks {
+            let n = min(blocks - done, Self.maxBlocksPerTransfer)
+            do throws(BlockDeviceError) {
+                try readChunk(lba + done, Self.address(UnsafeRawPointer(dst)) + done * 512, n)
+            } catch {
+                stats.errors &+= 1
+                throw error
+            }
+            done += n
+        }
+        stats.reads &+= 1
+        stats.blocksRead &+= blocks
+    }
+
+    /// Blocking write: startWrite() per chunk, then wait out the card busy time.
+    public func write(_ lba: U32, _ src: UnsafeRawPointer, blocks: U32) throws(BlockDeviceError) {
+        var done: U32 = 0
+        while done < blocks {
+            let n = min(blocks - done, Self.maxBlocksPerTransfer)
+            try startWrite(lba + done, src + Int(done) * 512, blocks: n)
+            var state: BlockWriteState = .busy
+            _ = waitUntil(Self.timeoutSpins) {
+                state = pollWrite()
+                return state != .busy
+            }
+            switch state {
+            case .done, .idle: break
+            case .busy: abortWrite(); throw .timeout
+            case .failed(let e): throw e
+            }
+            done += n
+        }
+    }
+
+    /// Start a write of up to maxBlocksPerTransfer blocks and return.
+    public func startWrite(_ lba: U32, _ src: UnsafeRawPointer, blocks: U32) throws(BlockDeviceError) {
+        try check(lba, blocks, Self.address(src))
+        if stage != .idle { throw .busy }
+        if blocks > Self.maxBlocksPerTransfer { throw .outOfRange }
+        guard let dma else { throw .notStarted }
+
+        writeMulti = blocks > 1
+        writeBlocks = blocks
+        writeStart = CycleCounter.now()
+        prepareData(blocks, blockLength: 512)
+        do throws(BlockDeviceError) {
+            _ = try command(
+                writeMulti ? 25 : 24, lba << addressShift, .r1,
+                flags: ATSAM3X8E.HSMCI.CMDR_TRCMD_START |
+                    (writeMulti ? ATSAM3X8E.HSMCI.CMDR_TRTYP_MULTIPLE : ATSAM3X8E.HSMCI.CMDR_TRTYP_SINGLE)
+            )
+        } catch {
+            write32(ATSAM3X8E.HSMCI.DMA, 0)
+            stats.errors &+= 1
+            throw error
+        }
+        dma.start(
+            DMA.Block(
+                source: Self.address(src),
+                destination: ATSAM3X8E.HSMCI.TDR,
+                count: blocks * 128, width: .word, flow: .memoryToPeripheral
+            ),
+            config: Self.txConfig
+        )
+        stage = .data
+    }
+
+    /// Advance the async write: DMA -> XFRDONE -> CMD12 -> card busy -> done.
+    public func pollWrite() -> BlockWriteState {
+        switch stage {
+        case .idle:
+            return .idle
+
+        case .data:
+            guard let dma else { return finishWrite(.failed(.notStarted)) }
+            if dma.isBusy {
+                dma.poll()
+                if dma.isBusy { return .busy }
+            }
+            if dma.lastResult != .done { return finishWrite(.failed(.dmaError)) }
+
+            let sr = read32(ATSAM3X8E.HSMCI.SR)
+            if (sr & ATSAM3X8E.HSMCI.SR_DATA_ERRORS) != 0 { return finishWrite(.failed(.data(sr))) }
+            if (sr & ATSAM3X8E.HSMCI.SR_XFRDONE) == 0 { return .busy }
+
+            if writeMulti {
+                do throws(BlockDeviceError) {
+                    _ = try command(12, 0, .r1b, flags: ATSAM3X8E.HSMCI.CMDR_TRCMD_STOP, checkStatus: false)
+                } catch {
+                    return finishWrite(.failed(error))
+                }
+            }
+            busyStart = CycleCounter.now()
+            stage = .programming
+            return .busy
+
+        case .programming:
+            let sr = read32(ATSAM3X8E.HSMCI.SR)
+            if (sr & ATSAM3X8E.HSMCI.SR_NOTBUSY) == 0 || (sr & ATSAM3X8E.HSMCI.SR_DTIP) != 0 {
+                if CycleCounter.now() &- busyStart > (mckHz / 1000) * Self.busyTimeoutMs {
+                    return finishWrite(.failed(.timeout))
+                }
+                return .busy
+            }
+            let busy = CycleCounter.now() &- busyStart
+            stats.lastBusyCycles = busy
+            if busy > stats.maxBusyCycles { stats.maxBusyCycles = busy }
+            return finishWrite(.done)
+        }
+    }
+
+    /// True while a write (or the card's programming after it) is running.
+    public var isWriting: Bool { stage != .idle }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - Internals
+
+    private func check(_ lba: U32, _ blocks: U32, _ addr: U32) throws(BlockDeviceError) {
+        guard let info else { throw .notStarted }
+        if blocks == 0 || lba >= info.blockCount || blocks > info.blockCount - lba { throw .outOfRange }
+        if (addr & 3) != 0 { throw .misaligned }
+    }
+
+    private func readChunk(_ lba: U32, _ addr: U32, _ n: U32) throws(BlockDeviceError) {
+        guard let dma else { throw .notStarted }
+        let multi = n > 1
+
+        // DMA first: it must be listening before the first word arrives.
+        prepareData(n, blockLength: 512)
+        dma.start(
+            DMA.Block(
+                source: ATSAM3X8E.HSMCI.RDR,
+                destination: addr,
+                count: n * 128, width: .word, flow: .peripheralToMemory
+            ),
+            config: Self.rxConfig
+        )
+        do throws(BlockDeviceError) {
+            _ = try command(
+                multi ? 18 : 17, lba << addressShift, .r1,
+                flags: ATSAM3X8E.HSMCI.CMDR_TRCMD_START | ATSAM3X8E.HSMCI.CMDR_TRDIR_READ |
+                    (multi ? ATSAM3X8E.HSMCI.CMDR_TRTYP_MULTIPLE : ATSAM3X8E.HSMCI.CMDR_TRTYP_SINGLE)
+            )
+        } catch {
+            dma.abort()
+            write32(ATSAM3X8E.HSMCI.DMA, 0)
+            throw error
+        }
+
+        let r = dma.wait()
+        var sr: U32 = 0
+        var errors: U32 = 0
+        let ok = waitUntil(Self.timeoutSpins) {
+            sr = read32(ATSAM3X8E.HSMCI.SR)
+            errors |= sr & ATSAM3X8E.HSMCI.SR_DATA_ERRORS
+            return (sr & ATSAM3X8E.HSMCI.SR_XFRDONE) != 0 || errors != 0
+        }
+        if multi {
+            // Stop even after an error so the card returns to transfer state.
+            _ = try? command(12, 0, .r1b, flags: ATSAM3X8E.HSMCI.CMDR_TRCMD_STOP, checkStatus: false)
+            _ = try? waitNotBusy()
+        }
+        write32(ATSAM3X8E.HSMCI.DMA, 0)
+
+        if r != .done { throw .dmaError }
+        if errors != 0 { throw .data(sr | errors) }
+        if !ok { throw .timeout }
+    }
+
+    private func prepareData(_ blocks: U32, blockLength: U32) {
+        write32(ATSAM3X8E.HSMCI.DMA, ATSAM3X8E.HSMCI.DMA_DMAEN | ATSAM3X8E.HSMCI.DMA_CHKSIZE_1)
+        write32(ATSAM3X8E.HSMCI.BLKR, blocks | (blockLength << ATSAM3X8E.HSMCI.BLKR_BLKLEN_SHIFT))
+    }
+
+    private func finishWrite(_ result: BlockWriteState) -> BlockWriteState {
+        write32(ATSAM3X8E.HSMCI.DMA, 0)
+        stage = .idle
+        if result == .done {
+            let t = CycleCounter.now() &- writeStart
+            stats.lastWriteCycles = t
+            if t > stats.maxWriteCycles { stats.maxWriteCycles = t }
+            stats.writes &+= 1
+            stats.blocksWritten &+= writeBlocks
+        } else {
+            stats.errors &+= 1
+            if writeMulti {
+                _ = try? command(12, 0, .r1b, flags: ATSAM3X8E.HSMCI.CMDR_TRCMD_STOP, checkStatus: false)
+                _ = try? waitNotBusy()
+            }
+        }
+        return result
+    }
+
+    private func abortWrite() {
+        dma?.abort()
+        _ = finishWrite(.failed(.timeout))
+    }
+
+    /// Issue one command and wait for its response (not for R1b busy).
+    private func command(
+        _ index: U32,
+        _ arg: U32,
+        _ rsp: Response,
+        flags: U32 = 0,
+        checkStatus: Bool = true
+    ) throws(BlockDeviceError) -> U32 {
+        var cmdr = index | flags
+        switch rsp {
+        case .none: cmdr |= ATSAM3X8E.HSMCI.CMDR_RSPTYP_NONE
+        case .r2: cmdr |= ATSAM3X8E.HSMCI.CMDR_RSPTYP_136 | ATSAM3X8E.HSMCI.CMDR_MAXLAT_64
+        case .r1b: cmdr |= ATSAM3X8E.HSMCI.CMDR_RSPTYP_R1B | ATSAM3X8E.HSMCI.CMDR_MAXLAT_64
+        default: cmdr |= ATSAM3X8E.HSMCI.CMDR_RSPTYP_48 | ATSAM3X8E.HSMCI.CMDR_MAXLAT_64
+        }
+
+        write32(ATSAM3X8E.HSMCI.ARGR, arg)
+        write32(ATSAM3X8E.HSMCI.CMDR, cmdr)
+
+        var sr: U32 = 0
+        if !waitUntil(Self.timeoutSpins, {
+            sr = read32(ATSAM3X8E.HSMCI.SR)
+            return (sr & ATSAM3X8E.HSMCI.SR_CMDRDY) != 0
+        }) {
+            throw .timeout
+        }
+
+        var errors = sr & ATSAM3X8E.HSMCI.SR_CMD_ERRORS
+        if rsp == .r3 { errors &= ~ATSAM3X8E.HSMCI.SR_RCRCE }    // R3 has no CRC
+        if errors != 0 { throw .command(index, sr) }
+
+        let r = rsp == .none ? 0 : read32(ATSAM3X8E.HSMCI.RSPR)
+        if checkStatus && (rsp == .r1 || rsp == .r1b) && (r & Self.r1Errors) != 0 {
+            throw .command(index, r)
+        }
+        return r
+    }
+
+    /// Card releases DAT0 (end of programming / R1b busy).
+    private func waitNotBusy() throws(BlockDeviceError) {
+        if !waitUntil(Self.timeoutSpins, {
+            let sr = read32(ATSAM3X8E.HSMCI.SR)
+            return (sr & ATSAM3X8E.HSMCI.SR_NOTBUSY) != 0 && (sr & ATSAM3X8E.HSMCI.SR_DTIP) == 0
+        }) {
+            throw .timeout
+        }
+    }
+
+    /// CSD from the R2 response (RSPR read 4x: bits 127..96 first).
+    private func readCapacity() -> U32 {
+        var csd: [U32] = [0, 0, 0, 0]
+        for i in 0..<4 { csd[i] = read32(ATSAM3X8E.HSMCI.RSPR) }
+
+        func bits(_ msb: Int, _ lsb: Int) -> U32 {
+            var v: U32 = 0
+            var b = msb
+            while b >= lsb {
+                let word = csd[3 - b / 32]
+                v = (v << 1) | ((word >> U32(b % 32)) & 1)
+                b -= 1
+            }
+            return v
+        }
+
+        switch bits(127, 126) {
+        case 0:     // CSD v1: (C_SIZE + 1) << (C_SIZE_MULT + 2) blocks of 2^READ_BL_LEN
+            let cSize = bits(73, 62)
+            let mult = bits(49, 47)
+            let blLen = bits(83, 80)
+            let bytes = UInt64(cSize + 1) << UInt64(mult + 2 + blLen)
+            return U32(bytes / 512)
+        case 1:     // CSD v2: (C_SIZE + 1) * 512 KiB
+            let cSize = bits(69, 48)
+            let blocks = UInt64(cSize + 1) * 1024
+            return blocks > 0xFFFF_FFFF ? 0xFFFF_FFFF : U32(blocks)
+        default:
+            return 0
+        }
+    }
+
+    /// CMD6 mode 1, group 1 function 1; true when the card switched.
+    private func switchHighSpeed() -> Bool {
+        write32(ATSAM3X8E.HSMCI.DMA, 0)
+        write32(ATSAM3X8E.HSMCI.BLKR, 1 | (64 << ATSAM3X8E.HSMCI.BLKR_BLKLEN_SHIFT))
+        do throws(BlockDeviceError) {
+            _ = try command(
+                6, 0x80FF_FFF1, .r1,
+                flags: ATSAM3X8E.HSMCI.CMDR_TRCMD_START | ATSAM3X8E.HSMCI.CMDR_TRDIR_READ |
+                    ATSAM3X8E.HSMCI.CMDR_TRTYP_SINGLE
+            )
+        } catch {
+            return false      // SD 1.0 cards do not know CMD6
+        }
+
+        // 512-bit status, first byte received = LSB of the first word.
+        var status: [U32] = [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
+        for i in 0..<16 {
+            if !waitBitSet32(ATSAM3X8E.HSMCI.SR, ATSAM3X8E.HSMCI.SR_RXRDY, timeout: Self.timeoutSpins) { return false }
+            status[i] = read32(ATSAM3X8E.HSMCI.RDR)
+        }
+        if !waitBitSet32(ATSAM3X8E.HSMCI.SR, ATSAM3X8E.HSMCI.SR_XFRDONE, timeout: Self.timeoutSpins) { return false }
+
+        // Byte 16 low nibble: function selected in group 1 (0xF = failed).
+        let selected = status[4] & 0xF
+        if selected != 1 { return false }
+        spin(mckHz / 4000)    // >= 8 clocks before the clock change; ~1 ms is plenty
+        return true
+    }
+
+    /// Program CLKDIV for at most `hz`; returns the real MCCK.
+    @discardableResult
+    private func setClock(_ hz: U32) -> U32 {
+        var div = (mckHz + 2 * hz - 1) / (2 * hz)
+        div = div == 0 ? 0 : div - 1
+        if div > ATSAM3X8E.HSMCI.MR_CLKDIV_MASK { div = ATSAM3X8E.HSMCI.MR_CLKDIV_MASK }
+        write32(
+            ATSAM3X8E.HSMCI.MR,
+            div | (7 << ATSAM3X8E.HSMCI.MR_PWSDIV_SHIFT) | ATSAM3X8E.HSMCI.MR_RDPROOF | ATSAM3X8E.HSMCI.MR_WRPROOF
+        )
+        return mckHz / (2 * (div + 1))
+    }
+
+    @inline(__always)
+    private static func address(_ p: UnsafeRawPointer) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+}
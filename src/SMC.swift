@@ -0,0 +1,444 @@
+//
+// SMC.swift — Static Memory Controller: external parallel SRAM / 8080 LCDs
+// as memory-mapped devices.
+//
+// Goals:
+// - Drive the external bus from the SMC instead of bit-banging PINs: one
+//   store to the chip-select window is one bus cycle (NCS, address, NWE,
+//   data) timed by hardware, a few tens of ns each.
+// - Timing from the datasheet, in ns: setup / pulse / hold per access type,
+//   converted to MCK cycles for the given mckHz (rounded up, never faster
+//   than asked) and reported back as actually programmed.
+// - Timing.sram(accessNs:) / Timing.ili9341 presets for the usual parts.
+// - External SRAM as normal memory: pointers, DMA, the .ext_sram linker
+//   section (support.c BM_EXT_SRAM) and the ExternalRAM arena.
+// - bandwidth(): CPU and DMAC throughput of any memory, internal or
+//   external, to see what the bus costs.
+//
+// Notes:
+// - 8-bit data bus (D0..D7). Wider CPU/DMA accesses are split by the SMC
+//   into byte cycles at consecutive addresses (a U32 store = 4 cycles).
+// - Read = NRD-controlled (data sampled when NRD rises), write =
+//   NWE-controlled. NCS asserts at the start of the cycle and releases with
+//   NRD/NWE; hold is the gap before the next cycle (address/data hold).
+// - floatNs: bus release time after a read (tHZ / tOHZ); the SMC inserts
+//   that many idle cycles before the next access on a different device.
+// - Pins (peripheral A unless noted):
+//     D0..D7 = PC2..PC9 (D34..D41)   NWE = PC18 (D45)
+//     A0..A5 = PC21..PC26 (D9..D4)   A6 = PC27, A9 = PC30: not on the headers
+//     A7/A8 = PC28/PC29 (D3/D10)     A10..A17 = PD0..PD7
+//     NRD = PA29 (B, shares the D4 pad with A5)
+//     NCS0 = PA6 (B, A4)   NCS1 = PA7 (B, D31)
+//   On a Due this fits an 8080 LCD (A0 = D/C, <= 5 address lines). External
+//   SRAM needs a SAM3X board with PC27/PC30 routed; the driver does not care.
+// - D0..D7 are PWMH/L0..3 and A0..A3 are PWML4..7: not usable together.
+// - ExternalRAM hands out memory from the end of .ext_sram up to
+//   EXT_SRAM_SIZE (Makefile). Configure NCS0 before the first access: the
+//   section is NOLOAD and never zeroed.
+//
+// Dependencies:
+// - MMIO.swift: read32/write32/setBits32/clearBits32, bm_read8/bm_write8,
+//   bm_ext_sram_base/free/end
+// - ATSAM3X8E.swift: SMC registers/bitfields, PMC, PIO
+// - DMAMemory.swift: DMAC copies in bandwidth()
+// - Timer.swift: CycleCounter (bandwidth())
+//
+
+public final class SMC {
+
+    // MARK: - Public types
+
+    /// One access type, in ns: address/NCS valid -> strobe, strobe low,
+    /// strobe high -> next cycle.
+    public struct Access {
+        public var setupNs: U32
+        public var pulseNs: U32
+        public var holdNs: U32
+
+        public init(setupNs: U32 = 0, pulseNs: U32, holdNs: U32 = 0) {
+            self.setupNs = setupNs
+            self.pulseNs = pulseNs
+            self.holdNs = holdNs
+        }
+    }
+
+    public struct Timing {
+        public var read: Access
+        public var write: Access
+        public var floatNs: U32             // data bus release after a read
+
+        public init(read: Access, write: Access, floatNs: U32 = 0) {
+            self.read = read
+            self.write = write
+            self.floatNs = floatNs
+        }
+
+        /// Asynchronous SRAM with access time `accessNs` (tAA = tWP-ish):
+        /// 10 ns input margin on reads, 1 cycle address setup/hold on writes.
+        public static func sram(accessNs: U32) -> Timing {
+            Timing(
+                read: Access(pulseNs: accessNs + 10),
+                write: Access(setupNs: 10, pulseNs: accessNs, holdNs: 10),
+                floatNs: 20
+            )
+        }
+
+        /// ILI9341-class 8080 LCD: write cycle 66 ns (WRX low/high >= 15 ns),
+        /// read cycle 450 ns (RDX low >= 355 ns).
+        public static let ili9341 = Timing(
+            read: Access(setupNs: 10, pulseNs: 360, holdNs: 90),
+            write: Access(setupNs: 10, pulseNs: 25, holdNs: 35),
+            floatNs: 80
+        )
+    }
+
+    /// A configured chip select: base address, size and the cycle counts
+    /// actually programmed.
+    public struct Window {
+        public let chipSelect: U32
+        public let base: U32
+        public let size: U32                // 1 << addressLines bytes
+        public let readCycles: U32          // MCK cycles per read
+        public let writeCycles: U32         // MCK cycles per write
+        public let floatCycles: U32
+
+        public var pointer: UnsafeMutableRawPointer {
+            UnsafeMutableRawPointer(bitPattern: UInt(base))!
+        }
+
+        /// One bus write cycle (volatile: repeated writes to the same
+        /// offset all reach the device, e.g. an LCD data register).
+        @inline(__always)
+        public func write8(_ offset: U32, _ value: U8) {
+            bm_write8(base &+ offset, value)
+        }
+
+        @inline(__always)
+        public func read8(_ offset: U32) -> U8 {
+            bm_read8(base &+ offset)
+        }
+    }
+
+    /// Throughput of one memory area, KiB/s at cpuHz.
+    public struct Bandwidth {
+        public let bytes: U32
+        public let cpuWrite: U32            // U32 stores
+        public let cpuRead: U32             // U32 loads
+        public let dmaWrite: U32            // DMAC word copy scratch -> target
+        public let dmaRead: U32             // DMAC word copy target -> scratch
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case invalidChipSelect
+        case invalidAddressLines
+        case timingOutOfRange
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .invalidChipSelect: return "invalid_chip_select"
+            case .invalidAddressLines: return "invalid_address_lines"
+            case .timingOutOfRange: return "timing_out_of_range"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .invalidChipSelect: return "Only NCS0 and NCS1 have pins on the Due."
+            case .invalidAddressLines: return "Address lines must be 0...18 (A0..A17)."
+            case .timingOutOfRange: return "Timing does not fit the SMC setup/pulse/cycle fields at this MCK."
+            }
+        }
+    }
+
+    // MARK: - State
+
+    private let mckHz: U32
+    private var clocked = false
+    private var addressLines: U32 = 0          // widest configured so far (pins)
+
+    // MARK: - Init
+
+    public init(mckHz: U32) {
+        self.mckHz = mckHz
+    }
+
+    // MARK: - Configure
+
+    /// Program `chipSelect` (0 or 1) with `timing`, mux the bus pins and
+    /// return its window. `addressLines` A0..A(n-1) are muxed; the window is
+    /// 2^n bytes (n = 0: one register, e.g. a write-only latch).
+    @discardableResult
+    public func configure(chipSelect: U32 = 0, timing: Timing, addressLines: U32) throws(SMC.Error) -> Window {
+        if chipSelect >= ATSAM3X8E.SMC.CHIP_SELECTS { throw .invalidChipSelect }
+        if addressLines > ATSAM3X8E.SMC.ADDR_LINES_MAX { throw .invalidAddressLines }
+
+        guard let rd = encode(timing.read), let wr = encode(timing.write) else { throw .timingOutOfRange }
+        let tdf = cycles(ns: timing.floatNs)
+        if tdf > ATSAM3X8E.SMC.MODE_TDF_MAX { throw .timingOutOfRange }
+
+        if !clocked {
+            PeripheralClock.acquire(ATSAM3X8E.ID.SMC)
+            write32(ATSAM3X8E.SMC.WPCR, ATSAM3X8E.SMC.WPCR_KEY)        // write protection off
+            clocked = true
+        }
+        muxPins(chipSelect: chipSelect, addressLines: addressLines)
+
+        let cs = ATSAM3X8E.SMC.CS_BASE + chipSelect * ATSAM3X8E.SMC.CS_STRIDE
+        // NCS: asserted from the start of the cycle (setup 0) until the strobe rises.
+        write32(
+            cs + ATSAM3X8E.SMC.SETUP_OFFSET,
+            (wr.setup << ATSAM3X8E.SMC.SETUP_NWE_SHIFT) | (rd.setup << ATSAM3X8E.SMC.SETUP_NRD_SHIFT)
+        )
+        write32(
+            cs + ATSAM3X8E.SMC.PULSE_OFFSET,
+            (wr.pulse << ATSAM3X8E.SMC.PULSE_NWE_SHIFT) | (wr.ncsPulse << ATSAM3X8E.SMC.PULSE_NCS_WR_SHIFT) |
+                (rd.pulse << ATSAM3X8E.SMC.PULSE_NRD_SHIFT) | (rd.ncsPulse << ATSAM3X8E.SMC.PULSE_NCS_RD_SHIFT)
+        )
+        write32(
+            cs + ATSAM3X8E.SMC.CYCLE_OFFSET,
+            (wr.cycle << ATSAM3X8E.SMC.CYCLE_NWE_SHIFT) | (rd.cycle << ATSAM3X8E.SMC.CYCLE_NRD_SHIFT)
+        )
+        write32(cs + ATSAM3X8E.SMC.TIMINGS_OFFSET, 0)
+        write32(
+            cs + ATSAM3X8E.SMC.MODE_OFFSET,
+            ATSAM3X8E.SMC.MODE_READ_NRD | ATSAM3X8E.SMC.MODE_WRITE_NWE | (tdf << ATSAM3X8E.SMC.MODE_TDF_SHIFT)
+        )
+        bm_dsb()
+
+        return Window(
+            chipSelect: chipSelect,
+            base: ATSAM3X8E.EBI_CS0_BASE + chipSelect * ATSAM3X8E.EBI_CS_STRIDE,
+            size: U32(1) << addressLines,
+            readCycles: rd.cycles,
+            writeCycles: wr.cycles,
+            floatCycles: tdf
+        )
+    }
+
+    /// MCK cycles covering `ns` (rounded up).
+    public func cycles(ns: U32) -> U32 {
+        U32((UInt64(ns) * UInt64(mckHz) + 999_999_999) / 1_000_000_000)
+    }
+
+    /// Duration of `cycles` MCK cycles in ns (rounded up).
+    public func nanoseconds(cycles: U32) -> U32 {
+        U32((UInt64(cycles) * 1_000_000_000 + UInt64(mckHz) - 1) / UInt64(mckHz))
+    }
+
+    // MARK: - Memory test
+
+    /// Data bus (walking ones), address bus (power-of-two offsets), then every
+    /// byte with an address-derived pattern. Returns the first failing offset,
+    /// nil when the first `bytes` of the window are good. Destroys the contents.
+    public static func verify(_ window: Window, bytes: U32) -> U32? {
+        let n = min(bytes, window.size)
+        if n == 0 { return nil }
+
+        var bit: U8 = 1
+        while bit != 0 {
+            window.write8(0, bit)
+            if window.read8(0) != bit { return 0 }
+            bit <<= 1
+        }
+
+        // Each address line on its own: a stuck or shorted line aliases
+        // two of these offsets.
+        window.write8(0, 0x55)
+        var off: U32 = 1
+        while off < n {
+            window.write8(off, 0xAA)
+            off <<= 1
+        }
+        if window.read8(0) != 0x55 { return 0 }
+        off = 1
+        while off < n {
+            if window.read8(off) != 0xAA { return off }
+            off <<= 1
+        }
+
+        var i: U32 = 0
+        while i < n {
+            window.write8(i, pattern(i))
+            i += 1
+        }
+        i = 0
+        while i < n {
+            if window.read8(i) != pattern(i) { return i }
+            i += 1
+        }
+        return nil
+    }
+
+    // MARK: - Bandwidth
+
+    /// CPU word stores/loads over `target` and DMAC copies between `target`
+    /// and `scratch` (internal RAM), `scratch.count` bytes each. Works for
+    /// internal RAM too, as a reference. Overwrites both buffers.
+    public static func bandwidth(
+        target: UnsafeMutableRawPointer,
+        scratch: UnsafeMutableRawBufferPointer,
+        cpuHz: U32
+    ) -> Bandwidth {
+        let bytes = scratch.count & ~3
+        guard let src = scratch.baseAddress, bytes >= 64 else {
+            return Bandwidth(bytes: 0, cpuWrite: 0, cpuRead: 0, dmaWrite: 0, dmaRead: 0)
+        }
+        let words = target.assumingMemoryBound(to: U32.self)
+        let count = bytes / 4
+
+        var t0 = CycleCounter.now()
+        var i = 0
+        while i < count {
+            words[i] = U32(truncatingIfNeeded: i) &* 0x9E37_79B9
+            i += 1
+        }
+        let cpuWrite = CycleCounter.now() &- t0
+
+        var sum: U32 = 0
+        t0 = CycleCounter.now()
+        i = 0
+        while i < count {
+            sum &+= words[i]
+            i += 1
+        }
+        let cpuRead = CycleCounter.now() &- t0
+        sink = sum
+
+        // Force the DMAC path whatever the calibrated threshold is.
+        let saved = DMAMemory.threshold
+        DMAMemory.threshold = 0
+        t0 = CycleCounter.now()
+        let wOk = DMAMemory.copy(dst: target, src: UnsafeRawPointer(src), len: bytes) == .done
+        let dmaWrite = CycleCounter.now() &- t0
+        t0 = CycleCounter.now()
+        let rOk = DMAMemory.copy(dst: src, src: UnsafeRawPointer(target), len: bytes) == .done
+        let dmaRead = CycleCounter.now() &- t0
+        DMAMemory.threshold = saved
+
+        // A failed DMAC transfer reports 0 KiB/s rather than a bogus rate.
+        return Bandwidth(
+            bytes: U32(bytes),
+            cpuWrite: kibPerSecond(U32(bytes), cpuWrite, cpuHz),
+            cpuRead: kibPerSecond(U32(bytes), cpuRead, cpuHz),
+            dmaWrite: wOk ? kibPerSecond(U32(bytes), dmaWrite, cpuHz) : 0,
+            dmaRead: rOk ? kibPerSecond(U32(bytes), dmaRead, cpuHz) : 0
+        )
+    }
+
+    // MARK: - Internals
+
+    /// One access type as register fields + the cycles they really take.
+    private struct Encoded {
+        let setup: U32
+        let pulse: U32
+        let ncsPulse: U32
+        let cycle: U32
+        let cycles: U32
+    }
+
+    private static var sink: U32 = 0
+
+    private func encode(_ a: Access) -> Encoded? {
+        guard let setup = Self.setupField(cycles(ns: a.setupNs)),
+              let pulse = Self.pulseField(max(cycles(ns: a.pulseNs), 1)),
+              let ncs = Self.pulseField(setup.1 + pulse.1),
+              let cycle = Self.cycleField(setup.1 + pulse.1 + cycles(ns: a.holdNs))
+        else { return nil }
+        return Encoded(setup: setup.0, pulse: pulse.0, ncsPulse: ncs.0, cycle: cycle.0, cycles: cycle.1)
+    }
+
+    // Field encodings (value, cycles), rounded up to the next representable
+    // count: setup = 128 * b5 + b4..0, pulse = 256 * b6 + b5..0,
+    // cycle = 256 * b8..7 + b6..0.
+
+    private static func setupField(_ n: U32) -> (U32, U32)? {
+        if n <= 31 { return (n, n) }
+        if n <= 128 { return (0x20, 128) }
+        if n <= 159 { return (0x20 | (n - 128), n) }
+        return nil
+    }
+
+    private static func pulseField(_ n: U32) -> (U32, U32)? {
+        if n <= 63 { return (n, n) }
+        if n <= 256 { return (0x40, 256) }
+        if n <= 319 { return (0x40 | (n - 256), n) }
+        return nil
+    }
+
+    private static func cycleField(_ n: U32) -> (U32, U32)? {
+        var k = n / 256
+        var r = n % 256
+        if r > 127 {
+            k += 1
+            r = 0
+        }
+        if k > 3 { return nil }
+        return ((k << 7) | r, k * 256 + r)
+    }
+
+    private func muxPins(chipSelect: U32, addressLines: U32) {
+        let lines = max(addressLines, self.addressLines)
+        self.addressLines = lines
+
+        let cLines = min(lines, ATSAM3X8E.SMC.PIOC_ADDR_LINES)
+        let cAddr = ((U32(1) << cLines) - 1) << ATSAM3X8E.SMC.PIOC_ADDR_SHIFT
+        let pioC = ATSAM3X8E.SMC.PIOC_DATA_MASK | ATSAM3X8E.SMC.PIOC_NWE_MASK | cAddr
+        write32(ATSAM3X8E.PIOC_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, pioC)
+        clearBits32(ATSAM3X8E.PIOC_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, pioC)     // A
+
+        if lines > ATSAM3X8E.SMC.PIOC_ADDR_LINES {
+            let pioD = (U32(1) << (lines - ATSAM3X8E.SMC.PIOC_ADDR_LINES)) - 1   // PD0..
+            write32(ATSAM3X8E.PIOD_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, pioD)
+            clearBits32(ATSAM3X8E.PIOD_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, pioD) // A
+        }
+
+        let ncs = chipSelect == 0 ? ATSAM3X8E.SMC.PIOA_NCS0_MASK : ATSAM3X8E.SMC.PIOA_NCS1_MASK
+        let pioA = ATSAM3X8E.SMC.PIOA_NRD_MASK | ncs
+        write32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, pioA)
+        setBits32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, pioA)       // B
+    }
+
+    @inline(__always)
+    private static func pattern(_ i: U32) -> U8 {
+        U8(truncatingIfNeeded: (i &* 7) ^ (i >> 8))
+    }
+
+    private static func kibPerSecond(_ bytes: U32, _ cycles: U32, _ cpuHz: U32) -> U32 {
+        if cycles == 0 { return 0 }
+        return U32(UInt64(bytes) * UInt64(cpuHz) / (UInt64(cycles) * 1024))
+    }
+}
+
+// MARK: - External SRAM arena
+
+/// Bump allocator over the external SRAM left after .ext_sram (NCS0,
+/// EXT_SRAM_SIZE bytes). Nothing is ever freed. NCS0 must be configured
+/// with enough address lines before the memory is touched.
+public enum ExternalRAM {
+
+    /// EXT_SRAM_SIZE (0 when the firmware was linked without external SRAM).
+    public static var size: U32 { bm_ext_sram_end() &- bm_ext_sram_base() }
+
+    /// Bytes still free in the arena.
+    public static var available: U32 { bm_ext_sram_end() &- current() }
+
+    /// `bytes` of external SRAM aligned to `alignment` (power of two), or
+    /// nil when the arena is exhausted. Contents are undefined.
+    public static func allocate(bytes: Int, alignment: Int = 4) -> UnsafeMutableRawPointer? {
+        let a = U32(max(alignment, 1))
+        let p = (current() + a - 1) & ~(a - 1)
+        let end = bm_ext_sram_end()
+        if bytes < 0 || p > end || U32(bytes) > end - p { return nil }
+        next = p + U32(bytes)
+        return UnsafeMutableRawPointer(bitPattern: UInt(p))
+    }
+
+    private static var next: U32 = 0
+
+    @inline(__always)
+    private static func current() -> U32 {
+        next == 0 ? bm_ext_sram_free() : next
+    }
+}
@@ -0,0 +1,557 @@
+//
+// SPI.swift — SPI0 master with DMAC transfers and chip-select management.
+//
+// Goals:
+// - Displays, SD cards, fast ADCs: full-duplex block transfers moved by the
+//   DMAC (one channel TX, one RX), so the bus runs back-to-back at SCK up to
+//   MCK/2 without the CPU touching every byte.
+// - Per chip-select settings (CSR0..3): SPI mode, clock, word size, CS hold.
+// - Fixed peripheral mode: transfer(...) on one chip select (blocking or async).
+// - Variable peripheral mode: each 32-bit TDR word carries its own PCS and
+//   LASTXFER, so a queue of transfers to different chips runs as ONE DMA
+//   linked list (LLI): no CPU gap between transfers, CS switches in hardware.
+// - measureThroughput() reports sustained bytes/s (MB/s x100).
+//
+// Notes:
+// - Pins: MISO/MOSI/SPCK on the SPI header; NPCS0 = D10, NPCS1 = D4,
+//   NPCS2 = D52, NPCS3 = PB23 (not on a header). A chip select pin is handed
+//   to the SPI only when that chip select is configured.
+// - Two DMAC channels (TX, RX) are allocated from DMA.swift in begin().
+// - The SPI0 clock is held from the first begin() to end().
+// - Async completion is polled (poll() from the main loop fires the callback);
+//   nothing SPI-side runs in an interrupt.
+// - Buffers handed to the DMA must stay alive and untouched until completion.
+// - A block transfer is at most 65535 words per DMA descriptor; blocking
+//   transfer() splits longer buffers, async/queued ones must fit.
+// - Cycle counts use the DWT counter, which runs at CPU clock (= MCK here).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, waitUntil
+// - DMA.swift: channel allocation, single blocks + LLI chains
+// - ATSAM3X8E.swift: SPI0 registers/bitfields, PMC, PIO
+// - Timer.swift: CycleCounter
+//
+
+public final class SPI {
+
+    // MARK: - Public types
+
+    public enum ChipSelect: U32 {
+        case cs0 = 0
+        case cs1 = 1
+        case cs2 = 2
+        case cs3 = 3
+    }
+
+    /// Classic SPI modes: CPOL = bit 1, CPHA = bit 0.
+    public enum Mode: U32 {
+        case mode0 = 0
+        case mode1 = 1
+        case mode2 = 2
+        case mode3 = 3
+    }
+
+    public struct Settings {
+        public var clockHz: U32
+        public var mode: Mode
+        public var bitsPerWord: U32       // 8...16 (fixed-mode DMA: 8 only)
+        public var keepSelected: Bool     // CSAAT: CS stays low until release()/LASTXFER
+        public var csSetupCycles: U32     // DLYBS: MCK cycles from CS low to first SCK
+        public var wordGapCycles: U32     // DLYBCT: x32 MCK cycles between words
+
+        public init(
+            clockHz: U32,
+            mode: Mode = .mode0,
+            bitsPerWord: U32 = 8,
+            keepSelected: Bool = false,
+            csSetupCycles: U32 = 0,
+            wordGapCycles: U32 = 0
+        ) {
+            self.clockHz = clockHz
+            self.mode = mode
+            self.bitsPerWord = bitsPerWord
+            self.keepSelected = keepSelected
+            self.csSetupCycles = csSetupCycles
+            self.wordGapCycles = wordGapCycles
+        }
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case notStarted
+        case busy
+        case timeout
+        case dmaError
+        case invalidLength(Int)
+        case invalidSettings
+        case wrongMode           // fixed-mode call in variable mode or vice versa
+        case queueFull
+        case noDMAChannel
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .notStarted: return "not_started"
+            case .busy: return "busy"
+            case .timeout: return "timeout"
+            case .dmaError: return "dma_error"
+            case .invalidLength: return "invalid_length"
+            case .invalidSettings: return "invalid_settings"
+            case .wrongMode: return "wrong_mode"
+            case .queueFull: return "queue_full"
+            case .noDMAChannel: return "no_dma_channel"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .notStarted: return "SPI not started (call begin())."
+            case .busy: return "A DMA transfer is already in flight."
+            case .timeout: return "SPI/DMA transfer timed out."
+            case .dmaError: return "DMAC reported an AHB error."
+            case .invalidLength(let n): return "Invalid transfer length (\(n))."
+            case .invalidSettings: return "Unsupported chip-select settings."
+            case .wrongMode: return "Call not valid in the current peripheral-select mode."
+            case .queueFull: return "Transfer queue is full."
+            case .noDMAChannel: return "No free DMAC channel."
+            }
+        }
+    }
+
+    public typealias Completion = (SPI.Error?) -> Void
+
+    public struct Throughput {
+        public let bytes: U32
+        public let cycles: U32
+        public let sckHz: U32
+        public let bytesPerSecond: U32
+        public let mbPerSecondX100: U32   // MB = 10^6 bytes
+    }
+
+    // MARK: - Constants
+
+    public static let maxQueue = 8
+    public static let maxWordsPerDescriptor = Int(DMA.maxBeatsPerBlock)
+
+    private static let timeoutSpins: U32 = 20_000_000
+
+    // MARK: - State
+
+    private let mckHz: U32
+    private var started = false
+    private var clockHeld = false
+    private var variable = false
+    private var mr: U32 = 0
+    private var sckHz: [U32] = [0, 0, 0, 0]
+
+    // DMA channels + scratch (heap memory never moves): 0xFF TX filler, RX sink
+    private var txDMA: DMA.Channel? = nil
+    private var rxDMA: DMA.Channel? = nil
+    private let txFill: UnsafeMutablePointer<U32>
+    private let rxSink: UnsafeMutablePointer<U32>
+    private let txChain = DMA.Chain(capacity: SPI.maxQueue)
+    private let rxChain = DMA.Chain(capacity: SPI.maxQueue)
+
+    private var inFlight = false
+    private var completion: Completion? = nil
+    private var queued = 0
+
+    // MARK: - Init
+
+    public init(mckHz: U32) {
+        self.mckHz = mckHz
+        self.txFill = UnsafeMutablePointer<U32>.allocate(capacity: 1)
+        self.rxSink = UnsafeMutablePointer<U32>.allocate(capacity: 1)
+        self.txFill.pointee = 0xFFFF_FFFF
+        self.rxSink.pointee = 0
+    }
+
+    // MARK: - Setup
+
+    /// Enable the SPI0 clock, take two DMAC channels, mux MISO/MOSI/SPCK and
+    /// enter master mode. `variablePeripheral`: PCS comes with every TDR word
+    /// (needed for queues). Calling it again switches mode, keeping the channels.
+    public func begin(variablePeripheral: Bool = false, csToCsDelayCycles: U32 = 6) {
+        if !clockHeld {
+            PeripheralClock.acquire(ATSAM3X8E.ID.SPI0)
+            clockHeld = true
+        }
+        if txDMA == nil { txDMA = DMA.allocate() }
+        if rxDMA == nil { rxDMA = DMA.allocate() }
+
+        let pioa = ATSAM3X8E.PIOA_BASE
+        write32(pioa + ATSAM3X8E.PIOX.PDR_OFFSET, ATSAM3X8E.SPI.PIOA_MASK)
+        clearBits32(pioa + ATSAM3X8E.PIOX.ABSR_OFFSET, ATSAM3X8E.SPI.PIOA_MASK)
+
+        write32(ATSAM3X8E.SPI.WPMR, ATSAM3X8E.SPI.WPMR_KEY)
+        write32(ATSAM3X8E.SPI.CR, ATSAM3X8E.SPI.CR_SPIDIS)
+        write32(ATSAM3X8E.SPI.CR, ATSAM3X8E.SPI.CR_SWRST)
+        write32(ATSAM3X8E.SPI.CR, ATSAM3X8E.SPI.CR_SWRST)   // reset twice (ArduinoCore does too)
+
+        variable = variablePeripheral
+        mr = ATSAM3X8E.SPI.MR_MSTR | ATSAM3X8E.SPI.MR_MODFDIS |
+            ((csToCsDelayCycles & 0xFF) << ATSAM3X8E.SPI.MR_DLYBCS_SHIFT)
+        if variable {
+            mr |= ATSAM3X8E.SPI.MR_PS
+        } else {
+            mr |= Self.pcsField(.cs0) << ATSAM3X8E.SPI.MR_PCS_SHIFT
+        }
+        write32(ATSAM3X8E.SPI.MR, mr)
+        queued = 0
+        txChain.reset()
+        rxChain.reset()
+
+        write32(ATSAM3X8E.SPI.CR, ATSAM3X8E.SPI.CR_SPIEN)
+        started = true
+    }
+
+    /// Abort any transfer in flight (its callback is dropped), disable the
+    /// SPI and release its clock. The DMA channels are kept for begin().
+    public func end() {
+        if inFlight {
+            txDMA?.abort()
+            rxDMA?.abort()
+            inFlight = false
+            completion = nil
+        }
+        clearQueue()
+        if clockHeld {
+            write32(ATSAM3X8E.SPI.CR, ATSAM3X8E.SPI.CR_SPIDIS)
+            PeripheralClock.release(ATSAM3X8E.ID.SPI0)
+            clockHeld = false
+        }
+        started = false
+    }
+
+    /// Program CSRn and hand the chip-select pin to the SPI.
+    /// Returns the SCK actually achieved (MCK / SCBR).
+    @discardableResult
+    public func configure(_ cs: ChipSelect, _ s: Settings) throws(SPI.Error) -> U32 {
+        if s.clockHz == 0 || s.bitsPerWord < 8 || s.bitsPerWord > 16 { throw .invalidSettings }
+
+        var scbr = (mckHz + s.clockHz - 1) / s.clockHz
+        if scbr < 1 { scbr = 1 }
+        if scbr > 255 { scbr = 255 }
+
+        var csr: U32 = 0
+        // CPOL = mode bit 1; NCPHA is the inverse of CPHA (mode bit 0).
+        if (s.mode.rawValue & 2) != 0 { csr |= ATSAM3X8E.SPI.CSR_CPOL }
+        if (s.mode.rawValue & 1) == 0 { csr |= ATSAM3X8E.SPI.CSR_NCPHA }
+        if s.keepSelected { csr |= ATSAM3X8E.SPI.CSR_CSAAT }
+        csr |= (s.bitsPerWord - 8) << ATSAM3X8E.SPI.CSR_BITS_SHIFT
+        csr |= scbr << ATSAM3X8E.SPI.CSR_SCBR_SHIFT
+        csr |= (s.csSetupCycles & 0xFF) << ATSAM3X8E.SPI.CSR_DLYBS_SHIFT
+        csr |= (s.wordGapCycles & 0xFF) << ATSAM3X8E.SPI.CSR_DLYBCT_SHIFT
+        write32(ATSAM3X8E.SPI.CSR0 + 4 * cs.rawValue, csr)
+
+        muxChipSelect(cs)
+        sckHz[Int(cs.rawValue)] = mckHz / scbr
+        return mckHz / scbr
+    }
+
+    /// SCK achieved for `cs` (0 if not configured).
+    public func clockHz(_ cs: ChipSelect) -> U32 { sckHz[Int(cs.rawValue)] }
+
+    /// Deassert a chip select held by keepSelected (CSAAT).
+    public func release() {
+        _ = waitBitSet32(ATSAM3X8E.SPI.SR, ATSAM3X8E.SPI.SR_TXEMPTY, timeout: Self.timeoutSpins)
+        write32(ATSAM3X8E.SPI.CR, ATSAM3X8E.SPI.CR_LASTXFER)
+    }
+
+    // MARK: - Programmed I/O (short commands)
+
+    /// One word, polled. `last` deasserts CS afterwards in variable mode.
+    public func transferWord(_ cs: ChipSelect, _ value: U16, last: Bool = true) throws(SPI.Error) -> U16 {
+        if !started { throw .notStarted }
+        if inFlight { throw .busy }
+        if !variable { select(cs) }
+
+        if !waitBitSet32(ATSAM3X8E.SPI.SR, ATSAM3X8E.SPI.SR_TDRE, timeout: Self.timeoutSpins) { throw .timeout }
+        write32(ATSAM3X8E.SPI.TDR, variable ? Self.word(U32(value), cs: cs, last: last) : U32(value))
+        if !waitBitSet32(ATSAM3X8E.SPI.SR, ATSAM3X8E.SPI.SR_RDRF, timeout: Self.timeoutSpins) { throw .timeout }
+        return U16(truncatingIfNeeded: read32(ATSAM3X8E.SPI.RDR))
+    }
+
+    // MARK: - Fixed peripheral mode (DMA, 8-bit words)
+
+    /// Full-duplex block transfer on `cs`, blocking. `tx == nil` clocks out
+    /// 0xFF; `rx == nil` discards what comes back. Long buffers are split.
+    public func transfer(
+        _ cs: ChipSelect,
+        tx: UnsafeBufferPointer<UInt8>?,
+        rx: UnsafeMutableBufferPointer<UInt8>?,
+        count: Int
+    ) throws(SPI.Error) {
+        try checkFixed(tx: tx, rx: rx, count: count, limit: Int.max)
+        select(cs)
+
+        var done = 0
+        while done < count {
+            let n = min(count - done, Self.maxWordsPerDescriptor)
+            let txAddr = tx.map { Self.address($0.baseAddress!) + U32(done) }
+            let rxAddr = rx.map { Self.address(UnsafePointer($0.baseAddress!)) + U32(done) }
+            startSingle(txAddr: txAddr, rxAddr: rxAddr, count: U32(n), width: .byte)
+            inFlight = true
+            let err = waitDone()
+            inFlight = false
+            if let err { throw err }
+            done += n
+        }
+    }
+
+    /// Same as transfer(), but returns right away; poll() fires `completion`.
+    public func transferAsync(
+        _ cs: ChipSelect,
+        tx: UnsafeBufferPointer<UInt8>?,
+        rx: UnsafeMutableBufferPointer<UInt8>?,
+        count: Int,
+        completion: @escaping Completion
+    ) throws(SPI.Error) {
+        try checkFixed(tx: tx, rx: rx, count: count, limit: Self.maxWordsPerDescriptor)
+        select(cs)
+
+        self.completion = completion
+        inFlight = true
+        startSingle(
+            txAddr: tx.map { Self.address($0.baseAddress!) },
+            rxAddr: rx.map { Self.address(UnsafePointer($0.baseAddress!)) },
+            count: U32(count),
+            width: .byte
+        )
+    }
+
+    // MARK: - Variable peripheral mode (queued, LLI)
+
+    /// TDR word for variable peripheral mode: data + PCS (+ LASTXFER).
+    @inline(__always)
+    public static func word(_ data: U32, cs: ChipSelect, last: Bool) -> U32 {
+        (data & 0xFFFF) |
+            (pcsField(cs) << ATSAM3X8E.SPI.TDR_PCS_SHIFT) |
+            (last ? ATSAM3X8E.SPI.TDR_LASTXFER : 0)
+    }
+
+    /// Queue one transfer for `cs`. `words` holds data in the low 16 bits and
+    /// is rewritten in place with PCS/LASTXFER (CS rises after the last word).
+    /// `rx` receives one RDR word per TX word (data in the low 16 bits).
+    public func enqueue(
+        _ cs: ChipSelect,
+        words: UnsafeMutableBufferPointer<U32>,
+        rx: UnsafeMutableBufferPointer<U32>? = nil
+    ) throws(SPI.Error) {
+        if !started { throw .notStarted }
+        if !variable { throw .wrongMode }
+        if inFlight { throw .busy }
+        if queued >= Self.maxQueue { throw .queueFull }
+        let n = words.count
+        if n == 0 || n > Self.maxWordsPerDescriptor { throw .invalidLength(n) }
+        if let rx, rx.count < n { throw .invalidLength(rx.count) }
+
+        var i = 0
+        while i < n {
+            words[i] = Self.word(words[i], cs: cs, last: i == n - 1)
+            i += 1
+        }
+
+        txChain.append(
+            DMA.Block(
+                source: Self.address(UnsafePointer(words.baseAddress!)),
+                destination: ATSAM3X8E.SPI.TDR,
+                count: U32(n), width: .word, flow: .memoryToPeripheral
+            ),
+            flow: .memoryToPeripheral
+        )
+        rxChain.append(
+            DMA.Block(
+                source: ATSAM3X8E.SPI.RDR,
+                destination: rx.map { Self.address(UnsafePointer($0.baseAddress!)) } ?? Self.address(UnsafePointer(rxSink)),
+                count: U32(n), width: .word, flow: .peripheralToMemory,
+                incrementDestination: rx != nil
+            ),
+            flow: .peripheralToMemory
+        )
+        queued += 1
+    }
+
+    /// Number of transfers waiting for runQueue()/startQueue().
+    public var queuedCount: Int { queued }
+
+    /// Drop queued transfers (their TX words keep the PCS bits).
+    public func clearQueue() {
+        if inFlight { return }
+        queued = 0
+        txChain.reset()
+        rxChain.reset()
+    }
+
+    /// Run the queue as one DMA chain and wait for it.
+    public func runQueue() throws(SPI.Error) {
+        try startChain()
+        let err = waitDone()
+        inFlight = false
+        clearQueue()
+        if let err { throw err }
+    }
+
+    /// Start the queue; poll() fires `completion` when the last word is out.
+    public func startQueue(completion: @escaping Completion) throws(SPI.Error) {
+        try startChain()
+        self.completion = completion
+    }
+
+    // MARK: - Async completion
+
+    public var isBusy: Bool { inFlight }
+
+    /// Call from the main loop while an async transfer/queue is in flight.
+    public func poll() {
+        if !inFlight || !dmaIdle() { return }
+        if (read32(ATSAM3X8E.SPI.SR) & ATSAM3X8E.SPI.SR_TXEMPTY) == 0 { return }
+
+        let err: SPI.Error? = dmaErrored() ? .dmaError : nil
+        inFlight = false
+        clearQueue()
+        let cb = completion
+        completion = nil
+        cb?(err)
+    }
+
+    // MARK: - Throughput
+
+    /// Full-duplex DMA transfer of `buffer` in place (TX always runs ahead of
+    /// RX, so loopback-safe) and the sustained rate it achieved on `cs`.
+    public func measureThroughput(_ cs: ChipSelect, buffer: UnsafeMutableBufferPointer<UInt8>) throws(SPI.Error) -> Throughput {
+        let t0 = CycleCounter.now()
+        try transfer(cs, tx: UnsafeBufferPointer(buffer), rx: buffer, count: buffer.count)
+        let cycles = CycleCounter.now() &- t0
+
+        let bytes = U32(buffer.count)
+        let bps = cycles == 0 ? 0 : U32((UInt64(bytes) * UInt64(mckHz)) / UInt64(cycles))
+        return Throughput(
+            bytes: bytes,
+            cycles: cycles,
+            sckHz: sckHz[Int(cs.rawValue)],
+            bytesPerSecond: bps,
+            mbPerSecondX100: bps / 10_000
+        )
+    }
+
+    // MARK: - DMA plumbing
+
+    private func checkFixed(tx: UnsafeBufferPointer<UInt8>?, rx: UnsafeMutableBufferPointer<UInt8>?, count: Int, limit: Int) throws(SPI.Error) {
+        if !started { throw .notStarted }
+        if variable { throw .wrongMode }
+        if inFlight { throw .busy }
+        if txDMA == nil || rxDMA == nil { throw .noDMAChannel }
+        if count <= 0 || count > limit { throw .invalidLength(count) }
+        if let tx, tx.count < count { throw .invalidLength(tx.count) }
+        if let rx, rx.count < count { throw .invalidLength(rx.count) }
+    }
+
+    /// Fixed mode: route the next transfers to `cs` (MR.PCS).
+    private func select(_ cs: ChipSelect) {
+        if variable { return }
+        let next = (mr & ~ATSAM3X8E.SPI.MR_PCS_MASK) | (Self.pcsField(cs) << ATSAM3X8E.SPI.MR_PCS_SHIFT)
+        if next == mr { return }
+        _ = waitBitSet32(ATSAM3X8E.SPI.SR, ATSAM3X8E.SPI.SR_TXEMPTY, timeout: Self.timeoutSpins)
+        mr = next
+        write32(ATSAM3X8E.SPI.MR, mr)
+    }
+
+    /// Drop a stale RX word and clear OVRES before a new DMA transfer.
+    private func flushRx() {
+        _ = read32(ATSAM3X8E.SPI.RDR)
+        _ = read32(ATSAM3X8E.SPI.SR)
+    }
+
+    private static let rxConfig = DMA.Config(flow: .peripheralToMemory, interface: .spi0Rx)
+    private static let txConfig = DMA.Config(flow: .memoryToPeripheral, interface: .spi0Tx)
+
+    private func startSingle(txAddr: U32?, rxAddr: U32?, count: U32, width: DMA.Width) {
+        guard let txDMA, let rxDMA else { return }
+        flushRx()
+
+        // RX first: it must be listening before the first word shifts in.
+        rxDMA.start(
+            DMA.Block(
+                source: ATSAM3X8E.SPI.RDR,
+                destination: rxAddr ?? Self.address(UnsafePointer(rxSink)),
+                count: count, width: width, flow: .peripheralToMemory,
+                incrementDestination: rxAddr != nil
+            ),
+            config: Self.rxConfig
+        )
+        txDMA.start(
+            DMA.Block(
+                source: txAddr ?? Self.address(UnsafePointer(txFill)),
+                destination: ATSAM3X8E.SPI.TDR,
+                count: count, width: width, flow: .memoryToPeripheral,
+                incrementSource: txAddr != nil
+            ),
+            config: Self.txConfig
+        )
+    }
+
+    private func startChain() throws(SPI.Error) {
+        if !started { throw .notStarted }
+        if !variable { throw .wrongMode }
+        if inFlight { throw .busy }
+        guard let txDMA, let rxDMA else { throw .noDMAChannel }
+        if queued == 0 { throw .invalidLength(0) }
+
+        flushRx()
+        inFlight = true
+        rxDMA.start(rxChain, config: Self.rxConfig)
+        txDMA.start(txChain, config: Self.txConfig)
+    }
+
+    /// Both channels retired (by the DMAC IRQ or by polling them here).
+    private func dmaIdle() -> Bool {
+        guard let txDMA, let rxDMA else { return true }
+        txDMA.poll()
+        rxDMA.poll()
+        return !txDMA.isBusy && !rxDMA.isBusy
+    }
+
+    private func dmaErrored() -> Bool {
+        txDMA?.lastResult != .done || rxDMA?.lastResult != .done
+    }
+
+    /// Wait for both channels, then for the last word to leave the shifter.
+    private func waitDone() -> SPI.Error? {
+        if !waitUntil(Self.timeoutSpins, { dmaIdle() }) {
+            txDMA?.abort()
+            rxDMA?.abort()
+            return .timeout
+        }
+        if !waitBitSet32(ATSAM3X8E.SPI.SR, ATSAM3X8E.SPI.SR_TXEMPTY, timeout: Self.timeoutSpins) {
+            return .timeout
+        }
+        return dmaErrored() ? .dmaError : nil
+    }
+
+    // MARK: - Pins / small utilities
+
+    private func muxChipSelect(_ cs: ChipSelect) {
+        switch cs {
+        case .cs0, .cs1:
+            let mask = cs == .cs0 ? ATSAM3X8E.SPI.PIOA_NPCS0 : ATSAM3X8E.SPI.PIOA_NPCS1
+            write32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, mask)
+            clearBits32(ATSAM3X8E.PIOA_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, mask)
+        case .cs2, .cs3:
+            let mask = cs == .cs2 ? ATSAM3X8E.SPI.PIOB_NPCS2 : ATSAM3X8E.SPI.PIOB_NPCS3
+            write32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.PDR_OFFSET, mask)
+            setBits32(ATSAM3X8E.PIOB_BASE + ATSAM3X8E.PIOX.ABSR_OFFSET, mask)
+        }
+    }
+
+    /// Non-decoded PCS: the selected line is the one 0 bit.
+    @inline(__always)
+    private static func pcsField(_ cs: ChipSelect) -> U32 {
+        ~(U32(1) << cs.rawValue) & 0xF
+    }
+
+    @inline(__always)
+    private static func address<T>(_ p: UnsafePointer<T>) -> U32 {
+        U32(UInt(bitPattern: p))
+    }
+}
@@ -1,18 +1,21 @@
 // SerialUART.swift — UART on ATSAM3X8E (Arduino Due "Programming Port" USB-serial)
 // Minimal polling TX/RX. No interrupts.
-// Depends on: MMIO.swift and ATSAM3X8E.swift.
+// Depends on: MMIO.swift, ATSAM3X8E.swift and ByteStream.swift.
 
-public final class SerialUART {
+public final class SerialUART: ByteStream {
     private let mckHz: U32
+    private var clockHeld = false
 
     public init(mckHz: U32) {
         self.mckHz = mckHz
     }
 
     public func begin(_ baud: U32) {
-        // Enable UART peripheral clock (PCER0) — write-1-to-enable
-        // NOTE: PCER0 is write-only; do NOT read-modify-write.
-        write32(ATSAM3X8E.PMC.PCER0, U32(1) << ATSAM3X8E.ID.UART)
+        // Enable UART peripheral clock (reference-counted, Power.swift), once
+        if !clockHeld {
+            PeripheralClock.acquire(ATSAM3X8E.ID.UART)
+            clockHeld = true
+        }
 
         // Switch PA8/PA9 to Peripheral A (UART), disable PIO control
         let pioa = ATSAM3X8E.PIOA_BASE
@@ -47,6 +50,15 @@ public final class SerialUART {
         write32(ATSAM3X8E.UART.CR, ATSAM3X8E.UART.CR_RXEN | ATSAM3X8E.UART.CR_TXEN)
     }
 
+    // Drain TX, disable TX/RX and release the clock. begin() again before writing.
+    public func end() {
+        if !clockHeld { return }
+        _ = waitBitSet32(ATSAM3X8E.UART.SR, ATSAM3X8E.UART.SR_TXEMPTY, timeout: 1_000_000)
+        write32(ATSAM3X8E.UART.CR, ATSAM3X8E.UART.CR_RXDIS | ATSAM3X8E.UART.CR_TXDIS)
+        PeripheralClock.release(ATSAM3X8E.ID.UART)
+        clockHeld = false
+    }
+
     // Init + minimal banner (no String interpolation)
     @inline(__always)
     public func beginWithBootBanner(_ baud: U32, clockOk: Bool) {
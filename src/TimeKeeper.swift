@@ -0,0 +1,396 @@
+//
+// TimeKeeper.swift — continuous 64-bit time on the RTT, RTC calendar,
+// low-power sleep with RTT alarm wakeup.
+//
+// Goals:
+// - now(): 64-bit tick count from the RTT (slow clock / prescaler, 1024 Hz
+//   by default), extended past the 32-bit counter by a wrap count kept in
+//   GPBR. RTT and GPBR live in the backup domain: time keeps running through
+//   Sleep, WAIT and backup mode and across resets (not across power loss).
+// - sleep(ms:mode:): SysTick off, RTT alarm, then Sleep (WFI) or WAIT.
+//   Timer.millis() is advanced by the RTT-measured time on wakeup, so a long
+//   sleep costs one wakeup instead of one per millisecond.
+// - sleepInBackup(ms:): core off until the RTT alarm resets the chip.
+// - calibrate(): MCK measured against the RTT (DWT cycles over N ticks),
+//   ppm error, optional SysTick retune.
+// - RTC calendar: set/read date and time (24 h), Unix seconds.
+//
+// Notes:
+// - begin(crystal: true) moves the slow clock to the Due's 32.768 kHz
+//   crystal (the internal RC is off by several percent). The switch is
+//   glitch-free and one-way until VDDBU is lost.
+// - The alarm compares the low 32 bits: one sleep is capped at 2^31 ticks
+//   (24 days at 1024 Hz), and now() must run once per 2^31 ticks to catch
+//   every wrap (each sleep does).
+// - GPBR0..2 belong to TimeKeeper (magic + prescaler, wraps, last top bit);
+//   GPBR3..4: Watchdog, GPBR5..6: Power, GPBR7: free.
+// - Waking from backup mode is a reset: main() runs again and begin() finds
+//   the magic and keeps counting (wokeFromBackup).
+// - WAIT mode stops MCK: DueClock.init84MHz() brings it back, so MCK-clocked
+//   peripherals (UART baud, SPI) need no reconfiguration. Peripherals keep
+//   their state but don't run during the sleep.
+// - Any other interrupt also ends sleep(): the return value is the time
+//   really slept.
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, bm_wfi, withIRQLocked
+// - ATSAM3X8E.swift: RTT, RTC, SUPC, GPBR, RSTC, PMC
+// - NVIC.swift: enable(.rtt)
+// - Clock.swift: DueClock.enterWaitMode / init84MHz
+// - Timer.swift: Timer (tick stop/advance/retune), CycleCounter
+// - arm/startup.s: RTT_Handler (IRQ 3)
+//
+
+// ISR target. MUST be global and single symbol.
+public var g_timeKeeper: TimeKeeper? = nil
+
+public final class TimeKeeper {
+
+    // MARK: - Public types
+
+    public enum SleepMode {
+        case sleep                  // WFI: core clock off, peripherals and IRQs run
+        case wait                   // every clock off except the slow clock
+    }
+
+    /// MCK measured against the RTT.
+    public struct Calibration {
+        public let measuredHz: U32
+        public let ppm: Int32               // measured vs Timer.cpuHz
+        public let crystal: Bool            // false: slow RC reference, not trustworthy
+    }
+
+    /// 24-hour calendar time. weekday: 1 = Monday ... 7 = Sunday.
+    public struct DateTime: Equatable {
+        public var year: U32
+        public var month: U32
+        public var day: U32
+        public var hour: U32
+        public var minute: U32
+        public var second: U32
+        public var weekday: U32
+
+        public init(year: U32, month: U32, day: U32, hour: U32 = 0, minute: U32 = 0, second: U32 = 0) {
+            self.year = year
+            self.month = month
+            self.day = day
+            self.hour = hour
+            self.minute = minute
+            self.second = second
+            let days = TimeKeeper.daysFromCivil(Int(year), Int(month), Int(day))
+            self.weekday = U32(((days % 7) + 10) % 7 + 1)          // 1970-01-01 was a Thursday
+        }
+    }
+
+    public struct Stats {
+        public var sleeps: U32 = 0
+        public var alarmWakeups: U32 = 0    // slept the whole time
+        public var earlyWakeups: U32 = 0    // another interrupt came first
+        public var sleptMs: U32 = 0
+    }
+
+    // MARK: - State
+
+    public let tickHz: U32
+    public private(set) var coldStart = false        // RTT (re)started by begin()
+    public private(set) var wokeFromBackup = false
+    public private(set) var stats = Stats()
+    public private(set) var lastAlarm: UInt64 = 0    // target tick of the last sleep()
+
+    private let timer: Timer
+    private let prescaler: U32
+    private var wraps: U32 = 0
+    private var lastTop: U32 = 0
+    private var msRemainder: UInt64 = 0              // tick fractions not yet in millis()
+
+    private static let magic: U32 = 0x544B_0000       // "TK" + prescaler
+    private static let gpbrMagic: U32 = ATSAM3X8E.GPBR_BASE
+    private static let gpbrWraps: U32 = ATSAM3X8E.GPBR_BASE + ATSAM3X8E.GPBR.STRIDE
+    private static let gpbrTop: U32 = ATSAM3X8E.GPBR_BASE + 2 * ATSAM3X8E.GPBR.STRIDE
+
+    // MARK: - Init
+
+    /// `prescaler`: slow clock cycles per tick (>= 3); 32 gives 1024 Hz
+    /// and a 48-day 32-bit counter, 3 gives ~92 us ticks.
+    public init(timer: Timer, prescaler: U32 = 32) {
+        self.timer = timer
+        self.prescaler = max(prescaler, 3) & ATSAM3X8E.RTT.MR_RTPRES_MASK
+        self.tickHz = 32_768 / self.prescaler
+    }
+
+    /// Resume the running RTT (warm boot, backup wakeup) or start it from 0.
+    public func begin(crystal: Bool = true) {
+        g_timeKeeper = self
+
+        let tag = Self.magic | prescaler
+        let running = (read32(ATSAM3X8E.RTT.MR) & ATSAM3X8E.RTT.MR_RTPRES_MASK) == prescaler
+        if running && read32(Self.gpbrMagic) == tag {
+            wraps = read32(Self.gpbrWraps)
+            lastTop = read32(Self.gpbrTop) & 1
+            let rsttyp = (read32(ATSAM3X8E.RSTC.SR) & ATSAM3X8E.RSTC.SR_RSTTYP_MASK) >> ATSAM3X8E.RSTC.SR_RSTTYP_SHIFT
+            wokeFromBackup = rsttyp == ATSAM3X8E.RSTC.RSTTYP_BACKUP
+        } else {
+            if crystal && (read32(ATSAM3X8E.SUPC.SR) & ATSAM3X8E.SUPC.SR_OSCSEL) == 0 {
+                write32(ATSAM3X8E.SUPC.CR, ATSAM3X8E.SUPC.CR_KEY | ATSAM3X8E.SUPC.CR_XTALSEL)
+            }
+            write32(ATSAM3X8E.RTT.MR, prescaler | ATSAM3X8E.RTT.MR_RTTRST)
+            wraps = 0
+            lastTop = 0
+            write32(Self.gpbrWraps, 0)
+            write32(Self.gpbrTop, 0)
+            write32(Self.gpbrMagic, tag)
+            coldStart = true
+        }
+        write32(ATSAM3X8E.RTC.MR, 0)                                 // 24-hour mode
+
+        NVIC.enable(.rtt)
+    }
+
+    // MARK: - Time
+
+    /// Ticks since the RTT was started (64-bit, monotonic across sleeps
+    /// and resets).
+    public func now() -> UInt64 {
+        withIRQLocked {
+            let vr = Self.readVR()
+            let top = vr >> 31
+            if top != lastTop {
+                if top == 0 {
+                    wraps &+= 1
+                    write32(Self.gpbrWraps, wraps)
+                }
+                lastTop = top
+                write32(Self.gpbrTop, top)
+            }
+            return (UInt64(wraps) << 32) | UInt64(vr)
+        }
+    }
+
+    public func nowMillis() -> UInt64 {
+        millis(ticks: now())
+    }
+
+    public func millis(ticks: UInt64) -> UInt64 {
+        ticks * 1000 / UInt64(tickHz)
+    }
+
+    /// Ticks covering `ms` (rounded up).
+    public func ticks(ms: U32) -> UInt64 {
+        (UInt64(ms) * UInt64(tickHz) + 999) / 1000
+    }
+
+    // MARK: - Sleep
+
+    /// Sleep for `ms` with SysTick stopped; the RTT alarm wakes the core.
+    /// Returns the milliseconds actually slept (millis() advanced by as
+    /// much). Call with IRQs enabled for `.sleep` to run other handlers.
+    @discardableResult
+    public func sleep(ms: U32, mode: SleepMode = .sleep) -> U32 {
+        if ms == 0 { return 0 }
+        let start = now()
+        let target = start + min(ticks(ms: ms), UInt64(0x8000_0000))
+        lastAlarm = target
+        stats.sleeps &+= 1
+
+        timer.stopTick()
+        armAlarm(U32(truncatingIfNeeded: target))
+        switch mode {
+        case .sleep:
+            bm_wfi()
+        case .wait:
+            let pll = (read32(ATSAM3X8E.PMC.MCKR) & ATSAM3X8E.PMC.MCKR_CSS_MASK) == ATSAM3X8E.PMC.MCKR_CSS_PLLA
+            DueClock.enterWaitMode(fastStartup: ATSAM3X8E.PMC.FSMR_RTTAL)
+            if pll { _ = DueClock.init84MHz() }
+        }
+        disarmAlarm()
+
+        let end = now()
+        if end >= target { stats.alarmWakeups &+= 1 } else { stats.earlyWakeups &+= 1 }
+        let slept = catchUp(end - start)
+        timer.startTick1ms()
+        return slept
+    }
+
+    /// Backup mode: core and RAM off, the RTT alarm resets the chip after
+    /// `ms`. RAM is lost; GPBR7 is left for application state.
+    public func sleepInBackup(ms: U32) -> Never {
+        sleepInBackup(untilTick: now() + min(ticks(ms: ms), UInt64(0x8000_0000)))
+    }
+
+    /// Backup mode until now() reaches `target` (at most 2^31 ticks ahead).
+    public func sleepInBackup(untilTick target: UInt64) -> Never {
+        timer.stopTick()
+        armAlarm(U32(truncatingIfNeeded: target))
+        write32(ATSAM3X8E.SUPC.WUMR, ATSAM3X8E.SUPC.WUMR_RTTEN)
+        write32(ATSAM3X8E.SUPC.CR, ATSAM3X8E.SUPC.CR_KEY | ATSAM3X8E.SUPC.CR_VROFF)
+        while true { bm_wfi() }
+    }
+
+    // MARK: - MCK calibration
+
+    /// Count DWT cycles over `ticks` RTT ticks (<= 30 s worth). With
+    /// `retune`, SysTick is reprogrammed for the measured clock.
+    public func calibrate(ticks: U32 = 1024, retune: Bool = false) -> Calibration {
+        let n = min(max(ticks, 1), tickHz * 30)
+        let first = Self.readVR()
+        var v0 = first
+        while v0 == first { v0 = Self.readVR() }                    // align to an edge
+        let c0 = CycleCounter.now()
+        while (Self.readVR() &- v0) < n {}
+        let cycles = CycleCounter.now() &- c0
+
+        let measured = U32(UInt64(cycles) * UInt64(tickHz) / UInt64(n))
+        let nominal = Int64(timer.cpuHz)
+        let ppm = Int32((Int64(measured) - nominal) * 1_000_000 / nominal)
+        if retune { timer.retune(cpuHz: measured) }
+        return Calibration(
+            measuredHz: measured,
+            ppm: ppm,
+            crystal: (read32(ATSAM3X8E.SUPC.SR) & ATSAM3X8E.SUPC.SR_OSCSEL) != 0
+        )
+    }
+
+    // MARK: - RTC calendar
+
+    /// Set the calendar (takes effect at the next second boundary, up to 1 s).
+    @discardableResult
+    public func setDateTime(_ t: DateTime) -> Bool {
+        write32(ATSAM3X8E.RTC.CR, ATSAM3X8E.RTC.CR_UPDTIM | ATSAM3X8E.RTC.CR_UPDCAL)
+        if !waitBitSet32(ATSAM3X8E.RTC.SR, ATSAM3X8E.RTC.SR_ACKUPD, timeout: 50_000_000) {
+            write32(ATSAM3X8E.RTC.CR, 0)
+            return false
+        }
+        write32(ATSAM3X8E.RTC.SCCR, ATSAM3X8E.RTC.SCCR_ACKCLR)
+        write32(ATSAM3X8E.RTC.TIMR, Self.bcd(t.second) | (Self.bcd(t.minute) << 8) | (Self.bcd(t.hour) << 16))
+        write32(
+            ATSAM3X8E.RTC.CALR,
+            Self.bcd(t.year / 100) | (Self.bcd(t.year % 100) << 8) | (Self.bcd(t.month) << 16) |
+                (t.weekday << 21) | (Self.bcd(t.day) << 24)
+        )
+        write32(ATSAM3X8E.RTC.CR, 0)
+        return true
+    }
+
+    public func dateTime() -> DateTime {
+        let tim = Self.stable(ATSAM3X8E.RTC.TIMR)
+        let cal = Self.stable(ATSAM3X8E.RTC.CALR)
+        return DateTime(
+            year: Self.bin(cal & 0x7F) * 100 + Self.bin((cal >> 8) & 0xFF),
+            month: Self.bin((cal >> 16) & 0x1F),
+            day: Self.bin((cal >> 24) & 0x3F),
+            hour: Self.bin((tim >> 16) & 0x3F),
+            minute: Self.bin((tim >> 8) & 0x7F),
+            second: Self.bin(tim & 0x7F)
+        )
+    }
+
+    /// Seconds since 1970-01-01 00:00:00 (the RTC holds UTC or local time:
+    /// whatever was set).
+    public func unixSeconds() -> UInt64 {
+        Self.unixSeconds(dateTime())
+    }
+
+    @discardableResult
+    public func setUnixSeconds(_ seconds: UInt64) -> Bool {
+        setDateTime(Self.dateTime(unixSeconds: seconds))
+    }
+
+    public static func unixSeconds(_ t: DateTime) -> UInt64 {
+        let days = UInt64(max(daysFromCivil(Int(t.year), Int(t.month), Int(t.day)), 0))
+        return days * 86_400 + UInt64(t.hour) * 3600 + UInt64(t.minute) * 60 + UInt64(t.second)
+    }
+
+    public static func dateTime(unixSeconds s: UInt64) -> DateTime {
+        // civil_from_days (H. Hinnant)
+        let z = Int(s / 86_400) + 719_468
+        let era = z / 146_097
+        let doe = z - era * 146_097
+        let yoe = (doe - doe / 1460 + doe / 36_524 - doe / 146_096) / 365
+        let doy = doe - (365 * yoe + yoe / 4 - yoe / 100)
+        let mp = (5 * doy + 2) / 153
+        let d = doy - (153 * mp + 2) / 5 + 1
+        let m = mp < 10 ? mp + 3 : mp - 9
+        let y = yoe + era * 400 + (m <= 2 ? 1 : 0)
+        let sod = U32(s % 86_400)
+        return DateTime(
+            year: U32(y), month: U32(m), day: U32(d),
+            hour: sod / 3600, minute: (sod / 60) % 60, second: sod % 60
+        )
+    }
+
+    // MARK: - Interrupt
+
+    /// RTT alarm: the wakeup already happened; just clear it.
+    public func handleInterrupt() {
+        _ = read32(ATSAM3X8E.RTT.SR)
+        clearBits32(ATSAM3X8E.RTT.MR, ATSAM3X8E.RTT.MR_ALMIEN)
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - Internals
+
+    private func armAlarm(_ tick: U32) {
+        clearBits32(ATSAM3X8E.RTT.MR, ATSAM3X8E.RTT.MR_ALMIEN)
+        write32(ATSAM3X8E.RTT.AR, tick &- 1)                        // ALMS when VR reaches AR + 1
+        _ = read32(ATSAM3X8E.RTT.SR)
+        setBits32(ATSAM3X8E.RTT.MR, ATSAM3X8E.RTT.MR_ALMIEN)
+    }
+
+    private func disarmAlarm() {
+        clearBits32(ATSAM3X8E.RTT.MR, ATSAM3X8E.RTT.MR_ALMIEN)
+        write32(ATSAM3X8E.RTT.AR, 0xFFFF_FFFF)
+        _ = read32(ATSAM3X8E.RTT.SR)
+        NVIC.clearPending(.rtt)
+    }
+
+    /// Move `elapsed` ticks into Timer.millis(), carrying the fraction.
+    private func catchUp(_ elapsed: UInt64) -> U32 {
+        let total = elapsed * 1000 + msRemainder
+        let ms = U32(truncatingIfNeeded: total / UInt64(tickHz))
+        msRemainder = total % UInt64(tickHz)
+        timer.advance(ms: ms)
+        stats.sleptMs &+= ms
+        return ms
+    }
+
+    /// The RTT counts in the slow clock domain: equal twice = stable.
+    private static func readVR() -> U32 {
+        stable(ATSAM3X8E.RTT.VR)
+    }
+
+    private static func stable(_ reg: U32) -> U32 {
+        var a = read32(reg)
+        while true {
+            let b = read32(reg)
+            if a == b { return a }
+            a = b
+        }
+    }
+
+    @inline(__always)
+    private static func bcd(_ v: U32) -> U32 { ((v / 10) << 4) | (v % 10) }
+
+    @inline(__always)
+    private static func bin(_ v: U32) -> U32 { (v >> 4) * 10 + (v & 0xF) }
+
+    // days_from_civil (H. Hinnant): days since 1970-01-01.
+    fileprivate static func daysFromCivil(_ year: Int, _ month: Int, _ day: Int) -> Int {
+        let y = month <= 2 ? year - 1 : year
+        let era = (y >= 0 ? y : y - 399) / 400
+        let yoe = y - era * 400
+        let mp = month > 2 ? month - 3 : month + 9
+        let doy = (153 * mp + 2) / 5 + day - 1
+        let doe = yoe * 365 + yoe / 4 - yoe / 100 + doy
+        return era * 146_097 + doe - 719_468
+    }
+}
+
+// MARK: - Interrupt handler
+
+@_cdecl("RTT_Handler")
+public func RTT_Handler() {
+    g_timeKeeper?.handleInterrupt()
+}
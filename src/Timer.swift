@@ -11,7 +11,7 @@ public func SysTick_Handler() {
 }
 
 public final class Timer {
-    private let cpuHz: U32
+    public private(set) var cpuHz: U32
 
     public init(cpuHz: U32) {
         self.cpuHz = cpuHz
@@ -38,6 +38,23 @@ public final class Timer {
         bm_isb()
     }
 
+    /// Stop the tick (sleep with the RTT as timebase: TimeKeeper).
+    public func stopTick() {
+        write32(ATSAM3X8E.SYST_CSR, 0)
+    }
+
+    /// Restart the tick for a measured CPU clock (TimeKeeper.calibrate()).
+    public func retune(cpuHz: U32) {
+        self.cpuHz = cpuHz
+        startTick1ms()
+    }
+
+    /// Add time spent with the tick stopped, so millis() stays continuous.
+    /// Keeps the caller's PRIMASK (polled code, outer critical sections).
+    public func advance(ms: U32) {
+        withIRQLocked { g_msTicks &+= ms }
+    }
+
     @inline(__always)
     public func millis() -> U32 {
         // Stable snapshot: SysTick IRQ might update while reading.
@@ -70,4 +87,25 @@ extension Timer {
         let d = millis() &+ ms
         sleepUntil(d)
     }
-}
\ No newline at end of file
+}
+// MARK: - DWT cycle counter
+//
+// Free-running CPU cycle counter (wraps every 2^32 cycles, ~51 s at 84 MHz).
+// Cheap enough for instrumentation: one volatile load per sample.
+
+public enum CycleCounter {
+    public static func enable() {
+        setBits32(ATSAM3X8E.DEMCR, ATSAM3X8E.DWT.DEMCR_TRCENA)
+        write32(ATSAM3X8E.DWT_CYCCNT, 0)
+        setBits32(ATSAM3X8E.DWT_CTRL, ATSAM3X8E.DWT.CTRL_CYCCNTENA)
+    }
+
+    public static var isEnabled: Bool {
+        (read32(ATSAM3X8E.DWT_CTRL) & ATSAM3X8E.DWT.CTRL_CYCCNTENA) != 0
+    }
+
+    @inline(__always)
+    public static func now() -> U32 {
+        read32(ATSAM3X8E.DWT_CYCCNT)
+    }
+}
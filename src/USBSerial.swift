@@ -0,0 +1,861 @@
+//
+// USBSerial.swift — USB CDC-ACM device on UOTGHS (the Due's Native USB port).
+//
+// Goals:
+// - A ByteStream like SerialUART, over the native USB port: begin(),
+//   writeByte(), writeString(), writeHex32(), readByteNonBlocking() behave
+//   the same. Code that takes a ByteStream (EEFCTelemetry.dump,
+//   Profiler.dump, Bench.run, FirmwareUpdater) runs on either port; code
+//   typed SerialUART has to change its type too.
+// - Minimal device stack: enumeration on EP0 (standard + CDC class requests),
+//   high speed (480 Mbit/s, 512-byte bulk packets) or full speed (64-byte).
+// - Double-banked bulk IN (EP1) and OUT (EP2) in the UOTGHS DPRAM; the
+//   interrupt endpoint EP3 only exists because CDC-ACM requires it.
+// - Byte writes go through a TX ring drained into free IN banks (from the
+//   caller and from UOTGHS_Handler); large aligned write() calls are moved by
+//   the endpoint DMA channel straight from RAM into the FIFO.
+// - RX: OUT packets land in an RX ring; when it is full the endpoint NAKs
+//   (flow control) until the reader catches up.
+// - measureThroughput() and stats for the benchmark (tools/usbcdc_test.py).
+//
+// Notes:
+// - Control requests are answered from UOTGHS_Handler. With global IRQs off,
+//   call poll() from the loop (every few ms) or enumeration will time out.
+//   poll() and the write/read paths leave PRIMASK as they found it.
+// - Writes before the host configured the device are dropped (counted), and
+//   when the host stops reading, writes wait txTimeoutSpins once and then
+//   drop until the ring drains: a closed terminal never hangs the firmware.
+// - The baud rate is a number the host sets (SET_LINE_CODING); it has no
+//   effect on USB speed. begin(baud) only sets the reported default.
+// - Default IDs are the Arduino Due native port (0x2341:0x003E), so the same
+//   host drivers/rules apply. Pass your own for anything you ship.
+// - The DMA path needs a 4-byte aligned buffer of at least 2 packets.
+// - One instance (the ISR reaches it through g_usbSerial).
+//
+// Dependencies:
+// - MMIO.swift: read32/write32, waitUntil, withIRQLocked
+// - ByteStream.swift: ByteStream
+// - ATSAM3X8E.swift: UOTGHS registers, PMC (UPLL)
+// - NVIC.swift: enable/disable(.uotghs)
+// - Timer.swift: CycleCounter (throughput)
+// - arm/startup.s: UOTGHS_Handler in the vector table (IRQ 40)
+//
+
+// ISR target. MUST be global and single symbol.
+public var g_usbSerial: USBSerial? = nil
+
+public final class USBSerial: ByteStream {
+
+    // MARK: - Public types
+
+    public enum Speed {
+        case full       // 12 Mbit/s, 64-byte bulk packets
+        case high       // 480 Mbit/s, 512-byte bulk packets
+    }
+
+    /// CDC line coding as set by the host (informational).
+    public struct LineCoding {
+        public var baud: U32 = 115_200
+        public var stopBits: U8 = 0      // 0 = 1, 1 = 1.5, 2 = 2
+        public var parity: U8 = 0        // 0 none, 1 odd, 2 even, 3 mark, 4 space
+        public var dataBits: U8 = 8
+    }
+
+    public struct Stats {
+        public var resets: U32 = 0
+        public var setups: U32 = 0
+        public var stalls: U32 = 0
+        public var suspends: U32 = 0
+        public var txBytes: U32 = 0
+        public var txPackets: U32 = 0
+        public var txDropped: U32 = 0
+        public var rxBytes: U32 = 0
+        public var rxPackets: U32 = 0
+        public var rxPauses: U32 = 0     // OUT endpoint NAKed: RX ring full
+        public var dmaWrites: U32 = 0
+    }
+
+    public struct Throughput {
+        public let bytes: U32
+        public let cycles: U32
+        public let bytesPerSecond: U32
+        public let speed: Speed
+    }
+
+    // MARK: - Constants
+
+    public static let txRingSize = 2048          // power of two
+    public static let rxRingSize = 1024          // power of two
+
+    private static let epControl: U32 = 0
+    private static let epIn: U32 = 1             // bulk IN, DMA channel 1
+    private static let epOut: U32 = 2            // bulk OUT
+    private static let epNotify: U32 = 3         // interrupt IN (never used)
+    private static let controlSize = 64
+    private static let dmaChunk = 32_768         // multiple of both packet sizes
+
+    private static let ctrlTimeoutSpins: U32 = 2_000_000
+    private static let txTimeoutSpins: U32 = 4_000_000     // ~50-100 ms
+    private static let dmaTimeoutSpins: U32 = 20_000_000
+
+    // MARK: - State
+
+    public private(set) var stats = Stats()
+    public private(set) var lineCoding = LineCoding()
+    public private(set) var speed: Speed = .full
+    public private(set) var configuration: U8 = 0
+    public private(set) var dtr = false
+    public private(set) var rts = false
+
+    private let mckHz: U32
+    private var clockHeld = false
+    private let vendorID: U16
+    private let productID: U16
+    private let highSpeedEnabled: Bool
+
+    private let tx: UnsafeMutablePointer<UInt8>
+    private let rx: UnsafeMutablePointer<UInt8>
+    private var txHead: U32 = 0       // written by the caller
+    private var txTail: U32 = 0       // advanced by the IN endpoint service
+    private var rxHead: U32 = 0       // advanced by the OUT endpoint service
+    private var rxTail: U32 = 0       // read by the caller
+    private var txStalled = false
+    private var rxPaused = false
+    private var dmaActive = false
+    private var packetSize = 64
+
+    private let setup: UnsafeMutablePointer<UInt8>      // 8-byte SETUP packet
+    private let ctrl: UnsafeMutablePointer<UInt8>       // descriptors / control data
+
+    // MARK: - Init
+
+    public init(mckHz: U32, vendorID: U16 = 0x2341, productID: U16 = 0x003E, highSpeed: Bool = true) {
+        self.mckHz = mckHz
+        self.vendorID = vendorID
+        self.productID = productID
+        self.highSpeedEnabled = highSpeed
+        self.tx = UnsafeMutablePointer<UInt8>.allocate(capacity: Self.txRingSize)
+        self.rx = UnsafeMutablePointer<UInt8>.allocate(capacity: Self.rxRingSize)
+        self.setup = UnsafeMutablePointer<UInt8>.allocate(capacity: 8)
+        self.ctrl = UnsafeMutablePointer<UInt8>.allocate(capacity: 128)
+    }
+
+    // MARK: - Setup (SerialUART-compatible)
+
+    /// Start the UTMI PLL and the controller, attach to the bus. `baud` is
+    /// only the line coding reported to the host until it sets its own.
+    public func begin(_ baud: U32 = 115_200) {
+        lineCoding.baud = baud
+        g_usbSerial = self
+
+        if !clockHeld {
+            PeripheralClock.acquire(ATSAM3X8E.ID.UOTGHS)
+            clockHeld = true
+        }
+
+        // UPLL 480 MHz from the 12 MHz crystal, USB clock = UPLL / 1.
+        write32(ATSAM3X8E.PMC.CKGR_UCKR, (3 << ATSAM3X8E.PMC.UCKR_UPLLCOUNT_SHIFT) | ATSAM3X8E.PMC.UCKR_UPLLEN)
+        _ = waitBitSet32(ATSAM3X8E.PMC.SR, ATSAM3X8E.PMC.SR_LOCKU, timeout: 1_000_000)
+        write32(ATSAM3X8E.PMC.USB, ATSAM3X8E.PMC.USB_USBS | (0 << ATSAM3X8E.PMC.USB_USBDIV_SHIFT))
+        write32(ATSAM3X8E.PMC.SCER, ATSAM3X8E.PMC.SCER_UOTGCLK)
+
+        // Device mode forced (ID pin ignored), no VBUS drive, pad + controller on.
+        write32(
+            ATSAM3X8E.UOTGHS.CTRL,
+            ATSAM3X8E.UOTGHS.CTRL_UIMOD_DEVICE | ATSAM3X8E.UOTGHS.CTRL_VBUSHWC | ATSAM3X8E.UOTGHS.CTRL_FRZCLK
+        )
+        setBits32(ATSAM3X8E.UOTGHS.CTRL, ATSAM3X8E.UOTGHS.CTRL_OTGPADE | ATSAM3X8E.UOTGHS.CTRL_USBE)
+        clearBits32(ATSAM3X8E.UOTGHS.CTRL, ATSAM3X8E.UOTGHS.CTRL_FRZCLK)
+        _ = waitBitSet32(ATSAM3X8E.UOTGHS.SR, ATSAM3X8E.UOTGHS.SR_CLKUSABLE, timeout: 1_000_000)
+
+        let spd = highSpeedEnabled ? ATSAM3X8E.UOTGHS.DEVCTRL_SPDCONF_NORMAL : ATSAM3X8E.UOTGHS.DEVCTRL_SPDCONF_FORCED_FS
+        write32(ATSAM3X8E.UOTGHS.DEVCTRL, ATSAM3X8E.UOTGHS.DEVCTRL_DETACH | spd)
+
+        write32(ATSAM3X8E.UOTGHS.DEVICR, 0x7F)
+        write32(
+            ATSAM3X8E.UOTGHS.DEVIER,
+            ATSAM3X8E.UOTGHS.DEV_EORST | ATSAM3X8E.UOTGHS.DEV_SUSP | ATSAM3X8E.UOTGHS.DEV_WAKEUP
+        )
+
+        NVIC.enable(.uotghs)
+
+        clearBits32(ATSAM3X8E.UOTGHS.DEVCTRL, ATSAM3X8E.UOTGHS.DEVCTRL_DETACH)
+    }
+
+    // Init + minimal banner (no String interpolation)
+    @inline(__always)
+    public func beginWithBootBanner(_ baud: U32, clockOk: Bool) {
+        begin(baud)
+        writeString("BOOT\r\nclock_ok=")
+        writeString(clockOk ? "1" : "0")
+        writeString("\r\n")
+    }
+
+    /// Drop off the bus (the host sees a disconnect) and release the
+    /// controller clock. begin() attaches again.
+    public func detach() {
+        if !clockHeld { return }
+        setBits32(ATSAM3X8E.UOTGHS.DEVCTRL, ATSAM3X8E.UOTGHS.DEVCTRL_DETACH)
+        NVIC.disable(.uotghs)
+        configuration = 0
+        PeripheralClock.release(ATSAM3X8E.ID.UOTGHS)
+        clockHeld = false
+    }
+
+    /// Host has configured the device (bulk endpoints live).
+    public var isConfigured: Bool { configuration != 0 }
+
+    /// A terminal has the port open (DTR set by the host).
+    public var isOpen: Bool { configuration != 0 && dtr }
+
+    // MARK: - Write
+
+    @inline(__always)
+    public func writeByte(_ b: U8) {
+        if put(b) { kickTx() }
+    }
+
+    public func writeString(_ s: String) {
+        for u in s.utf8 {
+            if u == 10 { _ = put(13) } // \n -> \r\n
+            _ = put(u)
+        }
+        kickTx()
+    }
+
+    // Hex print sem divisao (nao puxa __aeabi_uldivmod)
+    public func writeHex32(_ v: U32, prefix: Bool = true) {
+        if prefix { writeString("0x") }
+        var shift: U32 = 28
+        while true {
+            let nib = U8((v >> shift) & 0xF)
+            _ = put(nib < 10 ? 48 + nib : 55 + nib)
+            if shift == 0 { break }
+            shift &-= 4
+        }
+        kickTx()
+    }
+
+    /// Bulk write. Aligned buffers of 2+ packets go through the endpoint DMA
+    /// (after the ring drained, to keep the byte order). Returns bytes taken.
+    @discardableResult
+    public func write(_ p: UnsafeRawPointer, count: Int) -> Int {
+        if configuration == 0 || count <= 0 {
+            stats.txDropped &+= U32(max(count, 0))
+            return 0
+        }
+        if count >= 2 * packetSize && (UInt(bitPattern: p) & 3) == 0 && dmaWrite(p, count) {
+            return count
+        }
+        var n = 0
+        while n < count && put(p.load(fromByteOffset: n, as: UInt8.self)) { n += 1 }
+        kickTx()
+        return n
+    }
+
+    /// Wait until the ring and both IN banks are empty (host read everything).
+    @discardableResult
+    public func flush() -> Bool {
+        if configuration == 0 { return false }
+        return waitUntil(Self.txTimeoutSpins) {
+            kickTx()
+            let s = read32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epIn))
+            return txCount == 0 &&
+                ((s >> ATSAM3X8E.UOTGHS.EPT_NBUSYBK_SHIFT) & ATSAM3X8E.UOTGHS.EPT_NBUSYBK_MASK) == 0
+        }
+    }
+
+    // MARK: - Read
+
+    // Returns: 0...255 if byte available, or -1 if none
+    @inline(__always)
+    public func readByteNonBlocking() -> Int32 {
+        if rxHead == rxTail { pollRx() }
+        if rxHead == rxTail { return -1 }
+        let b = rx[Int(rxTail & U32(Self.rxRingSize - 1))]
+        rxTail &+= 1
+        resumeRx()
+        return Int32(b)
+    }
+
+    /// Copy up to `count` received bytes into `dst`; returns how many.
+    public func read(into dst: UnsafeMutableRawPointer, count: Int) -> Int {
+        if rxHead == rxTail { pollRx() }
+        var n = 0
+        while n < count && rxHead != rxTail {
+            dst.storeBytes(of: rx[Int(rxTail & U32(Self.rxRingSize - 1))], toByteOffset: n, as: UInt8.self)
+            rxTail &+= 1
+            n += 1
+        }
+        resumeRx()
+        return n
+    }
+
+    /// Bytes waiting in the RX ring.
+    public var available: Int { Int(rxHead &- rxTail) }
+
+    // MARK: - Service
+
+    /// Run the device service from the loop (needed with IRQs off).
+    public func poll() {
+        withIRQLocked { service() }
+    }
+
+    /// Send `totalBytes` by writing `buffer` repeatedly (DMA path when it is
+    /// aligned), then wait for the host to read it all. Nil if not configured.
+    public func measureThroughput(buffer: UnsafeRawBufferPointer, totalBytes: U32) -> Throughput? {
+        guard let base = buffer.baseAddress, buffer.count > 0, configuration != 0 else { return nil }
+        let t0 = CycleCounter.now()
+        var sent: U32 = 0
+        while sent < totalBytes {
+            let n = min(buffer.count, Int(totalBytes - sent))
+            let w = write(base, count: n)
+            if w == 0 { break }
+            sent &+= U32(w)
+        }
+        _ = flush()
+        let cycles = CycleCounter.now() &- t0
+        let bps = cycles == 0 ? 0 : U32((UInt64(sent) * UInt64(mckHz)) / UInt64(cycles))
+        return Throughput(bytes: sent, cycles: cycles, bytesPerSecond: bps, speed: speed)
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    /// Device events + endpoints. Called from UOTGHS_Handler or poll().
+    public func service() {
+        let isr = read32(ATSAM3X8E.UOTGHS.DEVISR)
+        let imr = read32(ATSAM3X8E.UOTGHS.DEVIMR)
+
+        if (isr & ATSAM3X8E.UOTGHS.DEV_EORST) != 0 {
+            write32(ATSAM3X8E.UOTGHS.DEVICR, ATSAM3X8E.UOTGHS.DEV_EORST)
+            busReset()
+        }
+        if (isr & imr & ATSAM3X8E.UOTGHS.DEV_SUSP) != 0 {
+            write32(ATSAM3X8E.UOTGHS.DEVICR, ATSAM3X8E.UOTGHS.DEV_SUSP)
+            write32(ATSAM3X8E.UOTGHS.DEVIDR, ATSAM3X8E.UOTGHS.DEV_SUSP)
+            write32(ATSAM3X8E.UOTGHS.DEVIER, ATSAM3X8E.UOTGHS.DEV_WAKEUP)
+            stats.suspends &+= 1
+        }
+        if (isr & imr & ATSAM3X8E.UOTGHS.DEV_WAKEUP) != 0 {
+            write32(ATSAM3X8E.UOTGHS.DEVICR, ATSAM3X8E.UOTGHS.DEV_WAKEUP)
+            write32(ATSAM3X8E.UOTGHS.DEVIDR, ATSAM3X8E.UOTGHS.DEV_WAKEUP)
+            write32(ATSAM3X8E.UOTGHS.DEVIER, ATSAM3X8E.UOTGHS.DEV_SUSP)
+        }
+
+        let eptSR = read32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epControl))
+        if (eptSR & ATSAM3X8E.UOTGHS.EPT_RXSTPI) != 0 {
+            handleSetup()
+        } else if (eptSR & ATSAM3X8E.UOTGHS.EPT_RXOUTI) != 0 {
+            // Late status stage of a control read.
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epControl), ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+        }
+
+        if configuration != 0 {
+            serviceOut()
+            serviceIn()
+        }
+    }
+
+    // MARK: - TX / RX rings
+
+    private var txCount: U32 { txHead &- txTail }
+
+    /// Queue one byte; waits (servicing the endpoint) when the ring is full.
+    private func put(_ b: U8) -> Bool {
+        if configuration == 0 {
+            stats.txDropped &+= 1
+            return false
+        }
+        if txCount >= U32(Self.txRingSize) {
+            if txStalled {
+                stats.txDropped &+= 1
+                return false
+            }
+            if !waitUntil(Self.txTimeoutSpins, {
+                kickTx()
+                return txCount < U32(Self.txRingSize) || configuration == 0
+            }) || configuration == 0 {
+                txStalled = true
+                stats.txDropped &+= 1
+                return false
+            }
+        }
+        txStalled = false
+        tx[Int(txHead & U32(Self.txRingSize - 1))] = b
+        txHead &+= 1
+        return true
+    }
+
+    /// Move ring bytes into free IN banks now and let the IRQ do the rest.
+    @inline(__always)
+    private func kickTx() {
+        if configuration == 0 || txCount == 0 { return }
+        withIRQLocked { serviceIn() }
+    }
+
+    private func pollRx() {
+        if configuration != 0 { withIRQLocked { serviceOut() } }
+    }
+
+    /// Re-open the OUT endpoint once a whole packet fits again.
+    private func resumeRx() {
+        if rxPaused && Self.rxRingSize - available >= packetSize {
+            rxPaused = false
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, Self.epOut), ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+        }
+    }
+
+    /// Fill every free IN bank from the TX ring (short packets allowed).
+    private func serviceIn() {
+        if dmaActive { return }
+        let isrReg = Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epIn)
+        while (read32(isrReg) & ATSAM3X8E.UOTGHS.EPT_TXINI) != 0 {
+            let n = Int(min(txCount, U32(packetSize)))
+            if n == 0 {
+                write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIDR, Self.epIn), ATSAM3X8E.UOTGHS.EPT_TXINI)
+                return
+            }
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epIn), ATSAM3X8E.UOTGHS.EPT_TXINI)
+
+            let fifo = Self.fifo(Self.epIn)
+            let start = Int(txTail & U32(Self.txRingSize - 1))
+            let first = min(n, Self.txRingSize - start)
+            fifo.update(from: tx + start, count: first)
+            if first < n { (fifo + first).update(from: tx, count: n - first) }
+            txTail &+= U32(n)
+
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIDR, Self.epIn), ATSAM3X8E.UOTGHS.EPT_FIFOCON)
+            stats.txPackets &+= 1
+            stats.txBytes &+= U32(n)
+        }
+        // Banks busy: the IRQ picks up the rest when one frees up.
+        write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, Self.epIn), ATSAM3X8E.UOTGHS.EPT_TXINI)
+    }
+
+    /// Copy every filled OUT bank into the RX ring; NAK when it is full.
+    private func serviceOut() {
+        let isrReg = Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epOut)
+        while true {
+            let s = read32(isrReg)
+            if (s & ATSAM3X8E.UOTGHS.EPT_RXOUTI) == 0 { return }
+            let n = Int((s >> ATSAM3X8E.UOTGHS.EPT_BYCT_SHIFT) & ATSAM3X8E.UOTGHS.EPT_BYCT_MASK)
+            if Self.rxRingSize - available < n {
+                write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIDR, Self.epOut), ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+                if !rxPaused { stats.rxPauses &+= 1 }
+                rxPaused = true
+                return
+            }
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epOut), ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+
+            let fifo = Self.fifo(Self.epOut)
+            let start = Int(rxHead & U32(Self.rxRingSize - 1))
+            let first = min(n, Self.rxRingSize - start)
+            (rx + start).update(from: fifo, count: first)
+            if first < n { rx.update(from: fifo + first, count: n - first) }
+            rxHead &+= U32(n)
+
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIDR, Self.epOut), ATSAM3X8E.UOTGHS.EPT_FIFOCON)
+            stats.rxPackets &+= 1
+            stats.rxBytes &+= U32(n)
+        }
+    }
+
+    /// Endpoint DMA (channel 1 = EP1): RAM -> IN banks, the last bank is
+    /// sent short at the end of each chunk (END_B_EN).
+    private func dmaWrite(_ p: UnsafeRawPointer, _ count: Int) -> Bool {
+        if !waitUntil(Self.txTimeoutSpins, {
+            kickTx()
+            return txCount == 0 || configuration == 0
+        }) || configuration == 0 {
+            return false
+        }
+
+        withIRQLocked {
+            dmaActive = true
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIDR, Self.epIn), ATSAM3X8E.UOTGHS.EPT_TXINI)
+        }
+        let ch = ATSAM3X8E.UOTGHS.DEVDMA_BASE + 0x10 * Self.epIn
+        var off = 0
+        var ok = true
+        while off < count {
+            let n = min(count - off, Self.dmaChunk)
+            write32(ch + ATSAM3X8E.UOTGHS.DEVDMA_ADDRESS_OFFSET, U32(UInt(bitPattern: p + off)))
+            write32(
+                ch + ATSAM3X8E.UOTGHS.DEVDMA_CONTROL_OFFSET,
+                (U32(n) << ATSAM3X8E.UOTGHS.DMA_BUFF_LENGTH_SHIFT) |
+                    ATSAM3X8E.UOTGHS.DMA_END_B_EN | ATSAM3X8E.UOTGHS.DMA_CHANN_ENB
+            )
+            if !waitUntil(Self.dmaTimeoutSpins, {
+                (read32(ch + ATSAM3X8E.UOTGHS.DEVDMA_STATUS_OFFSET) & ATSAM3X8E.UOTGHS.DMA_CHANN_ENB) == 0
+            }) {
+                write32(ch + ATSAM3X8E.UOTGHS.DEVDMA_CONTROL_OFFSET, 0)
+                ok = false
+                break
+            }
+            off += n
+            stats.txPackets &+= U32((n + packetSize - 1) / packetSize)
+        }
+        dmaActive = false
+        stats.txBytes &+= U32(off)
+        if ok { stats.dmaWrites &+= 1 } else { stats.txDropped &+= U32(count - off) }
+        return ok
+    }
+
+    // MARK: - Bus reset / endpoints
+
+    private func busReset() {
+        stats.resets &+= 1
+        configuration = 0
+        dtr = false
+        rts = false
+        rxPaused = false
+        dmaActive = false
+        disableDataEndpoints()
+
+        let spd = (read32(ATSAM3X8E.UOTGHS.SR) >> ATSAM3X8E.UOTGHS.SR_SPEED_SHIFT) & 3
+        speed = spd == 1 ? .high : .full
+        packetSize = speed == .high ? 512 : 64
+
+        write32(
+            Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTCFG, Self.epControl),
+            ATSAM3X8E.UOTGHS.EPTCFG_ALLOC |
+                (Self.sizeCode(Self.controlSize) << ATSAM3X8E.UOTGHS.EPTCFG_EPSIZE_SHIFT) |
+                (ATSAM3X8E.UOTGHS.EPTYPE_CTRL << ATSAM3X8E.UOTGHS.EPTCFG_EPTYPE_SHIFT)
+        )
+        write32(ATSAM3X8E.UOTGHS.DEVEPT, U32(1) << Self.epControl)
+        write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, Self.epControl), ATSAM3X8E.UOTGHS.EPT_RXSTPI)
+        write32(ATSAM3X8E.UOTGHS.DEVIER, U32(1) << (ATSAM3X8E.UOTGHS.DEV_PEP_SHIFT + Self.epControl))
+    }
+
+    /// Allocate EP1..3 in ascending order (DPRAM rule) and enable them.
+    private func configureDataEndpoints() {
+        disableDataEndpoints()
+        let bulk = Self.sizeCode(packetSize) << ATSAM3X8E.UOTGHS.EPTCFG_EPSIZE_SHIFT
+        let double = U32(1) << ATSAM3X8E.UOTGHS.EPTCFG_EPBK_SHIFT
+        let bulkType = ATSAM3X8E.UOTGHS.EPTYPE_BULK << ATSAM3X8E.UOTGHS.EPTCFG_EPTYPE_SHIFT
+
+        write32(
+            Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTCFG, Self.epIn),
+            ATSAM3X8E.UOTGHS.EPTCFG_ALLOC | bulk | double | bulkType |
+                ATSAM3X8E.UOTGHS.EPTCFG_EPDIR_IN | ATSAM3X8E.UOTGHS.EPTCFG_AUTOSW
+        )
+        write32(
+            Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTCFG, Self.epOut),
+            ATSAM3X8E.UOTGHS.EPTCFG_ALLOC | bulk | double | bulkType | ATSAM3X8E.UOTGHS.EPTCFG_AUTOSW
+        )
+        write32(
+            Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTCFG, Self.epNotify),
+            ATSAM3X8E.UOTGHS.EPTCFG_ALLOC | (Self.sizeCode(16) << ATSAM3X8E.UOTGHS.EPTCFG_EPSIZE_SHIFT) |
+                (ATSAM3X8E.UOTGHS.EPTYPE_INTR << ATSAM3X8E.UOTGHS.EPTCFG_EPTYPE_SHIFT) |
+                ATSAM3X8E.UOTGHS.EPTCFG_EPDIR_IN
+        )
+
+        let eps: U32 = (1 << Self.epIn) | (1 << Self.epOut) | (1 << Self.epNotify)
+        write32(ATSAM3X8E.UOTGHS.DEVEPT, (eps << ATSAM3X8E.UOTGHS.DEVEPT_EPRST_SHIFT) | (1 << Self.epControl))
+        write32(ATSAM3X8E.UOTGHS.DEVEPT, eps | (1 << Self.epControl))
+
+        rxPaused = false
+        write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, Self.epOut), ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+        write32(
+            ATSAM3X8E.UOTGHS.DEVIER,
+            (U32(1) << (ATSAM3X8E.UOTGHS.DEV_PEP_SHIFT + Self.epIn)) |
+                (U32(1) << (ATSAM3X8E.UOTGHS.DEV_PEP_SHIFT + Self.epOut))
+        )
+    }
+
+    /// Disable EP1..3 and free their DPRAM (descending order).
+    private func disableDataEndpoints() {
+        write32(ATSAM3X8E.UOTGHS.DEVEPT, read32(ATSAM3X8E.UOTGHS.DEVEPT) & (1 << Self.epControl))
+        var ep = Self.epNotify
+        while ep >= Self.epIn {
+            clearBits32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTCFG, ep), ATSAM3X8E.UOTGHS.EPTCFG_ALLOC)
+            ep -= 1
+        }
+    }
+
+    // MARK: - Control endpoint
+
+    private func handleSetup() {
+        for i in 0..<8 { setup[i] = Self.fifo(Self.epControl)[i] }
+        write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epControl), ATSAM3X8E.UOTGHS.EPT_RXSTPI)
+        stats.setups &+= 1
+
+        let requestType = setup[0]
+        let request = setup[1]
+        let value = U16(setup[2]) | (U16(setup[3]) << 8)
+        let index = U16(setup[4]) | (U16(setup[5]) << 8)
+        let length = Int(U16(setup[6]) | (U16(setup[7]) << 8))
+
+        var ok = false
+        switch requestType & 0x60 {
+        case 0x00: ok = standardRequest(requestType, request, value, index, length)
+        case 0x20: ok = classRequest(request, value, length)
+        default: ok = false
+        }
+        if !ok {
+            write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, Self.epControl), ATSAM3X8E.UOTGHS.EPT_STALLRQ)
+            stats.stalls &+= 1
+        }
+    }
+
+    private func standardRequest(_ type: U8, _ request: U8, _ value: U16, _ index: U16, _ length: Int) -> Bool {
+        let toEndpoint = (type & 0x1F) == 2
+        let ep = U32(index & 0x0F)
+
+        switch request {
+        case 0x00:      // GET_STATUS
+            var halted = false
+            if toEndpoint && ep <= Self.epNotify {
+                halted = (read32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIMR, ep)) & ATSAM3X8E.UOTGHS.EPT_STALLRQ) != 0
+            }
+            ctrl[0] = halted ? 1 : 0
+            ctrl[1] = 0
+            return controlIn(2, length)
+
+        case 0x01, 0x03:    // CLEAR_FEATURE / SET_FEATURE
+            if toEndpoint && value == 0 && ep >= Self.epIn && ep <= Self.epNotify {
+                if request == 0x03 {
+                    write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, ep), ATSAM3X8E.UOTGHS.EPT_STALLRQ)
+                } else {
+                    write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIDR, ep), ATSAM3X8E.UOTGHS.EPT_STALLRQ)
+                    write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTIER, ep), ATSAM3X8E.UOTGHS.EPT_RSTDT)
+                }
+                return statusIn()
+            }
+            return (type & 0x1F) == 0 && value == 1 && statusIn()     // remote wakeup: accepted, unused
+
+        case 0x05:      // SET_ADDRESS: takes effect after the status stage
+            let ctrlReg = read32(ATSAM3X8E.UOTGHS.DEVCTRL) &
+                ~(ATSAM3X8E.UOTGHS.DEVCTRL_UADD_MASK | ATSAM3X8E.UOTGHS.DEVCTRL_ADDEN)
+            write32(ATSAM3X8E.UOTGHS.DEVCTRL, ctrlReg | (U32(value) & ATSAM3X8E.UOTGHS.DEVCTRL_UADD_MASK))
+            if !statusIn() { return true }
+            _ = waitBitSet32(
+                Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epControl),
+                ATSAM3X8E.UOTGHS.EPT_TXINI,
+                timeout: Self.ctrlTimeoutSpins
+            )
+            setBits32(ATSAM3X8E.UOTGHS.DEVCTRL, ATSAM3X8E.UOTGHS.DEVCTRL_ADDEN)
+            return true
+
+        case 0x06:      // GET_DESCRIPTOR
+            let n = descriptor(U8(value >> 8), U8(value & 0xFF))
+            return n > 0 && controlIn(n, length)
+
+        case 0x08:      // GET_CONFIGURATION
+            ctrl[0] = configuration
+            return controlIn(1, length)
+
+        case 0x09:      // SET_CONFIGURATION
+            if value > 1 { return false }
+            configuration = U8(value)
+            if configuration != 0 { configureDataEndpoints() } else { disableDataEndpoints() }
+            return statusIn()
+
+        case 0x0A:      // GET_INTERFACE
+            ctrl[0] = 0
+            return controlIn(1, length)
+
+        case 0x0B:      // SET_INTERFACE (one alternate setting)
+            return value == 0 && statusIn()
+
+        default:
+            return false
+        }
+    }
+
+    private func classRequest(_ request: U8, _ value: U16, _ length: Int) -> Bool {
+        switch request {
+        case 0x20:      // SET_LINE_CODING
+            if controlOut(7) < 7 { return false }
+            lineCoding.baud = U32(ctrl[0]) | (U32(ctrl[1]) << 8) | (U32(ctrl[2]) << 16) | (U32(ctrl[3]) << 24)
+            lineCoding.stopBits = ctrl[4]
+            lineCoding.parity = ctrl[5]
+            lineCoding.dataBits = ctrl[6]
+            return statusIn()
+
+        case 0x21:      // GET_LINE_CODING
+            let b = lineCoding.baud
+            ctrl[0] = U8(b & 0xFF)
+            ctrl[1] = U8((b >> 8) & 0xFF)
+            ctrl[2] = U8((b >> 16) & 0xFF)
+            ctrl[3] = U8(b >> 24)
+            ctrl[4] = lineCoding.stopBits
+            ctrl[5] = lineCoding.parity
+            ctrl[6] = lineCoding.dataBits
+            return controlIn(7, length)
+
+        case 0x22:      // SET_CONTROL_LINE_STATE
+            dtr = (value & 1) != 0
+            rts = (value & 2) != 0
+            if dtr { txStalled = false }
+            return statusIn()
+
+        case 0x23:      // SEND_BREAK
+            return statusIn()
+
+        default:
+            return false
+        }
+    }
+
+    /// Data stage IN from `ctrl` (packets of 64, ZLP when the data is a
+    /// multiple of 64 shorter than wLength), then the host's status OUT.
+    private func controlIn(_ n: Int, _ wLength: Int) -> Bool {
+        let len = min(n, wLength)
+        let isrReg = Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epControl)
+        let icrReg = Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epControl)
+        var off = 0
+        while true {
+            var s: U32 = 0
+            if !waitUntil(Self.ctrlTimeoutSpins, {
+                s = read32(isrReg)
+                return (s & (ATSAM3X8E.UOTGHS.EPT_TXINI | ATSAM3X8E.UOTGHS.EPT_RXOUTI)) != 0
+            }) {
+                return true          // host gave up; nothing to stall
+            }
+            if (s & ATSAM3X8E.UOTGHS.EPT_RXOUTI) != 0 { break }     // host ended the data stage early
+
+            let k = min(Self.controlSize, len - off)
+            Self.fifo(Self.epControl).update(from: ctrl + off, count: k)
+            write32(icrReg, ATSAM3X8E.UOTGHS.EPT_TXINI)
+            off += k
+            if k < Self.controlSize || off == wLength { break }
+        }
+        _ = waitBitSet32(isrReg, ATSAM3X8E.UOTGHS.EPT_RXOUTI, timeout: Self.ctrlTimeoutSpins)
+        write32(icrReg, ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+        return true
+    }
+
+    /// Data stage OUT into `ctrl`; returns the bytes received.
+    private func controlOut(_ n: Int) -> Int {
+        let isrReg = Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epControl)
+        if !waitBitSet32(isrReg, ATSAM3X8E.UOTGHS.EPT_RXOUTI, timeout: Self.ctrlTimeoutSpins) { return 0 }
+        let count = Int((read32(isrReg) >> ATSAM3X8E.UOTGHS.EPT_BYCT_SHIFT) & ATSAM3X8E.UOTGHS.EPT_BYCT_MASK)
+        let k = min(n, count)
+        ctrl.update(from: Self.fifo(Self.epControl), count: k)
+        write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epControl), ATSAM3X8E.UOTGHS.EPT_RXOUTI)
+        return k
+    }
+
+    /// Zero-length IN status stage.
+    private func statusIn() -> Bool {
+        let isrReg = Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTISR, Self.epControl)
+        if !waitBitSet32(isrReg, ATSAM3X8E.UOTGHS.EPT_TXINI, timeout: Self.ctrlTimeoutSpins) { return false }
+        write32(Self.eptReg(ATSAM3X8E.UOTGHS.DEVEPTICR, Self.epControl), ATSAM3X8E.UOTGHS.EPT_TXINI)
+        return true
+    }
+
+    // MARK: - Descriptors (built into `ctrl`, no heap use per request)
+
+    private struct Emitter {
+        let p: UnsafeMutablePointer<UInt8>
+        var n = 0
+
+        mutating func u8(_ v: U8) {
+            p[n] = v
+            n += 1
+        }
+
+        mutating func u16(_ v: U16) {
+            u8(U8(v & 0xFF))
+            u8(U8(v >> 8))
+        }
+
+        /// ASCII StaticString as a UTF-16LE string descriptor.
+        mutating func string(_ s: StaticString) {
+            u8(U8(2 + 2 * s.utf8CodeUnitCount))
+            u8(0x03)
+            for i in 0..<s.utf8CodeUnitCount {
+                u8(s.utf8Start[i])
+                u8(0)
+            }
+        }
+    }
+
+    /// Returns the descriptor length in `ctrl`, 0 when unknown (STALL).
+    private func descriptor(_ type: U8, _ index: U8) -> Int {
+        var e = Emitter(p: ctrl)
+        switch type {
+        case 0x01:      // DEVICE
+            e.u8(18); e.u8(0x01); e.u16(0x0200)
+            e.u8(0x02); e.u8(0x00); e.u8(0x00)         // CDC at device level
+            e.u8(U8(Self.controlSize))
+            e.u16(vendorID); e.u16(productID); e.u16(0x0100)
+            e.u8(1); e.u8(2); e.u8(3); e.u8(1)
+
+        case 0x02, 0x07:    // CONFIGURATION / OTHER_SPEED_CONFIGURATION
+            if type == 0x07 && !highSpeedEnabled { return 0 }
+            let high = (speed == .high) != (type == 0x07)
+            configurationDescriptor(&e, type: type, high: high)
+
+        case 0x03:      // STRING
+            switch index {
+            case 0: e.u8(4); e.u8(0x03); e.u16(0x0409)
+            case 1: e.string("Embedded Swift")
+            case 2: e.string("Arduino Due CDC-ACM")
+            case 3: e.string("DUE-SWIFT-0001")
+            default: return 0
+            }
+
+        case 0x06:      // DEVICE_QUALIFIER (high-speed capable devices only)
+            if !highSpeedEnabled { return 0 }
+            e.u8(10); e.u8(0x06); e.u16(0x0200)
+            e.u8(0x02); e.u8(0x00); e.u8(0x00)
+            e.u8(U8(Self.controlSize)); e.u8(1); e.u8(0)
+
+        default:
+            return 0
+        }
+        return e.n
+    }
+
+    private func configurationDescriptor(_ e: inout Emitter, type: U8, high: Bool) {
+        let bulk: U16 = high ? 512 : 64
+        e.u8(9); e.u8(type); e.u16(67); e.u8(2); e.u8(1); e.u8(0); e.u8(0x80); e.u8(50)
+
+        // Interface 0: communication (ACM) + notification endpoint
+        e.u8(9); e.u8(0x04); e.u8(0); e.u8(0); e.u8(1); e.u8(0x02); e.u8(0x02); e.u8(0x01); e.u8(0)
+        e.u8(5); e.u8(0x24); e.u8(0x00); e.u16(0x0110)              // header, CDC 1.10
+        e.u8(5); e.u8(0x24); e.u8(0x01); e.u8(0x00); e.u8(1)        // call management
+        e.u8(4); e.u8(0x24); e.u8(0x02); e.u8(0x02)                 // ACM: line coding + state
+        e.u8(5); e.u8(0x24); e.u8(0x06); e.u8(0); e.u8(1)           // union: 0 -> 1
+        e.u8(7); e.u8(0x05); e.u8(0x80 | U8(Self.epNotify)); e.u8(0x03); e.u16(16); e.u8(high ? 8 : 16)
+
+        // Interface 1: data, bulk OUT + IN
+        e.u8(9); e.u8(0x04); e.u8(1); e.u8(0); e.u8(2); e.u8(0x0A); e.u8(0x00); e.u8(0x00); e.u8(0)
+        e.u8(7); e.u8(0x05); e.u8(U8(Self.epOut)); e.u8(0x02); e.u16(bulk); e.u8(0)
+        e.u8(7); e.u8(0x05); e.u8(0x80 | U8(Self.epIn)); e.u8(0x02); e.u16(bulk); e.u8(0)
+    }
+
+    // MARK: - Small utilities
+
+    @inline(__always)
+    private static func eptReg(_ base: U32, _ ep: U32) -> U32 {
+        base + 4 * ep
+    }
+
+    @inline(__always)
+    private static func fifo(_ ep: U32) -> UnsafeMutablePointer<UInt8> {
+        UnsafeMutablePointer<UInt8>(bitPattern: UInt(ATSAM3X8E.UOTGHS_RAM + ATSAM3X8E.UOTGHS.FIFO_STRIDE * ep))!
+    }
+
+    /// EPSIZE field: 8 << code bytes.
+    private static func sizeCode(_ bytes: Int) -> U32 {
+        var code: U32 = 0
+        var size = 8
+        while size < bytes {
+            size <<= 1
+            code += 1
+        }
+        return code
+    }
+}
+
+// MARK: - Interrupt handler
+
+@_cdecl("UOTGHS_Handler")
+public func UOTGHS_Handler() {
+    g_usbSerial?.service()
+}
@@ -0,0 +1,217 @@
+//
+// Watchdog.swift — WDT supervisor with per-task check-ins.
+//
+// Goals:
+// - Enable the hardware watchdog with a configurable period (4 ms .. 16 s).
+// - Tasks register a timeout and check in; the WDT is kicked only while
+//   every task checked in within its timeout. One missed deadline stops the
+//   kicks and the WDT resets the chip within one period.
+// - Record for the next boot (GPBR, survives the reset): the task that
+//   missed, or the last task that checked in when the whole loop hung
+//   (a TWI slave holding the bus, a waitReady that never returns).
+// - Negligible per-loop cost: checkIn() is two stores; service() is one
+//   compare until the next kick is due (period / 4).
+//
+// Notes:
+// - Board.initBoard(watchdog: true) is required: by default Board disables
+//   the WDT, and WDT_MR accepts a single write per reset.
+// - Check in right BEFORE a task's work: if the loop then hangs inside it,
+//   lastReset.lastCheckIn names that task.
+// - Timing uses Timer.millis(). After a TimeKeeper sleep (millis() jumps)
+//   call resume(). WDIDLEHLT stops the WDT during Sleep (WFI); kick before a
+//   WAIT sleep and keep it shorter than the period.
+// - GPBR3..4 belong to Watchdog (GPBR0..2: TimeKeeper).
+// - WDDBGHLT: a debugger halt does not reset the board.
+//
+// Dependencies:
+// - MMIO.swift: read32/write32
+// - ATSAM3X8E.swift: WDT, RSTC, GPBR
+// - Timer.swift: Timer, g_msTicks
+// - Board.swift: initBoard(watchdog: true)
+//
+
+public final class Watchdog {
+
+    // MARK: - Public types
+
+    /// What the previous boot left behind.
+    public struct Report {
+        public let resetByWatchdog: Bool        // RSTC: the last reset was the WDT
+        public let missedTask: Int?             // supervisor saw this task miss its deadline
+        public let overdueMs: U32               // how late missedTask was
+        public let lastCheckIn: Int?            // last task alive before the reset
+    }
+
+    public struct Stats {
+        public var kicks: U32 = 0
+        public var evaluations: U32 = 0
+    }
+
+    public enum Error: Swift.Error, Equatable {
+        case disabled
+        case invalidPeriod
+        case invalidTimeout
+        case tooManyTasks
+
+        /// Short stable identifier (good for logs / UI keys).
+        public var name: String {
+            switch self {
+            case .disabled: return "disabled"
+            case .invalidPeriod: return "invalid_period"
+            case .invalidTimeout: return "invalid_timeout"
+            case .tooManyTasks: return "too_many_tasks"
+            }
+        }
+
+        /// Human-readable message.
+        public var message: String {
+            switch self {
+            case .disabled: return "WDT already disabled: use Board.initBoard(watchdog: true)."
+            case .invalidPeriod: return "Watchdog period must be 4...15996 ms."
+            case .invalidTimeout: return "Task timeout must be non-zero and below 2^31 ms."
+            case .tooManyTasks: return "At most Watchdog.maxTasks tasks."
+            }
+        }
+    }
+
+    public static let maxTasks = 8
+
+    // MARK: - State
+
+    public let lastReset: Report
+    public private(set) var periodMs: U32 = 0
+    public private(set) var tripped = false           // kicks stopped, reset pending
+    public private(set) var stats = Stats()
+
+    private let timer: Timer
+    private var names: [String] = []
+    private var timeouts: [U32] = []
+    private var deadlines: [U32] = []
+    private var kickEveryMs: U32 = 0
+    private var nextKick: U32 = 0
+
+    // GPBR3: [31:16] tag, [15:8] missed task + 1, [7:0] last check-in + 1
+    // GPBR4: overdue ms of the missed task
+    private static let tag: U32 = 0x5744_0000          // "WD"
+    private static let record: U32 = ATSAM3X8E.GPBR_BASE + 3 * ATSAM3X8E.GPBR.STRIDE
+    private static let overdue: U32 = ATSAM3X8E.GPBR_BASE + 4 * ATSAM3X8E.GPBR.STRIDE
+
+    // MARK: - Init
+
+    /// Reads the previous boot's record; the WDT is untouched until begin().
+    public init(timer: Timer) {
+        self.timer = timer
+        names.reserveCapacity(Self.maxTasks)
+        timeouts.reserveCapacity(Self.maxTasks)
+        deadlines.reserveCapacity(Self.maxTasks)
+
+        let rsttyp = (read32(ATSAM3X8E.RSTC.SR) & ATSAM3X8E.RSTC.SR_RSTTYP_MASK) >> ATSAM3X8E.RSTC.SR_RSTTYP_SHIFT
+        let rec = read32(Self.record)
+        let valid = (rec & 0xFFFF_0000) == Self.tag
+        let missed = valid ? (rec >> 8) & 0xFF : 0
+        let last = valid ? rec & 0xFF : 0
+        lastReset = Report(
+            resetByWatchdog: rsttyp == ATSAM3X8E.RSTC.RSTTYP_WATCHDOG,
+            missedTask: missed == 0 ? nil : Int(missed - 1),
+            overdueMs: missed == 0 ? 0 : read32(Self.overdue),
+            lastCheckIn: last == 0 ? nil : Int(last - 1)
+        )
+    }
+
+    /// Program the WDT (reset on underflow) and clear the record. Register
+    /// tasks before or after; each starts with a full timeout.
+    public func begin(periodMs: U32) throws(Watchdog.Error) {
+        if (read32(ATSAM3X8E.WDT.MR) & ATSAM3X8E.WDT.WDT_MR_WDDIS) != 0 { throw .disabled }
+        let wdv = periodMs * ATSAM3X8E.WDT.TICK_HZ / 1000
+        if wdv == 0 || wdv > ATSAM3X8E.WDT.MR_WDV_MASK { throw .invalidPeriod }
+
+        // WDD = WDV: no window, a kick is accepted at any time.
+        write32(
+            ATSAM3X8E.WDT.MR,
+            wdv | (wdv << ATSAM3X8E.WDT.MR_WDD_SHIFT) | ATSAM3X8E.WDT.MR_WDRSTEN |
+                ATSAM3X8E.WDT.MR_WDDBGHLT | ATSAM3X8E.WDT.MR_WDIDLEHLT
+        )
+        self.periodMs = periodMs
+        kickEveryMs = max(periodMs / 4, 1)
+        write32(Self.record, Self.tag)
+        write32(Self.overdue, 0)
+        resume()
+    }
+
+    /// Add a task that must check in at least every `timeoutMs`.
+    public func register(_ name: String, timeoutMs: U32) throws(Watchdog.Error) -> Int {
+        if names.count >= Self.maxTasks { throw .tooManyTasks }
+        if timeoutMs == 0 || timeoutMs >= 0x8000_0000 { throw .invalidTimeout }
+        names.append(name)
+        timeouts.append(timeoutMs)
+        deadlines.append(timer.millis() &+ timeoutMs)
+        return names.count - 1
+    }
+
+    public func name(of task: Int) -> String {
+        task >= 0 && task < names.count ? names[task] : "?"
+    }
+
+    // MARK: - Per-loop calls
+
+    /// The task is alive; call it right before the task's work.
+    @inline(__always)
+    public func checkIn(_ task: Int) {
+        deadlines[task] = g_msTicks &+ timeouts[task]       // aligned word: atomic read
+        if !tripped { write32(Self.record, Self.tag | U32(task + 1)) }
+    }
+
+    /// Call once per main loop: kicks the WDT every period / 4 while all
+    /// tasks are on time.
+    @inline(__always)
+    public func service() {
+        let now = g_msTicks
+        if ((now &- nextKick) & 0x8000_0000) != 0 { return }
+        evaluate(now)
+    }
+
+    /// Restart every deadline and kick (after a sleep, a long blocking
+    /// operation the tasks agreed to, or a millis() jump).
+    public func resume() {
+        let now = timer.millis()
+        var i = 0
+        while i < deadlines.count {
+            deadlines[i] = now &+ timeouts[i]
+            i += 1
+        }
+        if !tripped { kick(now) }
+    }
+
+    public func resetStats() {
+        stats = Stats()
+    }
+
+    // MARK: - Internals
+
+    private func evaluate(_ now: U32) {
+        if tripped { return }
+        stats.evaluations &+= 1
+        var i = 0
+        while i < deadlines.count {
+            let late = now &- deadlines[i]
+            if (late & 0x8000_0000) == 0 && late != 0 {
+                // Missed: keep the last check-in byte, record the culprit, stop kicking.
+                let rec = read32(Self.record) & 0xFF
+                write32(Self.overdue, late)
+                write32(Self.record, Self.tag | (U32(i + 1) << 8) | rec)
+                tripped = true
+                return
+            }
+            i += 1
+        }
+        kick(now)
+    }
+
+    @inline(__always)
+    private func kick(_ now: U32) {
+        if periodMs == 0 { return }
+        write32(ATSAM3X8E.WDT.CR, ATSAM3X8E.WDT.CR_KEY | ATSAM3X8E.WDT.CR_WDRSTT)
+        nextKick = now &+ kickEveryMs
+        stats.kicks &+= 1
+    }
+}
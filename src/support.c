@@ -12,12 +12,29 @@ void bm_enable_irq(void) { __asm__ volatile ("cpsie i" ::: "memory"); }
 __attribute__((used))
 void bm_disable_irq(void) { __asm__ volatile ("cpsid i" ::: "memory"); }
 
+// Seção crítica aninhável: devolve o PRIMASK anterior (1 = IRQs já mascaradas)
+// e mascara as IRQs. bm_irq_restore() volta ao estado salvo.
+__attribute__((used))
+uint32_t bm_irq_save(void) {
+    uint32_t primask;
+    __asm__ volatile ("mrs %0, primask\n cpsid i" : "=r"(primask) :: "memory");
+    return primask;
+}
+
+__attribute__((used))
+void bm_irq_restore(uint32_t primask) { __asm__ volatile ("msr primask, %0" :: "r"(primask) : "memory"); }
+
 __attribute__((used))
 void bm_dsb(void) { __asm__ volatile ("dsb 0xF" ::: "memory"); }
 
 __attribute__((used))
 void bm_isb(void) { __asm__ volatile ("isb 0xF" ::: "memory"); }
 
+// Dorme até a próxima interrupção (Sleep mode; também acorda com IRQs
+// mascaradas por PRIMASK: o handler roda depois do cpsie).
+__attribute__((used))
+void bm_wfi(void) { __asm__ volatile ("dsb 0xF\n wfi" ::: "memory"); }
+
 // ✅ Volatile MMIO (evita "read otimizado" que trava wait loops)
 __attribute__((used))
 uint32_t bm_read32(uint32_t addr) {
@@ -29,6 +46,110 @@ void bm_write32(uint32_t addr, uint32_t value) {
   *(volatile uint32_t*)addr = value;
 }
 
+// Acessos de 8/16 bits (barramento externo do SMC: cada escrita vira um ciclo).
+__attribute__((used))
+uint8_t bm_read8(uint32_t addr) {
+  return *(volatile uint8_t*)addr;
+}
+
+__attribute__((used))
+void bm_write8(uint32_t addr, uint8_t value) {
+  *(volatile uint8_t*)addr = value;
+}
+
+// -----------------------------------------------------------------------------
+// Flash: comandos EEFC executados da RAM
+// - Um banco de flash não pode ser lido enquanto programa/apaga.
+// - Quando o código roda do mesmo banco (ex: boot pelo banco 1 via GPNVM2),
+//   ou para comandos GPNVM, o FCR + espera do FRDY precisam rodar da RAM.
+// - .ramfunc é copiada junto com .data pelo Reset_Handler (linker.ld).
+// - Chamar com IRQs desabilitadas (os handlers ficam na flash).
+// -----------------------------------------------------------------------------
+
+// Banco em que este código está rodando (endereço de link da própria função).
+__attribute__((used))
+uint32_t bm_running_bank(void) {
+  return ((uint32_t)&bm_running_bank >= 0x000C0000u) ? 1u : 0u;
+}
+
+// Escreve FCR e espera FRDY. Retorna FSR (lido uma vez: limpa FCMDE/FLOCKE).
+__attribute__((used, noinline, long_call, section(".ramfunc")))
+uint32_t bm_eefc_cmd_ram(uint32_t fcr, uint32_t fsr, uint32_t cmd) {
+  *(volatile uint32_t*)fcr = cmd;
+  uint32_t s = 0;
+  uint32_t n = 20000000u;
+  do {
+    s = *(volatile uint32_t*)fsr;
+  } while (((s & 1u) == 0u) && --n);
+  return s;
+}
+
+// -----------------------------------------------------------------------------
+// EMAC: área de DMA (descritores RX/TX + buffers RX + pool de pacotes)
+// - Seção própria .eth_dma (NOLOAD, sections.ld): fora de .bss, não é zerada
+//   no reset (EMAC.swift inicializa os descritores) e fica fora do heap.
+// - Tamanho: make ETH_DMA_SIZE=... (--defsym __eth_dma_size). Padrão 0: quem
+//   não usa Ethernet não perde RAM, e EMAC.begin() falha (areaTooSmall).
+// - Alinhada em 8; EMAC.swift divide a área (layout no header de EMAC.swift).
+// -----------------------------------------------------------------------------
+extern uint8_t __eth_dma_start;
+extern uint8_t __eth_dma_end;
+
+__attribute__((used))
+uint32_t bm_eth_dma_area(void) { return (uint32_t)(uintptr_t)&__eth_dma_start; }
+
+__attribute__((used))
+uint32_t bm_eth_dma_size(void) {
+  return (uint32_t)(uintptr_t)&__eth_dma_end - (uint32_t)(uintptr_t)&__eth_dma_start;
+}
+
+// -----------------------------------------------------------------------------
+// SRAM externa (SMC, NCS0 @ 0x60000000)
+// - Seção .ext_sram (NOLOAD, sections.ld) na região EXTRAM: buffers grandes
+//   declarados com BM_EXT_SRAM ficam fora da RAM interna.
+// - Não é zerada nem inicializada: o SMC precisa estar configurado (SMC.swift)
+//   antes do primeiro acesso, e o conteúdo é lixo até ser escrito.
+// - Tamanho real da SRAM: make EXT_SRAM_SIZE=... (--defsym __ext_sram_size);
+//   o link falha se .ext_sram não couber. O resto vira o arena de
+//   ExternalRAM.allocate() (SMC.swift).
+// -----------------------------------------------------------------------------
+#define BM_EXT_SRAM __attribute__((used, section(".ext_sram"), aligned(4)))
+
+extern uint8_t __ext_sram_start;
+extern uint8_t __ext_sram_free;
+extern uint8_t __ext_sram_end;
+
+__attribute__((used))
+uint32_t bm_ext_sram_base(void) { return (uint32_t)(uintptr_t)&__ext_sram_start; }
+
+// Primeiro byte livre depois dos objetos BM_EXT_SRAM.
+__attribute__((used))
+uint32_t bm_ext_sram_free(void) { return (uint32_t)(uintptr_t)&__ext_sram_free; }
+
+__attribute__((used))
+uint32_t bm_ext_sram_end(void) { return (uint32_t)(uintptr_t)&__ext_sram_end; }
+
+// -----------------------------------------------------------------------------
+// Profiler (Profiler.swift): handler do TC8
+// - Na entrada da exceção o hardware empilha r0-r3, r12, lr, pc, xPSR na
+//   pilha do código interrompido (MSP ou PSP: bit 2 do EXC_RETURN em lr).
+// - naked: nada é empilhado antes de ler o SP; o ponteiro do frame vai em r0
+//   para bm_profiler_sample (Swift): frame[5] = LR, frame[6] = PC.
+// - "b" (não "bl"): a função Swift retorna direto com o EXC_RETURN.
+// -----------------------------------------------------------------------------
+void bm_profiler_sample(const uint32_t *frame);
+
+__attribute__((naked, used))
+void TC8_Handler(void) {
+  __asm__ volatile (
+    "tst lr, #4\n"
+    "ite eq\n"
+    "mrseq r0, msp\n"
+    "mrsne r0, psp\n"
+    "b bm_profiler_sample\n"
+  );
+}
+
 // -----------------------------------------------------------------------------
 // Stack protector (Swift pode exigir isso dependendo de flags/toolchain)
 // -----------------------------------------------------------------------------
@@ -170,9 +291,25 @@ void __aeabi_memcpy8(void *dest, const void *src, size_t n) {
 }
 
 // -----------------------------------------------------------------------------
-// Swift hashing seed wants arc4random_buf. Tiny PRNG (NOT crypto-secure).
+// arc4random_buf: TRNG do SAM3X (semente do hashing do Swift e
+// SystemRandomNumberGenerator).
+// - Liga o TRNG sempre que o clock estiver desligado (primeira chamada, que
+//   pode vir antes de Board.initBoard, ou depois de
+//   PeripheralClock.disableUnused() em Power.swift) e grava uma palavra de
+//   32 bits por vez (nova palavra a cada 84 ciclos de MCK).
+// - Endereços espelham ATSAM3X8E.swift (PMC.PCER1/PCSR1, TRNG); Random.swift usa o
+//   mesmo periférico para TRNG.fill() e para semear o Xoshiro128.
+// - Se DATRDY não vier, mistura ODATA com um xorshift32: nunca trava o boot.
 // -----------------------------------------------------------------------------
-static uint32_t g_rng = 0x12345678u;
+#define BM_PMC_PCER1   0x400E0700u
+#define BM_PMC_PCSR1   0x400E0708u
+#define BM_TRNG_CR     0x400BC000u
+#define BM_TRNG_ISR    0x400BC01Cu
+#define BM_TRNG_ODATA  0x400BC050u
+#define BM_TRNG_ENABLE ((0x524E47u << 8) | 1u)   // KEY "RNG" + ENABLE
+#define BM_TRNG_ID     41u
+
+static uint32_t g_rng = 0x12345678u;   // só no fallback
 
 static uint32_t xorshift32(void) {
   uint32_t x = g_rng;
@@ -183,15 +320,41 @@ static uint32_t xorshift32(void) {
   return x;
 }
 
+static uint32_t trng_word(void) {
+  uint32_t n = 1000u;
+  while (((*(volatile uint32_t*)BM_TRNG_ISR & 1u) == 0u) && --n) { }
+  uint32_t w = *(volatile uint32_t*)BM_TRNG_ODATA;   // leitura limpa DATRDY
+  if (n == 0u) w ^= xorshift32();
+  return w;
+}
+
 __attribute__((used))
 void arc4random_buf(void *buf, size_t n) {
+  const uint32_t bit = 1u << (BM_TRNG_ID - 32u);
+  if ((*(volatile uint32_t*)BM_PMC_PCSR1 & bit) == 0u) {
+    *(volatile uint32_t*)BM_PMC_PCER1 = bit;
+    *(volatile uint32_t*)BM_TRNG_CR = BM_TRNG_ENABLE;
+  }
+
   uint8_t *p = (uint8_t*)buf;
-  while (n) {
-    uint32_t r = xorshift32();
-    for (int i = 0; i < 4 && n; i++) {
+  if (n && ((uintptr_t)p & 3u)) {
+    uint32_t r = trng_word();
+    while (n && ((uintptr_t)p & 3u)) {
       *p++ = (uint8_t)(r & 0xFF);
       r >>= 8;
       n--;
     }
   }
+  while (n >= 4) {
+    *(uint32_t*)p = trng_word();
+    p += 4;
+    n -= 4;
+  }
+  if (n) {
+    uint32_t r = trng_word();
+    while (n--) {
+      *p++ = (uint8_t)(r & 0xFF);
+      r >>= 8;
+    }
+  }
 }
\ No newline at end of file
@@ -0,0 +1,175 @@
+#!/usr/bin/env python3
+"""bench.py — capture and compare Bench (src/Bench.swift) reports.
+
+Usage:
+  make bench-firmware                                        # build/bench/firmware_bench.bin
+  tools/bench.py capture /dev/ttyACM0 -o build/bench/$(git describe --always).txt
+  tools/bench.py show build/bench/abc1234.txt
+  tools/bench.py compare build/bench/old.txt build/bench/new.txt --threshold 5
+
+The firmware prints one report per run:
+  BENCH_BEGIN build=<git describe> cpu_hz=... overhead=... count=...
+  BENCH name=<name> iters=... min=... median=... max=...      (cycles)
+  BENCH_END
+Reports are plain text: `capture` keeps exactly those lines, and a raw serial
+log works as input to `show` / `compare` too (the last complete report wins).
+
+`compare` matches benchmarks by name and compares medians. It exits with 1
+when a median grew by more than --threshold percent (regression), so it can
+gate a script.
+
+Capture requires pyserial (pip install pyserial); show/compare have no dependencies.
+"""
+
+import argparse
+import sys
+import time
+
+
+class Report:
+    def __init__(self, header, rows):
+        self.header = header        # dict from BENCH_BEGIN
+        self.rows = rows            # name -> dict (iters, min, median, max)
+
+
+def fields(line):
+    out = {}
+    for tok in line.split()[1:]:
+        key, sep, value = tok.partition("=")
+        if sep:
+            out[key] = int(value) if value.isdigit() else value
+    return out
+
+
+def parse(lines):
+    """Last complete report in `lines`."""
+    found = None
+    header, rows = None, None
+    for raw in lines:
+        line = raw.strip()
+        if line.startswith("BENCH_BEGIN"):
+            header, rows = fields(line), {}
+        elif line.startswith("BENCH ") and rows is not None:
+            f = fields(line)
+            if "name" in f:
+                rows[f["name"]] = f
+        elif line.startswith("BENCH_END") and rows is not None:
+            found = Report(header, rows)
+            header, rows = None, None
+    return found
+
+
+def load(path):
+    with open(path, errors="replace") as f:
+        report = parse(f)
+    if report is None:
+        sys.exit("[Error] %s: no complete BENCH_BEGIN..BENCH_END report" % path)
+    return report
+
+
+def cycles_to_us(cycles, cpu_hz):
+    return cycles * 1e6 / cpu_hz if cpu_hz else 0.0
+
+
+# ---------------------------------------------------------------------------
+# Commands
+# ---------------------------------------------------------------------------
+
+def capture(args):
+    try:
+        import serial  # pyserial
+    except ImportError:
+        sys.exit("[Error] pyserial not found: pip install pyserial")
+
+    ser = serial.Serial(args.port, args.baud, timeout=0.5)
+    deadline = time.time() + args.timeout
+    kept = []
+    while time.time() < deadline:
+        line = ser.readline().decode(errors="replace").strip("\r\n\x00")
+        at = line.find("BENCH")
+        if at < 0:
+            continue
+        line = line[at:]
+        if line.startswith("BENCH_BEGIN"):
+            kept = []
+        kept.append(line)
+        if line.startswith("BENCH_END") and kept[0].startswith("BENCH_BEGIN"):
+            break
+    else:
+        sys.exit("[Error] no complete report within %.0f s" % args.timeout)
+    ser.close()
+
+    with open(args.output, "w") as f:
+        f.write("\n".join(kept) + "\n")
+    report = parse(kept)
+    print("saved %d benchmarks (build %s) to %s" %
+          (len(report.rows), report.header.get("build", "?"), args.output))
+
+
+def show(args):
+    report = load(args.report)
+    hz = report.header.get("cpu_hz", 0)
+    print("build=%s cpu_hz=%s overhead=%s" %
+          (report.header.get("build", "?"), hz, report.header.get("overhead", "?")))
+    print()
+    print("%-20s %7s %10s %10s %10s %10s" % ("name", "iters", "min", "median", "max", "median_us"))
+    for name, r in report.rows.items():
+        print("%-20s %7d %10d %10d %10d %10.2f" %
+              (name, r["iters"], r["min"], r["median"], r["max"], cycles_to_us(r["median"], hz)))
+
+
+def compare(args):
+    old, new = load(args.old), load(args.new)
+    print("old build=%s  new build=%s" % (old.header.get("build", "?"), new.header.get("build", "?")))
+    if old.header.get("cpu_hz") != new.header.get("cpu_hz"):
+        print("[Warn] cpu_hz differs: %s vs %s" % (old.header.get("cpu_hz"), new.header.get("cpu_hz")),
+              file=sys.stderr)
+    print()
+    print("%-20s %10s %10s %9s  %s" % ("name", "old_med", "new_med", "delta", ""))
+
+    regressions = 0
+    for name in list(old.rows) + [n for n in new.rows if n not in old.rows]:
+        a, b = old.rows.get(name), new.rows.get(name)
+        if a is None or b is None:
+            print("%-20s %10s %10s %9s  %s" %
+                  (name, a["median"] if a else "-", b["median"] if b else "-", "", "added" if a is None else "removed"))
+            continue
+        base = a["median"] or 1
+        delta = (b["median"] - a["median"]) * 100.0 / base
+        mark = ""
+        if delta > args.threshold:
+            mark = "REGRESSION"
+            regressions += 1
+        elif delta < -args.threshold:
+            mark = "faster"
+        print("%-20s %10d %10d %+8.1f%%  %s" % (name, a["median"], b["median"], delta, mark))
+
+    print()
+    print("%d regression(s) above %.1f%%" % (regressions, args.threshold))
+    sys.exit(1 if regressions else 0)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Bench reports: capture over serial, show, compare.")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    c = sub.add_parser("capture", help="wait for a report on the serial port and save it")
+    c.add_argument("port")
+    c.add_argument("--baud", type=int, default=115200)
+    c.add_argument("--timeout", type=float, default=60.0, help="seconds to wait for the whole report")
+    c.add_argument("-o", "--output", default="build/bench/report.txt")
+
+    s = sub.add_parser("show", help="print one report as a table")
+    s.add_argument("report")
+
+    m = sub.add_parser("compare", help="median deltas between two reports")
+    m.add_argument("old")
+    m.add_argument("new")
+    m.add_argument("--threshold", type=float, default=5.0, help="percent; larger median growth fails")
+
+    args = ap.parse_args()
+    {"capture": capture, "show": show, "compare": compare}[args.cmd](args)
+
+
+if __name__ == "__main__":
+    main()
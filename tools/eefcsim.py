@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""eefcsim.py — power-loss simulator for the EEFC A/B page commit (src/EEFC.swift).
+
+Usage:
+  tools/eefcsim.py                          # default sweep, exits 1 on any failure
+  tools/eefcsim.py --saves 200 --seed 7 -v
+  tools/eefcsim.py --start-seq 0xFFFFFFF0   # cross the sequence wrap-around
+  tools/eefcsim.py --rule plain             # naive `a > b` rule: must FAIL at the wrap
+
+Model (same format as EEFCStorage, version 3):
+  page = [magic "EEKV" u32][version u32][sequence u32][usedBytes u32][crc u32]
+         [payload][0xFF padding]
+  crc  = ~crc32(sequence LE + usedBytes LE + payload)          (zlib polynomial)
+  A save writes the page NOT holding the newest copy, with sequence+1 (first
+  save: slot 0, sequence 1). Load keeps the valid page(s); with two, the newer
+  sequence in serial-number arithmetic wins.
+
+Every save is replayed once per tear point:
+  - program tear: EWP erased the page, then only words 0..k-1 were written
+    (k = 0 .. pageWords-1);
+  - erase tear: words 0..k-1 erased, the rest still holds the old bytes.
+After each tear the simulator "reboots" (loads from the two pages) and checks
+that recovery returns the previous committed payload; once the page content
+equals the full image (the rest is 0xFF padding anyway) it must return the
+new one. The next save starts from the torn image, so a torn slot is also
+exercised as the write target. Without --start-seq the sweep runs twice: from
+blank pages, then across the sequence wrap-around.
+
+No dependencies.
+"""
+
+import argparse
+import random
+import struct
+import sys
+import zlib
+
+MAGIC = 0x45454B56               # "EEKV"
+VERSION = 3
+HEADER = 20
+ERASED = b"\xff\xff\xff\xff"
+
+
+class Invalid(Exception):
+    pass
+
+
+def page_crc(seq, payload):
+    return ~zlib.crc32(struct.pack("<II", seq, len(payload)) + payload) & 0xFFFFFFFF
+
+
+def build_page(payload, seq, page_size):
+    page = struct.pack("<IIIII", MAGIC, VERSION, seq, len(payload), page_crc(seq, payload)) + payload
+    return page + b"\xff" * (page_size - len(page))
+
+
+def read_slot(page):
+    """(sequence, payload) of a valid page, as EEFCStorage.readSlot."""
+    magic, version, seq, used, crc = struct.unpack_from("<IIIII", page)
+    if magic == 0xFFFFFFFF:
+        raise Invalid("empty")
+    if magic != MAGIC:
+        raise Invalid("badMagic")
+    if version != VERSION:
+        raise Invalid("unsupportedVersion")
+    if used > len(page) - HEADER:
+        raise Invalid("corruptHeader")
+    payload = page[HEADER:HEADER + used]
+    if page_crc(seq, payload) != crc:
+        raise Invalid("crcMismatch")
+    return seq, payload
+
+
+def newer_serial(a, b):
+    d = (a - b) & 0xFFFFFFFF
+    return d != 0 and d < 0x80000000          # Int32(bitPattern: a &- b) > 0
+
+
+def newer_plain(a, b):
+    return a > b
+
+
+def newest(pages, newer):
+    """(slot, sequence, payload) or None, as EEFCStorage.newestSlot."""
+    found = []
+    for slot, page in enumerate(pages):
+        try:
+            seq, payload = read_slot(page)
+        except Invalid:
+            continue
+        found.append((slot, seq, payload))
+    if not found:
+        return None
+    if len(found) == 2 and newer(found[1][1], found[0][1]):
+        return found[1]
+    return found[0]
+
+
+def next_target(active):
+    if active is None:
+        return 0, 1
+    slot, seq, _ = active
+    return (slot + 1) % 2, (seq + 1) & 0xFFFFFFFF
+
+
+def torn_program(image, k):
+    words = len(image) // 4
+    return image[:4 * k] + ERASED * (words - k)
+
+
+def torn_erase(old, k):
+    return ERASED * k + old[4 * k:]
+
+
+def run(args):
+    rng = random.Random(args.seed)
+    page_size = args.page_size
+    words = page_size // 4
+    payload_max = page_size - HEADER
+    newer = newer_serial if args.rule == "serial" else newer_plain
+
+    pages = [b"\xff" * page_size, b"\xff" * page_size]
+    if args.start_seq is not None:
+        # Pre-existing image: the newest copy in slot 1 at start_seq.
+        seed_payload = b"seed"
+        pages[1] = build_page(seed_payload, args.start_seq, page_size)
+    committed = newest(pages, newer_serial)
+
+    checks = failures = 0
+
+    def check(what, expected, pages_now):
+        nonlocal checks, failures
+        checks += 1
+        got = newest(pages_now, newer)
+        want = expected[2] if expected else None
+        have = got[2] if got else None
+        if have != want:
+            failures += 1
+            if failures <= 10:
+                print("[FAIL] %s: expected %s, recovered %s" % (
+                    what,
+                    "seq %d (%d bytes)" % (expected[1], len(want)) if expected else "nothing",
+                    "seq %d slot %d (%d bytes)" % (got[1], got[0], len(have)) if got else "nothing"))
+
+    for n in range(args.saves):
+        size = rng.randint(0, payload_max)
+        payload = bytes(rng.getrandbits(8) for _ in range(size))
+        active = newest(pages, newer_serial)
+        slot, seq = next_target(active)
+        image = build_page(payload, seq, page_size)
+        old = pages[slot]
+
+        for k in range(words):
+            torn = list(pages)
+            torn[slot] = torn_program(image, k)
+            # Once the last non-0xFF word is in, the page already equals the
+            # full image: the save is committed even if EWP never finished.
+            expected = (slot, seq, payload) if torn[slot] == image else committed
+            check("save %d seq %d: program torn after %d words" % (n, seq, k), expected, torn)
+        for k in range(1, words + 1):
+            torn = list(pages)
+            torn[slot] = torn_erase(old, k)
+            check("save %d seq %d: erase torn after %d words" % (n, seq, k), committed, torn)
+
+        # Leave a torn page behind now and then: the next save overwrites it.
+        if rng.random() < args.leave_torn:
+            pages[slot] = torn_program(image, rng.randrange((HEADER + size + 3) // 4))
+            check("save %d seq %d: torn page kept" % (n, seq), committed, pages)
+            if args.verbose:
+                print("save %3d seq %08x slot %d: torn, kept" % (n, seq, slot))
+            continue
+
+        pages[slot] = image
+        committed = (slot, seq, payload)
+        check("save %d seq %d: complete" % (n, seq), committed, pages)
+        if args.verbose:
+            print("save %3d seq %08x slot %d: %3d bytes" % (n, seq, slot, size))
+
+    print("%d saves, %d recovery checks, %d failure(s) (rule=%s, page=%d bytes, start=%s)" %
+          (args.saves, checks, failures, args.rule, page_size,
+           "blank" if args.start_seq is None else "0x%08X" % args.start_seq))
+    return failures
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Tear the EEFC A/B page write after each word and check recovery.")
+    ap.add_argument("--saves", type=int, default=64)
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--page-size", type=int, default=256, help="ATSAM3X8E.NVM.PAGE_SIZE")
+    ap.add_argument("--start-seq", type=lambda s: int(s, 0), default=None,
+                    help="start from an existing copy with this sequence (e.g. 0xFFFFFFF0)")
+    ap.add_argument("--leave-torn", type=float, default=0.1, help="probability a save stays torn")
+    ap.add_argument("--rule", choices=("serial", "plain"), default="serial",
+                    help="sequence comparison used by recovery (plain = broken at the wrap)")
+    ap.add_argument("-v", "--verbose", action="store_true")
+    args = ap.parse_args()
+    if args.page_size % 4 or args.page_size <= HEADER:
+        sys.exit("[Error] page size must be a multiple of 4 above %d" % HEADER)
+
+    failures = run(args)
+    if args.start_seq is None and args.rule == "serial":
+        # Always cover the wrap-around too.
+        args.start_seq = 0xFFFFFFF0
+        failures += run(args)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
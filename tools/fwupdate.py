@@ -0,0 +1,264 @@
+#!/usr/bin/env python3
+"""fwupdate.py — send an A/B image to FirmwareUpdater over the serial port.
+
+Usage:
+  make images
+  tools/fwupdate.py /dev/cu.usbmodem14201            # picks build/firmware_bankN.bin
+  tools/fwupdate.py /dev/ttyACM0 --baud 115200 --no-switch
+  tools/fwupdate.py /dev/ttyACM0 --image build/firmware_bank1.bin
+  tools/fwupdate.py /dev/ttyACM0 --full                 # no delta, send every page
+
+Flow: HELLO (device reports the inactive bank) -> BEGIN(size, crc32) ->
+DATA x N (one 256-byte page per frame, next frame sent on ACK) -> END
+(device checks CRC32 in flash, reports bytes/s) -> SWITCH (GPNVM2 + reset).
+
+Delta (protocol 2, default): before BEGIN the tool reads page CRCs of both
+banks (HASH) and plans every page of the new image as
+  skip    - the target bank already holds it (not erased, not sent)
+  copy    - an identical page exists in the running bank (copied on device)
+  literal - sent as DATA
+If the device rejects a skip/copy (its flash changed), that page goes as DATA.
+If the final CRC still fails, the update is retried once as a full transfer.
+
+Frame format: see the header of src/FirmwareUpdater.swift.
+Requires pyserial (pip install pyserial).
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+import zlib
+
+try:
+    import serial  # pyserial
+except ImportError:
+    sys.exit("[Error] pyserial not found: pip install pyserial")
+
+SOF_HOST = 0xA5
+SOF_DEVICE = 0x5A
+
+HELLO, BEGIN, DATA, END, SWITCH, ABORT, PAGE_OP, HASH = 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08
+ACK, NAK = 0x80, 0x81
+
+OP_SKIP, OP_COPY, OP_LITERAL = 0, 1, None
+
+NAK_NAMES = {
+    1: "bad_frame", 2: "unexpected_frame", 3: "image_too_large", 4: "bad_offset",
+    5: "flash_timeout", 6: "flash_error", 7: "crc_mismatch", 8: "not_verified",
+    9: "gpnvm_failed", 10: "timeout",
+}
+
+CRC_MISMATCH = 7
+
+PAGE = 256
+MAX_HASHES = 32
+
+# Bytes an image may use per bank (bank 1 stops at the reserved NVM pages).
+BANK_LIMIT = {0: 0x40000, 1: 0x000FDC00 - 0x000C0000}
+
+
+class UpdateError(Exception):
+    def __init__(self, message, code=None):
+        super().__init__(message)
+        self.code = code
+
+
+class Link:
+    def __init__(self, port, baud, timeout, retries):
+        self.ser = serial.Serial(port, baud, timeout=timeout)
+        self.retries = retries
+        # Random start: the device replays its last reply for a repeated seq.
+        self.seq = int.from_bytes(os.urandom(2), "little")
+
+    def close(self):
+        self.ser.close()
+
+    def _frame(self, kind, seq, payload):
+        body = struct.pack("<BHH", kind, seq, len(payload)) + payload
+        return bytes([SOF_HOST]) + body + struct.pack("<I", zlib.crc32(body) & 0xFFFFFFFF)
+
+    def _read_reply(self):
+        # Skip anything that is not a reply (boot banners, app prints).
+        while True:
+            b = self.ser.read(1)
+            if not b:
+                return None
+            if b[0] == SOF_DEVICE:
+                break
+        hdr = self.ser.read(5)
+        if len(hdr) != 5:
+            return None
+        kind, seq, n = struct.unpack("<BHH", hdr)
+        rest = self.ser.read(n + 4)
+        if len(rest) != n + 4:
+            return None
+        payload, crc = rest[:n], struct.unpack("<I", rest[n:])[0]
+        if zlib.crc32(hdr + payload) & 0xFFFFFFFF != crc:
+            return None
+        return kind, seq, payload
+
+    def request(self, kind, payload=b""):
+        self.seq = (self.seq + 1) & 0xFFFF
+        frame = self._frame(kind, self.seq, payload)
+        for _ in range(self.retries):
+            self.ser.write(frame)
+            while True:
+                r = self._read_reply()
+                if r is None:
+                    break               # timeout: resend (device replays its reply)
+                rkind, rseq, rpayload = r
+                if rseq != self.seq:
+                    continue            # stale reply
+                if rkind == NAK:
+                    code, detail = struct.unpack("<BI", rpayload[:5])
+                    raise UpdateError("NAK %s (detail=0x%08X)" % (NAK_NAMES.get(code, code), detail), code)
+                return rpayload
+        raise UpdateError("no reply to frame type 0x%02X" % kind)
+
+
+def page_crc(image, i):
+    chunk = image[i * PAGE:(i + 1) * PAGE]
+    return zlib.crc32(chunk + b"\xff" * (PAGE - len(chunk))) & 0xFFFFFFFF
+
+
+def read_hashes(link, bank, npages):
+    out = []
+    while len(out) < npages:
+        n = min(MAX_HASHES, npages - len(out))
+        rep = link.request(HASH, struct.pack("<BHB", bank, len(out), n))
+        out.extend(struct.unpack("<%dI" % n, rep[:4 * n]))
+    return out
+
+
+def plan_delta(link, image, running, target):
+    """One op per page: OP_SKIP, (OP_COPY, src page) or OP_LITERAL."""
+    npages = (len(image) + PAGE - 1) // PAGE
+    new = [page_crc(image, i) for i in range(npages)]
+    have = read_hashes(link, target, npages)
+    old = read_hashes(link, running, min(BANK_LIMIT[running] // PAGE, npages + 64))
+
+    where = {}
+    for j, h in enumerate(old):
+        where.setdefault(h, j)
+
+    plan = []
+    for i, h in enumerate(new):
+        if have[i] == h:
+            plan.append((OP_SKIP, 0, h))
+        elif i < len(old) and old[i] == h:
+            plan.append((OP_COPY, i, h))
+        elif h in where:
+            plan.append((OP_COPY, where[h], h))
+        else:
+            plan.append((OP_LITERAL, 0, h))
+    return plan
+
+
+def send_image(link, image, plan):
+    """BEGIN .. END. plan=None sends every page as DATA."""
+    crc = zlib.crc32(image) & 0xFFFFFFFF
+    npages = (len(image) + PAGE - 1) // PAGE
+    counts = {"literal": 0, "copy": 0, "skip": 0, "fallback": 0}
+
+    link.request(BEGIN, struct.pack("<II", len(image), crc))
+    for i in range(npages):
+        off = i * PAGE
+        op, src, h = plan[i] if plan else (OP_LITERAL, 0, 0)
+        literal = op is OP_LITERAL
+        if not literal:
+            try:
+                link.request(PAGE_OP, struct.pack("<IBHI", off, op, src, h))
+                counts["skip" if op == OP_SKIP else "copy"] += 1
+            except UpdateError as e:
+                if e.code != CRC_MISMATCH:
+                    raise
+                counts["fallback"] += 1
+                literal = True
+        if literal:
+            link.request(DATA, struct.pack("<I", off) + image[off:off + PAGE])
+            counts["literal"] += 1
+        sys.stdout.write("\r[Info] page %4d / %d  (literal %d, copy %d, skip %d)"
+                         % (i + 1, npages, counts["literal"], counts["copy"], counts["skip"]))
+        sys.stdout.flush()
+    print()
+    if counts["fallback"]:
+        print("[Warning] %d skip/copy pages did not match on the device, sent as DATA" % counts["fallback"])
+
+    rep = link.request(END)
+    return struct.unpack("<%dI" % (len(rep) // 4), rep)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="A/B firmware update over serial (FirmwareUpdater).")
+    ap.add_argument("port")
+    ap.add_argument("--baud", type=int, default=115200)
+    ap.add_argument("--image", help="image to send (default: build/firmware_bank<N>.bin for the inactive bank)")
+    ap.add_argument("--build-dir", default=os.path.join(os.path.dirname(__file__), "..", "build"))
+    ap.add_argument("--no-switch", action="store_true", help="verify only, do not switch banks")
+    ap.add_argument("--full", action="store_true", help="send every page (no delta)")
+    ap.add_argument("--timeout", type=float, default=1.0, help="reply timeout (s)")
+    ap.add_argument("--retries", type=int, default=5)
+    args = ap.parse_args()
+
+    link = Link(args.port, args.baud, args.timeout, args.retries)
+    try:
+        info = link.request(HELLO)
+        proto, running, target, boot, page, max_image = struct.unpack("<BBBBHI", info[:10])
+        print("[Info] proto=%d running_bank=%d target_bank=%d boot_bank=%d page=%d max_image=%d"
+              % (proto, running, target, boot, page, max_image))
+
+        path = args.image or os.path.join(args.build_dir, "firmware_bank%d.bin" % target)
+        with open(path, "rb") as f:
+            image = f.read()
+        if args.image and ("bank%d" % target) not in os.path.basename(path):
+            print("[Warning] %s may not be linked for bank %d" % (path, target))
+        if len(image) > max_image:
+            raise UpdateError("image is %d bytes, bank holds %d" % (len(image), max_image))
+
+        crc = zlib.crc32(image) & 0xFFFFFFFF
+        print("[Info] sending %s (%d bytes, crc32=0x%08X)" % (path, len(image), crc))
+
+        t0 = time.time()
+        plan = None
+        if proto >= 2 and not args.full:
+            plan = plan_delta(link, image, running, target)
+            lit = sum(1 for p in plan if p[0] is OP_LITERAL)
+            print("[Info] delta: %d of %d pages to send" % (lit, len(plan)))
+
+        try:
+            rep = send_image(link, image, plan)
+        except UpdateError as e:
+            if plan is None or e.code != CRC_MISMATCH:
+                raise
+            print("[Warning] delta image failed CRC, retrying as a full transfer")
+            rep = send_image(link, image, None)
+
+        nbytes, ms, bps, stalls = rep[:4]
+        host_s = time.time() - t0
+        print("[Success] verified %d bytes in %d ms: device %d B/s, host %.0f B/s, flash stalls %d"
+              % (nbytes, ms, bps, len(image) / host_s if host_s > 0 else 0, stalls))
+        if len(rep) >= 7:
+            print("[Info] pages programmed %d (copied %d), skipped %d" % rep[4:7])
+
+        if args.no_switch:
+            print("[Info] --no-switch: staying on bank %d" % running)
+            return 0
+
+        link.request(SWITCH)
+        print("[Success] boot bank -> %d, device resetting" % target)
+        return 0
+    except UpdateError as e:
+        print("\n[Error] %s" % e)
+        try:
+            link.request(ABORT)
+        except UpdateError:
+            pass
+        return 1
+    finally:
+        link.close()
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,293 @@
+#!/usr/bin/env python3
+"""profile.py — capture and symbolize Profiler (src/Profiler.swift) dumps.
+
+Usage:
+  tools/profile.py capture /dev/ttyACM0 -o build/profile.bin   # waits for "PROFILE <hex>"
+  tools/profile.py report build/profile.bin                     # flat profile
+  tools/profile.py report build/profile.bin --folded build/profile.folded --demangle
+  flamegraph.pl build/profile.folded > build/profile.svg        # or load it in speedscope
+
+The device sends a text line "PROFILE <hex byte count>" and then the binary
+dump (format in the header of src/Profiler.swift, CRC32 at the end).
+`capture` saves only the binary part; `report` also accepts a raw log that
+still contains the text line.
+
+Symbols come from the ELF symbol table (build/firmware.elf). The map file
+(build/firmware.map) gives the object each address was linked from, and
+names for addresses the ELF does not cover.
+
+Folded stacks are at most two frames, "caller;callee": the caller comes
+from the stacked LR. LR is only trustworthy in leaf functions, so when it
+points back into the sampled function the sample is a single frame.
+
+Capture requires pyserial (pip install pyserial); report has no dependencies.
+"""
+
+import argparse
+import bisect
+import collections
+import re
+import shutil
+import struct
+import subprocess
+import sys
+import time
+import zlib
+
+HEADER = struct.Struct("<4s7I")
+ENTRY = struct.Struct("<3I")
+MAGIC = b"PRF1"
+MARKER = b"PROFILE "
+
+
+class Dump:
+    def __init__(self, data):
+        if len(data) < HEADER.size + 4:
+            sys.exit("[Error] dump too short")
+        body, crc = data[:-4], struct.unpack("<I", data[-4:])[0]
+        if zlib.crc32(body) & 0xFFFFFFFF != crc:
+            sys.exit("[Error] dump CRC mismatch (truncated capture?)")
+        magic, self.rate_hz, self.cpu_hz, self.samples, self.dropped, n, self.isr_cycles, _ = \
+            HEADER.unpack_from(body)
+        if magic != MAGIC:
+            sys.exit("[Error] not a Profiler dump (magic %r)" % magic)
+        if len(body) != HEADER.size + n * ENTRY.size:
+            sys.exit("[Error] dump length does not match its entry count")
+        self.entries = [ENTRY.unpack_from(body, HEADER.size + i * ENTRY.size) for i in range(n)]
+
+
+def extract(raw):
+    """Binary dump from a capture that may still hold the text line."""
+    at = raw.find(MARKER)
+    if at < 0:
+        return raw
+    end = raw.find(b"\n", at)
+    size = int(raw[at + len(MARKER):end].strip(), 16)
+    return raw[end + 1:end + 1 + size]
+
+
+# ---------------------------------------------------------------------------
+# Symbols
+# ---------------------------------------------------------------------------
+
+class Symbols:
+    def __init__(self):
+        self.starts = []
+        self.items = []         # (start, end, name)
+
+    def add(self, start, size, name):
+        self.items.append((start, start + size if size else None, name))
+
+    def finish(self):
+        # One name per address; sized (ELF) entries win over map-only ones.
+        self.items.sort(key=lambda it: (it[0], it[1] is None))
+        unique = [it for i, it in enumerate(self.items) if i == 0 or it[0] != self.items[i - 1][0]]
+        fixed = []
+        for i, (start, end, name) in enumerate(unique):
+            if end is None:     # no size: up to the next symbol
+                end = unique[i + 1][0] if i + 1 < len(unique) else start + 4
+            fixed.append((start, end, name))
+        self.items = fixed
+        self.starts = [s for s, _, _ in fixed]
+
+    def lookup(self, addr):
+        i = bisect.bisect_right(self.starts, addr) - 1
+        if i >= 0:
+            start, end, name = self.items[i]
+            if addr < end:
+                return name
+        return None
+
+    def __len__(self):
+        return len(self.items)
+
+
+def elf_symbols(path, syms):
+    data = open(path, "rb").read()
+    if data[:4] != b"\x7fELF":
+        sys.exit("[Error] %s is not an ELF file" % path)
+    is64 = data[4] == 2
+    if is64:
+        shoff, = struct.unpack_from("<Q", data, 0x28)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x3A)
+        sh = struct.Struct("<IIQQQQIIQQ")
+        sym = struct.Struct("<IBBHQQ")
+    else:
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x2E)
+        sh = struct.Struct("<IIIIIIIIII")
+        sym = struct.Struct("<IIIBBH")
+
+    sections = [sh.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+    for s in sections:
+        if s[1] != 2:       # SHT_SYMTAB
+            continue
+        offset, size, link = s[4], s[5], s[6]
+        strtab = sections[link]
+        str_off = strtab[4]
+        for i in range(size // sym.size):
+            f = sym.unpack_from(data, offset + i * sym.size)
+            if is64:
+                name, info, _, shndx, value, sz = f
+            else:
+                name, value, sz, info, _, shndx = f
+            if (info & 0xF) != 2 or shndx == 0:     # STT_FUNC, defined
+                continue
+            end = data.index(b"\0", str_off + name)
+            syms.add(value & ~1, sz, data[str_off + name:end].decode(errors="replace"))
+
+
+MAP_INPUT = re.compile(r"^\s*(?:\.\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+\.(?:o|a\(\S+\)|obj))\s*$")
+MAP_SYMBOL = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_$.][^\s=]*)\s*$")
+
+
+def map_objects(path, syms):
+    """Address ranges per object file; map-only symbols go into `syms`."""
+    objects = Symbols()
+    in_memory_map = False
+    for line in open(path, errors="replace"):
+        if line.startswith("Linker script and memory map"):
+            in_memory_map = True
+            continue
+        if not in_memory_map:
+            continue
+        m = MAP_INPUT.match(line)
+        if m:
+            addr, size = int(m.group(1), 16), int(m.group(2), 16)
+            if size:
+                objects.add(addr, size, m.group(3))
+            continue
+        m = MAP_SYMBOL.match(line)
+        if m:
+            syms.add(int(m.group(1), 16), 0, m.group(2))
+    objects.finish()
+    return objects
+
+
+def demangle(names):
+    tool = shutil.which("swift")
+    if not tool or not names:
+        return {}
+    out = subprocess.run([tool, "demangle", "--simplified", "--compact"], input="\n".join(names),
+                         capture_output=True, text=True)
+    if out.returncode != 0:
+        return {}
+    return dict(zip(names, out.stdout.splitlines()))
+
+
+# ---------------------------------------------------------------------------
+# Commands
+# ---------------------------------------------------------------------------
+
+def capture(args):
+    try:
+        import serial  # pyserial
+    except ImportError:
+        sys.exit("[Error] pyserial not found: pip install pyserial")
+
+    ser = serial.Serial(args.port, args.baud, timeout=0.5)
+    deadline = time.time() + args.timeout
+    line = b""
+    while time.time() < deadline:
+        line = ser.readline()
+        if MARKER in line:
+            line = line[line.index(MARKER):]
+            break
+    else:
+        sys.exit("[Error] no PROFILE line within %.0f s" % args.timeout)
+
+    size = int(line[len(MARKER):].strip(), 16)
+    data = b""
+    while len(data) < size and time.time() < deadline:
+        data += ser.read(size - len(data))
+    ser.close()
+    if len(data) < size:
+        sys.exit("[Error] got %d of %d bytes" % (len(data), size))
+    Dump(data)      # validates
+    open(args.output, "wb").write(data)
+    print("saved %d bytes to %s" % (size, args.output))
+
+
+def report(args):
+    dump = Dump(extract(open(args.dump, "rb").read()))
+
+    syms = Symbols()
+    try:
+        elf_symbols(args.elf, syms)
+    except FileNotFoundError:
+        print("[Warn] %s not found: map symbols only" % args.elf, file=sys.stderr)
+    objects = Symbols()
+    try:
+        objects = map_objects(args.map, syms)
+    except FileNotFoundError:
+        print("[Warn] %s not found: no per-object totals" % args.map, file=sys.stderr)
+    syms.finish()
+
+    def name(addr):
+        return syms.lookup(addr) or "0x%08x" % addr
+
+    flat = collections.Counter()
+    per_object = collections.Counter()
+    folded = collections.Counter()
+    for pc, lr, count in dump.entries:
+        callee = name(pc)
+        flat[callee] += count
+        per_object[objects.lookup(pc) or "?"] += count
+        caller = syms.lookup(lr) if lr else None
+        folded[(caller, callee) if caller and caller != callee else (None, callee)] += count
+
+    pretty = demangle(sorted(set(flat) | {c for c, _ in folded if c})) if args.demangle else {}
+
+    def show(n):
+        return pretty.get(n, n)
+
+    total = sum(flat.values()) or 1
+    overhead = dump.isr_cycles * dump.rate_hz * 100.0 / dump.cpu_hz if dump.cpu_hz else 0.0
+    print("samples=%d dropped=%d rate_hz=%d entries=%d isr_cycles_max=%d (<= %.2f%% CPU)" %
+          (dump.samples, dump.dropped, dump.rate_hz, len(dump.entries), dump.isr_cycles, overhead))
+    print()
+    print("%7s %7s %7s  %s" % ("self%", "cum%", "samples", "function"))
+    cum = 0
+    for fn, count in flat.most_common(args.top):
+        cum += count
+        print("%6.2f%% %6.2f%% %7d  %s" % (count * 100.0 / total, cum * 100.0 / total, count, show(fn)))
+
+    if len(objects):
+        print()
+        print("%7s %7s  %s" % ("self%", "samples", "object"))
+        for obj, count in per_object.most_common():
+            print("%6.2f%% %7d  %s" % (count * 100.0 / total, count, obj))
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for (caller, callee), count in sorted(folded.items(), key=lambda kv: -kv[1]):
+                frames = [show(caller), show(callee)] if caller else [show(callee)]
+                f.write("%s %d\n" % (";".join(s.replace(";", ":") for s in frames), count))
+        print()
+        print("folded stacks: %s" % args.folded)
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Profiler dumps: capture over serial, symbolize, fold.")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    c = sub.add_parser("capture", help="wait for a dump on the serial port and save it")
+    c.add_argument("port")
+    c.add_argument("--baud", type=int, default=115200)
+    c.add_argument("--timeout", type=float, default=60.0, help="seconds to wait for the whole dump")
+    c.add_argument("-o", "--output", default="build/profile.bin")
+
+    r = sub.add_parser("report", help="flat profile + folded stacks")
+    r.add_argument("dump")
+    r.add_argument("--elf", default="build/firmware.elf")
+    r.add_argument("--map", default="build/firmware.map")
+    r.add_argument("--top", type=int, default=30)
+    r.add_argument("--folded", help="write folded stacks here (flamegraph.pl / speedscope)")
+    r.add_argument("--demangle", action="store_true", help="demangle Swift names with `swift demangle`")
+
+    args = ap.parse_args()
+    capture(args) if args.cmd == "capture" else report(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,298 @@
+#!/usr/bin/env python3
+"""sdimage.py — FAT32 disk images with a preallocated FATLog file.
+
+Usage:
+  tools/sdimage.py create card.img --size-mb 1024 --log-mb 900      # MBR + FAT32 + LOG.BIN
+  tools/sdimage.py create card.img --size-mb 64 --name DATA.LOG
+  tools/sdimage.py info card.img
+  tools/sdimage.py dump card.img -o log.bin                         # data bytes of the log
+
+Write an image to a card (whole device, not a partition):
+  sudo dd if=card.img of=/dev/sdX bs=4M conv=fsync
+Read it back for dump/info:
+  sudo dd if=/dev/sdX of=card.img bs=4M count=<size-mb/4>
+
+The log file is contiguous and zero-filled; block 0 of the file is the FATLog
+header, data starts at block 1:
+  [magic "FLOG" u32][version u16][headerBlocks u16][used u32][~used u32][syncs u32]
+dump applies the same recovery as FATLog.mount(): non-zero blocks after `used`
+(up to --window blocks) are included.
+
+The image is written sparse; only metadata blocks take space on the host.
+The same image works with RAMDisk on the board (small sizes) or with a
+file-backed BlockDevice when FATLog.swift is compiled on the host.
+"""
+
+import argparse
+import struct
+import sys
+
+SECTOR = 512
+PART_START = 2048
+RESERVED = 32
+NUM_FATS = 2
+MIN_CLUSTERS = 65525 + 64        # stay clearly in FAT32 territory
+EOC = 0x0FFFFFFF
+MAGIC = 0x474F4C46               # "FLOG"
+VERSION = 1
+
+
+def short_name(name):
+    base, _, ext = name.upper().partition(".")
+    if not base or len(base) > 8 or len(ext) > 3 or "." in ext:
+        sys.exit("[Error] %s is not an 8.3 name" % name)
+    return (base.ljust(8) + ext.ljust(3)).encode("ascii")
+
+
+def layout(part_sectors):
+    """(sectors per cluster, FAT sectors, cluster count) for a FAT32 volume."""
+    spc = 64
+    while spc > 1 and part_sectors // spc < MIN_CLUSTERS:
+        spc //= 2
+    fat = 1
+    while True:
+        clusters = (part_sectors - RESERVED - NUM_FATS * fat) // spc
+        need = ((clusters + 2) * 4 + SECTOR - 1) // SECTOR
+        if need <= fat:
+            break
+        fat = need
+    if clusters < MIN_CLUSTERS:
+        sys.exit("[Error] image too small for FAT32 (use --size-mb 40 or more)")
+    return spc, fat, clusters
+
+
+def create(args):
+    total = args.size_mb * 2048
+    part = total - PART_START
+    spc, fat, clusters = layout(part)
+    cluster_bytes = spc * SECTOR
+
+    # Root directory in cluster 2, log file from cluster 3.
+    log_bytes = (args.log_mb * 1024 * 1024) if args.log_mb else (clusters - 2) * cluster_bytes
+    log_bytes = min(log_bytes, 0xFFFFFFFF // cluster_bytes * cluster_bytes, (clusters - 1) * cluster_bytes)
+    log_clusters = max(1, log_bytes // cluster_bytes)
+    log_bytes = log_clusters * cluster_bytes
+    if log_bytes < 2 * SECTOR * 17:
+        sys.exit("[Error] log file too small")
+
+    fat_lba = PART_START + RESERVED
+    data_lba = fat_lba + NUM_FATS * fat
+
+    with open(args.image, "wb") as f:
+        f.truncate(total * SECTOR)
+
+        def put(lba, data):
+            f.seek(lba * SECTOR)
+            f.write(data)
+
+        # MBR: one FAT32 LBA partition (type 0x0C).
+        mbr = bytearray(SECTOR)
+        mbr[446:462] = struct.pack("<B3sB3sII", 0x00, b"\xfe\xff\xff", 0x0C, b"\xfe\xff\xff", PART_START, part)
+        mbr[510:512] = b"\x55\xaa"
+        put(0, bytes(mbr))
+
+        # Boot sector + FSInfo (and their backups at 6/7).
+        vbr = bytearray(SECTOR)
+        vbr[0:3] = b"\xeb\x58\x90"
+        vbr[3:11] = b"DUELOG  "
+        struct.pack_into("<HBHBHHBHHHII", vbr, 11, SECTOR, spc, RESERVED, NUM_FATS, 0, 0, 0xF8, 0, 63, 255,
+                         PART_START, part)
+        struct.pack_into("<IHHIHH", vbr, 36, fat, 0, 0, 2, 1, 6)
+        struct.pack_into("<BBBI11s8s", vbr, 64, 0x80, 0, 0x29, 0x20260101, b"DUELOG     ", b"FAT32   ")
+        vbr[510:512] = b"\x55\xaa"
+        fsinfo = bytearray(SECTOR)
+        struct.pack_into("<I", fsinfo, 0, 0x41615252)
+        struct.pack_into("<IIII", fsinfo, 484, 0x61417272, clusters - 1 - log_clusters, 3 + log_clusters, 0)
+        struct.pack_into("<I", fsinfo, 508, 0xAA550000)
+        for base in (0, 6):
+            put(PART_START + base, bytes(vbr))
+            put(PART_START + base + 1, bytes(fsinfo))
+
+        # FAT: media, reserved, root EOC, then one contiguous chain.
+        entries = [0x0FFFFFF8, EOC, EOC] + list(range(4, 3 + log_clusters)) + [EOC]
+        table = struct.pack("<%dI" % len(entries), *entries)
+        for n in range(NUM_FATS):
+            put(fat_lba + n * fat, table)
+
+        # Root directory: volume label + the log file (archive, full size).
+        root = bytearray(cluster_bytes)
+        root[0:11] = b"DUELOG     "
+        root[11] = 0x08
+        entry = struct.pack("<11sBBBHHHHHHHI", short_name(args.name), 0x20, 0, 0,
+                            0, 0x5C21, 0x5C21, 0, 0, 0x5C21, 3, log_bytes)
+        root[32:64] = entry
+        put(data_lba, bytes(root))
+
+        # FATLog header: empty log.
+        put(data_lba + spc, struct.pack("<IHHIII", MAGIC, VERSION, 1, 0, 0xFFFFFFFF, 0))
+
+    print("[Success] %s: %d MB, FAT32 %d x %d-byte clusters, %s = %d bytes (%d data blocks)"
+          % (args.image, args.size_mb, clusters, cluster_bytes, args.name.upper(), log_bytes,
+             log_bytes // SECTOR - 1))
+    return 0
+
+
+class Image:
+    """Read-only view of a FAT32 image, same lookup rules as FATLog.swift."""
+
+    def __init__(self, path):
+        self.f = open(path, "rb")
+
+    def read(self, lba, count=1):
+        self.f.seek(lba * SECTOR)
+        data = self.f.read(count * SECTOR)
+        return data + b"\x00" * (count * SECTOR - len(data))
+
+    @staticmethod
+    def is_boot(s):
+        spc = s[13]
+        return (s[0] in (0xEB, 0xE9) and struct.unpack_from("<H", s, 11)[0] == SECTOR and spc
+                and spc & (spc - 1) == 0 and struct.unpack_from("<H", s, 22)[0] == 0
+                and struct.unpack_from("<I", s, 36)[0] != 0)
+
+    def mount(self):
+        s = self.read(0)
+        if s[510:512] != b"\x55\xaa":
+            raise ValueError("no boot signature")
+        part = 0
+        if not self.is_boot(s):
+            for i in range(4):
+                e = 446 + 16 * i
+                if s[e + 4] in (0x0B, 0x0C):
+                    part = struct.unpack_from("<I", s, e + 8)[0]
+                    break
+            else:
+                raise ValueError("no FAT32 partition")
+            s = self.read(part)
+            if not self.is_boot(s):
+                raise ValueError("partition is not FAT32")
+        spc, reserved, fats = s[13], struct.unpack_from("<H", s, 14)[0], s[16]
+        total, fat, root = struct.unpack_from("<I", s, 32)[0], struct.unpack_from("<I", s, 36)[0], \
+            struct.unpack_from("<I", s, 44)[0]
+        self.part, self.spc, self.root = part, spc, root
+        self.fat_lba = part + reserved
+        self.data_lba = self.fat_lba + fats * fat
+        self.clusters = (total - (self.data_lba - part)) // spc
+
+    def next_cluster(self, c):
+        s = self.read(self.fat_lba + c * 4 // SECTOR)
+        return struct.unpack_from("<I", s, c * 4 % SECTOR)[0] & 0x0FFFFFFF
+
+    def cluster_lba(self, c):
+        return self.data_lba + (c - 2) * self.spc
+
+    def find(self, name):
+        want = short_name(name)
+        c = self.root
+        while 2 <= c < 0x0FFFFFF8:
+            d = self.read(self.cluster_lba(c), self.spc)
+            for e in range(0, len(d), 32):
+                if d[e] == 0:
+                    raise ValueError("%s not found" % name)
+                attr = d[e + 11]
+                if d[e] != 0xE5 and attr != 0x0F and not attr & 0x18 and d[e:e + 11] == want:
+                    hi, lo, size = struct.unpack_from("<H", d, e + 20)[0], struct.unpack_from("<H", d, e + 26)[0], \
+                        struct.unpack_from("<I", d, e + 28)[0]
+                    return (hi << 16) | lo, size
+            c = self.next_cluster(c)
+        raise ValueError("%s not found" % name)
+
+    def chain(self, first):
+        n, c = 1, first
+        while True:
+            nxt = self.next_cluster(c)
+            if nxt >= 0x0FFFFFF8:
+                return n, True
+            if nxt != c + 1:
+                return n, False
+            c, n = nxt, n + 1
+
+
+def open_log(args):
+    img = Image(args.image)
+    img.mount()
+    first, size = img.find(args.name)
+    clusters, contiguous = img.chain(first)
+    blocks = min(clusters * img.spc, size // SECTOR)
+    lba = img.cluster_lba(first)
+    hdr = img.read(lba)
+    magic, version, hblocks, used, check, syncs = struct.unpack_from("<IHHIII", hdr, 0)
+    if magic != MAGIC or check != (~used & 0xFFFFFFFF):
+        used, syncs = 0, 0
+    return img, lba, blocks, contiguous, used, syncs
+
+
+def info(args):
+    img, lba, blocks, contiguous, used, syncs = open_log(args)
+    print("partition_lba=%d spc=%d fat_lba=%d data_lba=%d clusters=%d"
+          % (img.part, img.spc, img.fat_lba, img.data_lba, img.clusters))
+    print("file=%s lba=%d blocks=%d contiguous=%d used=%d syncs=%d capacity=%d"
+          % (args.name.upper(), lba, blocks, contiguous, used, syncs, (blocks - 1) * SECTOR))
+    return 0 if contiguous else 1
+
+
+def dump(args):
+    img, lba, blocks, contiguous, used, syncs = open_log(args)
+    if not contiguous:
+        sys.exit("[Error] log file is fragmented")
+    data_lba, data_blocks = lba + 1, blocks - 1
+
+    # Recovery: non-zero blocks written after the last header update.
+    end = used
+    b = used // SECTOR
+    last = min(data_blocks, b + args.window)
+    while b < last:
+        s = img.read(data_lba + b).rstrip(b"\x00")
+        if not s:
+            break
+        end = max(end, b * SECTOR + len(s))
+        b += 1
+
+    out = open(args.output, "wb") if args.output else sys.stdout.buffer
+    pos = 0
+    while pos < end:
+        n = min(end - pos, 1024 * 1024)
+        first = pos // SECTOR
+        chunk = img.read(data_lba + first, (n + SECTOR - 1) // SECTOR)
+        out.write(chunk[:n])
+        pos += n
+    if args.output:
+        out.close()
+    sys.stderr.write("[Info] used=%d recovered=%d total=%d syncs=%d\n" % (used, end - used, end, syncs))
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description="FAT32 images with a preallocated FATLog file.")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    c = sub.add_parser("create", help="new image: MBR + FAT32 + contiguous zero-filled log file")
+    c.add_argument("image")
+    c.add_argument("--size-mb", type=int, default=64)
+    c.add_argument("--log-mb", type=int, default=0, help="log size (default: whole volume)")
+    c.add_argument("--name", default="LOG.BIN")
+    c.set_defaults(func=create)
+
+    i = sub.add_parser("info", help="volume + log file geometry, header")
+    i.add_argument("image")
+    i.add_argument("--name", default="LOG.BIN")
+    i.set_defaults(func=info)
+
+    d = sub.add_parser("dump", help="write the log data bytes to a file (or stdout)")
+    d.add_argument("image")
+    d.add_argument("--name", default="LOG.BIN")
+    d.add_argument("-o", "--output")
+    d.add_argument("--window", type=int, default=2048 + 2 * 16 + 1,
+                   help="recovery scan in blocks (syncEveryBlocks + 2 x bufferBlocks + 1)")
+    d.set_defaults(func=dump)
+
+    args = ap.parse_args()
+    try:
+        return args.func(args)
+    except ValueError as e:
+        print("[Error] %s" % e)
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""udpstream.py — receiver for the UDP stream of examples/EMAC_example.swift.
+
+Usage:
+  tools/udpstream.py 192.168.1.50
+  tools/udpstream.py 192.168.1.50 --seconds 30 --port 5000
+
+Sends START to the device, then prints once per second:
+  Mbit/s of UDP payload, datagrams/s, sequence gaps (lost datagrams),
+  out-of-order datagrams
+and a total line at the end. STOP is sent on exit (also on Ctrl-C).
+
+Each datagram starts with a 32-bit big-endian sequence number.
+Exit status 1 if any datagram was lost.
+"""
+
+import argparse
+import socket
+import struct
+import sys
+import time
+
+
+def main():
+    ap = argparse.ArgumentParser(description="UDP stream receiver (EMAC example).")
+    ap.add_argument("device", help="device IPv4 address")
+    ap.add_argument("--port", type=int, default=5000, help="device UDP port")
+    ap.add_argument("--seconds", type=float, default=10.0, help="measurement time")
+    ap.add_argument("--rcvbuf", type=int, default=4 << 20, help="socket receive buffer (bytes)")
+    args = ap.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, args.rcvbuf)
+    sock.bind(("", 0))
+    sock.settimeout(0.5)
+    dest = (args.device, args.port)
+
+    expected = None
+    total_bytes = total_dgrams = total_lost = total_reorder = 0
+    win_bytes = win_dgrams = win_lost = 0
+    started = False
+
+    try:
+        t_start = time.perf_counter()
+        t_report = t_start + 1.0
+        while time.perf_counter() - t_start < args.seconds:
+            if not started:
+                sock.sendto(b"START", dest)
+            try:
+                data = sock.recv(2048)
+            except socket.timeout:
+                data = None
+
+            if data and len(data) >= 4:
+                started = True
+                (seq,) = struct.unpack(">I", data[:4])
+                if expected is not None:
+                    gap = (seq - expected) & 0xFFFFFFFF
+                    if gap >= 0x80000000:
+                        total_reorder += 1
+                    elif gap:
+                        win_lost += gap
+                        total_lost += gap
+                if expected is None or ((seq - expected) & 0xFFFFFFFF) < 0x80000000:
+                    expected = (seq + 1) & 0xFFFFFFFF
+                win_bytes += len(data)
+                win_dgrams += 1
+                total_bytes += len(data)
+                total_dgrams += 1
+
+            now = time.perf_counter()
+            if now >= t_report:
+                print("mbit_s=%.2f dgrams_s=%d lost=%d" % (win_bytes * 8 / 1e6, win_dgrams, win_lost))
+                win_bytes = win_dgrams = win_lost = 0
+                t_report += 1.0
+        elapsed = time.perf_counter() - t_start
+    finally:
+        sock.sendto(b"STOP", dest)
+        sock.close()
+
+    print("total mbit_s=%.2f dgrams=%d lost=%d reordered=%d" % (
+        total_bytes * 8 / 1e6 / elapsed, total_dgrams, total_lost, total_reorder))
+    sys.exit(1 if total_lost else 0)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,200 @@
+#!/usr/bin/env python3
+"""usbcdc_test.py — protocol checks + throughput for examples/USBSerial_example.swift.
+
+Usage:
+  tools/usbcdc_test.py /dev/ttyACM0
+  tools/usbcdc_test.py /dev/cu.usbmodem14101 --bytes 8000000
+  tools/usbcdc_test.py /dev/ttyACM0 --only throughput
+
+Checks (each prints PASS/FAIL, exit status 1 if any failed):
+  info        I: enumerated, speed and packet size reported, DTR seen
+  baud        SET_LINE_CODING round trip (baud reported back by the device)
+  echo        E: sizes around the packet boundaries (ZLP cases) come back intact
+  pattern     T: device -> host stream matches the pattern, no loss or reorder
+  sum         R: host -> device stream arrives complete (byte sum)
+  throughput  T and R with --bytes, host-side and device-side bytes/s
+
+The pattern is byte i = (i ^ (i >> 8)) & 0xFF, see the example header.
+Requires pyserial (pip install pyserial).
+"""
+
+import argparse
+import os
+import sys
+import time
+
+try:
+    import serial  # pyserial
+except ImportError:
+    sys.exit("[Error] pyserial not found: pip install pyserial")
+
+ECHO_SIZES = [1, 63, 64, 65, 511, 512, 513, 1024, 4095, 4096, 4097]
+PATTERN_SIZES = [1, 64, 512, 4096, 4097, 65536 + 7]
+
+
+class TestError(Exception):
+    pass
+
+
+def pattern(n, start=0):
+    return bytes(((i ^ (i >> 8)) & 0xFF) for i in range(start, start + n))
+
+
+class Device:
+    def __init__(self, port, timeout):
+        # The baud is only line coding for a CDC-ACM device.
+        self.ser = serial.Serial(port, 115200, timeout=timeout)
+        self.ser.dtr = True
+        time.sleep(0.1)
+        self.ser.reset_input_buffer()
+
+    def close(self):
+        self.ser.close()
+
+    def command(self, text):
+        self.ser.write(text.encode() + b"\n")
+
+    def read_exact(self, n):
+        data = bytearray()
+        while len(data) < n:
+            chunk = self.ser.read(n - len(data))
+            if not chunk:
+                raise TestError("timeout after %d of %d bytes" % (len(data), n))
+            data += chunk
+        return bytes(data)
+
+    def reply(self, tag):
+        line = self.ser.readline().decode(errors="replace").strip()
+        if not line.startswith("OK " + tag):
+            raise TestError("expected 'OK %s', got %r" % (tag, line))
+        fields = {}
+        for part in line.split()[2:]:
+            k, _, v = part.partition("=")
+            fields[k] = v
+        return fields
+
+
+def check_info(dev, args):
+    dev.command("I")
+    f = dev.reply("I")
+    if f.get("dtr") != "1":
+        raise TestError("DTR not seen by the device")
+    return "speed=%s packet=%s" % (f.get("speed"), f.get("packet"))
+
+
+def check_baud(dev, args):
+    for baud in (9600, 921600, 115200):
+        dev.ser.baudrate = baud
+        time.sleep(0.05)
+        dev.command("I")
+        f = dev.reply("I")
+        if int(f.get("baud", "0")) != baud:
+            raise TestError("baud %d reported as %s" % (baud, f.get("baud")))
+    return "9600/921600/115200"
+
+
+def check_echo(dev, args):
+    for n in ECHO_SIZES:
+        data = os.urandom(n)
+        dev.command("E %d" % n)
+        dev.ser.write(data)
+        back = dev.read_exact(n)
+        if back != data:
+            bad = next(i for i in range(n) if back[i] != data[i])
+            raise TestError("echo %d: first mismatch at %d" % (n, bad))
+        f = dev.reply("E")
+        if int(f["bytes"]) != n:
+            raise TestError("echo %d: device counted %s" % (n, f["bytes"]))
+    return "%d sizes" % len(ECHO_SIZES)
+
+
+def check_pattern(dev, args):
+    for n in PATTERN_SIZES:
+        dev.command("T %d" % n)
+        data = dev.read_exact(n)
+        if data != pattern(n):
+            bad = next(i for i in range(n) if data[i] != pattern(1, i)[0])
+            raise TestError("stream %d: first mismatch at %d" % (n, bad))
+        dev.reply("T")
+    return "%d sizes" % len(PATTERN_SIZES)
+
+
+def check_sum(dev, args):
+    for n in (1, 512, 4096, 100_000):
+        data = os.urandom(n)
+        dev.command("R %d" % n)
+        dev.ser.write(data)
+        f = dev.reply("R")
+        if int(f["bytes"]) != n or int(f["sum"]) != (sum(data) & 0xFFFFFFFF):
+            raise TestError("receive %d: device got bytes=%s sum=%s" % (n, f["bytes"], f["sum"]))
+    return "4 sizes"
+
+
+def check_throughput(dev, args):
+    n = args.bytes
+    dev.command("T %d" % n)
+    t0 = time.perf_counter()
+    got = 0
+    while got < n:
+        chunk = dev.ser.read(min(1 << 20, n - got))
+        if not chunk:
+            raise TestError("timeout after %d of %d bytes" % (got, n))
+        got += len(chunk)
+    host_in = n / (time.perf_counter() - t0)
+    dev_in = int(dev.reply("T")["bytes_s"])
+
+    data = os.urandom(1 << 16)
+    dev.command("R %d" % n)
+    t0 = time.perf_counter()
+    sent = 0
+    while sent < n:
+        k = min(len(data), n - sent)
+        dev.ser.write(data[:k])
+        sent += k
+    f = dev.reply("R")
+    host_out = n / (time.perf_counter() - t0)
+    dev_out = int(f["bytes_s"])
+    return "in %.2f MB/s (device %.2f)  out %.2f MB/s (device %.2f)" % (
+        host_in / 1e6, dev_in / 1e6, host_out / 1e6, dev_out / 1e6)
+
+
+CHECKS = [
+    ("info", check_info),
+    ("baud", check_baud),
+    ("echo", check_echo),
+    ("pattern", check_pattern),
+    ("sum", check_sum),
+    ("throughput", check_throughput),
+]
+
+
+def main():
+    ap = argparse.ArgumentParser(description="USB CDC-ACM protocol checks + throughput (USBSerial example).")
+    ap.add_argument("port")
+    ap.add_argument("--bytes", type=int, default=4_000_000, help="throughput transfer size")
+    ap.add_argument("--timeout", type=float, default=3.0, help="read timeout (s)")
+    ap.add_argument("--only", choices=[name for name, _ in CHECKS], action="append")
+    args = ap.parse_args()
+
+    dev = Device(args.port, args.timeout)
+    failed = 0
+    try:
+        for name, fn in CHECKS:
+            if args.only and name not in args.only:
+                continue
+            try:
+                detail = fn(dev, args)
+                print("PASS %-10s %s" % (name, detail))
+            except TestError as e:
+                failed += 1
+                print("FAIL %-10s %s" % (name, e))
+                dev.ser.reset_input_buffer()
+        dev.command("S")
+        print("stats " + " ".join("%s=%s" % kv for kv in dev.reply("S").items()))
+    finally:
+        dev.close()
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()